@@ -0,0 +1,6 @@
+#pragma once
+#include "activity_interface.h"
+
+/******** PRIVATE FUNCTIOINS **********/
+float _act_energy(act_handle_t* handle, const float* sample);
+void _act_track_floor(act_handle_t* handle, float energy);
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Speech activity detector, a streaming take on speak_detect in
+ * code/ml/signal_processing.py: the activity energy is the sum of the RMS of the
+ * leading channels, here an exponential RMS so every sample costs O(1).
+ *
+ * The energy is compared against a noise floor tracked while idle. A segment
+ * starts once the energy stays above on_ratio times the floor for min_on samples
+ * and ends after post_roll samples below off_ratio times the floor, or after
+ * max_segment samples so a floor that has drifted away cannot hold the gate open
+ * for good, the floor then starts over from the current energy. The caller
+ * keeps the last pre_roll + min_on samples while idle, act_backlog() says how
+ * many of them belong to the segment when it starts.
+ *
+ * Samples must be high-pass filtered, any DC offset counts as energy.
+ */
+
+#define ACT_MAX_CHANNELS    32
+
+typedef enum {
+    ACT_OK = 0,
+    ACT_ERR_NO_MEM = -1,       ///< Allocation failed
+    ACT_ERR_INVALID = -2,      ///< Bad channel count, window or thresholds
+} act_err_t;
+
+typedef enum {
+    ACT_IDLE,
+    ACT_ACTIVE,
+} act_state_t;
+
+typedef enum {
+    ACT_EVENT_NONE,
+    ACT_EVENT_START,           ///< This sample is the first after the backlog in a new segment
+    ACT_EVENT_END,             ///< This sample is the last of the segment
+} act_event_t;
+
+/// Configuration of a detector, durations in samples
+typedef struct {
+    uint8_t n_channels;        ///< Channels per sample
+    uint8_t n_detect;          ///< Leading channels the energy is taken over, 4 in signal_processing.py
+    uint16_t window;           ///< Time constant of the RMS
+    float on_ratio;            ///< Energy over the noise floor that starts a segment
+    float off_ratio;           ///< Energy over the noise floor that counts as quiet, at most on_ratio
+    uint16_t min_on;           ///< Samples above on_ratio needed to start, rejects clicks
+    uint16_t pre_roll;         ///< Samples before the onset sent with the segment
+    uint16_t post_roll;        ///< Quiet samples sent before the segment ends
+    uint32_t max_segment;      ///< Longest segment, 0 for no limit
+    uint32_t floor_rise_tc;    ///< Time constant the noise floor rises with while idle
+    uint32_t floor_fall_tc;    ///< And falls with, shorter so it settles into the gaps between words
+} act_config_t;
+
+/// What happened since the last act_reset_summary()
+typedef struct {
+    uint32_t n_samples;                  ///< Samples pushed
+    uint32_t active_samples;             ///< Of them in segments, backlog included
+    uint16_t segments;                   ///< Segments started
+    float peak;                          ///< Highest activity energy
+    float sum_sq[ACT_MAX_CHANNELS];      ///< Sum of squares per channel
+} act_summary_t;
+
+typedef struct {
+    act_config_t config;       ///< User passed configuration of the detector
+    act_state_t state;         ///< Whether the last sample was in a segment
+    float ms[ACT_MAX_CHANNELS];///< Exponential mean square per channel
+    float energy;              ///< Activity energy after the last sample
+    float floor;               ///< Noise floor of the energy
+    uint32_t seen;             ///< Samples since reset, saturates
+    uint16_t above;            ///< Consecutive samples above on_ratio while idle
+    uint16_t quiet;            ///< Consecutive samples below off_ratio while active
+    uint32_t length;           ///< Samples in the current segment
+    act_summary_t summary;     ///< Counters for the keep-alive summaries
+} act_handle_t;
+
+/******* PUBLIC FUNCTIONS *********/
+act_err_t act_init(const act_config_t* config, act_handle_t** out_handle);
+void act_deinit(act_handle_t* handle);
+void act_reset(act_handle_t* handle);
+act_event_t act_push(act_handle_t* handle, const float* sample);
+uint32_t act_backlog(act_handle_t* handle);
+void act_get_summary(act_handle_t* handle, act_summary_t* ret_summary);
+void act_reset_summary(act_handle_t* handle);
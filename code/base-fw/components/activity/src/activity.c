@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "activity.h"
+#include "activity_interface.h"
+
+act_err_t act_init(const act_config_t* config, act_handle_t** out_handle)
+{
+    if (config->n_channels == 0 || config->n_channels > ACT_MAX_CHANNELS) return ACT_ERR_INVALID;
+    if (config->n_detect == 0 || config->n_detect > config->n_channels) return ACT_ERR_INVALID;
+    if (config->window == 0 || config->min_on == 0) return ACT_ERR_INVALID;
+    if (config->floor_rise_tc == 0 || config->floor_fall_tc == 0) return ACT_ERR_INVALID;
+    if (!(config->off_ratio > 0) || config->off_ratio > config->on_ratio) return ACT_ERR_INVALID;
+
+    act_handle_t* handle = (act_handle_t*)malloc(sizeof(act_handle_t));
+    if (!handle) return ACT_ERR_NO_MEM;
+    handle->config = *config;
+
+    act_reset(handle);
+    *out_handle = handle;
+    return ACT_OK;
+}
+
+void act_deinit(act_handle_t* handle)
+{
+    free(handle);
+}
+
+void act_reset(act_handle_t* handle)
+{
+    handle->state = ACT_IDLE;
+    memset(handle->ms, 0, sizeof(handle->ms));
+    handle->energy = 0;
+    handle->floor = 0;
+    handle->seen = 0;
+    handle->above = 0;
+    handle->quiet = 0;
+    handle->length = 0;
+    act_reset_summary(handle);
+}
+
+act_event_t act_push(act_handle_t* handle, const float* sample)
+{
+    const act_config_t* c = &(handle->config);
+    act_summary_t* s = &(handle->summary);
+    float energy = _act_energy(handle, sample);
+    s->n_samples++;
+    if (energy > s->peak) s->peak = energy;
+
+    // Let the RMS settle before trusting it, the floor just follows the energy until then
+    if (handle->seen < 4 * (uint32_t)c->window) {
+        handle->seen++;
+        handle->floor = energy;
+        return ACT_EVENT_NONE;
+    }
+    if (handle->seen < UINT32_MAX) handle->seen++;
+
+    if (handle->state == ACT_IDLE) {
+        if (energy <= c->on_ratio * handle->floor) {
+            handle->above = 0;
+            _act_track_floor(handle, energy);
+            return ACT_EVENT_NONE;
+        }
+        if (++handle->above < c->min_on)
+            return ACT_EVENT_NONE;
+
+        handle->state = ACT_ACTIVE;
+        handle->quiet = 0;
+        handle->length = act_backlog(handle) + 1;
+        s->segments++;
+        s->active_samples += handle->length;
+        return ACT_EVENT_START;
+    }
+
+    // Active, the floor holds still so speech never raises it
+    s->active_samples++;
+    handle->length++;
+    if (c->max_segment && handle->length >= c->max_segment) {
+        handle->floor = energy;
+    } else if (energy >= c->off_ratio * handle->floor) {
+        handle->quiet = 0;
+        return ACT_EVENT_NONE;
+    } else if (++handle->quiet <= c->post_roll) {
+        return ACT_EVENT_NONE;
+    }
+
+    handle->state = ACT_IDLE;
+    handle->above = 0;
+    return ACT_EVENT_END;
+}
+
+uint32_t act_backlog(act_handle_t* handle)
+{
+    // Only meaningful right after ACT_EVENT_START: the pre-roll and the samples that crossed on_ratio,
+    // never more than have been pushed
+    uint32_t backlog = handle->config.pre_roll + handle->above - 1;
+    return backlog < handle->seen - 1 ? backlog : handle->seen - 1;
+}
+
+void act_get_summary(act_handle_t* handle, act_summary_t* ret_summary)
+{
+    *ret_summary = handle->summary;
+}
+
+void act_reset_summary(act_handle_t* handle)
+{
+    memset(&(handle->summary), 0, sizeof(handle->summary));
+}
+
+float _act_energy(act_handle_t* handle, const float* sample)
+{
+    const act_config_t* c = &(handle->config);
+    const float alpha = 1.0f / c->window;
+    float energy = 0;
+    for (int ch = 0; ch < c->n_channels; ch++) {
+        float sq = sample[ch] * sample[ch];
+        handle->summary.sum_sq[ch] += sq;
+        if (ch < c->n_detect) {
+            handle->ms[ch] += alpha * (sq - handle->ms[ch]);
+            energy += sqrtf(handle->ms[ch]);
+        }
+    }
+    handle->energy = energy;
+    return energy;
+}
+
+void _act_track_floor(act_handle_t* handle, float energy)
+{
+    // Asymmetric, so it sits near the quiet level between words rather than the average
+    const act_config_t* c = &(handle->config);
+    float tc = energy < handle->floor ? c->floor_fall_tc : c->floor_rise_tc;
+    handle->floor += (energy - handle->floor) / tc;
+}
@@ -1,8 +1,13 @@
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "driver/i2c_master.h"
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "adg715_interface.h"
 #include "adg715.h"
@@ -12,8 +17,13 @@ static const char *TAG = "esp_adg715";
 esp_err_t adg715_init(const adg715_config_t* config, adg715_handle_t** out_handle)
 {
     esp_err_t err;
+    const adg715_i2c_ops_t i2c_ops = config->i2c_ops ? *config->i2c_ops : (adg715_i2c_ops_t) {
+        .probe = _adg715_i2c_probe,
+        .transmit = _adg715_i2c_transmit,
+        .receive = _adg715_i2c_receive,
+    };
 
-    err = i2c_master_probe(config->i2c_bus, config->i2c_addr, 1);
+    err = i2c_ops.probe(config->i2c_bus, config->i2c_addr, 1, i2c_ops.ctx);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to find device with address %x", config->i2c_addr);
         return err;
@@ -28,6 +38,7 @@ esp_err_t adg715_init(const adg715_config_t* config, adg715_handle_t** out_handl
     // copy config into handle
     *handle = (adg715_handle_t) {
         .config = *config,
+        .i2c_ops = i2c_ops,
     };
 
     // Setup reset pin
@@ -46,13 +57,22 @@ esp_err_t adg715_init(const adg715_config_t* config, adg715_handle_t** out_handl
     i2c_device_config_t dev_cfg = {
         .dev_addr_length = I2C_ADDR_BIT_LEN_7,
         .device_address = config->i2c_addr,
-        .scl_speed_hz = 100000,
+        .scl_speed_hz = config->scl_speed_hz ? config->scl_speed_hz : ADG715_SCL_SPEED_HZ,
     };
 
     err = i2c_master_bus_add_device(config->i2c_bus, &dev_cfg, &(handle->i2c_dev));
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize I2C device");
         adg715_deinit(handle); // Release resources
+        return err;
+    }
+
+    // A reset of the ESP alone leaves the switches as they were, start the shadow from the device
+    err = adg715_get(handle, &(handle->state));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read switch state of %x", config->i2c_addr);
+        adg715_deinit(handle);
+        return err;
     }
 
     *out_handle = handle;
@@ -75,13 +95,32 @@ esp_err_t adg715_deinit(adg715_handle_t* handle)
 esp_err_t adg715_set(adg715_handle_t* handle, uint8_t state)
 {
     // Set the state of the ADG715 switches
-    return i2c_master_transmit(handle->i2c_dev, &state, 1, 10);
+    return _adg715_write(handle, state);
+}
+
+esp_err_t adg715_update(adg715_handle_t* handle, uint8_t mask, uint8_t state)
+{
+    // Read-modify-write of the switches in mask, against the shadow so it costs one write at most
+    uint8_t next = (handle->state & ~mask) | (state & mask);
+    if (next == handle->state)
+        return ESP_OK;
+    return _adg715_write(handle, next);
 }
 
 esp_err_t adg715_get(adg715_handle_t* handle, uint8_t* ret_val)
 {
-    // Get the state of the ADG715 switches
-    return i2c_master_receive(handle->i2c_dev, ret_val, 1, 10);
+    // Get the state of the ADG715 switches from the device, and resync the shadow
+    esp_err_t err = handle->i2c_ops.receive(handle->i2c_dev, ret_val, 1, ADG715_I2C_TIMEOUT_MS, handle->i2c_ops.ctx);
+    if (err == ESP_OK)
+        handle->state = *ret_val;
+    return err;
+}
+
+esp_err_t adg715_get_cached(adg715_handle_t* handle, uint8_t* ret_val)
+{
+    // Get the state of the ADG715 switches without touching the bus
+    *ret_val = handle->state;
+    return ESP_OK;
 }
 
 esp_err_t adg715_reset(adg715_handle_t* handle)
@@ -90,6 +129,132 @@ esp_err_t adg715_reset(adg715_handle_t* handle)
     gpio_set_level(handle->config.reset_pin, 0);
     vTaskDelay(10 / portTICK_PERIOD_MS);
     gpio_set_level(handle->config.reset_pin, 1);
+    handle->state = 0x00; // Every switch open after reset
+    return ESP_OK;
+}
+
+esp_err_t adg715_group_init(const adg715_group_config_t* config, adg715_group_t** out_group)
+{
+    if (config->n_devices == 0 || config->n_devices > ADG715_MAX_GROUP)
+        return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < config->n_devices; i++)
+        if (!config->devices[i])
+            return ESP_ERR_INVALID_ARG;
+
+    adg715_group_t* group = (adg715_group_t*)malloc(sizeof(adg715_group_t));
+    if (!group) {
+        ESP_LOGE(TAG, "Failed to allocate memory for ADG715 group");
+        return ESP_ERR_NO_MEM;
+    }
+    group->config = *config;
+    adg715_group_reset_stats(group);
+
+    *out_group = group;
+    return ESP_OK;
+}
+
+esp_err_t adg715_group_deinit(adg715_group_t* group)
+{
+    // The devices belong to the caller
+    free(group);
+    return ESP_OK;
+}
+
+esp_err_t adg715_group_set(adg715_group_t* group, const uint8_t* states)
+{
+    // One write per device whose switches change, back to back so the array spends as little time as
+    // possible half switched. Every device is attempted, the first error is returned.
+    adg715_group_stats_t* stats = &(group->stats);
+    esp_err_t err = ESP_OK;
+    uint32_t writes = 0;
+    int64_t start_us = esp_timer_get_time();
+
+    for (int i = 0; i < group->config.n_devices; i++) {
+        adg715_handle_t* dev = group->config.devices[i];
+        if (dev->state == states[i]) {
+            stats->skipped++;
+            continue;
+        }
+        esp_err_t e = _adg715_write(dev, states[i]);
+        if (e != ESP_OK && err == ESP_OK)
+            err = e;
+        writes++;
+    }
+    if (!writes)
+        return err;
+
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    stats->count++;
+    stats->writes += writes;
+    stats->last_us = elapsed_us;
+    stats->total_us += elapsed_us;
+    if (elapsed_us < stats->min_us) stats->min_us = elapsed_us;
+    if (elapsed_us > stats->max_us) stats->max_us = elapsed_us;
+    return err;
+}
+
+esp_err_t adg715_group_get_cached(adg715_group_t* group, uint8_t* ret_states)
+{
+    for (int i = 0; i < group->config.n_devices; i++)
+        ret_states[i] = group->config.devices[i]->state;
+    return ESP_OK;
+}
+
+esp_err_t adg715_group_reset(adg715_group_t* group)
+{
+    // The devices may share a reset line, as on the board. Every line of the group is pulsed once,
+    // together, and every device's shadow is zeroed, not only the one a line was configured with.
+    uint64_t pins = 0;
+    for (int i = 0; i < group->config.n_devices; i++)
+        pins |= 1ULL << group->config.devices[i]->config.reset_pin;
+
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++)
+        if (pins & (1ULL << pin))
+            gpio_set_level(pin, 0);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++)
+        if (pins & (1ULL << pin))
+            gpio_set_level(pin, 1);
+
+    for (int i = 0; i < group->config.n_devices; i++)
+        group->config.devices[i]->state = 0x00; // Every switch open after reset
+    return ESP_OK;
+}
+
+esp_err_t adg715_group_get_stats(adg715_group_t* group, adg715_group_stats_t* ret_stats)
+{
+    *ret_stats = group->stats;
     return ESP_OK;
 }
 
+esp_err_t adg715_group_reset_stats(adg715_group_t* group)
+{
+    group->stats = (adg715_group_stats_t) {
+        .min_us = INT64_MAX,
+    };
+    return ESP_OK;
+}
+
+esp_err_t _adg715_write(adg715_handle_t* handle, uint8_t state)
+{
+    // The shadow only follows writes the device acknowledged
+    esp_err_t err = handle->i2c_ops.transmit(handle->i2c_dev, &state, 1, ADG715_I2C_TIMEOUT_MS, handle->i2c_ops.ctx);
+    if (err == ESP_OK)
+        handle->state = state;
+    return err;
+}
+
+esp_err_t _adg715_i2c_probe(i2c_master_bus_handle_t bus, uint16_t addr, int timeout_ms, void* ctx)
+{
+    return i2c_master_probe(bus, addr, timeout_ms);
+}
+
+esp_err_t _adg715_i2c_transmit(i2c_master_dev_handle_t dev, const uint8_t* buf, size_t len, int timeout_ms, void* ctx)
+{
+    return i2c_master_transmit(dev, buf, len, timeout_ms);
+}
+
+esp_err_t _adg715_i2c_receive(i2c_master_dev_handle_t dev, uint8_t* buf, size_t len, int timeout_ms, void* ctx)
+{
+    return i2c_master_receive(dev, buf, len, timeout_ms);
+}
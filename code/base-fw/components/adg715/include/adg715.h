@@ -1 +1,10 @@
-void func(void);
+#pragma once
+#include "adg715_interface.h"
+
+#define ADG715_I2C_TIMEOUT_MS   10
+
+/******** PRIVATE FUNCTIOINS **********/
+esp_err_t _adg715_write(adg715_handle_t* handle, uint8_t state);
+esp_err_t _adg715_i2c_probe(i2c_master_bus_handle_t bus, uint16_t addr, int timeout_ms, void* ctx);
+esp_err_t _adg715_i2c_transmit(i2c_master_dev_handle_t dev, const uint8_t* buf, size_t len, int timeout_ms, void* ctx);
+esp_err_t _adg715_i2c_receive(i2c_master_dev_handle_t dev, uint8_t* buf, size_t len, int timeout_ms, void* ctx);
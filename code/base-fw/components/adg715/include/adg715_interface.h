@@ -1,23 +1,74 @@
 #pragma once
+#include <stdbool.h>
 #include "driver/gpio.h"
 #include "driver/i2c_master.h"
 
+#define ADG715_SCL_SPEED_HZ     (400*1000) // Fast mode, the default when the config leaves it at 0
+#define ADG715_MAX_GROUP        8          // Devices in a group, every address the ADG715 can take
+
+/// I2C transfers of the driver, for running it against something other than the I2C master driver
+typedef struct {
+    esp_err_t (*probe)(i2c_master_bus_handle_t bus, uint16_t addr, int timeout_ms, void* ctx);
+    esp_err_t (*transmit)(i2c_master_dev_handle_t dev, const uint8_t* buf, size_t len, int timeout_ms, void* ctx);
+    esp_err_t (*receive)(i2c_master_dev_handle_t dev, uint8_t* buf, size_t len, int timeout_ms, void* ctx);
+    void* ctx;                       ///< Passed to all three
+} adg715_i2c_ops_t;
+
 // Configuration of ADG715 interface
 typedef struct {
     i2c_master_bus_handle_t i2c_bus; ///< I2C bus to use
     uint8_t i2c_addr;                ///< I2C address of ADG715 
     gpio_num_t reset_pin;            ///< ADG715 reset pin 
+    uint32_t scl_speed_hz;           ///< SCL frequency up to 400kHz, 0 for ADG715_SCL_SPEED_HZ
+    const adg715_i2c_ops_t* i2c_ops; ///< I2C transfers, NULL for the ESP-IDF I2C master driver
 } adg715_config_t;
 
 typedef struct {
     adg715_config_t config;           ///< User passed configuration of ADG715 interface
     i2c_master_dev_handle_t i2c_dev;  ///< I2C device handle
+    adg715_i2c_ops_t i2c_ops;         ///< I2C transfers in use
+    uint8_t state;                    ///< Shadow of the switch register, as last written or read
 } adg715_handle_t;
 
+// Configuration of a group of ADG715s switched together
+typedef struct {
+    uint8_t n_devices;                            ///< Devices in the group
+    adg715_handle_t* devices[ADG715_MAX_GROUP];   ///< Initialised devices, state i of a group update goes to device i
+} adg715_group_config_t;
+
+/// Switching latency of adg715_group_set, from the first write starting to the last acknowledged
+typedef struct {
+    uint32_t count;            ///< Updates that wrote at least one device
+    uint32_t writes;           ///< Devices written
+    uint32_t skipped;          ///< Devices left alone because the shadow already matched
+    int64_t last_us;           ///< Latency of the last update
+    int64_t min_us;            ///< Fastest update
+    int64_t max_us;            ///< Slowest update
+    int64_t total_us;          ///< Sum of all updates, for the mean
+} adg715_group_stats_t;
+
+typedef struct {
+    adg715_group_config_t config;     ///< User passed configuration of the group
+    adg715_group_stats_t stats;       ///< Switching latency statistics
+} adg715_group_t;
+
 /******* PUBLIC FUNCTIONS *********/
 esp_err_t adg715_init(const adg715_config_t* config, adg715_handle_t** out_handle);
 esp_err_t adg715_deinit(adg715_handle_t* handle);
 
 esp_err_t adg715_set(adg715_handle_t* handle, uint8_t state);
+esp_err_t adg715_update(adg715_handle_t* handle, uint8_t mask, uint8_t state);
 esp_err_t adg715_get(adg715_handle_t* handle, uint8_t* ret_val);
+esp_err_t adg715_get_cached(adg715_handle_t* handle, uint8_t* ret_val);
+// Pulses the reset pin, which opens every device on it, but only this handle's shadow follows.
+// Devices sharing the pin are reset through adg715_group_reset.
 esp_err_t adg715_reset(adg715_handle_t* handle);
+
+// Several devices, on one bus or more, switched in one call
+esp_err_t adg715_group_init(const adg715_group_config_t* config, adg715_group_t** out_group);
+esp_err_t adg715_group_deinit(adg715_group_t* group);
+esp_err_t adg715_group_set(adg715_group_t* group, const uint8_t* states);
+esp_err_t adg715_group_get_cached(adg715_group_t* group, uint8_t* ret_states);
+esp_err_t adg715_group_reset(adg715_group_t* group);
+esp_err_t adg715_group_get_stats(adg715_group_t* group, adg715_group_stats_t* ret_stats);
+esp_err_t adg715_group_reset_stats(adg715_group_t* group);
@@ -18,7 +18,7 @@
 #define ADS_CONFIG1     0x01
 #define ADS_CONFIG2     0x02
 #define ADS_CONFIG3     0x03
-#define ADS_CONFIG4     0x04
+#define ADS_LOFF        0x04
 #define ADS_CH1SET      0x05
 #define ADS_CH2SET      0x06
 #define ADS_CH3SET      0x07
@@ -37,7 +37,31 @@
 #define ADS_GPIO        0x14
 #define ADS_MISC1       0x15
 #define ADS_MISC2       0x16
+#define ADS_CONFIG4     0x17
+
+/* Register shadow, ID and lead off status are read only */
+#define ADS_WRITABLE_REGS   (0x00FFFFFFUL & ~((1UL << ADS_ID) | (1UL << ADS_LOFF_STATP) | (1UL << ADS_LOFF_STATN)))
+#define ADS_WREG_MAX_GAP    2   // Clean registers a burst write may rewrite to avoid another WREG
+
+/* Data frame, 3 status bytes followed by 8 channels of 3 bytes, repeated per daisy chained device */
+#define ADS_FRAME_SIZE              27
+#define ADS_DMA_BUF_SIZE(n)         (((n) * ADS_FRAME_SIZE + 3) & ~3) // DMA buffers are word sized
+#define ADS_MAX_SAMPLE_RATE         16000 // Samples per second at DR_16KSPS with the 2.048MHz clock
+
+/* Acquisition task */
+#define ADS_ACQ_DRDY_TIMEOUT_MS     100   // Longest wait for DRDY before warning, 250SPS is 4ms
+#define ADS_ACQ_DEFAULT_STACK_SIZE  4096
 
 /******** PRIVATE FUNCTIOINS **********/
+esp_err_t _ads1299_spi_transmit(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx);
+esp_err_t _ads1299_spi_polling_transmit(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx);
 esp_err_t _ads1299_wreg(ads1299_handle_t* handle, uint8_t addr, uint8_t val);
-esp_err_t _ads1299_rreg(ads1299_handle_t* handle, uint8_t addr, uint8_t* ret_val);
\ No newline at end of file
+esp_err_t _ads1299_rreg(ads1299_handle_t* handle, uint8_t addr, uint8_t* ret_val);
+esp_err_t _ads1299_wreg_burst(ads1299_handle_t* handle, uint8_t addr, uint8_t n, const uint8_t* vals);
+esp_err_t _ads1299_rreg_burst(ads1299_handle_t* handle, uint8_t addr, uint8_t n, uint8_t* ret_val);
+void _ads1299_update_reg(ads1299_handle_t* handle, uint8_t addr, uint8_t mask, uint8_t val);
+esp_err_t _ads1299_apply(ads1299_handle_t* handle);
+esp_err_t _ads1299_flush(ads1299_handle_t* handle);
+void _ads1299_drdy_isr(void* arg);
+esp_err_t _ads1299_attach_drdy(ads1299_handle_t* handle);
+void _ads1299_acq_task(void* arg);
@@ -3,6 +3,23 @@
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "telemetry_interface.h"
+
+#define ADS1299_CHANNELS_PER_DEVICE  8
+#define ADS1299_MAX_DEVICES          4    // Daisy chained devices, 32 channels
+#define ADS1299_MAX_CHANNELS         (ADS1299_CHANNELS_PER_DEVICE * ADS1299_MAX_DEVICES)
+#define ADS1299_REG_COUNT            24
+
+/// SPI transfers of the driver, for running it against something other than the SPI master driver
+typedef struct {
+    esp_err_t (*transmit)(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx);         ///< Commands and register access
+    esp_err_t (*polling_transmit)(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx); ///< Conversion reads
+    void* ctx;                                                                                   ///< Passed to both
+} ads1299_spi_ops_t;
+
 /// Configuration of ADS1299 interface
 typedef struct {
     spi_host_device_t spi_host; ///< SPI host to use
@@ -13,12 +30,70 @@ typedef struct {
     gpio_num_t cs_pin;          ///< SPI CS pin
     gpio_num_t drdy_pin;        ///< ADS1299 DRDY pin
     gpio_num_t reset_pin;       ///< ADS1299 reset pin
+    uint8_t n_devices;          ///< ADS1299s daisy chained on the same CS and DRDY, 0 means 1
+    const ads1299_spi_ops_t* spi_ops; ///< SPI transfers, NULL for the ESP-IDF SPI master driver
 } ads1299_config_t;
 
+/// A single conversion captured by the acquisition task
+typedef struct {
+    int64_t timestamp_us;     ///< esp_timer time of the DRDY falling edge
+    uint32_t counter;         ///< DRDY edge count, gaps mean conversions were missed
+    uint32_t status[ADS1299_MAX_DEVICES];  ///< Status word of each device
+    int32_t data[ADS1299_MAX_CHANNELS];    ///< Sign extended channel data, device 0 first
+} ads1299_sample_t;
+
+/// Called from the acquisition task for every conversion, keep it short
+typedef void (*ads1299_sample_cb_t)(const ads1299_sample_t* sample, void* ctx);
+
+/// Configuration of the DRDY driven acquisition task
+typedef struct {
+    ads1299_sample_cb_t on_sample; ///< Sample callback
+    void* ctx;                     ///< User context passed to on_sample
+    UBaseType_t task_priority;     ///< FreeRTOS priority of the acquisition task
+    BaseType_t task_core;          ///< Core to pin the acquisition task to, or tskNO_AFFINITY
+    uint32_t task_stack_size;      ///< Stack size of the acquisition task in bytes
+} ads1299_acq_config_t;
+
+/// Timing statistics of the acquisition task
+typedef struct {
+    uint32_t drdy_count;       ///< DRDY falling edges seen by the ISR
+    uint32_t sample_count;     ///< Conversions read by the acquisition task
+    uint32_t missed_drdy;      ///< DRDY edges that were overrun before the task could read them
+    int64_t latency_min_us;    ///< Shortest DRDY to read complete time
+    int64_t latency_max_us;    ///< Longest DRDY to read complete time
+    int64_t latency_total_us;  ///< Sum of DRDY to read complete times, for the mean
+    int64_t period_min_us;     ///< Shortest time between consecutive DRDY edges
+    int64_t period_max_us;     ///< Longest time between consecutive DRDY edges
+} ads1299_acq_stats_t;
+
 typedef struct {
     ads1299_config_t config;  ///< User passed configuration of ADS1299 interface
     spi_device_handle_t spi;  ///< SPI device handle
+    ads1299_spi_ops_t spi_ops; ///< SPI transfers in use
     uint8_t id;
+    uint8_t n_devices;        ///< Daisy chained devices
+    uint8_t n_channels;       ///< Channels across all devices
+
+    uint8_t regs[ADS1299_REG_COUNT];       ///< Shadow copy of the device registers
+    uint32_t regs_dirty;                   ///< Shadow registers not yet written to the device
+    uint8_t cfg_depth;                     ///< Nesting of ads1299_config_begin
+
+    spi_transaction_ext_t read_trans;      ///< Pre-built RDATAC read transaction
+    uint8_t* read_tx;                      ///< DMA capable transmit buffer of read_trans
+    uint8_t* read_rx;                      ///< DMA capable receive buffer of read_trans
+    tlm_timer_t read_timer;                ///< Cycles of ads1299_read, from starting the SPI transfer to the parsed result
+
+    ads1299_acq_config_t acq_config;       ///< Configuration of the running acquisition task
+    TaskHandle_t acq_task;                 ///< Acquisition task, NULL when not running
+    volatile bool acq_running;             ///< Cleared to ask the acquisition task to exit
+    volatile int64_t drdy_time_us;         ///< Time of the last DRDY edge, written by the ISR
+    volatile int64_t drdy_prev_time_us;    ///< Time of the DRDY edge before that
+    volatile uint32_t drdy_count;          ///< DRDY edges, written by the ISR
+    volatile bool acq_isr_done;            ///< Set by the acquisition task once it attached the DRDY interrupt
+    volatile esp_err_t acq_isr_err;        ///< What attaching it returned
+    ads1299_acq_stats_t acq_stats;         ///< Acquisition timing statistics
+    tlm_timer_t latency_timer;             ///< DRDY edge to conversion read, microseconds counted as cycles
+    portMUX_TYPE acq_lock;                 ///< Guards the DRDY timestamps and statistics
 } ads1299_handle_t;
 
 typedef enum {GAIN_1, GAIN_2, GAIN_4, GAIN_6, GAIN_8, GAIN_12, GAIN_24} ads1299_gain_t;
@@ -33,9 +108,20 @@ esp_err_t ads1299_deinit(ads1299_handle_t* handle);
 
 // Check DRDY
 int ads1299_ready(ads1299_handle_t* handle);
-esp_err_t ads1299_read(ads1299_handle_t* handle, uint32_t* status, int32_t res[]);
+// status holds one word per device, res one value per channel
+esp_err_t ads1299_read(ads1299_handle_t* handle, uint32_t status[], int32_t res[]);
+esp_err_t ads1299_get_channel_count(ads1299_handle_t* handle, uint8_t* ret_val);
 esp_err_t ads1299_acquire_bus(ads1299_handle_t* handle);
 esp_err_t ads1299_release_bus(ads1299_handle_t* handle);
+esp_err_t ads1299_get_read_stats(ads1299_handle_t* handle, tlm_stats_t* ret_stats);
+esp_err_t ads1299_reset_read_stats(ads1299_handle_t* handle);
+
+// DRDY interrupt driven acquisition
+esp_err_t ads1299_acq_start(ads1299_handle_t* handle, const ads1299_acq_config_t* config);
+esp_err_t ads1299_acq_stop(ads1299_handle_t* handle);
+esp_err_t ads1299_acq_get_stats(ads1299_handle_t* handle, ads1299_acq_stats_t* ret_stats);
+esp_err_t ads1299_acq_reset_stats(ads1299_handle_t* handle);
+esp_err_t ads1299_acq_get_latency(ads1299_handle_t* handle, tlm_stats_t* ret_stats);
 
 esp_err_t ads1299_cmd(ads1299_handle_t* handle, uint8_t cmd);
 esp_err_t ads1299_wakeup(ads1299_handle_t* handle);
@@ -46,13 +132,21 @@ esp_err_t ads1299_rdatac(ads1299_handle_t* handle);
 esp_err_t ads1299_sdatac(ads1299_handle_t* handle);
 esp_err_t ads1299_reset(ads1299_handle_t* handle);
 
+// Configuration is kept in a register shadow. Setters write through immediately, unless wrapped
+// in begin/commit, which applies every pending change in one SDATAC window with burst writes.
+esp_err_t ads1299_config_begin(ads1299_handle_t* handle);
+esp_err_t ads1299_config_commit(ads1299_handle_t* handle);
+
+// Daisy chained devices share DIN and CS, so channel settings apply to channel ch of every device
 esp_err_t ads1299_set_ch_all(ads1299_handle_t* handle, bool en);
 esp_err_t ads1299_set_ch(ads1299_handle_t* handle, uint8_t ch, bool en);
 esp_err_t ads1299_get_ch(ads1299_handle_t* handle, uint8_t ch, uint8_t* ret_val);
 esp_err_t ads1299_set_ch_input(ads1299_handle_t* handle, uint8_t ch, ads1299_ch_input_t data);
 esp_err_t ads1299_set_ch_gain(ads1299_handle_t* handle, uint8_t ch, ads1299_gain_t gain);
+esp_err_t ads1299_get_ch_gain(ads1299_handle_t* handle, uint8_t ch, ads1299_gain_t* ret_val);
 esp_err_t ads1299_set_datarate(ads1299_handle_t* handle, ads1299_data_rate_t dr);
 esp_err_t ads1299_get_datarate(ads1299_handle_t* handle, ads1299_data_rate_t* ret_val);
+esp_err_t ads1299_get_sample_rate(ads1299_handle_t* handle, uint32_t* ret_val);
 esp_err_t ads1299_set_impedence_mode(ads1299_handle_t* handle, ads1299_loff_polarity_t loff);
 esp_err_t ads1299_reset_impedence_mode(ads1299_handle_t* handle, ads1299_loff_polarity_t loff);
 esp_err_t ads1299_get_impedence(ads1299_handle_t* handle, ads1299_loff_polarity_t loff, uint8_t* ret_val);
@@ -1,7 +1,13 @@
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_task_wdt.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 #include "ads1299.h"
 #include "ads1299_interface.h"
 
@@ -17,10 +23,42 @@ esp_err_t ads1299_init(const ads1299_config_t* config, ads1299_handle_t** out_ha
         return ESP_ERR_NO_MEM;
     }
     
+    if (config->n_devices > ADS1299_MAX_DEVICES) {
+        free(handle);
+        return ESP_ERR_INVALID_ARG;
+    }
+
     // copy config into handle
     *handle = (ads1299_handle_t) {
         .config = *config,
+        .n_devices = config->n_devices ? config->n_devices : 1,
+        .spi_ops = config->spi_ops ? *config->spi_ops : (ads1299_spi_ops_t) {
+            .transmit = _ads1299_spi_transmit,
+            .polling_transmit = _ads1299_spi_polling_transmit,
+        },
+        .acq_lock = portMUX_INITIALIZER_UNLOCKED,
     };
+    handle->n_channels = handle->n_devices * ADS1299_CHANNELS_PER_DEVICE;
+
+    // Pre-build the read transaction on DMA capable buffers, it is reused for every conversion.
+    // Daisy chained devices shift out back to back, so one burst reads all of them.
+    handle->read_tx = heap_caps_calloc(1, ADS_DMA_BUF_SIZE(handle->n_devices), MALLOC_CAP_DMA);
+    handle->read_rx = heap_caps_calloc(1, ADS_DMA_BUF_SIZE(handle->n_devices), MALLOC_CAP_DMA);
+    if (!handle->read_tx || !handle->read_rx) {
+        ESP_LOGE(TAG, "Failed to allocate DMA buffers for ADS1299 device");
+        ads1299_deinit(handle);
+        return ESP_ERR_NO_MEM;
+    }
+    handle->read_trans = (spi_transaction_ext_t) {
+        .base = (spi_transaction_t) {
+            .flags = SPI_TRANS_VARIABLE_CMD,
+            .length = (handle->n_devices * ADS_FRAME_SIZE * 8),
+            .tx_buffer = handle->read_tx,
+            .rx_buffer = handle->read_rx
+        },
+        .command_bits = 0
+    };
+    ads1299_reset_read_stats(handle);
 
     // Setup DRDY pin
     gpio_config_t gpio_conf = {
@@ -63,18 +101,25 @@ esp_err_t ads1299_init(const ads1299_config_t* config, ads1299_handle_t** out_ha
         // Initialization steps
         ads1299_reset(handle);
         ads1299_sdatac(handle);
-        _ads1299_rreg(handle, ADS_ID, &(handle->id));
-        ESP_LOGI(TAG, "ADS1299 ID: %d", handle->id);
-        _ads1299_wreg(handle, ADS_CONFIG2, 0xD5);
-        _ads1299_wreg(handle, ADS_CONFIG3, 0xFC);
-        // _ads1299_wreg(handle, ADS_MISC1, 0x20);
+
+        // Seed the register shadow with one burst read
+        _ads1299_rreg_burst(handle, ADS_ID, ADS1299_REG_COUNT, handle->regs);
+        handle->id = handle->regs[ADS_ID];
+        ESP_LOGI(TAG, "ADS1299 ID: %d, %d daisy chained device(s)", handle->id, handle->n_devices);
+
+        ads1299_config_begin(handle);
+        // Register writes reach every device in the chain, make sure daisy chain readback is selected
+        _ads1299_update_reg(handle, ADS_CONFIG1, 0x40, 0x00);
+        _ads1299_update_reg(handle, ADS_CONFIG2, 0xFF, 0xD5);
+        _ads1299_update_reg(handle, ADS_CONFIG3, 0xFF, 0xFC);
+        // _ads1299_update_reg(handle, ADS_MISC1, 0xFF, 0x20);
 
         int ch = 0;
         for (ch = 0; ch < 8; ch++)
-            _ads1299_wreg(handle, ADS_CH1SET + ch, 0x60); // configure to default 24x gain and normal input
+            _ads1299_update_reg(handle, ADS_CH1SET + ch, 0xFF, 0x60); // configure to default 24x gain and normal input
+        ads1299_config_commit(handle);
 
         ads1299_start(handle);
-        ads1299_rdatac(handle);
 
         *out_handle = handle;
         return ESP_OK;
@@ -89,6 +134,8 @@ esp_err_t ads1299_deinit(ads1299_handle_t* handle)
 {
     esp_err_t err = ESP_OK;
 
+    ads1299_acq_stop(handle);
+
     // Deregister gpio pin
     gpio_reset_pin(handle->config.drdy_pin);
 
@@ -97,6 +144,8 @@ esp_err_t ads1299_deinit(ads1299_handle_t* handle)
         handle->spi = NULL;
     }
 
+    heap_caps_free(handle->read_tx);
+    heap_caps_free(handle->read_rx);
     free(handle); // Release the allocated heap memory
     return err;
 }
@@ -106,38 +155,38 @@ int ads1299_ready(ads1299_handle_t* handle)
     return !gpio_get_level(handle->config.drdy_pin);
 }
 
-esp_err_t ads1299_read(ads1299_handle_t* handle, uint32_t* status, int32_t res[])
+esp_err_t ads1299_read(ads1299_handle_t* handle, uint32_t status[], int32_t res[])
 {
-    const uint8_t data_len = 8;
-
-    uint8_t transmit_buf[27] = {0x00};
-    uint8_t receive_buf[27] = {0x00};
-
-    spi_transaction_ext_t t = {
-        .base = (spi_transaction_t) {
-            .flags = SPI_TRANS_VARIABLE_CMD,
-            .length = (27 * 8),
-            .tx_buffer = transmit_buf,
-            .rx_buffer = receive_buf
-        },
-        .command_bits = 0
-    };
-
-    esp_err_t err = spi_device_transmit(handle->spi, &t);
+    uint32_t start = tlm_start();
 
+    // A frame of a few 27 byte blocks is over before an interrupt driven transaction would even be scheduled, so poll
+    esp_err_t err = handle->spi_ops.polling_transmit(handle->spi, &(handle->read_trans.base), handle->spi_ops.ctx);
     if (err != ESP_OK) return err;
 
-    // Parse the received data
-    for (int i = 0; i < data_len; i++) {
-        // Off by 4 because first three is status
-        // Sign conversion from 24 bit to 32 bit
-        res[i] = (int32_t) (((receive_buf[i*3+3] & 0x80) ? (0xFF) : (0x00)) << 24 |
-                ((receive_buf[i*3+3] & 0xFF) << 16) |
-                ((receive_buf[i*3+4] & 0xFF) << 8)  |
-                ((receive_buf[i*3+5] & 0xFF) << 0));
+    // Parse the received data, one frame per device
+    for (int dev = 0; dev < handle->n_devices; dev++) {
+        const uint8_t* receive_buf = handle->read_rx + dev * ADS_FRAME_SIZE;
+        int32_t* dev_res = res + dev * ADS1299_CHANNELS_PER_DEVICE;
+
+        for (int i = 0; i < ADS1299_CHANNELS_PER_DEVICE; i++) {
+            // Off by 4 because first three is status
+            // Sign conversion from 24 bit to 32 bit
+            dev_res[i] = (int32_t) (((receive_buf[i*3+3] & 0x80) ? (0xFF) : (0x00)) << 24 |
+                    ((receive_buf[i*3+3] & 0xFF) << 16) |
+                    ((receive_buf[i*3+4] & 0xFF) << 8)  |
+                    ((receive_buf[i*3+5] & 0xFF) << 0));
+        }
+
+        status[dev] = (receive_buf[0] << 16) | (receive_buf[1] << 8) | receive_buf[2];
     }
 
-    *status = (receive_buf[0] << 16) | (receive_buf[1] << 8) | receive_buf[2];
+    tlm_timer_stop(&(handle->read_timer), start);
+    return ESP_OK;
+}
+
+esp_err_t ads1299_get_channel_count(ads1299_handle_t* handle, uint8_t* ret_val)
+{
+    *ret_val = handle->n_channels;
     return ESP_OK;
 }
 
@@ -152,6 +201,194 @@ esp_err_t ads1299_release_bus(ads1299_handle_t* handle)
     return ESP_OK;
 }
 
+esp_err_t ads1299_get_read_stats(ads1299_handle_t* handle, tlm_stats_t* ret_stats)
+{
+    tlm_timer_read(&(handle->read_timer), ret_stats);
+    return ESP_OK;
+}
+
+esp_err_t ads1299_reset_read_stats(ads1299_handle_t* handle)
+{
+    // Only while nothing reads, like the acquisition task
+    tlm_timer_reset(&(handle->read_timer));
+    return ESP_OK;
+}
+
+esp_err_t ads1299_acq_start(ads1299_handle_t* handle, const ads1299_acq_config_t* config)
+{
+    if (!config->on_sample) return ESP_ERR_INVALID_ARG;
+    if (handle->acq_task) return ESP_ERR_INVALID_STATE;
+
+    handle->acq_config = *config;
+    if (!handle->acq_config.task_stack_size)
+        handle->acq_config.task_stack_size = ADS_ACQ_DEFAULT_STACK_SIZE;
+
+    ads1299_acq_reset_stats(handle);
+    handle->acq_running = true;
+    handle->acq_isr_done = false;
+
+    BaseType_t created = xTaskCreatePinnedToCore(_ads1299_acq_task, "ads1299_acq",
+        handle->acq_config.task_stack_size, handle, handle->acq_config.task_priority,
+        &(handle->acq_task), handle->acq_config.task_core);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create acquisition task");
+        handle->acq_running = false;
+        handle->acq_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The task attaches the DRDY interrupt itself
+    while (!handle->acq_isr_done)
+        vTaskDelay(1);
+    if (handle->acq_isr_err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to attach DRDY interrupt");
+        ads1299_acq_stop(handle);
+        return handle->acq_isr_err;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t ads1299_acq_stop(ads1299_handle_t* handle)
+{
+    if (!handle->acq_task) return ESP_OK;
+
+    gpio_isr_handler_remove(handle->config.drdy_pin);
+    gpio_set_intr_type(handle->config.drdy_pin, GPIO_INTR_DISABLE);
+
+    // Wake the task so it sees the flag, it clears acq_task on its way out
+    handle->acq_running = false;
+    xTaskNotifyGive(handle->acq_task);
+    while (handle->acq_task)
+        vTaskDelay(1);
+
+    return ESP_OK;
+}
+
+esp_err_t ads1299_acq_get_stats(ads1299_handle_t* handle, ads1299_acq_stats_t* ret_stats)
+{
+    portENTER_CRITICAL(&(handle->acq_lock));
+    *ret_stats = handle->acq_stats;
+    ret_stats->drdy_count = handle->drdy_count;
+    portEXIT_CRITICAL(&(handle->acq_lock));
+    return ESP_OK;
+}
+
+esp_err_t ads1299_acq_reset_stats(ads1299_handle_t* handle)
+{
+    portENTER_CRITICAL(&(handle->acq_lock));
+    handle->acq_stats = (ads1299_acq_stats_t) {
+        .latency_min_us = INT64_MAX,
+        .period_min_us = INT64_MAX,
+    };
+    handle->drdy_count = 0;
+    handle->drdy_time_us = 0;
+    handle->drdy_prev_time_us = 0;
+    portEXIT_CRITICAL(&(handle->acq_lock));
+    // Only while the acquisition task is stopped, it writes the timer
+    tlm_timer_reset(&(handle->latency_timer));
+    return ESP_OK;
+}
+
+esp_err_t ads1299_acq_get_latency(ads1299_handle_t* handle, tlm_stats_t* ret_stats)
+{
+    tlm_timer_read(&(handle->latency_timer), ret_stats);
+    return ESP_OK;
+}
+
+esp_err_t _ads1299_attach_drdy(ads1299_handle_t* handle)
+{
+    // The ISR service may already be installed by another component, on whichever core that ran
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+        return err;
+
+    gpio_set_intr_type(handle->config.drdy_pin, GPIO_INTR_NEGEDGE);
+    return gpio_isr_handler_add(handle->config.drdy_pin, _ads1299_drdy_isr, handle);
+}
+
+void IRAM_ATTR _ads1299_drdy_isr(void* arg)
+{
+    ads1299_handle_t* handle = (ads1299_handle_t*)arg;
+    BaseType_t woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&(handle->acq_lock));
+    handle->drdy_prev_time_us = handle->drdy_time_us;
+    handle->drdy_time_us = esp_timer_get_time();
+    handle->drdy_count++;
+    portEXIT_CRITICAL_ISR(&(handle->acq_lock));
+
+    vTaskNotifyGiveFromISR(handle->acq_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void _ads1299_acq_task(void* arg)
+{
+    ads1299_handle_t* handle = (ads1299_handle_t*)arg;
+    ads1299_acq_stats_t* stats = &(handle->acq_stats);
+    bool wdt = (esp_task_wdt_add(NULL) == ESP_OK);
+    const uint32_t mhz = tlm_cpu_mhz();
+
+    // Interrupts are allocated on the core that installs them, so from here DRDY is handled on this
+    // task's core, away from WiFi's. On failure ads1299_acq_start() stops the task again.
+    handle->acq_isr_err = _ads1299_attach_drdy(handle);
+    handle->acq_isr_done = true;
+
+    uint32_t taken = 0; // DRDY edges accounted for, read or missed
+    while (handle->acq_running) {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ADS_ACQ_DRDY_TIMEOUT_MS));
+        if (wdt) esp_task_wdt_reset();
+        if (!handle->acq_running) break;
+
+        if (pending == 0) {
+            ESP_LOGW(TAG, "No DRDY for %d ms", ADS_ACQ_DRDY_TIMEOUT_MS);
+            continue;
+        }
+
+        // Stamp the sample with the latest edge now, before the read, so an edge arriving during
+        // the SPI transfer is left for the next sample. A notification for an edge already taken
+        // here has nothing new to read.
+        ads1299_sample_t sample;
+        portENTER_CRITICAL(&(handle->acq_lock));
+        uint32_t count = handle->drdy_count;
+        sample.timestamp_us = handle->drdy_time_us;
+        int64_t period_us = sample.timestamp_us - handle->drdy_prev_time_us;
+        bool has_period = (handle->drdy_prev_time_us != 0);
+        portEXIT_CRITICAL(&(handle->acq_lock));
+        if (count == taken)
+            continue;
+        sample.counter = count - 1;
+        uint32_t missed = count - taken - 1; // Edges overrun before the task got to them
+        taken = count;
+
+        if (ads1299_read(handle, sample.status, sample.data) != ESP_OK)
+            continue;
+        int64_t done_us = esp_timer_get_time();
+
+        int64_t latency_us = done_us - sample.timestamp_us;
+        tlm_timer_add(&(handle->latency_timer),
+                      latency_us < UINT32_MAX / mhz ? (uint32_t)latency_us * mhz : UINT32_MAX);
+
+        portENTER_CRITICAL(&(handle->acq_lock));
+        stats->sample_count++;
+        stats->missed_drdy += missed;
+        stats->latency_total_us += latency_us;
+        if (latency_us < stats->latency_min_us) stats->latency_min_us = latency_us;
+        if (latency_us > stats->latency_max_us) stats->latency_max_us = latency_us;
+        if (has_period) {
+            if (period_us < stats->period_min_us) stats->period_min_us = period_us;
+            if (period_us > stats->period_max_us) stats->period_max_us = period_us;
+        }
+        portEXIT_CRITICAL(&(handle->acq_lock));
+
+        handle->acq_config.on_sample(&sample, handle->acq_config.ctx);
+    }
+
+    if (wdt) esp_task_wdt_delete(NULL);
+    handle->acq_task = NULL;
+    vTaskDelete(NULL);
+}
+
 esp_err_t ads1299_cmd(ads1299_handle_t* handle, uint8_t cmd)
 {
     spi_transaction_t t = {
@@ -159,7 +396,7 @@ esp_err_t ads1299_cmd(ads1299_handle_t* handle, uint8_t cmd)
         .length = 0,
     };
 
-    esp_err_t err = spi_device_transmit(handle->spi, &t);
+    esp_err_t err = handle->spi_ops.transmit(handle->spi, &t, handle->spi_ops.ctx);
     if (err != ESP_OK) {
         return err;
     }
@@ -175,62 +412,48 @@ esp_err_t ads1299_rdatac(ads1299_handle_t* handle) { return ads1299_cmd(handle,
 esp_err_t ads1299_sdatac(ads1299_handle_t* handle) { return ads1299_cmd(handle, ADS_SDATAC); }
 esp_err_t ads1299_reset(ads1299_handle_t* handle) { return ads1299_cmd(handle, ADS_RESET); }
 
-esp_err_t ads1299_set_ch_all(ads1299_handle_t* handle, bool en)
+esp_err_t ads1299_config_begin(ads1299_handle_t* handle)
 {
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
+    handle->cfg_depth++;
+    return ESP_OK;
+}
 
-    ads1299_sdatac(handle);
-    for (int ch = 0; ch < 8; ch++) {
-        ret = _ads1299_rreg(handle, ADS_CH1SET + ch, &reg);
-        if (ret != ESP_OK) return ret;
-        ret = _ads1299_wreg(handle, ADS_CH1SET + ch, en ? (reg & 0x7F) : (reg | 0x80));
-        if (ret != ESP_OK) return ret;
-    }
-    ads1299_rdatac(handle);
-    return ret;
+esp_err_t ads1299_config_commit(ads1299_handle_t* handle)
+{
+    if (handle->cfg_depth == 0) return ESP_ERR_INVALID_STATE;
+    if (--handle->cfg_depth) return ESP_OK; // Nested, the outermost commit writes
+    return _ads1299_flush(handle);
+}
+
+esp_err_t ads1299_set_ch_all(ads1299_handle_t* handle, bool en)
+{
+    for (int ch = 0; ch < 8; ch++)
+        _ads1299_update_reg(handle, ADS_CH1SET + ch, 0x80, en ? 0x00 : 0x80);
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_set_ch(ads1299_handle_t* handle, uint8_t ch, bool en)
 {
     if (0 > ch || ch > 7) return ESP_ERR_INVALID_ARG;
 
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CH1SET + ch, &reg);
-    if (ret != ESP_OK) return ret;
-    ret = _ads1299_wreg(handle, ADS_CH1SET + ch, en ? (reg & 0x7F) : (reg | 0x80));
-    if (ret != ESP_OK) return ret;
-    ads1299_rdatac(handle);
-    return ret;
+    _ads1299_update_reg(handle, ADS_CH1SET + ch, 0x80, en ? 0x00 : 0x80);
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_get_ch(ads1299_handle_t* handle, uint8_t ch, uint8_t* ret_val)
 {
     if (ch < 0 || ch > 7) return ESP_ERR_INVALID_ARG;
-        
-    esp_err_t ret = ESP_OK;
 
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CH1SET + ch, ret_val);
-    ads1299_rdatac(handle);
-    return ret;
+    *ret_val = handle->regs[ADS_CH1SET + ch];
+    return ESP_OK;
 }
 
 esp_err_t ads1299_set_ch_input(ads1299_handle_t* handle, uint8_t ch, ads1299_ch_input_t data)
 {
     if (ch < 0 || ch > 7) return ESP_ERR_INVALID_ARG;
 
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CH1SET + ch, &reg);
-    ret = _ads1299_wreg(handle, ADS_CH1SET + ch, (reg & 0xF8) | data);
-    ads1299_rdatac(handle);
-    return ret;
+    _ads1299_update_reg(handle, ADS_CH1SET + ch, 0x07, data);
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_set_ch_gain(ads1299_handle_t* handle, uint8_t ch, ads1299_gain_t gain)
@@ -238,88 +461,63 @@ esp_err_t ads1299_set_ch_gain(ads1299_handle_t* handle, uint8_t ch, ads1299_gain
     if (ch < 0 || ch > 7) 
         return ESP_ERR_INVALID_ARG;
 
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CH1SET + ch, &reg);
-    ret = _ads1299_wreg(handle, ADS_CH1SET + ch, (reg & 0x8F) | gain);
-    ads1299_rdatac(handle);
-    return ret;
+    _ads1299_update_reg(handle, ADS_CH1SET + ch, 0x70, gain << 4);
+    return _ads1299_apply(handle);
 }
 
-esp_err_t ads1299_set_srb2_ch(ads1299_handle_t* handle, uint8_t ch, bool en) 
+esp_err_t ads1299_get_ch_gain(ads1299_handle_t* handle, uint8_t ch, ads1299_gain_t* ret_val)
 {
     if (ch < 0 || ch > 7) return ESP_ERR_INVALID_ARG;
 
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
+    *ret_val = (handle->regs[ADS_CH1SET + ch] >> 4) & 0x07;
+    return ESP_OK;
+}
 
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CH1SET + ch, &reg);
-    ret = _ads1299_wreg(handle, ADS_CH1SET + ch, en ? (reg | 0x08) : (reg & (~0x08)));
-    ads1299_rdatac(handle);
-    return ret;
+esp_err_t ads1299_set_srb2_ch(ads1299_handle_t* handle, uint8_t ch, bool en) 
+{
+    if (ch < 0 || ch > 7) return ESP_ERR_INVALID_ARG;
 
+    _ads1299_update_reg(handle, ADS_CH1SET + ch, 0x08, en ? 0x08 : 0x00);
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_set_datarate(ads1299_handle_t* handle, ads1299_data_rate_t dr)
 {
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CONFIG1, &reg);
-    ret = _ads1299_wreg(handle, ADS_CONFIG1, (reg & 0xF8) | dr);
-    ads1299_rdatac(handle);
-    return ret;
+    _ads1299_update_reg(handle, ADS_CONFIG1, 0x07, dr);
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_get_datarate(ads1299_handle_t* handle, ads1299_data_rate_t* ret_val)
 {
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    ret = _ads1299_rreg(handle, ADS_CONFIG1, &reg);
-    ads1299_rdatac(handle);
+    *ret_val = handle->regs[ADS_CONFIG1] & 0x07;
+    return ESP_OK;
+}
 
-    // ESP_LOGI(TAG, "reg in hexadecimal: 0x%02X", reg);
-    *ret_val = reg & 0x07;
-    return ret;
+esp_err_t ads1299_get_sample_rate(ads1299_handle_t* handle, uint32_t* ret_val)
+{
+    // fMOD / 64 at DR_16KSPS, halving with every step of the rate code
+    *ret_val = ADS_MAX_SAMPLE_RATE >> (handle->regs[ADS_CONFIG1] & 0x07);
+    return ESP_OK;
 }
 
 esp_err_t ads1299_set_impedence_mode(ads1299_handle_t* handle, ads1299_loff_polarity_t loff)
 {
-    uint8_t reg = 0;
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    for (int ch = 0; ch < 8; ch++) {
-        ret = _ads1299_rreg(handle, ADS_CH1SET + ch, &reg);
-        // Set gain to 1 and ch input to normal
-        ret = _ads1299_wreg(handle, ADS_CH1SET + ch, (reg & 0x88));
-
-        if (ret != ESP_OK)
-            break;
-    }
-    ret = _ads1299_wreg(handle, (loff ? ADS_LOFF_SENSN : ADS_LOFF_SENSP), 0xFF); // Enable all channels
-    ads1299_rdatac(handle);
-    return ret;
+    // Set gain to 1 and ch input to normal
+    for (int ch = 0; ch < 8; ch++)
+        _ads1299_update_reg(handle, ADS_CH1SET + ch, 0x77, 0x00);
+    _ads1299_update_reg(handle, (loff ? ADS_LOFF_SENSN : ADS_LOFF_SENSP), 0xFF, 0xFF); // Enable all channels
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_reset_impedence_mode(ads1299_handle_t* handle, ads1299_loff_polarity_t loff)
 {
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    _ads1299_wreg(handle, (loff ? ADS_LOFF_SENSN : ADS_LOFF_SENSP), 0x00); // Enable all channels
-    ads1299_rdatac(handle);
-    return ret;
+    _ads1299_update_reg(handle, (loff ? ADS_LOFF_SENSN : ADS_LOFF_SENSP), 0xFF, 0x00); // Disable all channels
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_get_impedence(ads1299_handle_t* handle, ads1299_loff_polarity_t loff, uint8_t* ret_val)
 {
+    // Lead off status is live, read it from the device rather than the shadow
     esp_err_t ret = ESP_OK;
 
     ads1299_sdatac(handle);
@@ -330,83 +528,128 @@ esp_err_t ads1299_get_impedence(ads1299_handle_t* handle, ads1299_loff_polarity_
 
 esp_err_t ads1299_set_bias_all(ads1299_handle_t* handle, ads1299_bias_polarity_t bias, bool en)
 {
-    esp_err_t ret = ESP_OK;
-
-    ads1299_sdatac(handle);
-    ret = _ads1299_wreg(handle, bias ? ADS_BIAS_SENSN : ADS_BIAS_SENSP, en ? 0xFF : 0x00);
-    if (ret != ESP_OK) return ret;
-    ret = _ads1299_wreg(handle, ADS_CONFIG3, en ? 0xEC : 0xE0);
-    if (ret != ESP_OK) return ret;
-    ads1299_rdatac(handle);
-    return ret;
+    _ads1299_update_reg(handle, bias ? ADS_BIAS_SENSN : ADS_BIAS_SENSP, 0xFF, en ? 0xFF : 0x00);
+    _ads1299_update_reg(handle, ADS_CONFIG3, 0xFF, en ? 0xEC : 0xE0);
+    return _ads1299_apply(handle);
 }
 
 esp_err_t ads1299_set_bias_ch(ads1299_handle_t* handle, uint8_t ch, ads1299_bias_polarity_t bias, bool en)
 {
     if (ch < 0 || ch > 7) return ESP_ERR_INVALID_ARG;
 
-    uint8_t reg = 0;
+    _ads1299_update_reg(handle, bias ? ADS_BIAS_SENSN : ADS_BIAS_SENSP, 1 << ch, en ? (1 << ch) : 0x00);
+    _ads1299_update_reg(handle, ADS_CONFIG3, 0xFF, en ? 0xEC : 0xE0);
+    return _ads1299_apply(handle);
+}
+
+void _ads1299_update_reg(ads1299_handle_t* handle, uint8_t addr, uint8_t mask, uint8_t val)
+{
+    uint8_t reg = (handle->regs[addr] & ~mask) | (val & mask);
+    if (reg == handle->regs[addr]) return;
+
+    handle->regs[addr] = reg;
+    handle->regs_dirty |= (1UL << addr);
+}
+
+esp_err_t _ads1299_apply(ads1299_handle_t* handle)
+{
+    // Inside a begin/commit block the write is deferred to the commit
+    if (handle->cfg_depth) return ESP_OK;
+    return _ads1299_flush(handle);
+}
+
+esp_err_t _ads1299_flush(ads1299_handle_t* handle)
+{
+    if (!handle->regs_dirty) return ESP_OK;
+
     esp_err_t ret = ESP_OK;
+    int writes = 0;
 
     ads1299_sdatac(handle);
-    ret = _ads1299_wreg(handle, bias ? ADS_BIAS_SENSN : ADS_BIAS_SENSP, &reg);
-    if (ret != ESP_OK) return ret; // TODO: remove this so rdatac is run properly
-    ret = _ads1299_wreg(handle, bias ? ADS_BIAS_SENSN : ADS_BIAS_SENSP, en ? (reg | (1 << ch)) : (reg & ~(1 << ch)));
-    if (ret != ESP_OK) return ret;
-    ret = _ads1299_wreg(handle, ADS_CONFIG3, en ? 0xEC : 0xE0);
-    if (ret != ESP_OK) return ret;
+    for (uint8_t addr = 0; addr < ADS1299_REG_COUNT && ret == ESP_OK; addr++) {
+        if (!(handle->regs_dirty & (1UL << addr))) continue;
+
+        // Extend the burst over dirty registers, and over short runs of clean ones
+        // where rewriting the shadow value is cheaper than another WREG command
+        uint8_t end = addr + 1;
+        uint8_t last = addr;
+        while (end < ADS1299_REG_COUNT && end - last <= ADS_WREG_MAX_GAP + 1 &&
+               (ADS_WRITABLE_REGS & (1UL << end))) {
+            if (handle->regs_dirty & (1UL << end)) last = end;
+            end++;
+        }
+
+        ret = _ads1299_wreg_burst(handle, addr, last - addr + 1, &(handle->regs[addr]));
+        writes++;
+        addr = last;
+    }
     ads1299_rdatac(handle);
+
+    if (ret == ESP_OK) {
+        ESP_LOGD(TAG, "Committed registers 0x%06lx in %d write(s)", handle->regs_dirty, writes);
+        handle->regs_dirty = 0;
+    }
     return ret;
 }
 
-
 esp_err_t _ads1299_rreg(ads1299_handle_t* handle, uint8_t addr, uint8_t* ret_val)
 {
-    uint16_t command = 0x0000;
-    command = (ADS_RREG | addr) << 8;
+    return _ads1299_rreg_burst(handle, addr, 1, ret_val);
+}
+
+esp_err_t _ads1299_wreg(ads1299_handle_t* handle, uint8_t addr, uint8_t val)
+{
+    return _ads1299_wreg_burst(handle, addr, 1, &val);
+}
+
+esp_err_t _ads1299_rreg_burst(ads1299_handle_t* handle, uint8_t addr, uint8_t n, uint8_t* ret_val)
+{
+    if (n == 0 || addr + n > ADS1299_REG_COUNT) return ESP_ERR_INVALID_ARG;
+
+    // Second command byte is the number of registers less one
+    uint8_t tx[ADS1299_REG_COUNT] = {0x00};
     spi_transaction_ext_t t = {
         .base = (spi_transaction_t) {
-            .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_USE_RXDATA | SPI_TRANS_USE_TXDATA,
-            .cmd = command,
-            .length = 8,
-            .tx_data = {0x00},
-            .rx_data = {0x00}
+            .flags = SPI_TRANS_VARIABLE_CMD,
+            .cmd = ((ADS_RREG | addr) << 8) | (n - 1),
+            .length = n * 8,
+            .tx_buffer = tx,
+            .rx_buffer = ret_val
         },
         .command_bits = 16,
         .address_bits = 0,
         .dummy_bits = 0
     };
 
-    esp_err_t err = spi_device_transmit(handle->spi, &t);
-    if (err != ESP_OK) {
-        return err;
-    }
-
-    *ret_val = t.base.rx_data[0];
-    return ESP_OK;
+    return handle->spi_ops.transmit(handle->spi, &(t.base), handle->spi_ops.ctx);
 }
 
-esp_err_t _ads1299_wreg(ads1299_handle_t* handle, uint8_t addr, uint8_t val)
+esp_err_t _ads1299_wreg_burst(ads1299_handle_t* handle, uint8_t addr, uint8_t n, const uint8_t* vals)
 {
-    uint16_t command = 0x0000;
-    command = (ADS_WREG | addr) << 8;
+    if (n == 0 || addr + n > ADS1299_REG_COUNT) return ESP_ERR_INVALID_ARG;
+
     spi_transaction_ext_t t = {
         .base = (spi_transaction_t) {
-            .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_USE_RXDATA | SPI_TRANS_USE_TXDATA,
-            .cmd = command,
-            .length = 8,
-            .tx_data = {val},
-            .rx_data = {0x00}
+            .flags = SPI_TRANS_VARIABLE_CMD,
+            .cmd = ((ADS_WREG | addr) << 8) | (n - 1),
+            .length = n * 8,
+            .tx_buffer = vals,
+            .rx_buffer = NULL
         },
         .command_bits = 16,
         .address_bits = 0,
         .dummy_bits = 0
     };
 
-    esp_err_t err = spi_device_transmit(handle->spi, &t);
-    if (err != ESP_OK) {
-        return err;
-    }
+    return handle->spi_ops.transmit(handle->spi, &(t.base), handle->spi_ops.ctx);
+}
 
-    return ESP_OK;
-}
\ No newline at end of file
+esp_err_t _ads1299_spi_transmit(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx)
+{
+    return spi_device_transmit(spi, trans);
+}
+
+esp_err_t _ads1299_spi_polling_transmit(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx)
+{
+    return spi_device_polling_transmit(spi, trans);
+}
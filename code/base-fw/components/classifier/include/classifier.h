@@ -0,0 +1,10 @@
+#pragma once
+#include "classifier_interface.h"
+
+#define CLF_LOG_2PI     1.8378770664093453f
+
+/******** PRIVATE FUNCTIOINS **********/
+float _clf_log_add(float a, float b);
+float _clf_log_density(const clf_hmm_t* hmm, int state, const float* z, int n_components);
+uint32_t _clf_get_u32(const uint8_t* p);
+float _clf_get_f32(const uint8_t* p);
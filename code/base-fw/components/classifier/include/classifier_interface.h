@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "emg_features_interface.h"
+#include "mfcc_interface.h"
+
+/*
+ * Word classifier from hmm.ipynb: F2 features of each window are projected by
+ * the LDA, then scored by one left-to-right Gaussian HMM (diagonal covariance)
+ * per class. Scores are log-likelihoods from the forward algorithm, like
+ * hmmlearn's score(), with the Viterbi path likelihood alongside. Everything is
+ * in log space and updated one window at a time, so a decision is ready as
+ * soon as the last window of an utterance arrives.
+ *
+ * Models come from code/ml/export_classifier.py, little endian:
+ *
+ *   offset  size  field
+ *   0       4     magic "NXHM"
+ *   4       1     version
+ *   5       1     number of classes
+ *   6       1     HMM states per class
+ *   7       1     LDA components, the HMM observation size
+ *   8       2     F2 features per window, the LDA input size
+ *   10      2     reserved, zero
+ *   12            float32 lda_w[features][components], float32 lda_b[components]
+ *   ...           per class: char name[16], float32 log_start[states],
+ *                 log_trans[states][states], mean[states][components], var[states][components]
+ */
+
+#define CLF_MAGIC               0x4D48584E  // "NXHM"
+#define CLF_VERSION             1
+#define CLF_HEADER_SIZE         12
+#define CLF_NAME_LEN            16
+#define CLF_MAX_CLASSES         32
+#define CLF_MAX_STATES          8
+#define CLF_MAX_COMPONENTS      16
+#define CLF_MAX_FEATURES        512
+
+typedef enum {
+    CLF_OK = 0,
+    CLF_ERR_NO_MEM = -1,       ///< Allocation failed
+    CLF_ERR_INVALID = -2,      ///< Bad configuration or feature size
+    CLF_ERR_MODEL = -3,        ///< Model blob is truncated, has the wrong magic or version, or is too big
+} clf_err_t;
+
+/// HMM of one class, with the Gaussian terms that do not depend on the observation folded in
+typedef struct {
+    char name[CLF_NAME_LEN];                               ///< Class label, NUL terminated
+    float log_start[CLF_MAX_STATES];
+    float log_trans[CLF_MAX_STATES][CLF_MAX_STATES];       ///< [from][to]
+    float mean[CLF_MAX_STATES][CLF_MAX_COMPONENTS];
+    float inv_var[CLF_MAX_STATES][CLF_MAX_COMPONENTS];     ///< 1 / variance
+    float log_norm[CLF_MAX_STATES];                        ///< -0.5 * (D log 2pi + sum log variance)
+} clf_hmm_t;
+
+/// Scores of the utterance so far
+typedef struct {
+    uint16_t n_frames;                         ///< Windows scored since the last reset
+    uint8_t best;                              ///< Class with the highest forward log-likelihood
+    float margin;                              ///< Lead of the best class over the runner up
+    float log_likelihood[CLF_MAX_CLASSES];     ///< Forward log-likelihood per class
+    float viterbi[CLF_MAX_CLASSES];            ///< Best path log-likelihood per class
+} clf_result_t;
+
+typedef struct {
+    uint8_t n_classes;
+    uint8_t n_states;
+    uint8_t n_components;
+    uint16_t n_features;
+    float* lda_w;                              ///< [n_features][n_components]
+    float lda_b[CLF_MAX_COMPONENTS];
+    clf_hmm_t* hmm;                            ///< [n_classes]
+
+    // Utterance state
+    uint16_t n_frames;
+    float alpha[CLF_MAX_CLASSES][CLF_MAX_STATES];  ///< Forward log probabilities
+    float delta[CLF_MAX_CLASSES][CLF_MAX_STATES];  ///< Viterbi log probabilities
+} clf_handle_t;
+
+/// Configuration of the F2 feature pipeline, 400ms windows every 100ms in the notebooks
+typedef struct {
+    uint8_t n_channels;            ///< Channels per sample
+    uint16_t window;               ///< Samples per window
+    uint16_t stride;               ///< Samples between windows
+    float sample_rate;             ///< Samples per second
+    int64_t (*now_us)(void);       ///< Optional clock for the MFCC timing statistics
+} clf_f2_config_t;
+
+/// F2() of feature_extractors.py on a stream: mav, wl and 6 MFCCs per channel for every window
+typedef struct {
+    clf_f2_config_t config;        ///< User passed configuration of the pipeline
+    feat_handle_t* feat;           ///< Time domain features
+    mfcc_handle_t* mfcc;           ///< MFCC engine
+    float* history;                ///< Last window of samples twice over, so it is always contiguous
+    uint16_t pos;                  ///< History slot of the newest sample
+} clf_f2_t;
+
+#define CLF_F2_MFCC             6
+#define CLF_F2_MELS             15
+#define CLF_F2_SIZE(n_ch)       ((2 + CLF_F2_MFCC) * (n_ch))
+
+/******* PUBLIC FUNCTIONS *********/
+clf_err_t clf_init(const uint8_t* model, size_t len, clf_handle_t** out_handle);
+void clf_deinit(clf_handle_t* handle);
+void clf_reset(clf_handle_t* handle);
+clf_err_t clf_push(clf_handle_t* handle, const float* features);
+void clf_get_result(clf_handle_t* handle, clf_result_t* ret_result);
+void clf_project(clf_handle_t* handle, const float* features, float* ret_z);
+
+clf_err_t clf_f2_init(const clf_f2_config_t* config, clf_f2_t** out_handle);
+void clf_f2_deinit(clf_f2_t* handle);
+void clf_f2_reset(clf_f2_t* handle);
+bool clf_f2_push(clf_f2_t* handle, const float* sample, float* ret_features);
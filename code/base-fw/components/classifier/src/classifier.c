@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "classifier.h"
+#include "classifier_interface.h"
+
+clf_err_t clf_init(const uint8_t* model, size_t len, clf_handle_t** out_handle)
+{
+    if (len < CLF_HEADER_SIZE || _clf_get_u32(model) != CLF_MAGIC || model[4] != CLF_VERSION) return CLF_ERR_MODEL;
+
+    uint8_t n_classes = model[5], n_states = model[6], n_comp = model[7];
+    uint16_t n_features = model[8] | (model[9] << 8);
+    if (n_classes == 0 || n_classes > CLF_MAX_CLASSES || n_states == 0 || n_states > CLF_MAX_STATES ||
+        n_comp == 0 || n_comp > CLF_MAX_COMPONENTS || n_features == 0 || n_features > CLF_MAX_FEATURES)
+        return CLF_ERR_MODEL;
+
+    size_t per_class = CLF_NAME_LEN + 4 * ((size_t)n_states + n_states * n_states + 2 * n_states * n_comp);
+    size_t expected = CLF_HEADER_SIZE + 4 * ((size_t)n_features * n_comp + n_comp) + n_classes * per_class;
+    if (len < expected) return CLF_ERR_MODEL;
+
+    clf_handle_t* handle = (clf_handle_t*)calloc(1, sizeof(clf_handle_t));
+    if (!handle) return CLF_ERR_NO_MEM;
+    handle->lda_w = (float*)malloc((size_t)n_features * n_comp * sizeof(float));
+    handle->hmm = (clf_hmm_t*)calloc(n_classes, sizeof(clf_hmm_t));
+    if (!handle->lda_w || !handle->hmm) {
+        clf_deinit(handle);
+        return CLF_ERR_NO_MEM;
+    }
+
+    handle->n_classes = n_classes;
+    handle->n_states = n_states;
+    handle->n_components = n_comp;
+    handle->n_features = n_features;
+
+    const uint8_t* p = model + CLF_HEADER_SIZE;
+    for (size_t i = 0; i < (size_t)n_features * n_comp; i++, p += 4)
+        handle->lda_w[i] = _clf_get_f32(p);
+    for (int i = 0; i < n_comp; i++, p += 4)
+        handle->lda_b[i] = _clf_get_f32(p);
+
+    for (int c = 0; c < n_classes; c++) {
+        clf_hmm_t* hmm = &(handle->hmm[c]);
+        memcpy(hmm->name, p, CLF_NAME_LEN);
+        hmm->name[CLF_NAME_LEN - 1] = '\0';
+        p += CLF_NAME_LEN;
+
+        for (int s = 0; s < n_states; s++, p += 4)
+            hmm->log_start[s] = _clf_get_f32(p);
+        for (int s = 0; s < n_states; s++)
+            for (int t = 0; t < n_states; t++, p += 4)
+                hmm->log_trans[s][t] = _clf_get_f32(p);
+        for (int s = 0; s < n_states; s++)
+            for (int d = 0; d < n_comp; d++, p += 4)
+                hmm->mean[s][d] = _clf_get_f32(p);
+        for (int s = 0; s < n_states; s++) {
+            float log_norm = n_comp * CLF_LOG_2PI;
+            for (int d = 0; d < n_comp; d++, p += 4) {
+                float var = _clf_get_f32(p);
+                if (!(var > 0)) {
+                    clf_deinit(handle);
+                    return CLF_ERR_MODEL;
+                }
+                hmm->inv_var[s][d] = 1.0f / var;
+                log_norm += logf(var);
+            }
+            hmm->log_norm[s] = -0.5f * log_norm;
+        }
+    }
+
+    clf_reset(handle);
+    *out_handle = handle;
+    return CLF_OK;
+}
+
+void clf_deinit(clf_handle_t* handle)
+{
+    free(handle->lda_w);
+    free(handle->hmm);
+    free(handle);
+}
+
+void clf_reset(clf_handle_t* handle)
+{
+    handle->n_frames = 0;
+}
+
+void clf_project(clf_handle_t* handle, const float* features, float* ret_z)
+{
+    // sklearn transform() as an affine map, (x - xbar) @ scalings folded into w and b by the exporter
+    const int n_comp = handle->n_components;
+    for (int d = 0; d < n_comp; d++)
+        ret_z[d] = handle->lda_b[d];
+    for (int f = 0; f < handle->n_features; f++) {
+        const float* w = handle->lda_w + f * n_comp;
+        for (int d = 0; d < n_comp; d++)
+            ret_z[d] += features[f] * w[d];
+    }
+}
+
+clf_err_t clf_push(clf_handle_t* handle, const float* features)
+{
+    const int n_states = handle->n_states;
+    float z[CLF_MAX_COMPONENTS];
+    clf_project(handle, features, z);
+
+    for (int c = 0; c < handle->n_classes; c++) {
+        const clf_hmm_t* hmm = &(handle->hmm[c]);
+        float* alpha = handle->alpha[c];
+        float* delta = handle->delta[c];
+        float next_alpha[CLF_MAX_STATES], next_delta[CLF_MAX_STATES];
+
+        for (int t = 0; t < n_states; t++) {
+            float a, v;
+            if (handle->n_frames == 0) {
+                a = v = hmm->log_start[t];
+            } else {
+                // Left-to-right models leave most of log_trans at -inf, those terms drop out
+                a = v = -INFINITY;
+                for (int s = 0; s < n_states; s++) {
+                    float tr = hmm->log_trans[s][t];
+                    if (tr == -INFINITY) continue;
+                    a = _clf_log_add(a, alpha[s] + tr);
+                    v = fmaxf(v, delta[s] + tr);
+                }
+            }
+            float b = _clf_log_density(hmm, t, z, handle->n_components);
+            next_alpha[t] = a + b;
+            next_delta[t] = v + b;
+        }
+        memcpy(alpha, next_alpha, n_states * sizeof(float));
+        memcpy(delta, next_delta, n_states * sizeof(float));
+    }
+
+    if (handle->n_frames < UINT16_MAX)
+        handle->n_frames++;
+    return CLF_OK;
+}
+
+void clf_get_result(clf_handle_t* handle, clf_result_t* ret_result)
+{
+    memset(ret_result, 0, sizeof(*ret_result));
+    ret_result->n_frames = handle->n_frames;
+    if (handle->n_frames == 0) return;
+
+    float best = -INFINITY, second = -INFINITY;
+    for (int c = 0; c < handle->n_classes; c++) {
+        // score() is the log sum over the final states, Viterbi takes the best one
+        float ll = -INFINITY, vit = -INFINITY;
+        for (int s = 0; s < handle->n_states; s++) {
+            ll = _clf_log_add(ll, handle->alpha[c][s]);
+            vit = fmaxf(vit, handle->delta[c][s]);
+        }
+        ret_result->log_likelihood[c] = ll;
+        ret_result->viterbi[c] = vit;
+
+        if (ll > best) {
+            second = best;
+            best = ll;
+            ret_result->best = c;
+        } else if (ll > second) {
+            second = ll;
+        }
+    }
+    ret_result->margin = best - second;
+}
+
+float _clf_log_add(float a, float b)
+{
+    // log(exp(a) + exp(b)) without overflow
+    if (a == -INFINITY) return b;
+    if (b == -INFINITY) return a;
+    return (a > b) ? a + log1pf(expf(b - a)) : b + log1pf(expf(a - b));
+}
+
+float _clf_log_density(const clf_hmm_t* hmm, int state, const float* z, int n_components)
+{
+    float acc = 0;
+    for (int d = 0; d < n_components; d++) {
+        float diff = z[d] - hmm->mean[state][d];
+        acc += diff * diff * hmm->inv_var[state][d];
+    }
+    return hmm->log_norm[state] - 0.5f * acc;
+}
+
+uint32_t _clf_get_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+float _clf_get_f32(const uint8_t* p)
+{
+    uint32_t v = _clf_get_u32(p);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "classifier.h"
+#include "classifier_interface.h"
+
+clf_err_t clf_f2_init(const clf_f2_config_t* config, clf_f2_t** out_handle)
+{
+    if (config->n_channels == 0 || config->n_channels > FEAT_MAX_CHANNELS || config->window == 0) return CLF_ERR_INVALID;
+
+    clf_f2_t* handle = (clf_f2_t*)calloc(1, sizeof(clf_f2_t));
+    if (!handle) return CLF_ERR_NO_MEM;
+    handle->config = *config;
+
+    // Thresholds and MFCC sizes are the ones feature_extractors.py uses
+    feat_config_t feat_config = {
+        .n_channels = config->n_channels,
+        .window = config->window,
+        .stride = config->stride,
+        .zc_threshold = 20,
+        .ssc_threshold = 20,
+    };
+    mfcc_config_t mfcc_config = {
+        .n_channels = config->n_channels,
+        .n_fft = config->window,
+        .n_mels = CLF_F2_MELS,
+        .n_mfcc = CLF_F2_MFCC,
+        .sample_rate = config->sample_rate,
+        .top_db = 80,
+        .pad = MFCC_PAD_CONSTANT,
+        .now_us = config->now_us,
+    };
+    handle->history = (float*)calloc((size_t)2 * config->window * config->n_channels, sizeof(float));
+    if (!handle->history || feat_init(&feat_config, &(handle->feat)) != FEAT_OK ||
+        mfcc_init(&mfcc_config, &(handle->mfcc)) != MFCC_OK) {
+        clf_f2_deinit(handle);
+        return CLF_ERR_INVALID;
+    }
+
+    clf_f2_reset(handle);
+    *out_handle = handle;
+    return CLF_OK;
+}
+
+void clf_f2_deinit(clf_f2_t* handle)
+{
+    if (handle->feat) feat_deinit(handle->feat);
+    if (handle->mfcc) mfcc_deinit(handle->mfcc);
+    free(handle->history);
+    free(handle);
+}
+
+void clf_f2_reset(clf_f2_t* handle)
+{
+    feat_reset(handle->feat);
+    handle->pos = handle->config.window - 1;
+}
+
+bool clf_f2_push(clf_f2_t* handle, const float* sample, float* ret_features)
+{
+    const int n_ch = handle->config.n_channels;
+    const uint16_t window = handle->config.window;
+
+    // Every sample goes in twice, window slots apart, so the last window is one contiguous block
+    handle->pos = (handle->pos + 1 == window) ? 0 : handle->pos + 1;
+    memcpy(handle->history + (size_t)handle->pos * n_ch, sample, n_ch * sizeof(float));
+    memcpy(handle->history + ((size_t)handle->pos + window) * n_ch, sample, n_ch * sizeof(float));
+
+    feat_vector_t v;
+    if (!feat_push(handle->feat, sample, &v))
+        return false;
+
+    // Same order as F2 flattens (mav, wl, mfcc) x channels
+    for (int ch = 0; ch < n_ch; ch++) {
+        ret_features[ch] = v.mav[ch];
+        ret_features[n_ch + ch] = v.wl[ch];
+    }
+    mfcc_compute(handle->mfcc, handle->history + ((size_t)handle->pos + 1) * n_ch, ret_features + 2 * n_ch);
+    return true;
+}
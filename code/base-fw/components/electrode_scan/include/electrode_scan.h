@@ -0,0 +1,9 @@
+#pragma once
+#include "electrode_scan_interface.h"
+
+// Clipped captures rank below any real one
+#define SCAN_SNR_CLIPPED    -100.0f
+
+/******** PRIVATE FUNCTIOINS **********/
+void _scan_clear(scan_handle_t* handle);
+void _scan_estimate(scan_handle_t* handle);
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "iir_interface.h"
+
+/*
+ * Electrode orientation scan. The caller switches the array to each candidate
+ * configuration in turn, calls scan_begin() and pushes raw ADS1299 codes until
+ * scan_push() says the capture is done. The first settle samples after a switch
+ * only warm up the filter, the next capture samples are measured.
+ *
+ * The SNR of a channel is its power in the EMG band, high-passed at band_hz with
+ * the mains band stopped, over everything else it picked up: the mains hum and
+ * the drift below band_hz. Poor contact shows up as both long before it changes
+ * the EMG band. A capture with codes at the rails is clipped and ranks last.
+ *
+ * Channels are scored independently so arrays that switch each channel on its
+ * own can take the best candidate per channel, see scan_best_for_channel().
+ */
+
+#define SCAN_MAX_CHANNELS   32
+#define SCAN_MAX_CANDIDATES 16
+#define SCAN_CODE_LIMIT     0x7FFF00 // Codes this close to full scale count as clipped
+
+typedef enum {
+    SCAN_OK = 0,
+    SCAN_ERR_NO_MEM = -1,      ///< Allocation failed
+    SCAN_ERR_INVALID = -2,     ///< Bad channel or candidate count, durations or band
+} scan_err_t;
+
+typedef enum {
+    SCAN_SETTLE,               ///< Waiting out the switch, samples only warm up the filter
+    SCAN_CAPTURE,              ///< Samples are measured
+    SCAN_DONE,                 ///< Capture complete, the candidate is scored
+} scan_phase_t;
+
+/// Configuration of a scan, durations in samples
+typedef struct {
+    uint8_t n_channels;        ///< Channels per sample
+    uint8_t n_candidates;      ///< Configurations scanned
+    uint32_t settle;           ///< Samples ignored after each switch
+    uint32_t capture;          ///< Samples the SNR is estimated from
+    float sample_rate;         ///< In Hz, for the filter design
+    float band_hz;             ///< Low edge of the EMG band
+    float stop_lo_hz;          ///< Mains band, taken out of the EMG band
+    float stop_hi_hz;
+} scan_config_t;
+
+typedef struct {
+    scan_config_t config;      ///< User passed configuration of the scan
+    iir_handle_t* filter;      ///< EMG band filter
+    uint8_t candidate;         ///< Candidate being captured
+    scan_phase_t phase;        ///< Phase of the current candidate
+    uint32_t n;                ///< Samples pushed since scan_begin()
+    int32_t shift[SCAN_MAX_CHANNELS];   ///< First captured code, keeps the sums small
+    double sum[SCAN_MAX_CHANNELS];      ///< Sum of the shifted codes
+    double sum_sq[SCAN_MAX_CHANNELS];   ///< And of their squares
+    double band_sq[SCAN_MAX_CHANNELS];  ///< Sum of squares in the EMG band
+    bool clipped[SCAN_MAX_CHANNELS];    ///< A code reached SCAN_CODE_LIMIT
+    float snr_db[SCAN_MAX_CANDIDATES][SCAN_MAX_CHANNELS]; ///< Score of every candidate and channel
+} scan_handle_t;
+
+/******* PUBLIC FUNCTIONS *********/
+scan_err_t scan_init(const scan_config_t* config, scan_handle_t** out_handle);
+void scan_deinit(scan_handle_t* handle);
+void scan_begin(scan_handle_t* handle, uint8_t candidate);
+scan_phase_t scan_push(scan_handle_t* handle, const int32_t* codes);
+float scan_snr_db(scan_handle_t* handle, uint8_t candidate, uint8_t channel);
+float scan_mean_snr_db(scan_handle_t* handle, uint8_t candidate);
+uint8_t scan_best_for_channel(scan_handle_t* handle, uint8_t channel);
+uint8_t scan_best_candidate(scan_handle_t* handle);
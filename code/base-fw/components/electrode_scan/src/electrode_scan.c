@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "electrode_scan.h"
+#include "electrode_scan_interface.h"
+
+scan_err_t scan_init(const scan_config_t* config, scan_handle_t** out_handle)
+{
+    if (config->n_channels == 0 || config->n_channels > SCAN_MAX_CHANNELS) return SCAN_ERR_INVALID;
+    if (config->n_candidates == 0 || config->n_candidates > SCAN_MAX_CANDIDATES) return SCAN_ERR_INVALID;
+    if (config->capture < 2) return SCAN_ERR_INVALID;
+
+    // 4th order, as the stream filters
+    iir_config_t filter_config = { .n_channels = config->n_channels };
+    if (iir_butter(&filter_config, 4, IIR_HIGHPASS, config->band_hz, 0, config->sample_rate) != IIR_OK ||
+        iir_butter(&filter_config, 4, IIR_BANDSTOP, config->stop_lo_hz, config->stop_hi_hz, config->sample_rate) != IIR_OK)
+        return SCAN_ERR_INVALID;
+
+    scan_handle_t* handle = (scan_handle_t*)malloc(sizeof(scan_handle_t));
+    if (!handle) return SCAN_ERR_NO_MEM;
+    handle->config = *config;
+
+    if (iir_init(&filter_config, &(handle->filter)) != IIR_OK) {
+        free(handle);
+        return SCAN_ERR_NO_MEM;
+    }
+
+    // Unscanned candidates never win
+    for (int c = 0; c < SCAN_MAX_CANDIDATES; c++)
+        for (int ch = 0; ch < SCAN_MAX_CHANNELS; ch++)
+            handle->snr_db[c][ch] = SCAN_SNR_CLIPPED;
+    handle->candidate = 0;
+    _scan_clear(handle);
+    handle->phase = SCAN_DONE;
+
+    *out_handle = handle;
+    return SCAN_OK;
+}
+
+void scan_deinit(scan_handle_t* handle)
+{
+    iir_deinit(handle->filter);
+    free(handle);
+}
+
+void scan_begin(scan_handle_t* handle, uint8_t candidate)
+{
+    if (candidate >= handle->config.n_candidates) return;
+    handle->candidate = candidate;
+    _scan_clear(handle);
+}
+
+scan_phase_t scan_push(scan_handle_t* handle, const int32_t* codes)
+{
+    const scan_config_t* c = &(handle->config);
+    if (handle->phase == SCAN_DONE) return SCAN_DONE;
+
+    // Relative to the first sample after the switch, the electrode offset alone can be millions of codes
+    if (handle->n == 0)
+        memcpy(handle->shift, codes, c->n_channels * sizeof(int32_t));
+
+    iir_float_t x[SCAN_MAX_CHANNELS];
+    for (int ch = 0; ch < c->n_channels; ch++)
+        x[ch] = (iir_float_t)(codes[ch] - handle->shift[ch]);
+    iir_process(handle->filter, x, x, 1);
+
+    if (handle->n++ < c->settle)
+        return handle->phase;
+
+    handle->phase = SCAN_CAPTURE;
+    for (int ch = 0; ch < c->n_channels; ch++) {
+        double v = codes[ch] - handle->shift[ch];
+        handle->sum[ch] += v;
+        handle->sum_sq[ch] += v * v;
+        handle->band_sq[ch] += (double)x[ch] * x[ch];
+        if (codes[ch] >= SCAN_CODE_LIMIT || codes[ch] <= -SCAN_CODE_LIMIT)
+            handle->clipped[ch] = true;
+    }
+
+    if (handle->n >= c->settle + c->capture) {
+        _scan_estimate(handle);
+        handle->phase = SCAN_DONE;
+    }
+    return handle->phase;
+}
+
+float scan_snr_db(scan_handle_t* handle, uint8_t candidate, uint8_t channel)
+{
+    if (candidate >= SCAN_MAX_CANDIDATES || channel >= SCAN_MAX_CHANNELS) return SCAN_SNR_CLIPPED;
+    return handle->snr_db[candidate][channel];
+}
+
+float scan_mean_snr_db(scan_handle_t* handle, uint8_t candidate)
+{
+    if (candidate >= SCAN_MAX_CANDIDATES) return SCAN_SNR_CLIPPED;
+    float total = 0;
+    for (int ch = 0; ch < handle->config.n_channels; ch++)
+        total += handle->snr_db[candidate][ch];
+    return total / handle->config.n_channels;
+}
+
+uint8_t scan_best_for_channel(scan_handle_t* handle, uint8_t channel)
+{
+    uint8_t best = 0;
+    for (int c = 1; c < handle->config.n_candidates; c++)
+        if (scan_snr_db(handle, c, channel) > scan_snr_db(handle, best, channel)) best = c;
+    return best;
+}
+
+uint8_t scan_best_candidate(scan_handle_t* handle)
+{
+    // For arrays that can only switch as a whole
+    uint8_t best = 0;
+    for (int c = 1; c < handle->config.n_candidates; c++)
+        if (scan_mean_snr_db(handle, c) > scan_mean_snr_db(handle, best)) best = c;
+    return best;
+}
+
+void _scan_clear(scan_handle_t* handle)
+{
+    iir_reset(handle->filter);
+    handle->phase = SCAN_SETTLE;
+    handle->n = 0;
+    memset(handle->shift, 0, sizeof(handle->shift));
+    memset(handle->sum, 0, sizeof(handle->sum));
+    memset(handle->sum_sq, 0, sizeof(handle->sum_sq));
+    memset(handle->band_sq, 0, sizeof(handle->band_sq));
+    memset(handle->clipped, 0, sizeof(handle->clipped));
+}
+
+void _scan_estimate(scan_handle_t* handle)
+{
+    const uint32_t n = handle->config.capture;
+    for (int ch = 0; ch < handle->config.n_channels; ch++) {
+        float* snr = &(handle->snr_db[handle->candidate][ch]);
+        if (handle->clipped[ch]) {
+            *snr = SCAN_SNR_CLIPPED;
+            continue;
+        }
+        // Whatever the variance holds outside the EMG band is noise, never let it reach zero
+        double mean = handle->sum[ch] / n;
+        double var = handle->sum_sq[ch] / n - mean * mean;
+        double band = handle->band_sq[ch] / n;
+        double noise = var - band;
+        if (noise < 1e-3 * var) noise = 1e-3 * var;
+        if (!(band > 0) || !(noise > 0)) {
+            *snr = SCAN_SNR_CLIPPED; // Flat line, nothing connected
+            continue;
+        }
+        *snr = 10 * log10(band / noise);
+    }
+}
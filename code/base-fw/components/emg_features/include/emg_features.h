@@ -0,0 +1,5 @@
+#pragma once
+#include "emg_features_interface.h"
+
+/******** PRIVATE FUNCTIOINS **********/
+void _feat_resync(feat_handle_t* handle);
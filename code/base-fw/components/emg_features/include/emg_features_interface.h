@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Sliding window time domain features, matching mav(), wl(), zc() and ssc() in
+ * code/ml/feature_extractors.py over the windows of window_generator().
+ *
+ * Every sample updates running sums in O(1) per channel, a feature vector comes
+ * out each time a window completes: at sample window - 1, then every stride
+ * samples after that.
+ */
+
+#define FEAT_MAX_CHANNELS   32
+#define FEAT_MAX_WINDOW     4096
+
+typedef enum {
+    FEAT_OK = 0,
+    FEAT_ERR_NO_MEM = -1,      ///< Allocation failed
+    FEAT_ERR_INVALID = -2,     ///< Bad channel count, window or stride
+} feat_err_t;
+
+/// Configuration of an extractor
+typedef struct {
+    uint8_t n_channels;        ///< Channels per sample
+    uint16_t window;           ///< Samples per window, 100 for 400ms at 250SPS
+    uint16_t stride;           ///< Samples between windows, 25 for 100ms at 250SPS
+    float zc_threshold;        ///< Smallest step counted as a zero crossing, 20 in the notebooks
+    float ssc_threshold;       ///< Smallest slope change counted, 20 in the notebooks
+} feat_config_t;
+
+/// Features of one window
+typedef struct {
+    uint32_t end;                        ///< Index of the last sample of the window
+    float mav[FEAT_MAX_CHANNELS];        ///< Mean absolute value
+    float wl[FEAT_MAX_CHANNELS];         ///< Waveform length
+    uint16_t zc[FEAT_MAX_CHANNELS];      ///< Zero crossings
+    uint16_t ssc[FEAT_MAX_CHANNELS];     ///< Slope sign changes
+} feat_vector_t;
+
+typedef struct {
+    feat_config_t config;      ///< User passed configuration of the extractor
+    uint32_t count;            ///< Samples pushed since the last reset
+    uint16_t slot;             ///< Ring slot of the newest sample
+    uint16_t pending;          ///< Samples until the next window completes
+
+    // Per sample contributions, [slot][channel]. wl and zc belong to the pair ending at the
+    // sample, ssc to the triple ending at it, so each leaves the window at a different lag.
+    float* abs_ring;
+    float* wl_ring;
+    uint8_t* zc_ring;
+    uint8_t* ssc_ring;
+
+    // Running state, [channel]
+    float prev[FEAT_MAX_CHANNELS];       ///< Previous sample
+    float prev_diff[FEAT_MAX_CHANNELS];  ///< Previous first difference
+    float abs_sum[FEAT_MAX_CHANNELS];
+    float wl_sum[FEAT_MAX_CHANNELS];
+    int32_t zc_sum[FEAT_MAX_CHANNELS];
+    int32_t ssc_sum[FEAT_MAX_CHANNELS];
+} feat_handle_t;
+
+/******* PUBLIC FUNCTIONS *********/
+feat_err_t feat_init(const feat_config_t* config, feat_handle_t** out_handle);
+void feat_deinit(feat_handle_t* handle);
+void feat_reset(feat_handle_t* handle);
+bool feat_push(feat_handle_t* handle, const float* sample, feat_vector_t* ret_vec);
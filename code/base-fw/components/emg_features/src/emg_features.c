@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "emg_features.h"
+#include "emg_features_interface.h"
+
+static inline int sign(float v)
+{
+    return (v > 0) - (v < 0);
+}
+
+feat_err_t feat_init(const feat_config_t* config, feat_handle_t** out_handle)
+{
+    if (config->n_channels == 0 || config->n_channels > FEAT_MAX_CHANNELS) return FEAT_ERR_INVALID;
+    if (config->window < 3 || config->window > FEAT_MAX_WINDOW || config->stride == 0) return FEAT_ERR_INVALID;
+
+    feat_handle_t* handle = (feat_handle_t*)calloc(1, sizeof(feat_handle_t));
+    if (!handle) return FEAT_ERR_NO_MEM;
+
+    size_t n = (size_t)config->window * config->n_channels;
+    handle->config = *config;
+    handle->abs_ring = (float*)malloc(n * sizeof(float));
+    handle->wl_ring = (float*)malloc(n * sizeof(float));
+    handle->zc_ring = (uint8_t*)malloc(n);
+    handle->ssc_ring = (uint8_t*)malloc(n);
+    if (!handle->abs_ring || !handle->wl_ring || !handle->zc_ring || !handle->ssc_ring) {
+        feat_deinit(handle);
+        return FEAT_ERR_NO_MEM;
+    }
+
+    feat_reset(handle);
+    *out_handle = handle;
+    return FEAT_OK;
+}
+
+void feat_deinit(feat_handle_t* handle)
+{
+    free(handle->abs_ring);
+    free(handle->wl_ring);
+    free(handle->zc_ring);
+    free(handle->ssc_ring);
+    free(handle);
+}
+
+void feat_reset(feat_handle_t* handle)
+{
+    // Zeroed slots stand in for the pairs and triples that do not exist yet while the first window fills
+    size_t n = (size_t)handle->config.window * handle->config.n_channels;
+    memset(handle->abs_ring, 0, n * sizeof(float));
+    memset(handle->wl_ring, 0, n * sizeof(float));
+    memset(handle->zc_ring, 0, n);
+    memset(handle->ssc_ring, 0, n);
+
+    handle->count = 0;
+    handle->slot = handle->config.window - 1;
+    handle->pending = handle->config.window;
+    memset(handle->prev, 0, sizeof(handle->prev));
+    memset(handle->prev_diff, 0, sizeof(handle->prev_diff));
+    memset(handle->abs_sum, 0, sizeof(handle->abs_sum));
+    memset(handle->wl_sum, 0, sizeof(handle->wl_sum));
+    memset(handle->zc_sum, 0, sizeof(handle->zc_sum));
+    memset(handle->ssc_sum, 0, sizeof(handle->ssc_sum));
+}
+
+bool feat_push(feat_handle_t* handle, const float* sample, feat_vector_t* ret_vec)
+{
+    const feat_config_t* c = &(handle->config);
+    const int n_ch = c->n_channels;
+    const uint16_t window = c->window;
+
+    // The newest sample replaces the one leaving the window. The pair and triple leaving
+    // end one and two samples later, in the next slots of the ring.
+    uint16_t slot = (handle->slot + 1 == window) ? 0 : handle->slot + 1;
+    uint16_t pair_slot = (slot + 1 == window) ? 0 : slot + 1;
+    uint16_t triple_slot = (pair_slot + 1 == window) ? 0 : pair_slot + 1;
+    float* abs_cur = handle->abs_ring + (size_t)slot * n_ch;
+    float* wl_cur = handle->wl_ring + (size_t)slot * n_ch;
+    uint8_t* zc_cur = handle->zc_ring + (size_t)slot * n_ch;
+    uint8_t* ssc_cur = handle->ssc_ring + (size_t)slot * n_ch;
+    const float* wl_out = handle->wl_ring + (size_t)pair_slot * n_ch;
+    const uint8_t* zc_out = handle->zc_ring + (size_t)pair_slot * n_ch;
+    const uint8_t* ssc_out = handle->ssc_ring + (size_t)triple_slot * n_ch;
+    const bool has_pair = handle->count >= 1;
+    const bool has_triple = handle->count >= 2;
+
+    for (int ch = 0; ch < n_ch; ch++) {
+        float x = sample[ch];
+        float a = fabsf(x);
+        handle->abs_sum[ch] += a - abs_cur[ch];
+        abs_cur[ch] = a;
+
+        handle->wl_sum[ch] -= wl_out[ch];
+        handle->zc_sum[ch] -= zc_out[ch];
+        handle->ssc_sum[ch] -= ssc_out[ch];
+
+        float w = 0;
+        uint8_t zc = 0, ssc = 0;
+        if (has_pair) {
+            float d = x - handle->prev[ch];
+            w = fabsf(d);
+            zc = w >= c->zc_threshold && sign(x) != sign(handle->prev[ch]);
+            if (has_triple) {
+                float dd = d - handle->prev_diff[ch];
+                ssc = fabsf(dd) >= c->ssc_threshold && sign(d) != sign(handle->prev_diff[ch]);
+            }
+            handle->prev_diff[ch] = d;
+        }
+        handle->prev[ch] = x;
+
+        wl_cur[ch] = w;
+        zc_cur[ch] = zc;
+        ssc_cur[ch] = ssc;
+        handle->wl_sum[ch] += w;
+        handle->zc_sum[ch] += zc;
+        handle->ssc_sum[ch] += ssc;
+    }
+
+    handle->slot = slot;
+    handle->count++;
+
+    // Float sums drift as values come and go, rebuild them once per lap of the ring
+    if (slot == window - 1)
+        _feat_resync(handle);
+
+    if (--handle->pending)
+        return false;
+    handle->pending = c->stride;
+
+    if (ret_vec) {
+        ret_vec->end = handle->count - 1;
+        for (int ch = 0; ch < n_ch; ch++) {
+            ret_vec->mav[ch] = handle->abs_sum[ch] / window;
+            ret_vec->wl[ch] = handle->wl_sum[ch];
+            ret_vec->zc[ch] = handle->zc_sum[ch];
+            ret_vec->ssc[ch] = handle->ssc_sum[ch];
+        }
+    }
+    return true;
+}
+
+void _feat_resync(feat_handle_t* handle)
+{
+    // The oldest pair in the ring already left the window, leave it out of the wl sum
+    const int n_ch = handle->config.n_channels;
+    const uint16_t window = handle->config.window;
+    const uint16_t pair_slot = (handle->slot + 1 == window) ? 0 : handle->slot + 1;
+
+    for (int ch = 0; ch < n_ch; ch++) {
+        handle->abs_sum[ch] = 0;
+        handle->wl_sum[ch] = -handle->wl_ring[(size_t)pair_slot * n_ch + ch];
+    }
+    for (uint16_t s = 0; s < window; s++) {
+        const float* abs_row = handle->abs_ring + (size_t)s * n_ch;
+        const float* wl_row = handle->wl_ring + (size_t)s * n_ch;
+        for (int ch = 0; ch < n_ch; ch++) {
+            handle->abs_sum[ch] += abs_row[ch];
+            handle->wl_sum[ch] += wl_row[ch];
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <complex.h>
+
+#include "iir_interface.h"
+
+#define IIR_MAX_ORDER   8   // Butterworth prototype order, a band stop doubles it
+
+/******** PRIVATE FUNCTIOINS **********/
+void _iir_butter_prototype(uint8_t order, double complex* ret_p);
+double _iir_warp(double f, double fs);
+void _iir_add_sections(iir_config_t* config, const double complex* z, const double complex* p, int n, double k);
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Causal IIR filtering with cascades of second order sections, run on every
+ * channel of an interleaved (sample major) stream.
+ *
+ * Sections use the transposed direct form II of scipy.signal.sosfilt, in the
+ * same operation order. Built with IIR_DOUBLE the output is bit identical to
+ * sosfilt for the same coefficients, the default float build is what runs on
+ * the ESP32-S3 FPU.
+ */
+
+#define IIR_MAX_SECTIONS    8
+#define IIR_MAX_CHANNELS    32
+
+#ifdef IIR_DOUBLE
+typedef double iir_float_t;
+#else
+typedef float iir_float_t;
+#endif
+
+typedef enum {
+    IIR_OK = 0,
+    IIR_ERR_NO_MEM = -1,     ///< Allocation failed
+    IIR_ERR_INVALID = -2,    ///< Bad order, channel count or cutoff
+} iir_err_t;
+
+typedef enum { IIR_LOWPASS, IIR_HIGHPASS, IIR_BANDSTOP } iir_band_t;
+
+/// One second order section, a0 normalised to 1. A scipy sos row is [b0 b1 b2 1 a1 a2]
+typedef struct {
+    iir_float_t b0, b1, b2;
+    iir_float_t a1, a2;
+} iir_sos_t;
+
+/// Configuration of a filter
+typedef struct {
+    uint8_t n_channels;            ///< Channels per sample
+    uint8_t n_sections;            ///< Sections in the cascade
+    iir_sos_t sos[IIR_MAX_SECTIONS]; ///< Cascade, applied first to last
+} iir_config_t;
+
+typedef struct {
+    iir_config_t config;    ///< User passed configuration of the filter
+    iir_float_t* z;         ///< State, [section][2][channel] so channels run in lockstep
+} iir_handle_t;
+
+/******* PUBLIC FUNCTIONS *********/
+iir_err_t iir_init(const iir_config_t* config, iir_handle_t** out_handle);
+void iir_deinit(iir_handle_t* handle);
+void iir_reset(iir_handle_t* handle);
+void iir_process(iir_handle_t* handle, const iir_float_t* in, iir_float_t* out, size_t n_samples);
+
+// Filter design, appends sections to config, same coefficients as scipy.signal.butter(output='sos')
+iir_err_t iir_butter(iir_config_t* config, uint8_t order, iir_band_t band, double f1, double f2, double fs);
@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "iir.h"
+#include "iir_interface.h"
+
+iir_err_t iir_init(const iir_config_t* config, iir_handle_t** out_handle)
+{
+    if (config->n_channels == 0 || config->n_channels > IIR_MAX_CHANNELS) return IIR_ERR_INVALID;
+    if (config->n_sections == 0 || config->n_sections > IIR_MAX_SECTIONS) return IIR_ERR_INVALID;
+
+    iir_handle_t* handle = (iir_handle_t*)malloc(sizeof(iir_handle_t));
+    if (!handle) return IIR_ERR_NO_MEM;
+
+    handle->config = *config;
+    handle->z = (iir_float_t*)calloc((size_t)config->n_sections * 2 * config->n_channels, sizeof(iir_float_t));
+    if (!handle->z) {
+        free(handle);
+        return IIR_ERR_NO_MEM;
+    }
+
+    *out_handle = handle;
+    return IIR_OK;
+}
+
+void iir_deinit(iir_handle_t* handle)
+{
+    free(handle->z);
+    free(handle);
+}
+
+void iir_reset(iir_handle_t* handle)
+{
+    memset(handle->z, 0, (size_t)handle->config.n_sections * 2 * handle->config.n_channels * sizeof(iir_float_t));
+}
+
+void iir_process(iir_handle_t* handle, const iir_float_t* in, iir_float_t* out, size_t n_samples)
+{
+    // in and out may be the same buffer but must not partially overlap
+    const int n_ch = handle->config.n_channels;
+    const int n_sections = handle->config.n_sections;
+
+    for (size_t i = 0; i < n_samples; i++, in += n_ch, out += n_ch) {
+        if (out != in)
+            memcpy(out, in, n_ch * sizeof(iir_float_t));
+
+        iir_float_t* z = handle->z;
+        for (int s = 0; s < n_sections; s++, z += 2 * n_ch) {
+            const iir_sos_t c = handle->config.sos[s];
+            iir_float_t* z0 = z;
+            iir_float_t* z1 = z + n_ch;
+
+            // Channels are independent, this loop vectorises. Operation order matches sosfilt.
+            for (int ch = 0; ch < n_ch; ch++) {
+                iir_float_t x = out[ch];
+                iir_float_t y = c.b0 * x + z0[ch];
+                z0[ch] = c.b1 * x - c.a1 * y + z1[ch];
+                z1[ch] = c.b2 * x - c.a2 * y;
+                out[ch] = y;
+            }
+        }
+    }
+}
+
+iir_err_t iir_butter(iir_config_t* config, uint8_t order, iir_band_t band, double f1, double f2, double fs)
+{
+    if (order == 0 || order > IIR_MAX_ORDER || f1 <= 0 || f1 >= fs / 2) return IIR_ERR_INVALID;
+    if (band == IIR_BANDSTOP && (f2 <= f1 || f2 >= fs / 2)) return IIR_ERR_INVALID;
+
+    int n_poles = (band == IIR_BANDSTOP) ? 2 * order : order;
+    if (config->n_sections + (n_poles + 1) / 2 > IIR_MAX_SECTIONS) return IIR_ERR_INVALID;
+
+    // Analog prototype, then the same transforms as scipy.signal.iirfilter
+    double complex proto[IIR_MAX_ORDER];
+    double complex z[2 * IIR_MAX_ORDER], p[2 * IIR_MAX_ORDER];
+    double complex prod_p = 1;
+    _iir_butter_prototype(order, proto);
+
+    double w1 = _iir_warp(f1, fs);
+    switch (band) {
+    case IIR_LOWPASS:
+        for (int i = 0; i < order; i++) {
+            p[i] = proto[i] * w1;
+            z[i] = -INFINITY; // Zeros at infinity land on z = -1
+        }
+        break;
+    case IIR_HIGHPASS:
+        for (int i = 0; i < order; i++) {
+            p[i] = w1 / proto[i];
+            z[i] = 0;
+        }
+        break;
+    case IIR_BANDSTOP: {
+        double w2 = _iir_warp(f2, fs);
+        double wo = sqrt(w1 * w2), bw = w2 - w1;
+        for (int i = 0; i < order; i++) {
+            double complex ph = (bw / 2) / proto[i];
+            double complex d = csqrt(ph * ph - wo * wo);
+            p[i] = ph + d;
+            p[i + order] = ph - d;
+            z[i] = I * wo;
+            z[i + order] = -I * wo;
+        }
+        break;
+    }
+    default:
+        return IIR_ERR_INVALID;
+    }
+
+    // Analog gain, unity in the pass band of the normalised prototype
+    for (int i = 0; i < order; i++)
+        prod_p *= -proto[i];
+    double k = (band == IIR_LOWPASS) ? pow(w1, order) : creal(1 / prod_p);
+
+    // Bilinear transform, fs of the warped frequencies is 2
+    double complex num = 1, den = 1;
+    for (int i = 0; i < n_poles; i++) {
+        if (isinf(creal(z[i]))) {
+            z[i] = -1;
+        } else {
+            num *= 4 - z[i];
+            z[i] = (4 + z[i]) / (4 - z[i]);
+        }
+        den *= 4 - p[i];
+        p[i] = (4 + p[i]) / (4 - p[i]);
+    }
+    k *= creal(num / den);
+
+    _iir_add_sections(config, z, p, n_poles, k);
+    return IIR_OK;
+}
+
+void _iir_butter_prototype(uint8_t order, double complex* ret_p)
+{
+    // p = -exp(j pi m / 2N), m = -N+1, -N+3, ..., N-1
+    for (int i = 0; i < order; i++) {
+        int m = -order + 1 + 2 * i;
+        ret_p[i] = -cexp(I * M_PI * m / (2.0 * order));
+    }
+}
+
+double _iir_warp(double f, double fs)
+{
+    // Pre-warp for the bilinear transform at fs = 2, as scipy does with a normalised Wn
+    return 4 * tan(M_PI * f / fs);
+}
+
+void _iir_add_sections(iir_config_t* config, const double complex* z, const double complex* p, int n, double k)
+{
+    // One section per conjugate pole pair, or per real pole. Poles furthest from the unit circle go first
+    // like zpk2sos, so the sharpest resonances come last.
+    double complex pp[2 * IIR_MAX_ORDER], zz[2 * IIR_MAX_ORDER];
+    int n_pp = 0, n_zz = 0;
+    for (int i = 0; i < n; i++) {
+        if (cimag(p[i]) >= 0) pp[n_pp++] = p[i];
+        if (cimag(z[i]) >= 0) zz[n_zz++] = z[i];
+    }
+
+    for (int i = 1; i < n_pp; i++) {
+        double complex v = pp[i];
+        int j = i;
+        for (; j > 0 && fabs(1 - cabs(pp[j - 1])) < fabs(1 - cabs(v)); j--)
+            pp[j] = pp[j - 1];
+        pp[j] = v;
+    }
+
+    int zi = 0;
+    int first = config->n_sections;
+    for (int i = 0; i < n_pp; i++) {
+        iir_sos_t* s = &(config->sos[config->n_sections++]);
+        double complex pz = pp[i];
+
+        if (cimag(pz) > 0) {
+            s->a1 = -2 * creal(pz);
+            s->a2 = creal(pz) * creal(pz) + cimag(pz) * cimag(pz);
+        } else {
+            s->a1 = -creal(pz);
+            s->a2 = 0;
+        }
+
+        // Zeros of a design are all the same pair, so any pairing gives the same section
+        double complex zc = zz[zi < n_zz ? zi : n_zz - 1];
+        if (cimag(zc) > 0 || cimag(pz) > 0) {
+            double zr = creal(zc), zim = cimag(zc);
+            s->b0 = 1;
+            s->b1 = -2 * zr;
+            s->b2 = zr * zr + zim * zim;
+            zi += (cimag(zc) > 0) ? 1 : 2;
+        } else {
+            s->b0 = 1;
+            s->b1 = -creal(zc);
+            s->b2 = 0;
+            zi += 1;
+        }
+    }
+
+    // Gain goes in the first section, as zpk2sos does
+    config->sos[first].b0 *= k;
+    config->sos[first].b1 *= k;
+    config->sos[first].b2 *= k;
+}
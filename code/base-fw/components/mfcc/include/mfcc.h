@@ -0,0 +1,10 @@
+#pragma once
+#include "mfcc_interface.h"
+
+#define MFCC_AMIN   1e-10f  // power_to_db floor
+
+/******** PRIVATE FUNCTIOINS **********/
+double _mfcc_hz_to_mel(double hz);
+double _mfcc_mel_to_hz(double mel);
+void _mfcc_build_mel(mfcc_handle_t* handle);
+void _mfcc_power(mfcc_handle_t* handle, const float* samples);
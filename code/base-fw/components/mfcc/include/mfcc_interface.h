@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * MFCC of one window per call, the same numbers librosa.feature.mfcc gives for
+ * F2() in code/ml/feature_extractors.py: n_fft = window length, hann window,
+ * power spectrum, Slaney mel filterbank, power_to_db with top_db, orthonormal
+ * DCT-II.
+ *
+ * F2 leaves hop_length at 512 with center=True, so librosa takes a single frame
+ * centred on the first sample of the window: the first n_fft / 2 points are
+ * padding. This engine computes exactly that frame.
+ *
+ * All tables (window, twiddles, filterbank, DCT) are built once by mfcc_init,
+ * mfcc_compute only reads them.
+ */
+
+#define MFCC_MAX_CHANNELS   32
+#define MFCC_MAX_FFT        1024
+#define MFCC_MAX_MELS       64
+
+typedef enum {
+    MFCC_OK = 0,
+    MFCC_ERR_NO_MEM = -1,     ///< Allocation failed
+    MFCC_ERR_INVALID = -2,    ///< Bad size or sample rate
+} mfcc_err_t;
+
+typedef enum { MFCC_PAD_CONSTANT, MFCC_PAD_REFLECT } mfcc_pad_t;
+
+/// Configuration of an engine
+typedef struct {
+    uint8_t n_channels;        ///< Channels per sample
+    uint16_t n_fft;            ///< Window length in samples, even, 100 for 400ms at 250SPS
+    uint8_t n_mels;            ///< Mel bands, 15 in F2
+    uint8_t n_mfcc;            ///< Coefficients kept, 6 in F2
+    float sample_rate;         ///< Samples per second
+    float top_db;              ///< Floor below the loudest band of the window, 80 in librosa, 0 disables
+    mfcc_pad_t pad;            ///< Centre padding, librosa >= 0.10 pads with zeros
+    int64_t (*now_us)(void);   ///< Optional clock for the compute time statistics
+} mfcc_config_t;
+
+/// Compute time statistics, empty without a clock
+typedef struct {
+    uint32_t count;            ///< Windows computed
+    int64_t min_us;            ///< Shortest window
+    int64_t max_us;            ///< Longest window
+    int64_t total_us;          ///< Sum over all windows, for the mean
+} mfcc_stats_t;
+
+typedef struct {
+    mfcc_config_t config;      ///< User passed configuration of the engine
+    uint16_t n_bins;           ///< n_fft / 2 + 1
+    uint16_t first;            ///< First frame point that can be non zero
+
+    // Constant tables
+    float* window;             ///< Hann window, [n_fft]
+    float* cos_tab;            ///< cos(2 pi m / n_fft), [n_fft]
+    float* sin_tab;            ///< sin(2 pi m / n_fft), [n_fft]
+    float* mel_fb;             ///< Filterbank weights, [n_mels][n_bins]
+    uint16_t* mel_lo;          ///< First non zero bin of each band, [n_mels]
+    uint16_t* mel_hi;          ///< One past the last non zero bin, [n_mels]
+    float* dct;                ///< Orthonormal DCT-II, [n_mfcc][n_mels]
+
+    // Scratch
+    float* frame;              ///< Windowed frames, [n_fft][n_channels]
+    float* power;              ///< Power spectra, [n_bins][n_channels]
+    float* log_mel;            ///< Log mel energies, [n_channels][n_mels]
+
+    mfcc_stats_t stats;
+} mfcc_handle_t;
+
+/******* PUBLIC FUNCTIONS *********/
+mfcc_err_t mfcc_init(const mfcc_config_t* config, mfcc_handle_t** out_handle);
+void mfcc_deinit(mfcc_handle_t* handle);
+
+// samples is [n_fft][n_channels] sample major, ret_mfcc is [n_mfcc][n_channels] like F2 flattens it
+void mfcc_compute(mfcc_handle_t* handle, const float* samples, float* ret_mfcc);
+void mfcc_get_stats(mfcc_handle_t* handle, mfcc_stats_t* ret_stats);
+void mfcc_reset_stats(mfcc_handle_t* handle);
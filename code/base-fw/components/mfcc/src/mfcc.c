@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mfcc.h"
+#include "mfcc_interface.h"
+
+mfcc_err_t mfcc_init(const mfcc_config_t* config, mfcc_handle_t** out_handle)
+{
+    if (config->n_channels == 0 || config->n_channels > MFCC_MAX_CHANNELS) return MFCC_ERR_INVALID;
+    if (config->n_fft < 4 || config->n_fft > MFCC_MAX_FFT || (config->n_fft & 1)) return MFCC_ERR_INVALID;
+    if (config->n_mels == 0 || config->n_mels > MFCC_MAX_MELS) return MFCC_ERR_INVALID;
+    if (config->n_mfcc == 0 || config->n_mfcc > config->n_mels || config->sample_rate <= 0) return MFCC_ERR_INVALID;
+
+    mfcc_handle_t* handle = (mfcc_handle_t*)calloc(1, sizeof(mfcc_handle_t));
+    if (!handle) return MFCC_ERR_NO_MEM;
+
+    const uint16_t n_fft = config->n_fft;
+    handle->config = *config;
+    handle->n_bins = n_fft / 2 + 1;
+    // Zero padding covers the first half of the centred frame
+    handle->first = (config->pad == MFCC_PAD_CONSTANT) ? n_fft / 2 : 0;
+
+    handle->window = (float*)malloc(n_fft * sizeof(float));
+    handle->cos_tab = (float*)malloc(n_fft * sizeof(float));
+    handle->sin_tab = (float*)malloc(n_fft * sizeof(float));
+    handle->mel_fb = (float*)calloc((size_t)config->n_mels * handle->n_bins, sizeof(float));
+    handle->mel_lo = (uint16_t*)malloc(config->n_mels * sizeof(uint16_t));
+    handle->mel_hi = (uint16_t*)malloc(config->n_mels * sizeof(uint16_t));
+    handle->dct = (float*)malloc((size_t)config->n_mfcc * config->n_mels * sizeof(float));
+    handle->frame = (float*)malloc((size_t)n_fft * config->n_channels * sizeof(float));
+    handle->power = (float*)malloc((size_t)handle->n_bins * config->n_channels * sizeof(float));
+    handle->log_mel = (float*)malloc((size_t)config->n_channels * config->n_mels * sizeof(float));
+    if (!handle->window || !handle->cos_tab || !handle->sin_tab || !handle->mel_fb || !handle->mel_lo ||
+        !handle->mel_hi || !handle->dct || !handle->frame || !handle->power || !handle->log_mel) {
+        mfcc_deinit(handle);
+        return MFCC_ERR_NO_MEM;
+    }
+
+    // Periodic Hann, scipy.signal.get_window('hann', n_fft)
+    for (int n = 0; n < n_fft; n++) {
+        handle->window[n] = 0.5 - 0.5 * cos(2 * M_PI * n / n_fft);
+        handle->cos_tab[n] = cos(2 * M_PI * n / n_fft);
+        handle->sin_tab[n] = sin(2 * M_PI * n / n_fft);
+    }
+
+    _mfcc_build_mel(handle);
+
+    // scipy.fftpack.dct(type=2, norm='ortho') rows
+    const int n_mels = config->n_mels;
+    for (int k = 0; k < config->n_mfcc; k++) {
+        double scale = (k == 0) ? sqrt(1.0 / n_mels) : sqrt(2.0 / n_mels);
+        for (int m = 0; m < n_mels; m++)
+            handle->dct[k * n_mels + m] = scale * cos(M_PI * k * (2 * m + 1) / (2.0 * n_mels));
+    }
+
+    mfcc_reset_stats(handle);
+    *out_handle = handle;
+    return MFCC_OK;
+}
+
+void mfcc_deinit(mfcc_handle_t* handle)
+{
+    free(handle->window);
+    free(handle->cos_tab);
+    free(handle->sin_tab);
+    free(handle->mel_fb);
+    free(handle->mel_lo);
+    free(handle->mel_hi);
+    free(handle->dct);
+    free(handle->frame);
+    free(handle->power);
+    free(handle->log_mel);
+    free(handle);
+}
+
+void mfcc_compute(mfcc_handle_t* handle, const float* samples, float* ret_mfcc)
+{
+    const mfcc_config_t* c = &(handle->config);
+    const int n_ch = c->n_channels;
+    const int n_mels = c->n_mels;
+    int64_t start_us = c->now_us ? c->now_us() : 0;
+
+    _mfcc_power(handle, samples);
+
+    float max_db = -INFINITY;
+    for (int ch = 0; ch < n_ch; ch++) {
+        float* log_mel = handle->log_mel + ch * n_mels;
+        for (int m = 0; m < n_mels; m++) {
+            const float* w = handle->mel_fb + m * handle->n_bins;
+            float acc = 0;
+            for (int k = handle->mel_lo[m]; k < handle->mel_hi[m]; k++)
+                acc += w[k] * handle->power[k * n_ch + ch];
+            log_mel[m] = 10 * log10f(fmaxf(acc, MFCC_AMIN));
+            max_db = fmaxf(max_db, log_mel[m]);
+        }
+    }
+
+    // librosa applies top_db over the whole array it is given, every channel of the window at once
+    if (c->top_db > 0) {
+        float floor_db = max_db - c->top_db;
+        for (int i = 0; i < n_ch * n_mels; i++)
+            handle->log_mel[i] = fmaxf(handle->log_mel[i], floor_db);
+    }
+
+    for (int k = 0; k < c->n_mfcc; k++) {
+        const float* dct = handle->dct + k * n_mels;
+        for (int ch = 0; ch < n_ch; ch++) {
+            const float* log_mel = handle->log_mel + ch * n_mels;
+            float acc = 0;
+            for (int m = 0; m < n_mels; m++)
+                acc += dct[m] * log_mel[m];
+            ret_mfcc[k * n_ch + ch] = acc;
+        }
+    }
+
+    if (c->now_us) {
+        int64_t elapsed = c->now_us() - start_us;
+        mfcc_stats_t* s = &(handle->stats);
+        s->count++;
+        s->total_us += elapsed;
+        if (elapsed < s->min_us) s->min_us = elapsed;
+        if (elapsed > s->max_us) s->max_us = elapsed;
+    }
+}
+
+void mfcc_get_stats(mfcc_handle_t* handle, mfcc_stats_t* ret_stats)
+{
+    *ret_stats = handle->stats;
+}
+
+void mfcc_reset_stats(mfcc_handle_t* handle)
+{
+    handle->stats = (mfcc_stats_t) { .min_us = INT64_MAX };
+}
+
+double _mfcc_hz_to_mel(double hz)
+{
+    // Slaney: linear to 1kHz, logarithmic above
+    const double f_sp = 200.0 / 3, min_log_hz = 1000, logstep = log(6.4) / 27;
+    if (hz < min_log_hz) return hz / f_sp;
+    return min_log_hz / f_sp + log(hz / min_log_hz) / logstep;
+}
+
+double _mfcc_mel_to_hz(double mel)
+{
+    const double f_sp = 200.0 / 3, min_log_hz = 1000, logstep = log(6.4) / 27;
+    const double min_log_mel = min_log_hz / f_sp;
+    if (mel < min_log_mel) return mel * f_sp;
+    return min_log_hz * exp(logstep * (mel - min_log_mel));
+}
+
+void _mfcc_build_mel(mfcc_handle_t* handle)
+{
+    // librosa.filters.mel(norm='slaney', htk=False), fmin 0 and fmax sr / 2
+    const mfcc_config_t* c = &(handle->config);
+    const int n_mels = c->n_mels, n_bins = handle->n_bins;
+    double mel_f[MFCC_MAX_MELS + 2];
+    double mel_max = _mfcc_hz_to_mel(c->sample_rate / 2.0);
+    for (int i = 0; i < n_mels + 2; i++)
+        mel_f[i] = _mfcc_mel_to_hz(mel_max * i / (n_mels + 1));
+
+    for (int m = 0; m < n_mels; m++) {
+        float* w = handle->mel_fb + m * n_bins;
+        double lower_diff = mel_f[m + 1] - mel_f[m];
+        double upper_diff = mel_f[m + 2] - mel_f[m + 1];
+        double enorm = 2.0 / (mel_f[m + 2] - mel_f[m]);
+
+        handle->mel_lo[m] = n_bins;
+        handle->mel_hi[m] = 0;
+        for (int k = 0; k < n_bins; k++) {
+            double f = (double)k * c->sample_rate / c->n_fft;
+            double lower = (f - mel_f[m]) / lower_diff;
+            double upper = (mel_f[m + 2] - f) / upper_diff;
+            double v = fmax(0, fmin(lower, upper));
+            if (v <= 0) continue;
+            w[k] = v * enorm;
+            if (k < handle->mel_lo[m]) handle->mel_lo[m] = k;
+            handle->mel_hi[m] = k + 1;
+        }
+        if (handle->mel_hi[m] == 0) handle->mel_lo[m] = 0; // Empty band, librosa warns about these
+    }
+}
+
+void _mfcc_power(mfcc_handle_t* handle, const float* samples)
+{
+    const mfcc_config_t* c = &(handle->config);
+    const int n_fft = c->n_fft, n_ch = c->n_channels, half = n_fft / 2;
+    const int first = handle->first;
+    float* frame = handle->frame;
+
+    // Frame centred on the first sample, reflect padding mirrors samples 1..half
+    for (int n = first; n < n_fft; n++) {
+        int s = n - half;
+        const float* in = samples + (s < 0 ? -s : s) * n_ch;
+        for (int ch = 0; ch < n_ch; ch++)
+            frame[n * n_ch + ch] = handle->window[n] * in[ch];
+    }
+
+    // Real DFT straight from the twiddle tables, only over the points that can be non zero.
+    // n_fft is 100 in F2, not a power of two, and half of it is padding. Channels run in
+    // lockstep so each twiddle is loaded once and the inner loop vectorises.
+    float re[MFCC_MAX_CHANNELS], im[MFCC_MAX_CHANNELS];
+    for (int k = 0; k < handle->n_bins; k++) {
+        memset(re, 0, n_ch * sizeof(float));
+        memset(im, 0, n_ch * sizeof(float));
+        int idx = (k * first) % n_fft;
+        for (int n = first; n < n_fft; n++) {
+            const float cr = handle->cos_tab[idx], ci = handle->sin_tab[idx];
+            const float* f = frame + n * n_ch;
+            for (int ch = 0; ch < n_ch; ch++) {
+                re[ch] += f[ch] * cr;
+                im[ch] -= f[ch] * ci;
+            }
+            idx += k;
+            if (idx >= n_fft) idx -= n_fft;
+        }
+        for (int ch = 0; ch < n_ch; ch++)
+            handle->power[k * n_ch + ch] = re[ch] * re[ch] + im[ch] * im[ch];
+    }
+}
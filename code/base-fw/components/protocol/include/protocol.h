@@ -0,0 +1,76 @@
+#pragma once
+#include "protocol_interface.h"
+
+/* Header field offsets */
+#define PROTO_OFF_MAGIC         0
+#define PROTO_OFF_VERSION       2
+#define PROTO_OFF_TYPE          3
+#define PROTO_OFF_DEVICE_ID     4
+#define PROTO_OFF_SEQ           8
+#define PROTO_OFF_SAMPLE_CNT    12
+#define PROTO_OFF_N_SAMPLES     16
+#define PROTO_OFF_DATA_RATE     18
+#define PROTO_OFF_N_CHANNELS    19
+#define PROTO_OFF_STATUS        20
+#define PROTO_OFF_FLAGS         23
+#define PROTO_OFF_TIMESTAMP     24
+#define PROTO_OFF_GAIN          32
+
+/* Sync frame field offsets */
+#define PROTO_OFF_SYNC_SEQ      8
+#define PROTO_OFF_SYNC_T1       12
+#define PROTO_OFF_SYNC_T2       20
+#define PROTO_OFF_SYNC_T3       28
+
+/* NACK frame field offsets */
+#define PROTO_OFF_NACK_SEQ      8
+#define PROTO_OFF_NACK_RANGES   12
+#define PROTO_OFF_NACK_FIRST    16
+
+/* Conversion, matches the LSB used by the firmware before the binary protocol */
+#define PROTO_VREF              2.5
+#define PROTO_FULL_SCALE        16777215.0
+
+/* Rice coding of the sample section */
+#define PROTO_RICE_MAX_ORDER    2   // Fixed predictors up to second order
+#define PROTO_RICE_MAX_K        27
+#define PROTO_RICE_ESCAPE       24  // Quotients this long are sent as raw residuals instead
+#define PROTO_RICE_RAW_BITS     28  // Zigzag residual of a second order prediction of 24 bit samples
+
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    uint64_t acc;
+    int n_bits;
+    bool overflow;
+} _proto_bit_writer_t;
+
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    size_t pos;                 ///< Next byte to load
+    uint64_t acc;
+    int n_bits;                 ///< Bits loaded but not read
+    bool overrun;
+} _proto_bit_reader_t;
+
+/******** PRIVATE FUNCTIOINS **********/
+void _proto_put_u16(uint8_t* p, uint16_t v);
+void _proto_put_u24(uint8_t* p, uint32_t v);
+void _proto_put_u32(uint8_t* p, uint32_t v);
+void _proto_put_u64(uint8_t* p, uint64_t v);
+void _proto_put_header(uint8_t* p, const proto_header_t* h);
+uint8_t* _proto_begin_extra(proto_encoder_t* enc, uint8_t* buf, proto_type_t type, uint32_t sample_counter,
+                            int64_t timestamp_us);
+void _proto_put_f32(uint8_t* p, float v);
+float _proto_get_f32(const uint8_t* p);
+uint16_t _proto_get_u16(const uint8_t* p);
+uint32_t _proto_get_u24(const uint8_t* p);
+uint32_t _proto_get_u32(const uint8_t* p);
+uint64_t _proto_get_u64(const uint8_t* p);
+int32_t _proto_rice_sample(const uint8_t* packed, uint8_t n_channels, int s, int ch);
+void _proto_bits_put(_proto_bit_writer_t* w, uint32_t value, int n_bits);
+void _proto_bits_flush(_proto_bit_writer_t* w);
+uint8_t* _proto_replay_slot(proto_replay_t* replay, uint32_t seq);
+uint32_t _proto_bits_get(_proto_bit_reader_t* r, int n_bits);
@@ -0,0 +1,316 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Binary streaming protocol, shared by the firmware encoder and the host decoder.
+ *
+ * Every datagram is one frame. All multi-byte fields are little endian.
+ *
+ *   offset  size  field
+ *   0       2     magic "NX"
+ *   2       1     version
+ *   3       1     frame type
+ *   4       4     device id
+ *   8       4     frame sequence number
+ *   12      4     sample counter of the first sample in the frame
+ *   16      2     number of samples
+ *   18      1     data rate (ads1299_data_rate_t)
+ *   19      1     number of channels
+ *   20      3     ADS1299 status word of the last sample, first device of a daisy chain
+ *   23      1     flags (PROTO_FLAG_*)
+ *   24      8     board time of the first sample's DRDY edge, esp_timer microseconds
+ *   32      n_ch  per channel gain (ads1299_gain_t)
+ *   ...           n_samples * n_ch packed 24 bit two's complement samples, sample major
+ *
+ * With PROTO_FLAG_RICE the samples are losslessly compressed instead, to the end of
+ * the datagram. Each channel in turn, as an MSB first bit stream:
+ *
+ *   2 bits        predictor order p: 0 the sample, 1 the previous sample, 2 linear
+ *                 extrapolation of the previous two
+ *   5 bits        Rice parameter k
+ *   p * 24 bits   first samples verbatim, so a frame never depends on the one before
+ *   ...           residual of every other sample, zigzag mapped to u, as u >> k in unary
+ *                 (ones ended by a zero) and the low k bits. Quotients of 24 and more
+ *                 are 24 ones and u in 28 bits.
+ *
+ * Zero bits pad the end to a byte. The encoder falls back to raw samples when the
+ * coded frame would not be smaller.
+ *
+ * Decision frames (PROTO_TYPE_DECISION) carry no samples. The sample counter and time
+ * are the last sample of the utterance, and after the gains come:
+ *
+ *   0       1     best class
+ *   1       1     number of classes
+ *   2       2     windows scored
+ *   4       4*n   float32 log-likelihood per class
+ *
+ * Summary frames (PROTO_TYPE_SUMMARY) keep the host informed while activity gating
+ * holds samples back. The sample counter and time are the latest sample, after the gains:
+ *
+ *   0       4     samples since the last summary
+ *   4       4     of them sent in segments
+ *   8       2     segments started
+ *   10      2     reserved, zero
+ *   12      4     float32 noise floor of the activity energy
+ *   16      4     float32 peak activity energy
+ *   20      4*n_ch float32 RMS per channel, in codes
+ *
+ * Telemetry frames (PROTO_TYPE_TELEMETRY) report the board's counters every few seconds
+ * on the data socket. The sample counter and time are the latest sample; every count is
+ * since streaming started, so a lost frame loses nothing but resolution. After the gains:
+ *
+ *   0       4     DRDY edges
+ *   4       4     conversions read
+ *   8       4     DRDY edges missed, overrun before they were read
+ *   12      4     samples lost to a full sample ring
+ *   16      2     samples in the ring
+ *   18      2     most samples the ring held
+ *   20      2     ring capacity
+ *   22      1     int8 WiFi RSSI in dBm, 0 when not associated
+ *   23      1     CPU clock in MHz, the timers below count its cycles
+ *   24      4     frames sent
+ *   28      4     samples sent
+ *   32      4     sendto() retries while WiFi was out of TX buffers
+ *   36      4     sendto() failures
+ *   40      4     samples dropped after the retries ran out
+ *   44      4     bytes sent, wraps
+ *   48      4     longest DRDY edge to conversion read, microseconds
+ *   52      4     lowest free heap, bytes
+ *   56      4     frames resent for NACKs
+ *   60      4     frames NACKed that had already left the replay window
+ *   64      84*7  one block per timer, in proto_tlm_timer_t order:
+ *                   0   4   durations recorded
+ *                   4   4   shortest, cycles
+ *                   8   4   longest, cycles
+ *                   12  8   sum of all, cycles
+ *                   20  4*16 durations per bin: bin 0 under 2^8 cycles, bin i under
+ *                          2^(8+i), the last one everything beyond
+ *
+ * Sync frames align the board's clock with the host's, NTP style. The host sends a
+ * request (PROTO_TYPE_SYNC_REQUEST) to the board's sync port and the board answers
+ * (PROTO_TYPE_SYNC_REPLY) at once, to the sender. Both have their own short layout:
+ *
+ *   0       2     magic "NX"
+ *   2       1     version
+ *   3       1     frame type
+ *   4       4     device id, of the board asked in a request
+ *   8       4     exchange number, echoed
+ *   12      8     t1, host time the request was sent, echoed
+ *   20      8     t2, board time the request arrived, zero in a request
+ *   28      8     t3, board time the reply was sent, zero in a request
+ *
+ * Board times are esp_timer microseconds, the same clock as the sample times.
+ *
+ * NACK frames (PROTO_TYPE_NACK) ask a board to resend frames the host is missing, by
+ * sequence number. The host sends them to wherever the board's frames come from and
+ * the board resends what is still in its replay window (proto_replay_t), unchanged but
+ * for PROTO_FLAG_RETRANSMIT. Their own layout:
+ *
+ *   0       2     magic "NX"
+ *   2       1     version
+ *   3       1     frame type
+ *   4       4     device id of the board asked
+ *   8       4     NACK number, counts up
+ *   12      1     number of ranges, up to PROTO_NACK_MAX_RANGES
+ *   13      3     reserved, zero
+ *   16      6*n   per range: first sequence number (4) and frames from it (2)
+ */
+
+#define PROTO_MAGIC         0x584E  // "NX"
+#define PROTO_VERSION       2
+#define PROTO_HEADER_SIZE   32
+#define PROTO_SAMPLE_BYTES  3
+#define PROTO_MAX_CHANNELS  32
+#define PROTO_MAX_DATA_RATE 6       // DR_250SPS, slowest ads1299_data_rate_t code
+#define PROTO_MAX_CLASSES   32
+#define PROTO_DECISION_SIZE(n_ch, n_classes) ((size_t)PROTO_HEADER_SIZE + (n_ch) + 4 + 4 * (n_classes))
+#define PROTO_SUMMARY_SIZE(n_ch) ((size_t)PROTO_HEADER_SIZE + (n_ch) + 20 + 4 * (n_ch))
+#define PROTO_SYNC_SIZE     36
+#define PROTO_TLM_HIST_BINS 16
+#define PROTO_TLM_HIST_SHIFT 8      // Cycles under the first bin's bound, as a power of two
+#define PROTO_TELEMETRY_SIZE(n_ch) ((size_t)PROTO_HEADER_SIZE + (n_ch) + 64 + 84 * PROTO_TLM_TIMERS)
+#define PROTO_NACK_MAX_RANGES 32
+#define PROTO_NACK_SIZE(n_ranges) ((size_t)16 + 6 * (n_ranges))
+
+typedef enum {
+    PROTO_OK = 0,
+    PROTO_ERR_SHORT = -1,      ///< Buffer too short for the frame
+    PROTO_ERR_MAGIC = -2,      ///< Not a protocol frame
+    PROTO_ERR_VERSION = -3,    ///< Unsupported protocol version
+    PROTO_ERR_FULL = -4,       ///< No room for another sample in the frame
+    PROTO_ERR_INVALID = -5,    ///< Malformed field
+} proto_err_t;
+
+typedef enum {
+    PROTO_TYPE_DATA,
+    PROTO_TYPE_DECISION,
+    PROTO_TYPE_SUMMARY,
+    PROTO_TYPE_SYNC_REQUEST,
+    PROTO_TYPE_SYNC_REPLY,
+    PROTO_TYPE_TELEMETRY,
+    PROTO_TYPE_NACK,
+} proto_type_t;
+
+/// Timers of a telemetry frame, in the order they are sent
+typedef enum {
+    PROTO_TLM_READ,            ///< ads1299_read(), the SPI transfer and parsing
+    PROTO_TLM_CALLBACK,        ///< Sample callback in the acquisition task, the ring push, filtering without a DSP task
+    PROTO_TLM_PROCESS,         ///< Stream task work per sample, classifier, gating and framing
+    PROTO_TLM_ENCODE,          ///< proto_encoder_finish(), the Rice coding
+    PROTO_TLM_SEND,            ///< sendto() of a data frame, with its retries
+    PROTO_TLM_DSP,             ///< DSP task work per sample, filtering and the ring push
+    PROTO_TLM_LATENCY,         ///< DRDY edge to conversion read, whole microseconds times the CPU clock
+    PROTO_TLM_TIMERS
+} proto_tlm_timer_t;
+
+#define PROTO_FLAG_FILTERED 0x01   // Samples went through the on-board IIR filters
+#define PROTO_FLAG_RICE     0x02   // Samples are Rice coded, set per frame by the encoder
+#define PROTO_FLAG_RETRANSMIT 0x04 // Resent from the replay window for a NACK
+
+/// Decoded frame header
+typedef struct {
+    uint8_t version;                    ///< Protocol version
+    uint8_t type;                       ///< proto_type_t
+    uint8_t flags;                      ///< PROTO_FLAG_* bits
+    uint32_t device_id;                 ///< Identifier of the sending board
+    uint32_t seq;                       ///< Frame sequence number
+    uint32_t sample_counter;            ///< Counter of the first sample in the frame
+    uint16_t n_samples;                 ///< Samples in the frame
+    uint8_t data_rate;                  ///< ads1299_data_rate_t code
+    uint8_t n_channels;                 ///< Channels per sample
+    uint32_t status;                    ///< ADS1299 status word of the last sample
+    int64_t timestamp_us;               ///< Board time of the first sample's DRDY edge
+    uint8_t gain[PROTO_MAX_CHANNELS];   ///< ads1299_gain_t code per channel
+} proto_header_t;
+
+/// Word decision of the on-board classifier
+typedef struct {
+    uint8_t best;                              ///< Index of the winning class
+    uint8_t n_classes;                         ///< Classes scored
+    uint16_t n_frames;                         ///< Windows in the utterance
+    float log_likelihood[PROTO_MAX_CLASSES];   ///< Score per class
+} proto_decision_t;
+
+/// Keep-alive summary of a gated stream
+typedef struct {
+    uint32_t n_samples;                        ///< Samples since the last summary
+    uint32_t active_samples;                   ///< Of them sent in segments
+    uint16_t segments;                         ///< Segments started
+    float floor;                               ///< Noise floor of the activity energy
+    float peak;                                ///< Highest activity energy
+    float rms[PROTO_MAX_CHANNELS];             ///< RMS per channel in codes
+} proto_summary_t;
+
+/// Cycle count statistics of one timer
+typedef struct {
+    uint32_t count;                            ///< Durations recorded
+    uint32_t min_cycles;                       ///< Shortest
+    uint32_t max_cycles;                       ///< Longest
+    uint64_t total_cycles;                     ///< Sum of all
+    uint32_t hist[PROTO_TLM_HIST_BINS];        ///< Durations per power of two bin
+} proto_tlm_stats_t;
+
+/// Board counters, cumulative since streaming started
+typedef struct {
+    uint32_t drdy_count;                       ///< DRDY edges
+    uint32_t sample_count;                     ///< Conversions read
+    uint32_t missed_drdy;                      ///< DRDY edges overrun before they were read
+    uint32_t ring_overflows;                   ///< Samples lost to a full sample ring
+    uint16_t ring_count;                       ///< Samples in the ring
+    uint16_t ring_high_water;                  ///< Most samples the ring held
+    uint16_t ring_capacity;                    ///< Samples the ring holds
+    int8_t rssi;                               ///< WiFi RSSI in dBm, 0 when not associated
+    uint8_t cpu_mhz;                           ///< Clock the timers count cycles of
+    uint32_t frames_sent;                      ///< Frames sent
+    uint32_t samples_sent;                     ///< Samples sent
+    uint32_t send_retries;                     ///< sendto() retried while out of TX buffers
+    uint32_t send_errors;                      ///< sendto() failures
+    uint32_t samples_dropped;                  ///< Samples dropped after the retries ran out
+    uint32_t sent_bytes;                       ///< Bytes sent, wraps
+    uint32_t latency_max_us;                   ///< Longest DRDY edge to conversion read
+    uint32_t heap_min_free;                    ///< Lowest free heap in bytes
+    uint32_t retransmits;                      ///< Frames resent for NACKs
+    uint32_t replay_misses;                    ///< Frames NACKed after they left the replay window
+    proto_tlm_stats_t timers[PROTO_TLM_TIMERS]; ///< By proto_tlm_timer_t
+} proto_telemetry_t;
+
+/// One clock exchange, request or reply
+typedef struct {
+    uint8_t type;                              ///< PROTO_TYPE_SYNC_REQUEST or PROTO_TYPE_SYNC_REPLY
+    uint32_t device_id;                        ///< Board answering, or asked
+    uint32_t seq;                              ///< Exchange number chosen by the host
+    int64_t t1_us;                             ///< Host time the request was sent
+    int64_t t2_us;                             ///< Board time the request arrived
+    int64_t t3_us;                             ///< Board time the reply was sent
+} proto_sync_t;
+
+/// Range of frames a NACK asks for
+typedef struct {
+    uint32_t first_seq;                        ///< Sequence number of the first
+    uint16_t count;                            ///< Frames from it
+} proto_nack_range_t;
+
+/// Frames the host is missing from one board
+typedef struct {
+    uint32_t device_id;                        ///< Board asked
+    uint32_t seq;                              ///< NACK number chosen by the host
+    uint8_t n_ranges;
+    proto_nack_range_t ranges[PROTO_NACK_MAX_RANGES];
+} proto_nack_t;
+
+/// The latest frames sent, for resending on a NACK. Slot seq % n_slots holds frame seq.
+typedef struct {
+    uint8_t* buf;               ///< n_slots * slot_size bytes, caller owned
+    uint16_t n_slots;
+    uint16_t slot_size;         ///< Largest frame plus its 2 byte length
+} proto_replay_t;
+
+/// Frame encoder writing into a caller owned buffer
+typedef struct {
+    uint8_t* buf;               ///< Output buffer
+    size_t cap;                 ///< Size of the output buffer
+    size_t len;                 ///< Bytes used by the frame being built
+    proto_header_t header;      ///< Header of the frame being built
+    uint8_t* scratch;           ///< Room for the Rice coded samples, NULL sends them raw
+    size_t scratch_cap;         ///< Size of scratch
+} proto_encoder_t;
+
+/******* PUBLIC FUNCTIONS *********/
+proto_err_t proto_encoder_init(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t device_id,
+                               uint8_t data_rate, uint8_t n_channels, const uint8_t gain[]);
+proto_err_t proto_encoder_begin(proto_encoder_t* enc, uint32_t sample_counter, int64_t timestamp_us);
+proto_err_t proto_encoder_add(proto_encoder_t* enc, uint32_t status, const int32_t data[]);
+size_t proto_encoder_finish(proto_encoder_t* enc);
+proto_err_t proto_encoder_set_data_rate(proto_encoder_t* enc, uint8_t data_rate);
+proto_err_t proto_encoder_set_flags(proto_encoder_t* enc, uint8_t flags);
+proto_err_t proto_encoder_set_rice(proto_encoder_t* enc, uint8_t* scratch, size_t scratch_cap);
+size_t proto_encode_decision(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t sample_counter,
+                             int64_t timestamp_us, const proto_decision_t* decision);
+size_t proto_encode_summary(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t sample_counter,
+                            int64_t timestamp_us, const proto_summary_t* summary);
+size_t proto_encode_telemetry(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t sample_counter,
+                              int64_t timestamp_us, const proto_telemetry_t* telemetry);
+size_t proto_encode_sync(uint8_t* buf, size_t cap, const proto_sync_t* sync);
+size_t proto_encode_nack(uint8_t* buf, size_t cap, const proto_nack_t* nack);
+size_t proto_frame_size(uint8_t n_channels, uint16_t n_samples);
+uint16_t proto_frame_capacity(size_t cap, uint8_t n_channels);
+
+proto_err_t proto_decode_header(const uint8_t* buf, size_t len, proto_header_t* ret_header);
+proto_err_t proto_decode_samples(const uint8_t* buf, size_t len, const proto_header_t* header, int32_t* ret_data);
+proto_err_t proto_decode_decision(const uint8_t* buf, size_t len, const proto_header_t* header, proto_decision_t* ret_decision);
+proto_err_t proto_decode_summary(const uint8_t* buf, size_t len, const proto_header_t* header, proto_summary_t* ret_summary);
+proto_err_t proto_decode_telemetry(const uint8_t* buf, size_t len, const proto_header_t* header,
+                                  proto_telemetry_t* ret_telemetry);
+proto_err_t proto_decode_sync(const uint8_t* buf, size_t len, proto_sync_t* ret_sync);
+proto_err_t proto_decode_nack(const uint8_t* buf, size_t len, proto_nack_t* ret_nack);
+proto_err_t proto_replay_init(proto_replay_t* replay, uint8_t* buf, size_t cap, size_t max_frame);
+void proto_replay_clear(proto_replay_t* replay);
+proto_err_t proto_replay_store(proto_replay_t* replay, const uint8_t* frame, size_t len);
+size_t proto_replay_get(proto_replay_t* replay, uint32_t seq, const uint8_t** ret_frame);
+size_t proto_rice_encode(const uint8_t* packed, uint16_t n_samples, uint8_t n_channels, uint8_t* out, size_t cap);
+proto_err_t proto_rice_decode(const uint8_t* in, size_t len, uint16_t n_samples, uint8_t n_channels, int32_t* ret_data);
+uint32_t proto_data_rate_sps(uint8_t data_rate);
+double proto_gain_value(uint8_t gain);
+double proto_to_volts(int32_t code, uint8_t gain);
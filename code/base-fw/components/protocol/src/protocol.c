@@ -0,0 +1,523 @@
+#include <string.h>
+
+#include "protocol.h"
+#include "protocol_interface.h"
+
+static const double gain_values[] = {1, 2, 4, 6, 8, 12, 24};
+
+proto_err_t proto_encoder_init(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t device_id,
+                               uint8_t data_rate, uint8_t n_channels, const uint8_t gain[])
+{
+    if (n_channels == 0 || n_channels > PROTO_MAX_CHANNELS) return PROTO_ERR_INVALID;
+    if (cap < proto_frame_size(n_channels, 1)) return PROTO_ERR_SHORT;
+
+    *enc = (proto_encoder_t) {
+        .buf = buf,
+        .cap = cap,
+        .header = {
+            .version = PROTO_VERSION,
+            .type = PROTO_TYPE_DATA,
+            .device_id = device_id,
+            .data_rate = data_rate,
+            .n_channels = n_channels,
+        },
+    };
+    memcpy(enc->header.gain, gain, n_channels);
+    return PROTO_OK;
+}
+
+proto_err_t proto_encoder_begin(proto_encoder_t* enc, uint32_t sample_counter, int64_t timestamp_us)
+{
+    proto_header_t* h = &(enc->header);
+    h->sample_counter = sample_counter;
+    h->timestamp_us = timestamp_us;
+    h->n_samples = 0;
+    h->status = 0;
+
+    // Everything but n_samples and status is known up front
+    _proto_put_header(enc->buf, h);
+
+    enc->len = PROTO_HEADER_SIZE + h->n_channels;
+    return PROTO_OK;
+}
+
+proto_err_t proto_encoder_add(proto_encoder_t* enc, uint32_t status, const int32_t data[])
+{
+    proto_header_t* h = &(enc->header);
+    size_t sample_len = (size_t)h->n_channels * PROTO_SAMPLE_BYTES;
+    if (enc->len + sample_len > enc->cap || h->n_samples == UINT16_MAX) return PROTO_ERR_FULL;
+
+    uint8_t* p = enc->buf + enc->len;
+    for (int i = 0; i < h->n_channels; i++, p += PROTO_SAMPLE_BYTES)
+        _proto_put_u24(p, (uint32_t)data[i]);
+
+    enc->len += sample_len;
+    h->n_samples++;
+    h->status = status;
+    return PROTO_OK;
+}
+
+size_t proto_encoder_finish(proto_encoder_t* enc)
+{
+    proto_header_t* h = &(enc->header);
+    _proto_put_u16(enc->buf + PROTO_OFF_N_SAMPLES, h->n_samples);
+    _proto_put_u24(enc->buf + PROTO_OFF_STATUS, h->status);
+
+    if (enc->scratch && h->n_samples > 1) {
+        // Keep the coded samples only when they are smaller, the flag goes out with this frame alone
+        size_t off = PROTO_HEADER_SIZE + h->n_channels, raw = enc->len - off;
+        size_t cap = raw - 1 < enc->scratch_cap ? raw - 1 : enc->scratch_cap;
+        size_t n = proto_rice_encode(enc->buf + off, h->n_samples, h->n_channels, enc->scratch, cap);
+        if (n) {
+            memcpy(enc->buf + off, enc->scratch, n);
+            enc->len = off + n;
+            enc->buf[PROTO_OFF_FLAGS] = h->flags | PROTO_FLAG_RICE;
+        }
+    }
+
+    // Idle until the next begin
+    h->seq++;
+    h->n_samples = 0;
+    return enc->len;
+}
+
+proto_err_t proto_encoder_set_data_rate(proto_encoder_t* enc, uint8_t data_rate)
+{
+    // Only between frames, a frame never mixes rates
+    if (data_rate > PROTO_MAX_DATA_RATE || enc->header.n_samples) return PROTO_ERR_INVALID;
+    enc->header.data_rate = data_rate;
+    return PROTO_OK;
+}
+
+proto_err_t proto_encoder_set_flags(proto_encoder_t* enc, uint8_t flags)
+{
+    if (enc->header.n_samples || (flags & (PROTO_FLAG_RICE | PROTO_FLAG_RETRANSMIT))) return PROTO_ERR_INVALID;
+    enc->header.flags = flags;
+    return PROTO_OK;
+}
+
+proto_err_t proto_encoder_set_rice(proto_encoder_t* enc, uint8_t* scratch, size_t scratch_cap)
+{
+    if (enc->header.n_samples) return PROTO_ERR_INVALID;
+    enc->scratch = scratch;
+    enc->scratch_cap = scratch_cap;
+    return PROTO_OK;
+}
+
+size_t proto_encode_decision(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t sample_counter,
+                             int64_t timestamp_us, const proto_decision_t* decision)
+{
+    size_t len = PROTO_DECISION_SIZE(enc->header.n_channels, decision->n_classes);
+    if (decision->n_classes > PROTO_MAX_CLASSES || cap < len) return 0;
+
+    uint8_t* p = _proto_begin_extra(enc, buf, PROTO_TYPE_DECISION, sample_counter, timestamp_us);
+    p[0] = decision->best;
+    p[1] = decision->n_classes;
+    _proto_put_u16(p + 2, decision->n_frames);
+    p += 4;
+    for (int i = 0; i < decision->n_classes; i++, p += 4)
+        _proto_put_f32(p, decision->log_likelihood[i]);
+    return len;
+}
+
+size_t proto_encode_summary(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t sample_counter,
+                            int64_t timestamp_us, const proto_summary_t* summary)
+{
+    size_t len = PROTO_SUMMARY_SIZE(enc->header.n_channels);
+    if (cap < len) return 0;
+
+    uint8_t* p = _proto_begin_extra(enc, buf, PROTO_TYPE_SUMMARY, sample_counter, timestamp_us);
+    _proto_put_u32(p, summary->n_samples);
+    _proto_put_u32(p + 4, summary->active_samples);
+    _proto_put_u16(p + 8, summary->segments);
+    _proto_put_u16(p + 10, 0);
+    _proto_put_f32(p + 12, summary->floor);
+    _proto_put_f32(p + 16, summary->peak);
+    p += 20;
+    for (int i = 0; i < enc->header.n_channels; i++, p += 4)
+        _proto_put_f32(p, summary->rms[i]);
+    return len;
+}
+
+size_t proto_encode_telemetry(proto_encoder_t* enc, uint8_t* buf, size_t cap, uint32_t sample_counter,
+                              int64_t timestamp_us, const proto_telemetry_t* telemetry)
+{
+    size_t len = PROTO_TELEMETRY_SIZE(enc->header.n_channels);
+    if (cap < len) return 0;
+
+    const proto_telemetry_t* t = telemetry;
+    uint8_t* p = _proto_begin_extra(enc, buf, PROTO_TYPE_TELEMETRY, sample_counter, timestamp_us);
+    _proto_put_u32(p, t->drdy_count);
+    _proto_put_u32(p + 4, t->sample_count);
+    _proto_put_u32(p + 8, t->missed_drdy);
+    _proto_put_u32(p + 12, t->ring_overflows);
+    _proto_put_u16(p + 16, t->ring_count);
+    _proto_put_u16(p + 18, t->ring_high_water);
+    _proto_put_u16(p + 20, t->ring_capacity);
+    p[22] = (uint8_t)t->rssi;
+    p[23] = t->cpu_mhz;
+    _proto_put_u32(p + 24, t->frames_sent);
+    _proto_put_u32(p + 28, t->samples_sent);
+    _proto_put_u32(p + 32, t->send_retries);
+    _proto_put_u32(p + 36, t->send_errors);
+    _proto_put_u32(p + 40, t->samples_dropped);
+    _proto_put_u32(p + 44, t->sent_bytes);
+    _proto_put_u32(p + 48, t->latency_max_us);
+    _proto_put_u32(p + 52, t->heap_min_free);
+    _proto_put_u32(p + 56, t->retransmits);
+    _proto_put_u32(p + 60, t->replay_misses);
+    p += 64;
+    for (int i = 0; i < PROTO_TLM_TIMERS; i++) {
+        const proto_tlm_stats_t* s = &(t->timers[i]);
+        _proto_put_u32(p, s->count);
+        _proto_put_u32(p + 4, s->min_cycles);
+        _proto_put_u32(p + 8, s->max_cycles);
+        _proto_put_u64(p + 12, s->total_cycles);
+        p += 20;
+        for (int b = 0; b < PROTO_TLM_HIST_BINS; b++, p += 4)
+            _proto_put_u32(p, s->hist[b]);
+    }
+    return len;
+}
+
+size_t proto_encode_sync(uint8_t* buf, size_t cap, const proto_sync_t* sync)
+{
+    if (cap < PROTO_SYNC_SIZE) return 0;
+    if (sync->type != PROTO_TYPE_SYNC_REQUEST && sync->type != PROTO_TYPE_SYNC_REPLY) return 0;
+
+    _proto_put_u16(buf + PROTO_OFF_MAGIC, PROTO_MAGIC);
+    buf[PROTO_OFF_VERSION] = PROTO_VERSION;
+    buf[PROTO_OFF_TYPE] = sync->type;
+    _proto_put_u32(buf + PROTO_OFF_DEVICE_ID, sync->device_id);
+    _proto_put_u32(buf + PROTO_OFF_SYNC_SEQ, sync->seq);
+    _proto_put_u64(buf + PROTO_OFF_SYNC_T1, (uint64_t)sync->t1_us);
+    _proto_put_u64(buf + PROTO_OFF_SYNC_T2, (uint64_t)sync->t2_us);
+    _proto_put_u64(buf + PROTO_OFF_SYNC_T3, (uint64_t)sync->t3_us);
+    return PROTO_SYNC_SIZE;
+}
+
+size_t proto_encode_nack(uint8_t* buf, size_t cap, const proto_nack_t* nack)
+{
+    size_t len = PROTO_NACK_SIZE(nack->n_ranges);
+    if (nack->n_ranges > PROTO_NACK_MAX_RANGES || cap < len) return 0;
+
+    _proto_put_u16(buf + PROTO_OFF_MAGIC, PROTO_MAGIC);
+    buf[PROTO_OFF_VERSION] = PROTO_VERSION;
+    buf[PROTO_OFF_TYPE] = PROTO_TYPE_NACK;
+    _proto_put_u32(buf + PROTO_OFF_DEVICE_ID, nack->device_id);
+    _proto_put_u32(buf + PROTO_OFF_NACK_SEQ, nack->seq);
+    buf[PROTO_OFF_NACK_RANGES] = nack->n_ranges;
+    _proto_put_u24(buf + PROTO_OFF_NACK_RANGES + 1, 0);
+    uint8_t* p = buf + PROTO_OFF_NACK_FIRST;
+    for (int i = 0; i < nack->n_ranges; i++, p += 6) {
+        _proto_put_u32(p, nack->ranges[i].first_seq);
+        _proto_put_u16(p + 4, nack->ranges[i].count);
+    }
+    return len;
+}
+
+size_t proto_frame_size(uint8_t n_channels, uint16_t n_samples)
+{
+    return PROTO_HEADER_SIZE + n_channels + (size_t)n_samples * n_channels * PROTO_SAMPLE_BYTES;
+}
+
+uint16_t proto_frame_capacity(size_t cap, uint8_t n_channels)
+{
+    size_t header = PROTO_HEADER_SIZE + n_channels;
+    if (n_channels == 0 || cap < header) return 0;
+    size_t n = (cap - header) / ((size_t)n_channels * PROTO_SAMPLE_BYTES);
+    return n > UINT16_MAX ? UINT16_MAX : (uint16_t)n;
+}
+
+proto_err_t proto_decode_header(const uint8_t* buf, size_t len, proto_header_t* ret_header)
+{
+    if (len < PROTO_HEADER_SIZE) return PROTO_ERR_SHORT;
+    if (_proto_get_u16(buf + PROTO_OFF_MAGIC) != PROTO_MAGIC) return PROTO_ERR_MAGIC;
+    if (buf[PROTO_OFF_VERSION] != PROTO_VERSION) return PROTO_ERR_VERSION;
+    // Sync and NACK frames have layouts of their own, see proto_decode_sync and proto_decode_nack
+    if (buf[PROTO_OFF_TYPE] == PROTO_TYPE_SYNC_REQUEST || buf[PROTO_OFF_TYPE] == PROTO_TYPE_SYNC_REPLY ||
+        buf[PROTO_OFF_TYPE] == PROTO_TYPE_NACK)
+        return PROTO_ERR_INVALID;
+
+    proto_header_t h = {
+        .version = buf[PROTO_OFF_VERSION],
+        .type = buf[PROTO_OFF_TYPE],
+        .flags = buf[PROTO_OFF_FLAGS],
+        .device_id = _proto_get_u32(buf + PROTO_OFF_DEVICE_ID),
+        .seq = _proto_get_u32(buf + PROTO_OFF_SEQ),
+        .sample_counter = _proto_get_u32(buf + PROTO_OFF_SAMPLE_CNT),
+        .n_samples = _proto_get_u16(buf + PROTO_OFF_N_SAMPLES),
+        .data_rate = buf[PROTO_OFF_DATA_RATE],
+        .n_channels = buf[PROTO_OFF_N_CHANNELS],
+        .status = _proto_get_u24(buf + PROTO_OFF_STATUS),
+        .timestamp_us = (int64_t)_proto_get_u64(buf + PROTO_OFF_TIMESTAMP),
+    };
+
+    if (h.n_channels == 0 || h.n_channels > PROTO_MAX_CHANNELS) return PROTO_ERR_INVALID;
+    // Coded samples have no fixed size, proto_decode_samples finds out whether they are all there
+    size_t min_len = (h.flags & PROTO_FLAG_RICE) ? proto_frame_size(h.n_channels, 0) : proto_frame_size(h.n_channels, h.n_samples);
+    if (len < min_len) return PROTO_ERR_SHORT;
+    memcpy(h.gain, buf + PROTO_OFF_GAIN, h.n_channels);
+
+    *ret_header = h;
+    return PROTO_OK;
+}
+
+proto_err_t proto_decode_samples(const uint8_t* buf, size_t len, const proto_header_t* header, int32_t* ret_data)
+{
+    size_t count = (size_t)header->n_samples * header->n_channels;
+    const uint8_t* p = buf + PROTO_HEADER_SIZE + header->n_channels;
+    if (header->flags & PROTO_FLAG_RICE)
+        return proto_rice_decode(p, len - (p - buf), header->n_samples, header->n_channels, ret_data);
+    if (len < proto_frame_size(header->n_channels, header->n_samples)) return PROTO_ERR_SHORT;
+
+    for (size_t i = 0; i < count; i++, p += PROTO_SAMPLE_BYTES) {
+        // Sign conversion from 24 bit to 32 bit
+        uint32_t v = _proto_get_u24(p);
+        ret_data[i] = (int32_t)((v & 0x800000) ? (v | 0xFF000000) : v);
+    }
+    return PROTO_OK;
+}
+
+uint32_t proto_data_rate_sps(uint8_t data_rate)
+{
+    // 16kSPS at code 0, halving with every step
+    if (data_rate > PROTO_MAX_DATA_RATE) return 0;
+    return 16000u >> data_rate;
+}
+
+proto_err_t proto_decode_decision(const uint8_t* buf, size_t len, const proto_header_t* header, proto_decision_t* ret_decision)
+{
+    size_t off = PROTO_HEADER_SIZE + header->n_channels;
+    if (header->type != PROTO_TYPE_DECISION) return PROTO_ERR_INVALID;
+    if (len < off + 4) return PROTO_ERR_SHORT;
+
+    const uint8_t* p = buf + off;
+    proto_decision_t d = {
+        .best = p[0],
+        .n_classes = p[1],
+        .n_frames = _proto_get_u16(p + 2),
+    };
+    if (d.n_classes > PROTO_MAX_CLASSES || d.best >= d.n_classes) return PROTO_ERR_INVALID;
+    if (len < PROTO_DECISION_SIZE(header->n_channels, d.n_classes)) return PROTO_ERR_SHORT;
+
+    p += 4;
+    for (int i = 0; i < d.n_classes; i++, p += 4)
+        d.log_likelihood[i] = _proto_get_f32(p);
+    *ret_decision = d;
+    return PROTO_OK;
+}
+
+proto_err_t proto_decode_summary(const uint8_t* buf, size_t len, const proto_header_t* header, proto_summary_t* ret_summary)
+{
+    if (header->type != PROTO_TYPE_SUMMARY) return PROTO_ERR_INVALID;
+    if (len < PROTO_SUMMARY_SIZE(header->n_channels)) return PROTO_ERR_SHORT;
+
+    const uint8_t* p = buf + PROTO_HEADER_SIZE + header->n_channels;
+    proto_summary_t s = {
+        .n_samples = _proto_get_u32(p),
+        .active_samples = _proto_get_u32(p + 4),
+        .segments = _proto_get_u16(p + 8),
+        .floor = _proto_get_f32(p + 12),
+        .peak = _proto_get_f32(p + 16),
+    };
+    p += 20;
+    for (int i = 0; i < header->n_channels; i++, p += 4)
+        s.rms[i] = _proto_get_f32(p);
+    *ret_summary = s;
+    return PROTO_OK;
+}
+
+proto_err_t proto_decode_telemetry(const uint8_t* buf, size_t len, const proto_header_t* header,
+                                  proto_telemetry_t* ret_telemetry)
+{
+    if (header->type != PROTO_TYPE_TELEMETRY) return PROTO_ERR_INVALID;
+    if (len < PROTO_TELEMETRY_SIZE(header->n_channels)) return PROTO_ERR_SHORT;
+
+    const uint8_t* p = buf + PROTO_HEADER_SIZE + header->n_channels;
+    proto_telemetry_t t = {
+        .drdy_count = _proto_get_u32(p),
+        .sample_count = _proto_get_u32(p + 4),
+        .missed_drdy = _proto_get_u32(p + 8),
+        .ring_overflows = _proto_get_u32(p + 12),
+        .ring_count = _proto_get_u16(p + 16),
+        .ring_high_water = _proto_get_u16(p + 18),
+        .ring_capacity = _proto_get_u16(p + 20),
+        .rssi = (int8_t)p[22],
+        .cpu_mhz = p[23],
+        .frames_sent = _proto_get_u32(p + 24),
+        .samples_sent = _proto_get_u32(p + 28),
+        .send_retries = _proto_get_u32(p + 32),
+        .send_errors = _proto_get_u32(p + 36),
+        .samples_dropped = _proto_get_u32(p + 40),
+        .sent_bytes = _proto_get_u32(p + 44),
+        .latency_max_us = _proto_get_u32(p + 48),
+        .heap_min_free = _proto_get_u32(p + 52),
+        .retransmits = _proto_get_u32(p + 56),
+        .replay_misses = _proto_get_u32(p + 60),
+    };
+    p += 64;
+    for (int i = 0; i < PROTO_TLM_TIMERS; i++) {
+        proto_tlm_stats_t* s = &(t.timers[i]);
+        s->count = _proto_get_u32(p);
+        s->min_cycles = _proto_get_u32(p + 4);
+        s->max_cycles = _proto_get_u32(p + 8);
+        s->total_cycles = _proto_get_u64(p + 12);
+        p += 20;
+        for (int b = 0; b < PROTO_TLM_HIST_BINS; b++, p += 4)
+            s->hist[b] = _proto_get_u32(p);
+    }
+    *ret_telemetry = t;
+    return PROTO_OK;
+}
+
+proto_err_t proto_decode_sync(const uint8_t* buf, size_t len, proto_sync_t* ret_sync)
+{
+    if (len < 4) return PROTO_ERR_SHORT;
+    if (_proto_get_u16(buf + PROTO_OFF_MAGIC) != PROTO_MAGIC) return PROTO_ERR_MAGIC;
+    if (buf[PROTO_OFF_VERSION] != PROTO_VERSION) return PROTO_ERR_VERSION;
+    if (buf[PROTO_OFF_TYPE] != PROTO_TYPE_SYNC_REQUEST && buf[PROTO_OFF_TYPE] != PROTO_TYPE_SYNC_REPLY)
+        return PROTO_ERR_INVALID;
+    if (len < PROTO_SYNC_SIZE) return PROTO_ERR_SHORT;
+
+    *ret_sync = (proto_sync_t) {
+        .type = buf[PROTO_OFF_TYPE],
+        .device_id = _proto_get_u32(buf + PROTO_OFF_DEVICE_ID),
+        .seq = _proto_get_u32(buf + PROTO_OFF_SYNC_SEQ),
+        .t1_us = (int64_t)_proto_get_u64(buf + PROTO_OFF_SYNC_T1),
+        .t2_us = (int64_t)_proto_get_u64(buf + PROTO_OFF_SYNC_T2),
+        .t3_us = (int64_t)_proto_get_u64(buf + PROTO_OFF_SYNC_T3),
+    };
+    return PROTO_OK;
+}
+
+proto_err_t proto_decode_nack(const uint8_t* buf, size_t len, proto_nack_t* ret_nack)
+{
+    if (len < 4) return PROTO_ERR_SHORT;
+    if (_proto_get_u16(buf + PROTO_OFF_MAGIC) != PROTO_MAGIC) return PROTO_ERR_MAGIC;
+    if (buf[PROTO_OFF_VERSION] != PROTO_VERSION) return PROTO_ERR_VERSION;
+    if (buf[PROTO_OFF_TYPE] != PROTO_TYPE_NACK) return PROTO_ERR_INVALID;
+    if (len < PROTO_NACK_SIZE(0)) return PROTO_ERR_SHORT;
+
+    proto_nack_t n = {
+        .device_id = _proto_get_u32(buf + PROTO_OFF_DEVICE_ID),
+        .seq = _proto_get_u32(buf + PROTO_OFF_NACK_SEQ),
+        .n_ranges = buf[PROTO_OFF_NACK_RANGES],
+    };
+    if (n.n_ranges > PROTO_NACK_MAX_RANGES) return PROTO_ERR_INVALID;
+    if (len < PROTO_NACK_SIZE(n.n_ranges)) return PROTO_ERR_SHORT;
+    const uint8_t* p = buf + PROTO_OFF_NACK_FIRST;
+    for (int i = 0; i < n.n_ranges; i++, p += 6) {
+        n.ranges[i].first_seq = _proto_get_u32(p);
+        n.ranges[i].count = _proto_get_u16(p + 4);
+    }
+    *ret_nack = n;
+    return PROTO_OK;
+}
+
+double proto_gain_value(uint8_t gain)
+{
+    if (gain >= sizeof(gain_values) / sizeof(gain_values[0])) return 1;
+    return gain_values[gain];
+}
+
+double proto_to_volts(int32_t code, uint8_t gain)
+{
+    // LSB = VREF / Gain / (2^24 - 1)
+    return code * (PROTO_VREF / proto_gain_value(gain) / PROTO_FULL_SCALE);
+}
+
+void _proto_put_header(uint8_t* p, const proto_header_t* h)
+{
+    _proto_put_u16(p + PROTO_OFF_MAGIC, PROTO_MAGIC);
+    p[PROTO_OFF_VERSION] = h->version;
+    p[PROTO_OFF_TYPE] = h->type;
+    _proto_put_u32(p + PROTO_OFF_DEVICE_ID, h->device_id);
+    _proto_put_u32(p + PROTO_OFF_SEQ, h->seq);
+    _proto_put_u32(p + PROTO_OFF_SAMPLE_CNT, h->sample_counter);
+    p[PROTO_OFF_DATA_RATE] = h->data_rate;
+    p[PROTO_OFF_N_CHANNELS] = h->n_channels;
+    p[PROTO_OFF_FLAGS] = h->flags;
+    _proto_put_u64(p + PROTO_OFF_TIMESTAMP, (uint64_t)h->timestamp_us);
+    memcpy(p + PROTO_OFF_GAIN, h->gain, h->n_channels);
+}
+
+uint8_t* _proto_begin_extra(proto_encoder_t* enc, uint8_t* buf, proto_type_t type, uint32_t sample_counter,
+                            int64_t timestamp_us)
+{
+    // Frames without samples share the stream's identity and sequence, in their own buffer
+    // since a data frame may be half built in the encoder's
+    proto_header_t h = enc->header;
+    h.type = type;
+    h.sample_counter = sample_counter;
+    h.timestamp_us = timestamp_us;
+    h.n_samples = 0;
+    h.status = 0;
+    _proto_put_header(buf, &h);
+    _proto_put_u16(buf + PROTO_OFF_N_SAMPLES, 0);
+    _proto_put_u24(buf + PROTO_OFF_STATUS, 0);
+    enc->header.seq++;
+    return buf + PROTO_HEADER_SIZE + h.n_channels;
+}
+
+void _proto_put_f32(uint8_t* p, float v)
+{
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    _proto_put_u32(p, u);
+}
+
+float _proto_get_f32(const uint8_t* p)
+{
+    uint32_t u = _proto_get_u32(p);
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+void _proto_put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+void _proto_put_u24(uint8_t* p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+}
+
+void _proto_put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void _proto_put_u64(uint8_t* p, uint64_t v)
+{
+    _proto_put_u32(p, (uint32_t)v);
+    _proto_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+uint16_t _proto_get_u16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t _proto_get_u24(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+uint32_t _proto_get_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t _proto_get_u64(const uint8_t* p)
+{
+    return _proto_get_u32(p) | ((uint64_t)_proto_get_u32(p + 4) << 32);
+}
@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include "protocol.h"
+#include "protocol_interface.h"
+
+proto_err_t proto_replay_init(proto_replay_t* replay, uint8_t* buf, size_t cap, size_t max_frame)
+{
+    size_t slot_size = max_frame + 2;
+    if (max_frame < PROTO_HEADER_SIZE || slot_size > UINT16_MAX) return PROTO_ERR_INVALID;
+    size_t n_slots = cap / slot_size;
+    if (n_slots == 0) return PROTO_ERR_SHORT;
+
+    *replay = (proto_replay_t) {
+        .buf = buf,
+        .n_slots = n_slots > UINT16_MAX ? UINT16_MAX : (uint16_t)n_slots,
+        .slot_size = (uint16_t)slot_size,
+    };
+    proto_replay_clear(replay);
+    return PROTO_OK;
+}
+
+void proto_replay_clear(proto_replay_t* replay)
+{
+    // A zero length marks an empty slot
+    for (int i = 0; i < replay->n_slots; i++)
+        _proto_put_u16(replay->buf + (size_t)i * replay->slot_size, 0);
+}
+
+proto_err_t proto_replay_store(proto_replay_t* replay, const uint8_t* frame, size_t len)
+{
+    if (len < PROTO_HEADER_SIZE) return PROTO_ERR_SHORT;
+    if (len + 2 > replay->slot_size) return PROTO_ERR_FULL;
+
+    // Takes the place of the frame n_slots before it
+    uint8_t* slot = _proto_replay_slot(replay, _proto_get_u32(frame + PROTO_OFF_SEQ));
+    _proto_put_u16(slot, (uint16_t)len);
+    memcpy(slot + 2, frame, len);
+    return PROTO_OK;
+}
+
+size_t proto_replay_get(proto_replay_t* replay, uint32_t seq, const uint8_t** ret_frame)
+{
+    uint8_t* slot = _proto_replay_slot(replay, seq);
+    size_t len = _proto_get_u16(slot);
+    if (!len || _proto_get_u32(slot + 2 + PROTO_OFF_SEQ) != seq) return 0;
+
+    // Only ever sent again as a retransmission
+    slot[2 + PROTO_OFF_FLAGS] |= PROTO_FLAG_RETRANSMIT;
+    *ret_frame = slot + 2;
+    return len;
+}
+
+uint8_t* _proto_replay_slot(proto_replay_t* replay, uint32_t seq)
+{
+    return replay->buf + (size_t)(seq % replay->n_slots) * replay->slot_size;
+}
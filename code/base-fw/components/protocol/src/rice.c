@@ -0,0 +1,156 @@
+#include <string.h>
+
+#include "protocol.h"
+#include "protocol_interface.h"
+
+size_t proto_rice_encode(const uint8_t* packed, uint16_t n_samples, uint8_t n_channels, uint8_t* out, size_t cap)
+{
+    uint8_t order[PROTO_MAX_CHANNELS], k[PROTO_MAX_CHANNELS];
+    uint64_t estimate = 0;
+
+    for (int ch = 0; ch < n_channels; ch++) {
+        // Pick the fixed predictor with the smallest residuals over the frame, then k from their mean
+        uint64_t sum[PROTO_RICE_MAX_ORDER + 1] = {0};
+        int32_t x1 = 0, x2 = 0;
+        for (int s = 0; s < n_samples; s++) {
+            int32_t x = _proto_rice_sample(packed, n_channels, s, ch);
+            if (s >= PROTO_RICE_MAX_ORDER) {
+                sum[0] += (uint32_t)(x < 0 ? -x : x);
+                int32_t r1 = x - x1, r2 = x - 2 * x1 + x2;
+                sum[1] += (uint32_t)(r1 < 0 ? -r1 : r1);
+                sum[2] += (uint32_t)(r2 < 0 ? -r2 : r2);
+            }
+            x2 = x1;
+            x1 = x;
+        }
+        int o = 0;
+        for (int i = 1; i <= PROTO_RICE_MAX_ORDER; i++)
+            if (sum[i] < sum[o]) o = i;
+        if (o > n_samples) o = n_samples;
+
+        // Zigzag doubles the magnitudes, 2^k near their mean
+        uint32_t count = n_samples > PROTO_RICE_MAX_ORDER ? n_samples - PROTO_RICE_MAX_ORDER : 1;
+        int b = 0;
+        while (b < PROTO_RICE_MAX_K && ((uint64_t)count << (b + 1)) < 2 * sum[o])
+            b++;
+
+        order[ch] = o;
+        k[ch] = b;
+        estimate += 7 + 24 * o + (uint64_t)(n_samples - o) * (b + 1) + ((2 * sum[o]) >> b);
+    }
+
+    // Rice length from the same sums, a frame that will not fit goes raw before anything is written.
+    // The worst case is one pass over the samples, however noisy they are.
+    if (estimate > (uint64_t)cap * 8) return 0;
+
+    _proto_bit_writer_t w = { .buf = out, .cap = cap };
+    for (int ch = 0; ch < n_channels; ch++) {
+        const int o = order[ch], b = k[ch];
+        _proto_bits_put(&w, o, 2);
+        _proto_bits_put(&w, b, 5);
+
+        // Warm up samples go verbatim so every frame decodes on its own
+        int32_t x1 = 0, x2 = 0;
+        for (int s = 0; s < n_samples; s++) {
+            int32_t x = _proto_rice_sample(packed, n_channels, s, ch);
+            if (s < o) {
+                _proto_bits_put(&w, (uint32_t)x & 0xFFFFFF, 24);
+            } else {
+                int32_t r = o == 0 ? x : (o == 1 ? x - x1 : x - 2 * x1 + x2);
+                uint32_t u = ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+                uint32_t q = u >> b;
+                if (q < PROTO_RICE_ESCAPE) {
+                    _proto_bits_put(&w, (1u << (q + 1)) - 2, q + 1);
+                    _proto_bits_put(&w, u & ((1u << b) - 1), b);
+                } else {
+                    _proto_bits_put(&w, (1u << PROTO_RICE_ESCAPE) - 1, PROTO_RICE_ESCAPE);
+                    _proto_bits_put(&w, u, PROTO_RICE_RAW_BITS);
+                }
+            }
+            if (w.overflow) return 0;
+            x2 = x1;
+            x1 = x;
+        }
+    }
+
+    _proto_bits_flush(&w);
+    return w.overflow ? 0 : w.len;
+}
+
+proto_err_t proto_rice_decode(const uint8_t* in, size_t len, uint16_t n_samples, uint8_t n_channels, int32_t* ret_data)
+{
+    _proto_bit_reader_t r = { .buf = in, .len = len };
+
+    for (int ch = 0; ch < n_channels; ch++) {
+        int order = _proto_bits_get(&r, 2);
+        int k = _proto_bits_get(&r, 5);
+        if (order > PROTO_RICE_MAX_ORDER || k > PROTO_RICE_MAX_K) return PROTO_ERR_INVALID;
+
+        int32_t x1 = 0, x2 = 0;
+        for (int s = 0; s < n_samples; s++) {
+            int32_t x;
+            if (s < order) {
+                uint32_t v = _proto_bits_get(&r, 24);
+                x = (int32_t)((v & 0x800000) ? (v | 0xFF000000) : v);
+            } else {
+                uint32_t q = 0;
+                while (q < PROTO_RICE_ESCAPE && _proto_bits_get(&r, 1))
+                    q++;
+                uint32_t u = (q < PROTO_RICE_ESCAPE) ? (q << k) | _proto_bits_get(&r, k) : _proto_bits_get(&r, PROTO_RICE_RAW_BITS);
+                int32_t res = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+                x = order == 0 ? res : (order == 1 ? res + x1 : res + 2 * x1 - x2);
+            }
+            if (r.overrun) return PROTO_ERR_SHORT;
+            ret_data[(size_t)s * n_channels + ch] = x;
+            x2 = x1;
+            x1 = x;
+        }
+    }
+    return PROTO_OK;
+}
+
+int32_t _proto_rice_sample(const uint8_t* packed, uint8_t n_channels, int s, int ch)
+{
+    uint32_t v = _proto_get_u24(packed + ((size_t)s * n_channels + ch) * PROTO_SAMPLE_BYTES);
+    return (int32_t)((v & 0x800000) ? (v | 0xFF000000) : v);
+}
+
+void _proto_bits_put(_proto_bit_writer_t* w, uint32_t value, int n_bits)
+{
+    // MSB first, n_bits at most 32
+    if (n_bits == 0) return;
+    w->acc = (w->acc << n_bits) | (value & (0xFFFFFFFFu >> (32 - n_bits)));
+    w->n_bits += n_bits;
+    while (w->n_bits >= 8) {
+        w->n_bits -= 8;
+        if (w->len >= w->cap) {
+            w->overflow = true;
+            return;
+        }
+        w->buf[w->len++] = (uint8_t)(w->acc >> w->n_bits);
+    }
+}
+
+void _proto_bits_flush(_proto_bit_writer_t* w)
+{
+    if (w->n_bits)
+        _proto_bits_put(w, 0, 8 - w->n_bits);
+}
+
+uint32_t _proto_bits_get(_proto_bit_reader_t* r, int n_bits)
+{
+    // n_bits at most 32, past the end reads zeros and flags the overrun
+    if (n_bits == 0) return 0;
+    while (r->n_bits < n_bits) {
+        uint8_t byte = 0;
+        if (r->pos < r->len)
+            byte = r->buf[r->pos];
+        else
+            r->overrun = true;
+        r->pos++;
+        r->acc = (r->acc << 8) | byte;
+        r->n_bits += 8;
+    }
+    r->n_bits -= n_bits;
+    return (uint32_t)(r->acc >> r->n_bits) & (0xFFFFFFFFu >> (32 - n_bits));
+}
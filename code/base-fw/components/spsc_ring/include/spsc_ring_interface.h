@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/*
+ * Lock free single producer / single consumer ring of fixed size elements.
+ *
+ * Exactly one task may push and exactly one task may pop, they can run on
+ * different cores. Producer and consumer indices live on separate cache lines
+ * so the two sides never false share.
+ */
+
+#define SPSC_RING_CACHE_LINE 64 // Covers the ESP32-S3 (32 bytes) and most hosts (64 bytes)
+#define SPSC_RING_ALIGNED _Alignas(SPSC_RING_CACHE_LINE)
+
+typedef enum {
+    SPSC_RING_OK = 0,
+    SPSC_RING_ERR_NO_MEM = -1,     ///< Allocation failed
+    SPSC_RING_ERR_INVALID = -2,    ///< Capacity is not a power of two, or zero sized elements
+} spsc_ring_err_t;
+
+/// Configuration of a ring
+typedef struct {
+    uint32_t elem_size;    ///< Size of one element in bytes
+    uint32_t capacity;     ///< Number of elements, must be a power of two
+} spsc_ring_config_t;
+
+/// Ring statistics
+typedef struct {
+    uint32_t capacity;     ///< Number of elements the ring holds
+    uint32_t count;        ///< Elements currently in the ring
+    uint32_t high_water;   ///< Most elements ever held at once
+    uint32_t overflows;    ///< Pushes rejected because the ring was full
+    uint32_t pushed;       ///< Elements pushed since init, wraps
+} spsc_ring_stats_t;
+
+typedef struct {
+    // Producer side
+    SPSC_RING_ALIGNED atomic_uint head;  ///< Next slot to write, free running
+    atomic_uint high_water;              ///< Most elements ever held at once
+    atomic_uint overflows;               ///< Pushes rejected because the ring was full
+
+    // Consumer side
+    SPSC_RING_ALIGNED atomic_uint tail;  ///< Next slot to read, free running
+
+    // Read only after init
+    SPSC_RING_ALIGNED spsc_ring_config_t config; ///< User passed configuration of the ring
+    uint32_t mask;                       ///< capacity - 1
+    uint8_t* buf;                        ///< Element storage
+} spsc_ring_handle_t;
+
+/******* PUBLIC FUNCTIONS *********/
+spsc_ring_err_t spsc_ring_init(const spsc_ring_config_t* config, spsc_ring_handle_t** out_handle);
+void spsc_ring_deinit(spsc_ring_handle_t* handle);
+
+// Producer only
+bool spsc_ring_push(spsc_ring_handle_t* handle, const void* elem);
+
+// Consumer only
+bool spsc_ring_pop(spsc_ring_handle_t* handle, void* ret_elem);
+void spsc_ring_clear(spsc_ring_handle_t* handle);
+
+// Any task
+uint32_t spsc_ring_count(spsc_ring_handle_t* handle);
+void spsc_ring_get_stats(spsc_ring_handle_t* handle, spsc_ring_stats_t* ret_stats);
+void spsc_ring_reset_stats(spsc_ring_handle_t* handle);
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc_ring_interface.h"
+
+spsc_ring_err_t spsc_ring_init(const spsc_ring_config_t* config, spsc_ring_handle_t** out_handle)
+{
+    uint32_t cap = config->capacity;
+    if (cap == 0 || (cap & (cap - 1)) || config->elem_size == 0) return SPSC_RING_ERR_INVALID;
+
+    // aligned_alloc wants the size to be a multiple of the alignment
+    size_t size = (sizeof(spsc_ring_handle_t) + SPSC_RING_CACHE_LINE - 1) & ~(size_t)(SPSC_RING_CACHE_LINE - 1);
+    spsc_ring_handle_t* handle = (spsc_ring_handle_t*)aligned_alloc(SPSC_RING_CACHE_LINE, size);
+    if (!handle) return SPSC_RING_ERR_NO_MEM;
+
+    memset(handle, 0, sizeof(*handle));
+    handle->config = *config;
+    handle->mask = cap - 1;
+    handle->buf = (uint8_t*)malloc((size_t)cap * config->elem_size);
+    if (!handle->buf) {
+        free(handle);
+        return SPSC_RING_ERR_NO_MEM;
+    }
+
+    atomic_init(&(handle->head), 0);
+    atomic_init(&(handle->tail), 0);
+    atomic_init(&(handle->high_water), 0);
+    atomic_init(&(handle->overflows), 0);
+
+    *out_handle = handle;
+    return SPSC_RING_OK;
+}
+
+void spsc_ring_deinit(spsc_ring_handle_t* handle)
+{
+    free(handle->buf);
+    free(handle);
+}
+
+bool spsc_ring_push(spsc_ring_handle_t* handle, const void* elem)
+{
+    unsigned head = atomic_load_explicit(&(handle->head), memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&(handle->tail), memory_order_acquire);
+    unsigned used = head - tail;
+
+    if (used > handle->mask) {
+        atomic_fetch_add_explicit(&(handle->overflows), 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(handle->buf + (size_t)(head & handle->mask) * handle->config.elem_size, elem, handle->config.elem_size);
+    atomic_store_explicit(&(handle->head), head + 1, memory_order_release);
+
+    // Only the producer writes the high water mark
+    if (used + 1 > atomic_load_explicit(&(handle->high_water), memory_order_relaxed))
+        atomic_store_explicit(&(handle->high_water), used + 1, memory_order_relaxed);
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_handle_t* handle, void* ret_elem)
+{
+    unsigned tail = atomic_load_explicit(&(handle->tail), memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&(handle->head), memory_order_acquire);
+    if (head == tail) return false;
+
+    memcpy(ret_elem, handle->buf + (size_t)(tail & handle->mask) * handle->config.elem_size, handle->config.elem_size);
+    atomic_store_explicit(&(handle->tail), tail + 1, memory_order_release);
+    return true;
+}
+
+void spsc_ring_clear(spsc_ring_handle_t* handle)
+{
+    // Consume everything the producer has published so far
+    unsigned head = atomic_load_explicit(&(handle->head), memory_order_acquire);
+    atomic_store_explicit(&(handle->tail), head, memory_order_release);
+}
+
+uint32_t spsc_ring_count(spsc_ring_handle_t* handle)
+{
+    unsigned tail = atomic_load_explicit(&(handle->tail), memory_order_acquire);
+    unsigned head = atomic_load_explicit(&(handle->head), memory_order_acquire);
+    return head - tail;
+}
+
+void spsc_ring_get_stats(spsc_ring_handle_t* handle, spsc_ring_stats_t* ret_stats)
+{
+    *ret_stats = (spsc_ring_stats_t) {
+        .capacity = handle->config.capacity,
+        .count = spsc_ring_count(handle),
+        .high_water = atomic_load_explicit(&(handle->high_water), memory_order_relaxed),
+        .overflows = atomic_load_explicit(&(handle->overflows), memory_order_relaxed),
+        .pushed = atomic_load_explicit(&(handle->head), memory_order_relaxed),
+    };
+}
+
+void spsc_ring_reset_stats(spsc_ring_handle_t* handle)
+{
+    // Races with a concurrent push, call while the producer is idle
+    atomic_store_explicit(&(handle->high_water), spsc_ring_count(handle), memory_order_relaxed);
+    atomic_store_explicit(&(handle->overflows), 0, memory_order_relaxed);
+}
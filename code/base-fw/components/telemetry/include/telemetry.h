@@ -0,0 +1,5 @@
+#pragma once
+#include "telemetry_interface.h"
+
+/******** PRIVATE FUNCTIOINS **********/
+int _tlm_bin(uint32_t cycles);
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "esp_cpu.h"
+
+/*
+ * Cycle count timers for the hot paths, cheap enough to leave on in production.
+ *
+ * A timer has one writer and any number of readers. The writer bumps a sequence
+ * number before and after every update and a reader copies the statistics until it
+ * sees the same even number on both sides, so neither side ever waits on a lock.
+ * The cycle counter is per core: start and stop a timer in a task pinned to a core.
+ *
+ * Durations are also counted in power of two bins: bin 0 holds those under
+ * 2^TLM_HIST_SHIFT cycles, every next bin those up to twice as long, and the last
+ * bin everything beyond.
+ */
+
+#define TLM_HIST_BINS   16
+#define TLM_HIST_SHIFT  8   // 256 cycles, about 1us at 240MHz, the last bin starts near 17ms
+
+/// Statistics of one timer, in CPU cycles
+typedef struct {
+    uint32_t count;                  ///< Durations recorded
+    uint32_t min_cycles;             ///< Shortest, UINT32_MAX before the first
+    uint32_t max_cycles;             ///< Longest
+    uint64_t total_cycles;           ///< Sum of all, for the mean
+    uint32_t hist[TLM_HIST_BINS];    ///< Durations per power of two bin
+} tlm_stats_t;
+
+typedef struct {
+    atomic_uint seq;                 ///< Odd while the writer is updating stats
+    tlm_stats_t stats;
+} tlm_timer_t;
+
+/******* PUBLIC FUNCTIONS *********/
+// Writer only, or while the writer is stopped
+void tlm_timer_reset(tlm_timer_t* timer);
+void tlm_timer_add(tlm_timer_t* timer, uint32_t cycles);
+
+// Any task
+void tlm_timer_read(tlm_timer_t* timer, tlm_stats_t* ret_stats);
+uint32_t tlm_quantile_cycles(const tlm_stats_t* stats, float q);
+uint32_t tlm_cpu_mhz(void);
+double tlm_cycles_to_us(uint64_t cycles);
+
+static inline uint32_t tlm_start(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+// Records the cycles since tlm_start(), which wrap in 17s at 240MHz
+static inline void tlm_timer_stop(tlm_timer_t* timer, uint32_t start)
+{
+    tlm_timer_add(timer, esp_cpu_get_cycle_count() - start);
+}
@@ -0,0 +1,70 @@
+#include <string.h>
+
+#include "esp_rom_sys.h"
+
+#include "telemetry.h"
+
+void tlm_timer_reset(tlm_timer_t* timer)
+{
+    atomic_fetch_add_explicit(&(timer->seq), 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memset(&(timer->stats), 0, sizeof(timer->stats));
+    timer->stats.min_cycles = UINT32_MAX;
+    atomic_fetch_add_explicit(&(timer->seq), 1, memory_order_release);
+}
+
+void tlm_timer_add(tlm_timer_t* timer, uint32_t cycles)
+{
+    tlm_stats_t* s = &(timer->stats);
+    atomic_fetch_add_explicit(&(timer->seq), 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->count++;
+    s->total_cycles += cycles;
+    if (cycles < s->min_cycles) s->min_cycles = cycles;
+    if (cycles > s->max_cycles) s->max_cycles = cycles;
+    s->hist[_tlm_bin(cycles)]++;
+    atomic_fetch_add_explicit(&(timer->seq), 1, memory_order_release);
+}
+
+void tlm_timer_read(tlm_timer_t* timer, tlm_stats_t* ret_stats)
+{
+    unsigned before, after;
+    do {
+        // An update takes a few dozen cycles, spinning through one is cheaper than a lock
+        before = atomic_load_explicit(&(timer->seq), memory_order_acquire);
+        memcpy(ret_stats, &(timer->stats), sizeof(*ret_stats));
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&(timer->seq), memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+// Upper edge of the bin the q quantile falls in, at most the longest duration
+uint32_t tlm_quantile_cycles(const tlm_stats_t* stats, float q)
+{
+    uint64_t seen = 0;
+    for (int b = 0; b < TLM_HIST_BINS - 1; b++) {
+        seen += stats->hist[b];
+        uint32_t end = 1u << (TLM_HIST_SHIFT + b);
+        if (seen && seen >= q * stats->count)
+            return end < stats->max_cycles ? end : stats->max_cycles;
+    }
+    return stats->max_cycles;
+}
+
+uint32_t tlm_cpu_mhz(void)
+{
+    return esp_rom_get_cpu_ticks_per_us();
+}
+
+double tlm_cycles_to_us(uint64_t cycles)
+{
+    return (double)cycles / tlm_cpu_mhz();
+}
+
+int _tlm_bin(uint32_t cycles)
+{
+    uint32_t units = cycles >> TLM_HIST_SHIFT;
+    if (!units) return 0;
+    int bin = 32 - __builtin_clz(units);
+    return bin < TLM_HIST_BINS ? bin : TLM_HIST_BINS - 1;
+}
@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
 #include <sys/socket.h>
-#include <time.h>
 #include <sys/time.h>
 
 // ESP includes
@@ -11,7 +13,8 @@
 #include "esp_event.h"
 #include "nvs_flash.h"
 #include "esp_task_wdt.h"
-#include "esp_sntp.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
 #include "driver/i2c_master.h"
 
 // FreeRTOS includes
@@ -23,6 +26,13 @@
 #include "ads1299_interface.h"
 #include "adg715_interface.h"
 #include "status_interface.h"
+#include "protocol_interface.h"
+#include "spsc_ring_interface.h"
+#include "iir_interface.h"
+#include "classifier_interface.h"
+#include "activity_interface.h"
+#include "electrode_scan_interface.h"
+#include "telemetry_interface.h"
 
 // #define BASE_WIFI_SSID "BT-RSC2QS"
 // #define BASE_WIFI_PASS "tVDHXba7t9GeK4"
@@ -55,16 +65,40 @@ int sock = -1;
 int addr_family = 0;
 int ip_protocol = 0;
 
+/********* CLOCK SYNC ***********/
+
+// The host aligns sample times with its own clock by timing exchanges with the board, see
+// PROTO_TYPE_SYNC_REQUEST. Frames carry esp_timer times, so there is no wall clock to set.
+#define SYNC_PORT 8081
+#define SYNC_TASK_PRIORITY (configMAX_PRIORITIES - 3) // Above the stream task, a request is stamped as it arrives
+#define SYNC_TASK_CORE 0 // With WiFi, away from acquisition
+#define SYNC_TASK_STACK 3072
+static TaskHandle_t sync_task_handle;
+
 /********* ADS1299 INTERFACE PINS *******/
 
 #define ADS1299_SPI_HOST             SPI2_HOST
-#define ADS1299_SPI_CLOCK_SPEED_HZ   (2*1000*1000)
+#define ADS1299_SPI_CLOCK_SPEED_HZ   (8*1000*1000) // 27 byte frame in ~30us, leaves headroom at 16kSPS
 #define ADS1299_MISO_PIN             GPIO_NUM_8
 #define ADS1299_MOSI_PIN             GPIO_NUM_12
 #define ADS1299_SCLK_PIN             GPIO_NUM_9
 #define ADS1299_CS_PIN               GPIO_NUM_10
 #define ADS1299_DRDY_PIN             GPIO_NUM_18
 #define ADS1299_RESET_PIN            GPIO_NUM_11
+#define ADS1299_DAISY_DEVICES        1 // Chain 2 or 4 boards for 16 or 32 channels
+
+#define ADS1299_ACQ_TASK_PRIORITY    (configMAX_PRIORITIES - 2)
+#define ADS1299_ACQ_TASK_CORE        1
+
+#define BASE_DATA_RATE               DR_250SPS // Up to DR_4KSPS sustained over WiFi, see BASE_THROUGHPUT_BENCH
+#define BASE_THROUGHPUT_BENCH        0 // 1 to sweep every data rate once before streaming
+#define BENCH_DURATION_US            (10*1000*1000) // Streaming time per data rate
+#define BASE_JITTER_BENCH            0 // 1 to log the DRDY to read latency with and without a WiFi flood before streaming
+#define JITTER_BENCH_DURATION_US     (20*1000*1000) // Streaming time per phase
+#define JITTER_FLOOD_PORT            9 // Discard port on the host, the flood's datagrams are thrown away
+#define JITTER_FLOOD_BURST           8 // Datagrams between 1 tick sleeps, ~94Mbit/s, more than WiFi takes
+#define BASE_LATENCY_BENCH           0 // 1 to stream at each of latency_bench_ms[] before streaming, for nexus-ingest --latency
+#define LATENCY_BENCH_DURATION_US    (20*1000*1000) // Streaming time per flush latency
 
 /********* MASTER I2C and ADG715 **********/
 
@@ -72,19 +106,211 @@ int ip_protocol = 0;
 #define BOARD_I2C_SDA_PIN GPIO_NUM_21
 #define BOARD_I2C_SCL_PIN GPIO_NUM_47
 #define ADG715_RESET_PIN GPIO_NUM_16
+#define ADG715_I2C_SPEED_HZ (400*1000) // Fast mode, a write to every ADG715 in well under 1ms
 
 const uint8_t adg715_addr[4] = {0x48, 0x49, 0x4A, 0x4B};
 
+/********* ELECTRODE SCAN ***********/
+
+#define BASE_SCAN_ENABLE 1 // 1 to pick the electrode orientation of every channel at boot
+#define BASE_SCAN_SETTLE_MS 200 // Wait after switching, the filter warms up on these samples
+#define BASE_SCAN_CAPTURE_MS 400 // Samples the SNR is estimated from
+#define BASE_SCAN_BAND_HZ 20 // Low edge of the EMG band, drift below it counts as noise
+
+// One orientation per switch, every channel moves together so channels are scored side by side.
+// A nibble of each ADG715 selects one of four orientations of a channel, see scan_channel_map.
+static const uint8_t scan_candidates[][4] = {
+    {0x11, 0x11, 0x11, 0x11},
+    {0x22, 0x22, 0x22, 0x22},
+    {0x44, 0x44, 0x44, 0x44},
+    {0x88, 0x88, 0x88, 0x88},
+};
+#define SCAN_CANDIDATES (sizeof(scan_candidates) / sizeof(scan_candidates[0]))
+
+// ADG715 and switches of each ADS1299 channel: U1 high nibble is CH3, low nibble CH2, and so on
+static const struct {
+    uint8_t mux;
+    uint8_t mask;
+} scan_channel_map[] = {
+    {2, 0x0F}, // CH1, U3
+    {0, 0x0F}, // CH2, U1
+    {0, 0xF0}, // CH3, U1
+    {2, 0xF0}, // CH4, U3
+    {3, 0x0F}, // CH5, U4
+    {1, 0x0F}, // CH6, U2
+    {1, 0xF0}, // CH7, U2
+    {3, 0xF0}, // CH8, U4
+};
+
 /********* STATUS LED CONFIG *********/
 
 #define STATUS_LED_GPIO GPIO_NUM_48
 
 /********* COMM BUFFER ***********/
 
-#define BUFFER_SIZE (256 * 16) // TODO: Optimize this
-#define BUFFER_FLUSH_SIZE (256 * 15)
-static char buffer[BUFFER_SIZE];
-static int buffer_index = 0;
+#define FRAME_BUFFER_SIZE 1472 // Largest UDP payload without IP fragmentation on a 1500 byte MTU
+#define SEND_RETRIES 3 // Attempts with a 1 tick back off while WiFi is out of TX buffers
+#define BASE_RICE_ENABLE 1 // Lossless compression of the samples, frames that do not shrink go out raw
+static uint8_t frame_buffer[FRAME_BUFFER_SIZE];
+static uint8_t rice_buffer[FRAME_BUFFER_SIZE];
+static proto_encoder_t encoder;
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t samples_sent;
+    uint32_t send_retries;     ///< sendto() retried after ENOMEM
+    uint32_t send_errors;      ///< sendto() calls that failed, retries included
+    uint32_t samples_dropped;  ///< Samples in frames dropped after SEND_RETRIES
+    uint32_t raw_bytes;        ///< Size of the sent frames without compression
+    uint32_t sent_bytes;       ///< Size as sent
+    uint32_t nacks;            ///< NACKs from the host
+    uint32_t retransmits;      ///< Frames resent for them
+    uint32_t replay_misses;    ///< Frames asked for that had left the replay window
+} stream_stats_t;
+static stream_stats_t stream_stats;
+
+/********* FLUSH POLICY ***********/
+
+// A frame goes out when it holds FLUSH_MAX_LATENCY_MS of samples, when it would outgrow a datagram of
+// FLUSH_MTU, or when its first sample has waited FLUSH_MAX_LATENCY_MS since its DRDY edge, whichever
+// comes first. Live decoding wants a few tens of ms, bulk recording full datagrams: at 250SPS 8 channels
+// fill one in about 240ms, at 4kSPS in 15ms.
+#define FLUSH_MAX_LATENCY_MS 100 // 25 samples at 250SPS
+#define FLUSH_MTU 1500 // Of the path to the host, frames are never fragmented
+#define FLUSH_MAX_DATAGRAM (FLUSH_MTU - 28) // Minus the IPv4 and UDP headers
+_Static_assert(FLUSH_MAX_DATAGRAM <= FRAME_BUFFER_SIZE, "Frames are encoded in frame_buffer");
+
+// Adaptive batching starts at FLUSH_MIN_LATENCY_MS frames and doubles them while sendto() takes more than
+// FLUSH_SEND_SHARE percent of the time the frames cover, halving them again once it takes less than a
+// quarter of that. Per datagram costs then buy latency only while the network keeps up.
+#define BASE_FLUSH_ADAPTIVE 0 // 1 to size frames by the observed send time, 0 for the largest the limits allow
+#define FLUSH_MIN_LATENCY_MS 10
+#define FLUSH_SEND_SHARE 25
+#define FLUSH_ADAPT_FRAMES 16 // Full frames between adjustments
+
+static uint32_t flush_latency_ms = FLUSH_MAX_LATENCY_MS;
+static int64_t flush_latency_us;
+static uint32_t sample_period_us;
+static uint16_t frame_samples; // Samples a frame is sent at, between the two below
+static uint16_t flush_min_samples, flush_max_samples;
+static tlm_timer_t flush_age_timer; // First sample's DRDY edge to the frame sent, in us times the CPU MHz
+#if BASE_FLUSH_ADAPTIVE
+static uint32_t adapt_frames;
+static uint64_t adapt_send_us, adapt_frame_us;
+#endif
+
+/********* REPLAY WINDOW ***********/
+
+// The latest frames on the data socket, kept to resend when the host NACKs them (PROTO_TYPE_NACK).
+// A frame lost on the air then costs a round trip instead of its samples, and unlike TCP nothing
+// after it waits for the resend.
+#define BASE_REPLAY_ENABLE 1 // 0 to send every frame once
+#define REPLAY_FRAMES 32 // 3.2s of frames at 250SPS, about 0.5s at 4kSPS
+#define REPLAY_POLL_MS 10 // How often a drained stream looks for NACKs
+#if BASE_REPLAY_ENABLE
+static uint8_t replay_buffer[REPLAY_FRAMES * (FRAME_BUFFER_SIZE + 2)];
+static proto_replay_t replay;
+#endif
+
+/********* FILTERS ***********/
+
+#define BASE_FILTER_ENABLE 1 // Causal version of the offline filtering in code/ml/signal_processing.py
+#define BASE_FILTER_ORDER 4
+#define BASE_FILTER_HIGHPASS_HZ 0.5
+#define BASE_FILTER_STOP_LO_HZ 48 // 50Hz power line band-stop
+#define BASE_FILTER_STOP_HI_HZ 52
+static iir_handle_t* filter;
+
+/********* CLASSIFIER ***********/
+
+#define BASE_CLASSIFIER_ENABLE 0 // 1 to classify on the board, needs classifier_model.h from code/ml/export_classifier.py
+#define BASE_CLASSIFIER_ONLY 0 // 1 to send decision frames only, no samples
+#define BASE_CLASSIFIER_RATE 250 // Sample rate the models were trained at
+#define BASE_CLASSIFIER_WINDOW 100 // 400ms F2 windows every 100ms, as in code/ml/hmm.ipynb
+#define BASE_CLASSIFIER_STRIDE 25
+#define BASE_CLASSIFIER_FRAMES 37 // Windows per utterance, 4s of samples
+#if BASE_CLASSIFIER_ENABLE
+#include "classifier_model.h"
+#endif
+static clf_handle_t* classifier;
+static clf_f2_t* f2;
+static uint8_t decision_buffer[PROTO_DECISION_SIZE(ADS1299_MAX_CHANNELS, PROTO_MAX_CLASSES)];
+
+/********* ACTIVITY GATING ***********/
+
+#define BASE_ACTIVITY_ENABLE 0 // 1 to only stream segments with speech activity, needs BASE_FILTER_ENABLE
+#define BASE_ACTIVITY_CHANNELS 4 // Leading channels the energy is summed over, as speak_detect in signal_processing.py
+#define BASE_ACTIVITY_WINDOW_MS 50 // Time constant of the RMS
+#define BASE_ACTIVITY_ON_RATIO 2.5 // Energy over the noise floor to start a segment, tuned with host/nexus-gate
+#define BASE_ACTIVITY_OFF_RATIO 2.0 // And to keep it going
+#define BASE_ACTIVITY_MIN_ON_MS 40
+#define BASE_ACTIVITY_PRE_ROLL_MS 500
+#define BASE_ACTIVITY_POST_ROLL_MS 500
+#define BASE_ACTIVITY_MAX_SEGMENT_MS 5000
+#define BASE_ACTIVITY_FLOOR_RISE_MS 2000 // How quickly the noise floor follows the electrodes settling
+#define BASE_ACTIVITY_FLOOR_FALL_MS 1000
+#define SUMMARY_PERIOD_MS 1000 // Keep-alive summary of the gated stream
+static act_handle_t* activity;
+static spsc_ring_handle_t* pre_roll; // Written and read by the stream task only
+static uint32_t summary_samples;
+static uint8_t summary_buffer[PROTO_SUMMARY_SIZE(ADS1299_MAX_CHANNELS)];
+
+/********* TELEMETRY ***********/
+
+// Counters and cycle count timers of the hot path, sent as PROTO_TYPE_TELEMETRY frames on the data socket.
+// A timer costs two cycle counter reads and a few stores, leave them on.
+#define BASE_TELEMETRY_ENABLE 1 // 0 to only log the counters when the connection drops
+#define TELEMETRY_PERIOD_MS 5000
+static tlm_timer_t callback_timer; // Written by the acquisition task
+static tlm_timer_t dsp_timer; // Written by the DSP task
+static tlm_timer_t process_timer, encode_timer, send_timer; // Written by the stream task
+static int64_t telemetry_due_us;
+static uint8_t telemetry_buffer[PROTO_TELEMETRY_SIZE(ADS1299_MAX_CHANNELS)];
+_Static_assert(TLM_HIST_BINS == PROTO_TLM_HIST_BINS && TLM_HIST_SHIFT == PROTO_TLM_HIST_SHIFT,
+               "Telemetry histograms must match the protocol's");
+
+/********* SAMPLE RING ***********/
+
+#define SAMPLE_RING_LEN 512 // Samples buffered between the acquisition task and the network, power of two, 128ms at 4kSPS
+#define DSP_RING_LEN 512 // Filtered samples between the DSP task and the network
+static spsc_ring_handle_t* sample_ring;
+static spsc_ring_handle_t* stream_ring; // The ring the network drains, the DSP task's own with BASE_DSP_TASK
+static TaskHandle_t stream_task; // Woken once stream_ring holds a frame
+
+/********* TASKS ***********/
+
+// Acquisition has core 1 and the DRDY interrupt to itself at the highest priority, see ADS1299_ACQ_TASK_*.
+// Everything else shares core 0 with WiFi and lwIP: the DSP task filters samples from sample_ring into
+// stream_ring, the network task frames and sends them, and the supervisor runs the state machine and starts
+// and stops the other two per connection. The rings are bounded, when one fills the samples are counted
+// as overflows rather than holding up the task before it.
+#define BASE_DSP_TASK 1 // 0 to filter in the acquisition task, one ring and one task fewer
+#define DSP_TASK_PRIORITY 6 // Above the network task, so a slow send never backs up sample_ring
+#define DSP_TASK_CORE 0
+#define DSP_TASK_STACK 4096
+#define DSP_TASK_POLL_MS 100 // Longest wait for samples, and so to stop
+#define NET_TASK_PRIORITY 5 // Below lwIP and WiFi, which it feeds
+#define NET_TASK_CORE 0
+#define NET_TASK_STACK 6144
+#define SUPERVISOR_TASK_PRIORITY 2
+#define SUPERVISOR_TASK_CORE 0
+#define SUPERVISOR_TASK_STACK 6144
+#if BASE_DSP_TASK
+static TaskHandle_t dsp_task_handle; // NULL when not running
+static volatile bool dsp_running;
+#endif
+
+// What the supervisor hands to the tasks it starts
+typedef struct {
+    status_handle_t *status;
+    ads1299_handle_t *ads1299;
+    adg715_group_t *electrodes;
+    ads1299_acq_config_t acq_config;
+    struct sockaddr_in dest_addr;
+    TaskHandle_t supervisor_task;
+    TaskHandle_t net_task; // NULL when not streaming
+} base_context_t;
+static base_context_t base_ctx;
 
 // System state machine
 enum base_state_t
@@ -96,11 +322,1020 @@ enum base_state_t
 };
 static enum base_state_t base_state = WIFI_CONNECTING;
 
-void time_sync_notification_cb(struct timeval *tv)
+// Answers clock exchanges from the host for as long as the board runs. t2 is taken as soon as the
+// request is in and t3 just before the reply goes out, the time in between is not part of the round trip.
+static void sync_task(void *arg)
+{
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SYNC_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (s < 0 || bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "[SYNC] Unable to listen on port %d: errno %d, no clock sync", SYNC_PORT, errno);
+        if (s >= 0)
+            close(s);
+        sync_task_handle = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "[SYNC] Answering clock exchanges on port %d", SYNC_PORT);
+
+    uint8_t buf[PROTO_SYNC_SIZE];
+    while (1) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(s, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        int64_t t2 = esp_timer_get_time();
+        proto_sync_t sync;
+        if (len < 0 || proto_decode_sync(buf, len, &sync) != PROTO_OK || sync.type != PROTO_TYPE_SYNC_REQUEST)
+            continue;
+
+        sync.type = PROTO_TYPE_SYNC_REPLY;
+        sync.device_id = encoder.header.device_id;
+        sync.t2_us = t2;
+        sync.t3_us = esp_timer_get_time();
+        len = proto_encode_sync(buf, sizeof(buf), &sync);
+        sendto(s, buf, len, 0, (struct sockaddr *)&from, from_len);
+    }
+}
+
+static void filter_sample(ads1299_sample_t *sample, uint8_t n_channels)
+{
+    iir_float_t x[ADS1299_MAX_CHANNELS];
+    for (int i = 0; i < n_channels; i++)
+        x[i] = sample->data[i];
+    iir_process(filter, x, x, 1);
+
+    // Back to 24 bit codes for the frame
+    for (int i = 0; i < n_channels; i++) {
+        int32_t v = lrintf(x[i]);
+        sample->data[i] = v > 0x7FFFFF ? 0x7FFFFF : (v < -0x800000 ? -0x800000 : v);
+    }
+}
+
+static void on_sample(const ads1299_sample_t *sample, void *ctx)
+{
+    // Runs in the acquisition task on the other core from WiFi, never block on the network.
+    // Wake the next task once per frame rather than per sample, at high data rates a cross core notify
+    // per sample is most of the CPU.
+    uint32_t start = tlm_start();
+#if BASE_DSP_TASK
+    if (spsc_ring_push(sample_ring, sample) && spsc_ring_count(sample_ring) >= frame_samples)
+        xTaskNotifyGive(dsp_task_handle);
+#else
+    ads1299_sample_t s = *sample;
+    if (filter)
+        filter_sample(&s, filter->config.n_channels);
+
+    if (spsc_ring_push(sample_ring, &s) && spsc_ring_count(sample_ring) >= frame_samples)
+        xTaskNotifyGive(stream_task);
+#endif
+    tlm_timer_stop(&callback_timer, start);
+}
+
+#if BASE_DSP_TASK
+// Filters whatever the acquisition task queued, for as long as the pipeline runs
+static void dsp_task(void *arg)
+{
+    while (dsp_running) {
+        ads1299_sample_t sample;
+        if (!spsc_ring_pop(sample_ring, &sample)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DSP_TASK_POLL_MS));
+            continue;
+        }
+        uint32_t start = tlm_start();
+        if (filter)
+            filter_sample(&sample, filter->config.n_channels);
+        if (spsc_ring_push(stream_ring, &sample) && spsc_ring_count(stream_ring) >= frame_samples)
+            xTaskNotifyGive(stream_task);
+        tlm_timer_stop(&dsp_timer, start);
+    }
+    dsp_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+#endif
+
+// Starts acquisition and, with BASE_DSP_TASK, filtering. consumer is woken once stream_ring holds a frame.
+static void pipeline_start(ads1299_handle_t *handle, const ads1299_acq_config_t *acq_config, TaskHandle_t consumer)
+{
+    stream_task = consumer;
+#if BASE_DSP_TASK
+    dsp_running = true;
+    if (xTaskCreatePinnedToCore(dsp_task, "dsp", DSP_TASK_STACK, NULL, DSP_TASK_PRIORITY,
+                                &dsp_task_handle, DSP_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create DSP task");
+        abort();
+    }
+#endif
+    ESP_ERROR_CHECK(ads1299_acq_start(handle, acq_config));
+}
+
+static void pipeline_stop(ads1299_handle_t *handle)
+{
+    ads1299_acq_stop(handle);
+#if BASE_DSP_TASK
+    // Not woken, it may be gone by the time a notification arrives
+    dsp_running = false;
+    while (dsp_task_handle)
+        vTaskDelay(1);
+#endif
+}
+
+static void log_timer(const char *name, const tlm_stats_t *stats)
+{
+    if (stats->count)
+        ESP_LOGI(TAG, "%s us min/mean/max: %.1f/%.1f/%.1f", name, tlm_cycles_to_us(stats->min_cycles),
+            tlm_cycles_to_us(stats->total_cycles) / stats->count, tlm_cycles_to_us(stats->max_cycles));
+}
+
+static void log_acq_stats(ads1299_handle_t *handle)
+{
+    ads1299_acq_stats_t stats;
+    spsc_ring_stats_t ring_stats;
+    ads1299_acq_get_stats(handle, &stats);
+    spsc_ring_get_stats(sample_ring, &ring_stats);
+    ESP_LOGI(TAG, "DRDY: %lu, samples: %lu, missed: %lu, ring overflows: %lu, ring high water: %lu/%lu",
+        stats.drdy_count, stats.sample_count, stats.missed_drdy,
+        ring_stats.overflows, ring_stats.high_water, ring_stats.capacity);
+    if (stream_ring != sample_ring) {
+        spsc_ring_get_stats(stream_ring, &ring_stats);
+        ESP_LOGI(TAG, "DSP ring overflows: %lu, high water: %lu/%lu",
+            ring_stats.overflows, ring_stats.high_water, ring_stats.capacity);
+    }
+    tlm_stats_t timer_stats;
+    ads1299_acq_get_latency(handle, &timer_stats);
+    if (stats.sample_count)
+        ESP_LOGI(TAG, "DRDY to sample us min/mean/p99/max: %lld/%lld/%.0f/%lld, DRDY period us min/max: %lld/%lld",
+            stats.latency_min_us, stats.latency_total_us / stats.sample_count,
+            tlm_cycles_to_us(tlm_quantile_cycles(&timer_stats, 0.99f)), stats.latency_max_us,
+            stats.period_min_us, stats.period_max_us);
+
+    ads1299_get_read_stats(handle, &timer_stats);
+    log_timer("SPI read", &timer_stats);
+    tlm_timer_read(&callback_timer, &timer_stats);
+    log_timer("Sample callback", &timer_stats);
+    tlm_timer_read(&dsp_timer, &timer_stats);
+    log_timer("DSP", &timer_stats);
+    tlm_timer_read(&process_timer, &timer_stats);
+    log_timer("Sample processing", &timer_stats);
+    tlm_timer_read(&encode_timer, &timer_stats);
+    log_timer("Frame encode", &timer_stats);
+    tlm_timer_read(&send_timer, &timer_stats);
+    log_timer("Frame send", &timer_stats);
+    tlm_timer_read(&flush_age_timer, &timer_stats);
+    if (timer_stats.count)
+        ESP_LOGI(TAG, "Frame age at send ms p50/p99/max: %.1f/%.1f/%.1f, %u samples per frame (%u to %u)",
+            tlm_cycles_to_us(tlm_quantile_cycles(&timer_stats, 0.5f)) / 1000,
+            tlm_cycles_to_us(tlm_quantile_cycles(&timer_stats, 0.99f)) / 1000,
+            tlm_cycles_to_us(timer_stats.max_cycles) / 1000, frame_samples, flush_min_samples, flush_max_samples);
+
+    ESP_LOGI(TAG, "Frames sent: %lu, samples sent: %lu, send retries: %lu, send errors: %lu, samples dropped: %lu",
+        stream_stats.frames_sent, stream_stats.samples_sent, stream_stats.send_retries,
+        stream_stats.send_errors, stream_stats.samples_dropped);
+    if (stream_stats.nacks)
+        ESP_LOGI(TAG, "NACKs: %lu, frames resent: %lu, asked for after they left the replay window: %lu",
+            stream_stats.nacks, stream_stats.retransmits, stream_stats.replay_misses);
+    if (stream_stats.sent_bytes)
+        ESP_LOGI(TAG, "Compression ratio: %.2f", (double)stream_stats.raw_bytes / stream_stats.sent_bytes);
+}
+
+static void stream_configure(ads1299_handle_t *handle)
+{
+    // Follow the ADS1299 data rate, must only be called while acquisition is stopped
+    ads1299_data_rate_t dr = BASE_DATA_RATE;
+    uint32_t sps = 0;
+    ads1299_get_datarate(handle, &dr);
+    ads1299_get_sample_rate(handle, &sps);
+    proto_encoder_set_data_rate(&encoder, dr);
+
+    // Raw frames bound the size, Rice coded ones only ever go out smaller
+    uint16_t cap = proto_frame_capacity(FLUSH_MAX_DATAGRAM, encoder.header.n_channels);
+    uint32_t n = sps * flush_latency_ms / 1000;
+    flush_max_samples = n < 1 ? 1 : (n > cap ? cap : n);
+    flush_min_samples = flush_max_samples;
+#if BASE_FLUSH_ADAPTIVE
+    n = sps * FLUSH_MIN_LATENCY_MS / 1000;
+    flush_min_samples = n < 1 ? 1 : (n > flush_max_samples ? flush_max_samples : n);
+    adapt_frames = 0;
+    adapt_send_us = adapt_frame_us = 0;
+#endif
+    frame_samples = flush_min_samples;
+    flush_latency_us = flush_latency_ms * 1000;
+    sample_period_us = 1000000 / sps;
+    ESP_LOGI(TAG, "Streaming %lu SPS, %u to %u samples per frame, at most %lu ms old", sps, flush_min_samples,
+        flush_max_samples, flush_latency_ms);
+
+#if BASE_FILTER_ENABLE
+    // Cutoffs are in Hz, redesign for the new rate
+    if (filter) {
+        iir_deinit(filter);
+        filter = NULL;
+    }
+    iir_config_t filter_config = { .n_channels = encoder.header.n_channels };
+    if (iir_butter(&filter_config, BASE_FILTER_ORDER, IIR_HIGHPASS, BASE_FILTER_HIGHPASS_HZ, 0, sps) != IIR_OK ||
+        iir_butter(&filter_config, BASE_FILTER_ORDER, IIR_BANDSTOP, BASE_FILTER_STOP_LO_HZ, BASE_FILTER_STOP_HI_HZ, sps) != IIR_OK ||
+        iir_init(&filter_config, &filter) != IIR_OK) {
+        ESP_LOGE(TAG, "Failed to set up filters at %lu SPS, streaming raw samples", sps);
+        filter = NULL;
+    }
+#endif
+    proto_encoder_set_flags(&encoder, filter ? PROTO_FLAG_FILTERED : 0);
+
+#if BASE_ACTIVITY_ENABLE
+    // Durations are in samples, rebuild for the new rate
+    if (activity) {
+        act_deinit(activity);
+        activity = NULL;
+    }
+    if (pre_roll) {
+        spsc_ring_deinit(pre_roll);
+        pre_roll = NULL;
+    }
+    act_config_t act_config = {
+        .n_channels = encoder.header.n_channels,
+        .n_detect = BASE_ACTIVITY_CHANNELS < encoder.header.n_channels ? BASE_ACTIVITY_CHANNELS : encoder.header.n_channels,
+        .window = sps * BASE_ACTIVITY_WINDOW_MS / 1000,
+        .on_ratio = BASE_ACTIVITY_ON_RATIO,
+        .off_ratio = BASE_ACTIVITY_OFF_RATIO,
+        .min_on = sps * BASE_ACTIVITY_MIN_ON_MS / 1000,
+        .pre_roll = sps * BASE_ACTIVITY_PRE_ROLL_MS / 1000,
+        .post_roll = sps * BASE_ACTIVITY_POST_ROLL_MS / 1000,
+        .max_segment = sps * BASE_ACTIVITY_MAX_SEGMENT_MS / 1000,
+        .floor_rise_tc = sps * BASE_ACTIVITY_FLOOR_RISE_MS / 1000,
+        .floor_fall_tc = sps * BASE_ACTIVITY_FLOOR_FALL_MS / 1000,
+    };
+    // Holds the backlog of a segment start, the pre-roll plus the samples that crossed the threshold
+    uint32_t backlog = act_config.pre_roll + act_config.min_on, capacity = 1;
+    while (capacity < backlog)
+        capacity <<= 1;
+    spsc_ring_config_t pre_roll_config = { .elem_size = sizeof(ads1299_sample_t), .capacity = capacity };
+    if (act_init(&act_config, &activity) != ACT_OK || spsc_ring_init(&pre_roll_config, &pre_roll) != SPSC_RING_OK) {
+        ESP_LOGE(TAG, "Failed to set up activity gating at %lu SPS, streaming every sample", sps);
+        if (activity)
+            act_deinit(activity);
+        activity = NULL;
+        pre_roll = NULL;
+    }
+    summary_samples = sps * SUMMARY_PERIOD_MS / 1000;
+#endif
+
+#if BASE_CLASSIFIER_ENABLE
+    if (f2) {
+        clf_f2_deinit(f2);
+        f2 = NULL;
+    }
+    if (!classifier && clf_init(classifier_model, sizeof(classifier_model), &classifier) != CLF_OK) {
+        ESP_LOGE(TAG, "Bad classifier model, not classifying");
+        return;
+    }
+    // Features are in Hz and samples, the models only hold at the rate they were trained at
+    clf_f2_config_t f2_config = {
+        .n_channels = encoder.header.n_channels,
+        .window = BASE_CLASSIFIER_WINDOW,
+        .stride = BASE_CLASSIFIER_STRIDE,
+        .sample_rate = sps,
+        .now_us = esp_timer_get_time,
+    };
+    if (sps != BASE_CLASSIFIER_RATE || CLF_F2_SIZE(f2_config.n_channels) != classifier->n_features ||
+        clf_f2_init(&f2_config, &f2) != CLF_OK) {
+        ESP_LOGW(TAG, "Classifier needs %u features at %d SPS, not classifying", classifier->n_features, BASE_CLASSIFIER_RATE);
+        f2 = NULL;
+        return;
+    }
+    ESP_LOGI(TAG, "Classifying %u words every %d windows", classifier->n_classes, BASE_CLASSIFIER_FRAMES);
+#endif
+}
+
+// Every frame on the data socket goes through here before it is sent, the host may ask for it again
+static void keep_frame(const uint8_t *buf, size_t len)
+{
+#if BASE_REPLAY_ENABLE
+    proto_replay_store(&replay, buf, len);
+#endif
+}
+
+// Resends what the host's NACKs ask for, as far as it is still in the replay window. Never waits.
+static int answer_nacks(const struct sockaddr_in *dest_addr)
+{
+#if BASE_REPLAY_ENABLE
+    uint8_t buf[PROTO_NACK_SIZE(PROTO_NACK_MAX_RANGES)];
+    int len;
+    while ((len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        proto_nack_t nack;
+        if (proto_decode_nack(buf, len, &nack) != PROTO_OK || nack.device_id != encoder.header.device_id)
+            continue;
+        stream_stats.nacks++;
+        if (encoder.header.seq == 0)
+            continue; // Nothing sent yet
+        uint32_t latest = encoder.header.seq - 1;
+        for (int r = 0; r < nack.n_ranges; r++) {
+            if (nack.ranges[r].count == 0)
+                continue;
+            // Ages back from the latest frame sent, clamped to the window. Frames not sent yet are
+            // ignored and ones that left the window are a miss each, however many the host asks for.
+            int64_t oldest = (int32_t)(latest - nack.ranges[r].first_seq);
+            int64_t newest = oldest - (nack.ranges[r].count - 1);
+            if (oldest < 0)
+                continue;
+            if (newest < 0)
+                newest = 0;
+            if (oldest > latest)
+                oldest = latest;
+            if (oldest >= REPLAY_FRAMES) {
+                stream_stats.replay_misses += oldest - (newest > REPLAY_FRAMES ? newest : REPLAY_FRAMES) + 1;
+                oldest = REPLAY_FRAMES - 1;
+            }
+            for (int64_t age = oldest; age >= newest; age--) {
+                const uint8_t *frame;
+                size_t frame_len = proto_replay_get(&replay, latest - (uint32_t)age, &frame);
+                if (!frame_len) {
+                    stream_stats.replay_misses++;
+                    continue;
+                }
+                if (sendto(sock, frame, frame_len, 0, (struct sockaddr *)dest_addr, sizeof(*dest_addr)) < 0) {
+                    stream_stats.send_errors++;
+                    // Out of TX buffers the host asks again
+                    if (errno != ENOMEM)
+                        return -1;
+                    continue;
+                }
+                stream_stats.retransmits++;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+// Grows or shrinks frame_samples by the share of a frame's time its sendto() took
+static void flush_adapt(uint16_t n_samples, uint32_t send_cycles)
+{
+#if BASE_FLUSH_ADAPTIVE
+    // Only full frames say what a size costs, early flushes are short by chance
+    if (n_samples != frame_samples)
+        return;
+    adapt_send_us += (uint64_t)tlm_cycles_to_us(send_cycles);
+    adapt_frame_us += (uint64_t)n_samples * sample_period_us;
+    if (++adapt_frames < FLUSH_ADAPT_FRAMES)
+        return;
+
+    uint32_t share = adapt_send_us * 100 / adapt_frame_us;
+    uint16_t n = frame_samples;
+    if (share > FLUSH_SEND_SHARE)
+        n = n * 2 > flush_max_samples ? flush_max_samples : n * 2;
+    else if (share * 4 < FLUSH_SEND_SHARE)
+        n = n / 2 < flush_min_samples ? flush_min_samples : n / 2;
+    if (n != frame_samples)
+        ESP_LOGD(TAG, "sendto() takes %lu%% of the frame time, %u samples per frame", share, n);
+    frame_samples = n;
+    adapt_frames = 0;
+    adapt_send_us = adapt_frame_us = 0;
+#endif
+}
+
+static int send_frame(const struct sockaddr_in *dest_addr)
+{
+    uint16_t n_samples = encoder.header.n_samples;
+    int64_t first_us = encoder.header.timestamp_us;
+    uint32_t start = tlm_start();
+    size_t len = proto_encoder_finish(&encoder);
+    tlm_timer_stop(&encode_timer, start);
+    keep_frame(frame_buffer, len);
+
+    start = tlm_start();
+    for (int attempt = 0; ; attempt++) {
+        if (sendto(sock, frame_buffer, len, 0, (struct sockaddr *)dest_addr, sizeof(*dest_addr)) >= 0) {
+            uint32_t send_cycles = tlm_start() - start;
+            tlm_timer_add(&send_timer, send_cycles);
+            tlm_timer_add(&flush_age_timer, (uint32_t)(esp_timer_get_time() - first_us) * tlm_cpu_mhz());
+            flush_adapt(n_samples, send_cycles);
+            stream_stats.frames_sent++;
+            stream_stats.samples_sent += n_samples;
+            stream_stats.raw_bytes += proto_frame_size(encoder.header.n_channels, n_samples);
+            stream_stats.sent_bytes += len;
+            return 0;
+        }
+        stream_stats.send_errors++;
+        // Out of WiFi TX buffers is transient, back off instead of dropping the connection
+        if (errno != ENOMEM || attempt >= SEND_RETRIES)
+            break;
+        stream_stats.send_retries++;
+        vTaskDelay(1);
+    }
+    tlm_timer_stop(&send_timer, start);
+    if (errno != ENOMEM)
+        return -1;
+    stream_stats.samples_dropped += n_samples;
+    return 0;
+}
+
+static int send_decision(const struct sockaddr_in *dest_addr, const ads1299_sample_t *sample)
+{
+    clf_result_t result;
+    clf_get_result(classifier, &result);
+    proto_decision_t decision = {
+        .best = result.best,
+        .n_classes = classifier->n_classes,
+        .n_frames = result.n_frames,
+    };
+    memcpy(decision.log_likelihood, result.log_likelihood, classifier->n_classes * sizeof(float));
+    ESP_LOGI(TAG, "Decision: %s, margin %.1f", classifier->hmm[result.best].name, result.margin);
+
+    size_t len = proto_encode_decision(&encoder, decision_buffer, sizeof(decision_buffer), sample->counter,
+                                       sample->timestamp_us, &decision);
+    keep_frame(decision_buffer, len);
+    if (sendto(sock, decision_buffer, len, 0, (struct sockaddr *)dest_addr, sizeof(*dest_addr)) < 0) {
+        stream_stats.send_errors++;
+        if (errno != ENOMEM)
+            return -1;
+    }
+    return 0;
+}
+
+// Runs the F2 features and HMMs a window at a time, so a decision is out one window after the utterance ends
+static int classify_sample(const ads1299_sample_t *sample, const struct sockaddr_in *dest_addr)
+{
+    // The models are trained on microvolts
+    const uint8_t n_channels = encoder.header.n_channels;
+    float x[ADS1299_MAX_CHANNELS], features[CLF_F2_SIZE(ADS1299_MAX_CHANNELS)];
+    for (int i = 0; i < n_channels; i++)
+        x[i] = proto_to_volts(sample->data[i], encoder.header.gain[i]) * 1e6;
+
+    if (!clf_f2_push(f2, x, features))
+        return 0;
+    clf_push(classifier, features);
+    if (classifier->n_frames < BASE_CLASSIFIER_FRAMES)
+        return 0;
+
+    // Fixed length utterances for now, back to back
+    int err = send_decision(dest_addr, sample);
+    clf_reset(classifier);
+    clf_f2_reset(f2);
+    return err;
+}
+
+static int frame_sample(const ads1299_sample_t *sample, const struct sockaddr_in *dest_addr)
+{
+    // Frames hold consecutive samples only, send early after a gap
+    if (encoder.header.n_samples &&
+        sample->counter != encoder.header.sample_counter + encoder.header.n_samples) {
+        if (send_frame(dest_addr) < 0)
+            return -1;
+    }
+    if (encoder.header.n_samples == 0)
+        proto_encoder_begin(&encoder, sample->counter, sample->timestamp_us);
+
+    proto_encoder_add(&encoder, sample->status[0], sample->data);
+
+    // Full, or the first sample would be past the deadline by the next one. Samples that queued up
+    // behind a stall go out in full frames rather than one by one.
+    if (encoder.header.n_samples >= frame_samples ||
+        sample->timestamp_us + sample_period_us - encoder.header.timestamp_us > flush_latency_us) {
+        // Flush to network
+        if (send_frame(dest_addr) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int send_summary(const struct sockaddr_in *dest_addr, const ads1299_sample_t *sample)
+{
+    act_summary_t s;
+    act_get_summary(activity, &s);
+    act_reset_summary(activity);
+
+    proto_summary_t summary = {
+        .n_samples = s.n_samples,
+        .active_samples = s.active_samples,
+        .segments = s.segments,
+        .floor = activity->floor,
+        .peak = s.peak,
+    };
+    for (int i = 0; i < encoder.header.n_channels; i++)
+        summary.rms[i] = s.n_samples ? sqrtf(s.sum_sq[i] / s.n_samples) : 0;
+
+    size_t len = proto_encode_summary(&encoder, summary_buffer, sizeof(summary_buffer), sample->counter,
+                                      sample->timestamp_us, &summary);
+    keep_frame(summary_buffer, len);
+    if (sendto(sock, summary_buffer, len, 0, (struct sockaddr *)dest_addr, sizeof(*dest_addr)) < 0) {
+        stream_stats.send_errors++;
+        if (errno != ENOMEM)
+            return -1;
+    }
+    return 0;
+}
+
+// Only samples in activity segments reach the network, the rest wait in the pre-roll until they are too old
+static int gate_sample(const ads1299_sample_t *sample, const struct sockaddr_in *dest_addr)
+{
+    float x[ADS1299_MAX_CHANNELS];
+    for (int i = 0; i < encoder.header.n_channels; i++)
+        x[i] = sample->data[i];
+
+    ads1299_sample_t s;
+    act_event_t event = act_push(activity, x);
+    if (event == ACT_EVENT_START) {
+        // Send the part of the pre-roll the detector counts into the segment
+        uint32_t count = spsc_ring_count(pre_roll), backlog = act_backlog(activity);
+        for (; count > backlog; count--)
+            spsc_ring_pop(pre_roll, &s);
+        while (spsc_ring_pop(pre_roll, &s))
+            if (frame_sample(&s, dest_addr) < 0)
+                return -1;
+    }
+
+    if (activity->state == ACT_ACTIVE || event == ACT_EVENT_END) {
+        if (frame_sample(sample, dest_addr) < 0)
+            return -1;
+        // The partial frame closes the segment
+        if (event == ACT_EVENT_END && encoder.header.n_samples && send_frame(dest_addr) < 0)
+            return -1;
+    } else {
+        if (spsc_ring_count(pre_roll) == pre_roll->config.capacity)
+            spsc_ring_pop(pre_roll, &s);
+        spsc_ring_push(pre_roll, sample);
+    }
+
+    if (activity->summary.n_samples >= summary_samples)
+        return send_summary(dest_addr, sample);
+    return 0;
+}
+
+static void copy_timer_stats(const tlm_stats_t *stats, proto_tlm_stats_t *ret_stats)
+{
+    *ret_stats = (proto_tlm_stats_t) {
+        .count = stats->count,
+        .min_cycles = stats->count ? stats->min_cycles : 0,
+        .max_cycles = stats->max_cycles,
+        .total_cycles = stats->total_cycles,
+    };
+    memcpy(ret_stats->hist, stats->hist, sizeof(ret_stats->hist));
+}
+
+// Everything log_acq_stats() prints and more, for the host to watch while streaming
+static int send_telemetry(ads1299_handle_t *handle, const struct sockaddr_in *dest_addr, uint32_t sample_counter,
+                          int64_t timestamp_us)
+{
+    ads1299_acq_stats_t acq_stats;
+    spsc_ring_stats_t ring_stats, acq_ring_stats = {0};
+    wifi_ap_record_t ap;
+    ads1299_acq_get_stats(handle, &acq_stats);
+    // Occupancy of the ring the network drains, overflows of both
+    spsc_ring_get_stats(stream_ring, &ring_stats);
+    if (stream_ring != sample_ring)
+        spsc_ring_get_stats(sample_ring, &acq_ring_stats);
+
+    proto_telemetry_t t = {
+        .drdy_count = acq_stats.drdy_count,
+        .sample_count = acq_stats.sample_count,
+        .missed_drdy = acq_stats.missed_drdy,
+        .ring_overflows = ring_stats.overflows + acq_ring_stats.overflows,
+        .ring_count = ring_stats.count,
+        .ring_high_water = ring_stats.high_water,
+        .ring_capacity = ring_stats.capacity,
+        .rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0,
+        .cpu_mhz = tlm_cpu_mhz(),
+        .frames_sent = stream_stats.frames_sent,
+        .samples_sent = stream_stats.samples_sent,
+        .send_retries = stream_stats.send_retries,
+        .send_errors = stream_stats.send_errors,
+        .samples_dropped = stream_stats.samples_dropped,
+        .sent_bytes = stream_stats.sent_bytes,
+        .latency_max_us = acq_stats.sample_count ? acq_stats.latency_max_us : 0,
+        .heap_min_free = esp_get_minimum_free_heap_size(),
+        .retransmits = stream_stats.retransmits,
+        .replay_misses = stream_stats.replay_misses,
+    };
+    tlm_stats_t stats;
+    ads1299_get_read_stats(handle, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_READ]);
+    tlm_timer_read(&callback_timer, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_CALLBACK]);
+    tlm_timer_read(&process_timer, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_PROCESS]);
+    tlm_timer_read(&encode_timer, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_ENCODE]);
+    tlm_timer_read(&send_timer, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_SEND]);
+    tlm_timer_read(&dsp_timer, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_DSP]);
+    ads1299_acq_get_latency(handle, &stats);
+    copy_timer_stats(&stats, &t.timers[PROTO_TLM_LATENCY]);
+
+    size_t len = proto_encode_telemetry(&encoder, telemetry_buffer, sizeof(telemetry_buffer), sample_counter,
+                                        timestamp_us, &t);
+    keep_frame(telemetry_buffer, len);
+    if (sendto(sock, telemetry_buffer, len, 0, (struct sockaddr *)dest_addr, sizeof(*dest_addr)) < 0) {
+        stream_stats.send_errors++;
+        if (errno != ENOMEM)
+            return -1;
+    }
+    return 0;
+}
+
+// Forward samples from the ring to the network for duration_us, or until the connection fails when 0
+static int stream_samples(ads1299_handle_t *handle, const struct sockaddr_in *dest_addr, int64_t duration_us)
+{
+    int64_t end_us = esp_timer_get_time() + duration_us;
+    uint32_t last_counter = 0, until_check = 0, waited_ms = 0;
+    int64_t last_timestamp_us = 0;
+    while (!duration_us || esp_timer_get_time() < end_us) {
+        // Look at the clock and for NACKs about once a frame, whether or not the ring ever drains
+        if (until_check-- == 0) {
+            until_check = frame_samples;
+            if (answer_nacks(dest_addr) < 0)
+                return -1;
+            int64_t now_us = esp_timer_get_time();
+            if (BASE_TELEMETRY_ENABLE && now_us >= telemetry_due_us) {
+                telemetry_due_us = now_us + TELEMETRY_PERIOD_MS * 1000;
+                if (send_telemetry(handle, dest_addr, last_counter, last_timestamp_us) < 0)
+                    return -1;
+            }
+        }
+
+        ads1299_sample_t sample;
+        if (!spsc_ring_pop(stream_ring, &sample)) {
+            // Drained, sleep until the acquisition or DSP task has a frame worth of samples. With a replay
+            // window wake now and then for NACKs, a frame period is long for the host to wait.
+            uint32_t wait_ms = BASE_REPLAY_ENABLE ? REPLAY_POLL_MS : 1000;
+            if (encoder.header.n_samples) {
+                // No later than the partial frame's deadline, the samples stopped or the gate holds them
+                int64_t left_us = encoder.header.timestamp_us + flush_latency_us - esp_timer_get_time();
+                if (left_us <= 0) {
+                    if (send_frame(dest_addr) < 0)
+                        return -1;
+                    continue;
+                }
+                if (left_us / 1000 + 1 < wait_ms)
+                    wait_ms = left_us / 1000 + 1;
+            }
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms))) {
+                waited_ms = 0;
+                continue;
+            }
+            if (answer_nacks(dest_addr) < 0)
+                return -1;
+            if ((waited_ms += wait_ms) >= 1000) {
+                ESP_LOGW(TAG, "[STREAMING] No samples from ADS1299");
+                log_acq_stats(handle);
+                waited_ms = 0;
+            }
+            continue;
+        }
+
+        uint32_t start = tlm_start();
+        last_counter = sample.counter;
+        last_timestamp_us = sample.timestamp_us;
+        if (f2 && classify_sample(&sample, dest_addr) < 0)
+            return -1;
+        if (!(BASE_CLASSIFIER_ONLY && f2) &&
+            (activity ? gate_sample(&sample, dest_addr) : frame_sample(&sample, dest_addr)) < 0)
+            return -1;
+        tlm_timer_stop(&process_timer, start);
+    }
+
+    // Out of time, flush the partial frame
+    if (encoder.header.n_samples && send_frame(dest_addr) < 0)
+        return -1;
+    return 0;
+}
+
+static void stream_reset(ads1299_handle_t *handle)
+{
+    // Only while the pipeline is stopped
+    spsc_ring_clear(sample_ring);
+    spsc_ring_reset_stats(sample_ring);
+    spsc_ring_clear(stream_ring);
+    spsc_ring_reset_stats(stream_ring);
+    ads1299_reset_read_stats(handle);
+    tlm_timer_reset(&callback_timer);
+    tlm_timer_reset(&dsp_timer);
+    tlm_timer_reset(&process_timer);
+    tlm_timer_reset(&encode_timer);
+    tlm_timer_reset(&send_timer);
+    tlm_timer_reset(&flush_age_timer);
+    telemetry_due_us = esp_timer_get_time() + TELEMETRY_PERIOD_MS * 1000;
+    stream_stats = (stream_stats_t) {0};
+#if BASE_REPLAY_ENABLE
+    proto_replay_clear(&replay); // The host starts over with a new connection
+#endif
+    if (filter)
+        iir_reset(filter);
+    if (f2) {
+        clf_reset(classifier);
+        clf_f2_reset(f2);
+    }
+    if (activity) {
+        act_reset(activity);
+        spsc_ring_clear(pre_roll);
+    }
+    encoder.header.n_samples = 0; // Drop any partial frame from the last connection
+}
+
+#if BASE_THROUGHPUT_BENCH
+static void cpu_idle_time(configRUN_TIME_COUNTER_TYPE ret_idle[])
+{
+    // Run time counters tick in microseconds, clocked from esp_timer
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+        ret_idle[core] = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+}
+
+static int run_throughput_bench(ads1299_handle_t *handle, const ads1299_acq_config_t *acq_config,
+                                const struct sockaddr_in *dest_addr)
+{
+    static const ads1299_data_rate_t rates[] = {
+        DR_250SPS, DR_500SPS, DR_1KSPS, DR_2KSPS, DR_4KSPS, DR_8KSPS, DR_16KSPS
+    };
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    vTaskPrioritySet(NULL, NET_TASK_PRIORITY);
+    int err = 0;
+
+    for (int i = 0; i < sizeof(rates) / sizeof(rates[0]) && !err; i++) {
+        ads1299_set_datarate(handle, rates[i]);
+        stream_reset(handle);
+        stream_configure(handle);
+
+        configRUN_TIME_COUNTER_TYPE idle_start[portNUM_PROCESSORS], idle_end[portNUM_PROCESSORS];
+        cpu_idle_time(idle_start);
+        int64_t start_us = esp_timer_get_time();
+
+        pipeline_start(handle, acq_config, xTaskGetCurrentTaskHandle());
+        err = stream_samples(handle, dest_addr, BENCH_DURATION_US);
+        pipeline_stop(handle);
+
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        cpu_idle_time(idle_end);
+
+        uint32_t sps = 0;
+        ads1299_acq_stats_t acq_stats;
+        spsc_ring_stats_t ring_stats, dsp_ring_stats = {0};
+        ads1299_get_sample_rate(handle, &sps);
+        ads1299_acq_get_stats(handle, &acq_stats);
+        spsc_ring_get_stats(sample_ring, &ring_stats);
+        if (stream_ring != sample_ring)
+            spsc_ring_get_stats(stream_ring, &dsp_ring_stats);
+        uint32_t drops = acq_stats.missed_drdy + ring_stats.overflows + dsp_ring_stats.overflows +
+                         stream_stats.samples_dropped;
+
+        ESP_LOGI(TAG, "[BENCH] %5lu SPS: %7.1f samples/s sent, %lu dropped (DRDY %lu, ring %lu, DSP ring %lu, network %lu)",
+            sps, stream_stats.samples_sent * 1e6 / elapsed_us, drops, acq_stats.missed_drdy,
+            ring_stats.overflows, dsp_ring_stats.overflows, stream_stats.samples_dropped);
+        for (int core = 0; core < portNUM_PROCESSORS; core++)
+            ESP_LOGI(TAG, "[BENCH] %5lu SPS: CPU%d %5.1f%% busy", sps, core,
+                100.0 - 100.0 * (configRUN_TIME_COUNTER_TYPE)(idle_end[core] - idle_start[core]) / elapsed_us);
+        log_acq_stats(handle);
+    }
+
+    // Back to the configured rate for normal streaming
+    vTaskPrioritySet(NULL, priority);
+    ads1299_set_datarate(handle, BASE_DATA_RATE);
+    stream_configure(handle);
+    return err;
+}
+#endif
+
+#if BASE_JITTER_BENCH
+static volatile bool flood_running;
+static TaskHandle_t flood_task_handle; // NULL when not running
+static uint32_t flood_sent;
+
+// Saturates WiFi from the network core with full size datagrams to the host's discard port
+static void flood_task(void *arg)
 {
-    ESP_LOGI(TAG, "Notification of a time synchronization event");
+    static uint8_t payload[FRAME_BUFFER_SIZE];
+    struct sockaddr_in addr = *(const struct sockaddr_in *)arg;
+    addr.sin_port = htons(JITTER_FLOOD_PORT);
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    flood_sent = 0;
+    while (flood_running && s >= 0) {
+        if (sendto(s, payload, sizeof(payload), 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+            vTaskDelay(1); // Out of TX buffers, WiFi is as busy as it gets
+        else if (++flood_sent % JITTER_FLOOD_BURST == 0)
+            vTaskDelay(1); // Let the idle task in, its watchdog is still armed
+    }
+    if (s >= 0)
+        close(s);
+    flood_task_handle = NULL;
+    vTaskDelete(NULL);
 }
 
+static void log_latency(ads1299_handle_t *handle, const char *phase, int64_t elapsed_us)
+{
+    tlm_stats_t stats;
+    ads1299_acq_get_latency(handle, &stats);
+    if (!stats.count) {
+        ESP_LOGW(TAG, "[JITTER] %s: no samples", phase);
+        return;
+    }
+    ESP_LOGI(TAG, "[JITTER] %s: %lu samples, %.1f Mbit/s flood, DRDY to read us p50/p99/p99.9/max: %.0f/%.0f/%.0f/%.0f",
+        phase, stats.count, flood_sent * (double)FRAME_BUFFER_SIZE * 8 / elapsed_us,
+        tlm_cycles_to_us(tlm_quantile_cycles(&stats, 0.5f)), tlm_cycles_to_us(tlm_quantile_cycles(&stats, 0.99f)),
+        tlm_cycles_to_us(tlm_quantile_cycles(&stats, 0.999f)), tlm_cycles_to_us(stats.max_cycles));
+
+    // The distribution, one power of two bin per column
+    char line[TLM_HIST_BINS * 20];
+    int len = 0;
+    for (int b = 0; b < TLM_HIST_BINS && len < sizeof(line); b++) {
+        if (!stats.hist[b])
+            continue;
+        if (b < TLM_HIST_BINS - 1)
+            len += snprintf(line + len, sizeof(line) - len, " <%.0fus:%lu",
+                            tlm_cycles_to_us(1u << (TLM_HIST_SHIFT + b)), stats.hist[b]);
+        else
+            len += snprintf(line + len, sizeof(line) - len, " more:%lu", stats.hist[b]);
+    }
+    ESP_LOGI(TAG, "[JITTER] %s:%s", phase, line);
+}
+
+// DRDY to read latency while streaming as usual, then again with WiFi saturated on the network core
+static int run_jitter_bench(ads1299_handle_t *handle, const ads1299_acq_config_t *acq_config,
+                            const struct sockaddr_in *dest_addr)
+{
+    // Stream at the network task's priority, as normal streaming does
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    vTaskPrioritySet(NULL, NET_TASK_PRIORITY);
+    int err = 0;
+    for (int loaded = 0; loaded < 2 && !err; loaded++) {
+        stream_reset(handle);
+        flood_sent = 0;
+        if (loaded) {
+            flood_running = true;
+            xTaskCreatePinnedToCore(flood_task, "flood", 3072, (void *)dest_addr, NET_TASK_PRIORITY,
+                                    &flood_task_handle, NET_TASK_CORE);
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        pipeline_start(handle, acq_config, xTaskGetCurrentTaskHandle());
+        err = stream_samples(handle, dest_addr, JITTER_BENCH_DURATION_US);
+        pipeline_stop(handle);
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+        flood_running = false;
+        while (flood_task_handle)
+            vTaskDelay(1);
+        log_latency(handle, loaded ? "WiFi flood" : "Quiet", elapsed_us);
+        log_acq_stats(handle);
+    }
+    vTaskPrioritySet(NULL, priority);
+    return err;
+}
+#endif
+
+#if BASE_LATENCY_BENCH
+static const uint32_t latency_bench_ms[] = {5, 10, 20, 50, 100, 200};
+
+// Streams with each flush latency in turn, nexus-ingest --latency measures the host's side of each
+static int run_latency_bench(ads1299_handle_t *handle, const ads1299_acq_config_t *acq_config,
+                             const struct sockaddr_in *dest_addr)
+{
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    vTaskPrioritySet(NULL, NET_TASK_PRIORITY);
+    int err = 0;
+
+    for (int i = 0; i < sizeof(latency_bench_ms) / sizeof(latency_bench_ms[0]) && !err; i++) {
+        flush_latency_ms = latency_bench_ms[i];
+        stream_reset(handle);
+        stream_configure(handle);
+        ESP_LOGI(TAG, "[LATENCY] %3lu ms for %d s", flush_latency_ms, LATENCY_BENCH_DURATION_US / 1000000);
+
+        int64_t start_us = esp_timer_get_time();
+        pipeline_start(handle, acq_config, xTaskGetCurrentTaskHandle());
+        err = stream_samples(handle, dest_addr, LATENCY_BENCH_DURATION_US);
+        pipeline_stop(handle);
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+        tlm_stats_t age, send;
+        tlm_timer_read(&flush_age_timer, &age);
+        tlm_timer_read(&send_timer, &send);
+        if (!stream_stats.frames_sent || !age.count || !send.count)
+            continue;
+        ESP_LOGI(TAG, "[LATENCY] %3lu ms: %.1f frames/s of %.1f samples, sendto mean %.0f us, "
+            "frame age at send ms p50/p99/max %.1f/%.1f/%.1f", flush_latency_ms,
+            stream_stats.frames_sent * 1e6 / elapsed_us, (double)stream_stats.samples_sent / stream_stats.frames_sent,
+            tlm_cycles_to_us(send.total_cycles) / send.count,
+            tlm_cycles_to_us(tlm_quantile_cycles(&age, 0.5f)) / 1000,
+            tlm_cycles_to_us(tlm_quantile_cycles(&age, 0.99f)) / 1000, tlm_cycles_to_us(age.max_cycles) / 1000);
+    }
+
+    // Back to the configured policy for normal streaming
+    vTaskPrioritySet(NULL, priority);
+    flush_latency_ms = FLUSH_MAX_LATENCY_MS;
+    stream_configure(handle);
+    return err;
+}
+#endif
+
+#if BASE_SCAN_ENABLE
+// Steps through scan_candidates on raw samples and leaves every channel in its best orientation
+static void run_electrode_scan(ads1299_handle_t *handle, adg715_group_t *electrodes, const ads1299_acq_config_t *acq_config)
+{
+    const uint8_t n_channels = encoder.header.n_channels;
+    uint32_t sps = 0;
+    ads1299_get_sample_rate(handle, &sps);
+    scan_config_t config = {
+        .n_channels = n_channels,
+        .n_candidates = SCAN_CANDIDATES,
+        .settle = sps * BASE_SCAN_SETTLE_MS / 1000,
+        .capture = sps * BASE_SCAN_CAPTURE_MS / 1000,
+        .sample_rate = sps,
+        .band_hz = BASE_SCAN_BAND_HZ,
+        .stop_lo_hz = BASE_FILTER_STOP_LO_HZ,
+        .stop_hi_hz = BASE_FILTER_STOP_HI_HZ,
+    };
+    scan_handle_t *scan;
+    if (scan_init(&config, &scan) != SCAN_OK) {
+        ESP_LOGE(TAG, "[SCAN] Bad scan configuration at %lu SPS, electrodes left as they are", sps);
+        return;
+    }
+
+    // The drift and hum the stream filters take out are what the scan measures. Wake on every sample so
+    // the phases are timed to the sample.
+    iir_handle_t *stream_filter = filter;
+    uint16_t stream_frame_samples = frame_samples;
+    filter = NULL;
+    frame_samples = 1;
+    ads1299_acquire_bus(handle);
+    stream_reset(handle);
+    pipeline_start(handle, acq_config, xTaskGetCurrentTaskHandle());
+
+    int64_t scan_start_us = esp_timer_get_time();
+    bool complete = true;
+    for (int c = 0; c < SCAN_CANDIDATES && complete; c++) {
+        const uint8_t *state = scan_candidates[c];
+        if (adg715_group_set(electrodes, state) != ESP_OK)
+            ESP_LOGW(TAG, "[SCAN] Failed to switch every ADG715 to candidate %d", c);
+        int64_t settle_us = esp_timer_get_time(), capture_us = 0;
+
+        // Anything queued was sampled before the switch
+        ads1299_sample_t sample;
+        while (spsc_ring_pop(stream_ring, &sample))
+            ;
+        scan_begin(scan, c);
+        for (scan_phase_t phase = SCAN_SETTLE; phase != SCAN_DONE; ) {
+            if (!spsc_ring_pop(stream_ring, &sample)) {
+                if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000))) {
+                    ESP_LOGE(TAG, "[SCAN] No samples from ADS1299");
+                    complete = false;
+                    break;
+                }
+                continue;
+            }
+            phase = scan_push(scan, sample.data);
+            if (phase != SCAN_SETTLE && !capture_us)
+                capture_us = esp_timer_get_time();
+        }
+        if (!complete)
+            break;
+        int64_t done_us = esp_timer_get_time();
+
+        char line[8 * ADS1299_MAX_CHANNELS];
+        int len = 0;
+        for (int ch = 0; ch < n_channels && len < sizeof(line); ch++)
+            len += snprintf(line + len, sizeof(line) - len, " %.1f", scan_snr_db(scan, c, ch));
+        ESP_LOGI(TAG, "[SCAN] %02x %02x %02x %02x: switch %lld us, settle %lld ms, capture %lld ms, SNR dB%s",
+            state[0], state[1], state[2], state[3], electrodes->stats.last_us,
+            (capture_us - settle_us) / 1000, (done_us - capture_us) / 1000, line);
+    }
+    pipeline_stop(handle);
+    ads1299_release_bus(handle);
+    filter = stream_filter;
+    frame_samples = stream_frame_samples;
+
+    if (!complete) {
+        ESP_LOGE(TAG, "[SCAN] Incomplete, electrodes left disconnected");
+        scan_deinit(scan);
+        return;
+    }
+
+    // Every channel takes its own best candidate, through its own switches
+    uint8_t best_state[sizeof(adg715_addr)] = {0};
+    float mean_db = 0;
+    int n_mapped = 0;
+    for (int ch = 0; ch < n_channels && ch < sizeof(scan_channel_map) / sizeof(scan_channel_map[0]); ch++) {
+        uint8_t best = scan_best_for_channel(scan, ch), m = scan_channel_map[ch].mux;
+        best_state[m] |= scan_candidates[best][m] & scan_channel_map[ch].mask;
+        mean_db += scan_snr_db(scan, best, ch);
+        n_mapped++;
+        ESP_LOGI(TAG, "[SCAN] CH%d: candidate %u, SNR %.1f dB", ch + 1, best, scan_snr_db(scan, best, ch));
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(adg715_group_set(electrodes, best_state));
+    int64_t end_us = esp_timer_get_time();
+
+    uint8_t whole = scan_best_candidate(scan);
+    ESP_LOGI(TAG, "[SCAN] Best %02x %02x %02x %02x, mean SNR %.1f dB (best single candidate %d, %.1f dB)",
+        best_state[0], best_state[1], best_state[2], best_state[3],
+        n_mapped ? mean_db / n_mapped : 0, whole, scan_mean_snr_db(scan, whole));
+    adg715_group_stats_t switch_stats;
+    adg715_group_get_stats(electrodes, &switch_stats);
+    ESP_LOGI(TAG, "[SCAN] %d candidates in %lld ms, final switch %lld us, switch us min/mean/max: %lld/%lld/%lld",
+        SCAN_CANDIDATES, (end_us - scan_start_us) / 1000, switch_stats.last_us, switch_stats.min_us,
+        switch_stats.count ? switch_stats.total_us / switch_stats.count : 0, switch_stats.max_us);
+    scan_deinit(scan);
+}
+#endif
+
 static void event_handler(void *arg, esp_event_base_t event_base,
                           int32_t event_id, void *event_data)
 {
@@ -165,10 +1400,155 @@ void wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Modem sleep holds TX for up to a DTIM period, too long for the sample ring at high data rates
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 }
 
+// Streams until the connection fails, then hands back to the supervisor
+static void net_task(void *arg)
+{
+    base_context_t *ctx = (base_context_t *)arg;
+    stream_samples(ctx->ads1299, &ctx->dest_addr, 0);
+    ESP_LOGE(TAG, "Connection lost: errno %d", errno);
+    xTaskNotifyGive(ctx->supervisor_task);
+    // The pipeline notifies this task until it is stopped, the supervisor deletes it after that
+    vTaskSuspend(NULL);
+}
+
+// Owns the state machine, the ADS1299 configuration and the socket, the other tasks only move samples
+static void supervisor_task(void *arg)
+{
+    base_context_t *ctx = (base_context_t *)arg;
+
+#if BASE_SCAN_ENABLE
+    if (ctx->electrodes)
+        run_electrode_scan(ctx->ads1299, ctx->electrodes, &ctx->acq_config);
+#endif
+
+    /********* STATE MACHINE *******/
+    while (1)
+    {
+        switch (base_state)
+        {
+        case WIFI_DISCONNECTED:
+            // ESP_LOGI(TAG, "Disconnected from Wifi");
+            status_red(ctx->status);
+            break;
+        case WIFI_CONNECTING:
+            ESP_LOGI(TAG, "Connecting to Wifi");
+            status_red(ctx->status);
+
+            wifi_init_sta();
+
+            /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection 
+             * failed for the maximum number of re-tries (WIFI_FAIL_BIT). The bits are set by 
+             * event_handler() (see above) */
+            EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+                WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+
+            if (bits & WIFI_CONNECTED_BIT)
+                base_state = SERVER_CONNECTING;
+            else if (bits & WIFI_FAIL_BIT)
+                base_state = WIFI_DISCONNECTED;
+            else
+            {
+                ESP_LOGE(TAG, "UNEXPECTED EVENT");
+                base_state = WIFI_DISCONNECTED;
+            }
+            break;
+        case SERVER_CONNECTING:
+            ESP_LOGI(TAG, "[SERVER_DISCONNECTED] Connected to ap SSID:%s password:%s", 
+                BASE_WIFI_SSID, BASE_WIFI_PASS);
+            ESP_LOGI(TAG, "[SERVER_DISCONNECTED] Looking for server.");
+            status_yellow(ctx->status);
+
+            // Clock exchanges run on their own socket from here on, across reconnections
+            if (!sync_task_handle)
+                xTaskCreatePinnedToCore(sync_task, "clock_sync", SYNC_TASK_STACK, NULL, SYNC_TASK_PRIORITY,
+                                        &sync_task_handle, SYNC_TASK_CORE);
+            
+            // Setting up UDP socket
+            ctx->dest_addr.sin_addr.s_addr = inet_addr(HOST_IP_ADDR);
+            ctx->dest_addr.sin_family = AF_INET;
+            ctx->dest_addr.sin_port = htons(HOST_IP_PORT);
+            addr_family = AF_INET;
+            ip_protocol = IPPROTO_IP;
+
+            sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
+            if (sock < 0) {
+                ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+                vTaskDelay(1000 / portTICK_PERIOD_MS);
+                break;
+            }
+
+            // Set timeout
+            struct timeval timeout;
+            timeout.tv_sec = 10;
+            timeout.tv_usec = 0;
+            setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+            ESP_LOGI(TAG, "Socket created, sending to %s:%d", HOST_IP_ADDR, HOST_IP_PORT);
+            base_state = STREAMING;
+            break;
+        case STREAMING:
+            ESP_LOGI(TAG, "[STREAMING] Streaming data.");
+            status_green(ctx->status);
+            ads1299_acquire_bus(ctx->ads1299);
+
+            int stream_err = 0;
+#if BASE_THROUGHPUT_BENCH
+            static bool bench_done = false;
+            if (!bench_done) {
+                stream_err = run_throughput_bench(ctx->ads1299, &ctx->acq_config, &ctx->dest_addr);
+                bench_done = true;
+            }
+#endif
+#if BASE_JITTER_BENCH
+            static bool jitter_done = false;
+            if (!stream_err && !jitter_done) {
+                stream_err = run_jitter_bench(ctx->ads1299, &ctx->acq_config, &ctx->dest_addr);
+                jitter_done = true;
+            }
+#endif
+#if BASE_LATENCY_BENCH
+            static bool latency_done = false;
+            if (!stream_err && !latency_done) {
+                stream_err = run_latency_bench(ctx->ads1299, &ctx->acq_config, &ctx->dest_addr);
+                latency_done = true;
+            }
+#endif
+            if (stream_err) {
+                ESP_LOGE(TAG, "Connection lost: errno %d", errno);
+            } else {
+                stream_reset(ctx->ads1299);
+                // Drop what the scan or a bench left, from here only the network task notifies
+                ulTaskNotifyTake(pdTRUE, 0);
+                // It waits on the empty ring until acquisition starts
+                if (xTaskCreatePinnedToCore(net_task, "net", NET_TASK_STACK, ctx, NET_TASK_PRIORITY,
+                                            &ctx->net_task, NET_TASK_CORE) != pdPASS) {
+                    ESP_LOGE(TAG, "Failed to create network task");
+                    abort();
+                }
+                pipeline_start(ctx->ads1299, &ctx->acq_config, ctx->net_task);
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                pipeline_stop(ctx->ads1299);
+                vTaskDelete(ctx->net_task);
+                ctx->net_task = NULL;
+                log_acq_stats(ctx->ads1299);
+            }
+
+            // Error with UDP, go back to SERVER_CONNECTING
+            shutdown(sock, 0);
+            close(sock);
+            ads1299_release_bus(ctx->ads1299);
+            base_state = SERVER_CONNECTING;
+            break;
+        }
+    }
+}
+
 void app_main(void)
 {
     /********* SETUP CODE **********/
@@ -182,12 +1562,6 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);   
 
-    // Setup time
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-
     // Setup status
     status_config_t status_config = {
         .led_pin = STATUS_LED_GPIO
@@ -210,18 +1584,28 @@ void app_main(void)
     i2c_master_bus_handle_t i2c_bus_handle;
     ESP_ERROR_CHECK(i2c_new_master_bus(&i2c_master_config, &i2c_bus_handle));
 
-    /* Setup 4 ADG715s */
-    adg715_handle_t* adg715_handle[4];
+    /* Setup 4 ADG715s, switched together as one group */
+    adg715_handle_t* adg715_handle[4] = {0};
+    adg715_group_config_t electrodes_config = { .n_devices = sizeof(adg715_addr) };
     for(int i = 0; i < sizeof(adg715_addr); i++) {
         adg715_config_t adg715_config = {
             .i2c_bus = i2c_bus_handle,
             .i2c_addr = adg715_addr[i],
-            .reset_pin = ADG715_RESET_PIN
+            .reset_pin = ADG715_RESET_PIN,
+            .scl_speed_hz = ADG715_I2C_SPEED_HZ
         };
         adg715_init(&adg715_config, &adg715_handle[i]);
-        adg715_set(adg715_handle[i],0x00);
+        electrodes_config.devices[i] = adg715_handle[i];
     }
 
+    adg715_group_t* electrodes = NULL;
+    const uint8_t electrodes_open[4] = {0x00, 0x00, 0x00, 0x00};
+    if (adg715_group_init(&electrodes_config, &electrodes) != ESP_OK)
+        ESP_LOGE(TAG, "Missing ADG715, electrodes left as they are");
+    else
+        adg715_group_set(electrodes, electrodes_open);
+
+    // Hand picked orientation, BASE_SCAN_ENABLE chooses one at boot instead
     //adg715_set(adg715_handle[0], 0x81); // U1 (MSB S8, LSB S1) (CH3, CH2)
     //adg715_set(adg715_handle[1], 0x28); // U2 (CH7, CH6)
     //adg715_set(adg715_handle[2], 0x88); // U3 (CH4, CH1)
@@ -235,10 +1619,10 @@ void app_main(void)
         .sclk_io_num = ADS1299_SCLK_PIN,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = 32,
+        .max_transfer_sz = ADS1299_MAX_DEVICES * 27 + 4, // Daisy chained 27 byte frames
     };
 
-    ESP_ERROR_CHECK(spi_bus_initialize(ADS1299_SPI_HOST, &buscfg, SPI_DMA_DISABLED));
+    ESP_ERROR_CHECK(spi_bus_initialize(ADS1299_SPI_HOST, &buscfg, SPI_DMA_CH_AUTO));
 
     // Setup ADS1299
     ads1299_config_t ads1299_config = {
@@ -249,12 +1633,16 @@ void app_main(void)
         .sclk_pin = ADS1299_SCLK_PIN,
         .cs_pin = ADS1299_CS_PIN,
         .drdy_pin = ADS1299_DRDY_PIN,
-        .reset_pin = ADS1299_RESET_PIN
+        .reset_pin = ADS1299_RESET_PIN,
+        .n_devices = ADS1299_DAISY_DEVICES
     };
 
     ads1299_handle_t* ads1299_handle;
     ads1299_init(&ads1299_config, &ads1299_handle);
-    ads1299_set_datarate(ads1299_handle, DR_250SPS);
+
+    // Batch the whole configuration into one SDATAC window
+    ads1299_config_begin(ads1299_handle);
+    ads1299_set_datarate(ads1299_handle, BASE_DATA_RATE);
     
     //ads1299_set_ch_all(ads1299_handle, false);
     //ads1299_set_ch(ads1299_handle, 1, true);
@@ -266,8 +1654,12 @@ void app_main(void)
     ads1299_get_datarate(ads1299_handle, &dr);
     ESP_LOGI(TAG, "Data rate: %d", dr);
 
-    // print all channels state
-    for(int i = 0; i < 8; i++) {
+    uint8_t n_channels = 0;
+    ads1299_get_channel_count(ads1299_handle, &n_channels);
+    ESP_LOGI(TAG, "Channels: %d", n_channels);
+
+    // print all channels state, settings are shared by every daisy chained device
+    for(int i = 0; i < ADS1299_CHANNELS_PER_DEVICE; i++) {
         uint8_t reg;
 
         // ads1299_set_ch_input(ads1299_handle, i, TESTSIG);
@@ -277,132 +1669,58 @@ void app_main(void)
         ads1299_get_ch(ads1299_handle, i, &reg);
         ESP_LOGI(TAG, "CH%d Setting: %x", i, reg);
     }
+    ESP_ERROR_CHECK(ads1299_config_commit(ads1299_handle));
     
-    // TODO: Move this into the ADS1299 component library to be gain dependent
-    const double LSB = 2.5 / 24 / (16777216 - 1); // LSB = VREF / Gain / (2^24 - 1)
-
-    /********* STATE MACHINE *******/
-    while (1)
-    {
-        switch (base_state)
-        {
-        case WIFI_DISCONNECTED:
-            // ESP_LOGI(TAG, "Disconnected from Wifi");
-            status_red(status_handle);
-            break;
-        case WIFI_CONNECTING:
-            ESP_LOGI(TAG, "Connecting to Wifi");
-            status_red(status_handle);
-
-            wifi_init_sta();
-
-            /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection 
-             * failed for the maximum number of re-tries (WIFI_FAIL_BIT). The bits are set by 
-             * event_handler() (see above) */
-            EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-
-            if (bits & WIFI_CONNECTED_BIT)
-                base_state = SERVER_CONNECTING;
-            else if (bits & WIFI_FAIL_BIT)
-                base_state = WIFI_DISCONNECTED;
-            else
-            {
-                ESP_LOGE(TAG, "UNEXPECTED EVENT");
-                base_state = WIFI_DISCONNECTED;
-            }
-            break;
-        case SERVER_CONNECTING:
-            ESP_LOGI(TAG, "[SERVER_DISCONNECTED] Connected to ap SSID:%s password:%s", 
-                BASE_WIFI_SSID, BASE_WIFI_PASS);
-            ESP_LOGI(TAG, "[SERVER_DISCONNECTED] Looking for server.");
-            status_yellow(status_handle);
-
-            // Setup time
-            ESP_LOGI(TAG, "[SERVER_DISCONNECTED] Initializing SNTP");
-            esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-            esp_sntp_setservername(0, "pool.ntp.org");
-            esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-            esp_sntp_init();
-
-            // wait for time to be set
-            int retry = 0;
-            const int retry_count = 10;
-            while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET && ++retry < retry_count) {
-                ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-                vTaskDelay(2000 / portTICK_PERIOD_MS);
-            }
-            
-            // Setting up UDP socket
-            struct sockaddr_in dest_addr;
-            dest_addr.sin_addr.s_addr = inet_addr(HOST_IP_ADDR);
-            dest_addr.sin_family = AF_INET;
-            dest_addr.sin_port = htons(HOST_IP_PORT);
-            addr_family = AF_INET;
-            ip_protocol = IPPROTO_IP;
-
-            sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
-            if (sock < 0) {
-                ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
-                break;
-            }
-
-            // Set timeout
-            struct timeval timeout;
-            timeout.tv_sec = 10;
-            timeout.tv_usec = 0;
-            setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    // Conversion to volts happens on the host, frames carry the gain of each channel
+    uint8_t gain[ADS1299_MAX_CHANNELS];
+    for(int i = 0; i < n_channels; i++) {
+        ads1299_gain_t g = GAIN_24;
+        ads1299_get_ch_gain(ads1299_handle, i % ADS1299_CHANNELS_PER_DEVICE, &g);
+        gain[i] = g;
+    }
 
-            ESP_LOGI(TAG, "Socket created, sending to %s:%d", HOST_IP_ADDR, HOST_IP_PORT);
-            base_state = STREAMING;
-            break;
-        case STREAMING:
-            ESP_LOGI(TAG, "[STREAMING] Streaming data.");
-            status_green(status_handle);
-            ads1299_acquire_bus(ads1299_handle);
-
-            while (1) {
-                if (ads1299_ready(ads1299_handle)) {
-                    uint32_t status;
-                    int32_t res[8];
-                    double res_V[8];
-
-                    ads1299_read(ads1299_handle, &status, res);
-                    time(&now);
-
-                    // Convert to uV
-                    for(int i = 0; i < 8; i++) {
-                        res_V[i] = res[i] * LSB;
-                    }
-                    
-                    char temp_buffer[256] = {0};
-                    sprintf(temp_buffer, "%lld,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf\n", now, res_V[0], res_V[1], res_V[2], res_V[3], res_V[4], res_V[5], res_V[6], res_V[7]);
-                    memcpy(&buffer[buffer_index], temp_buffer, 256);
-        
-                    if (buffer_index + 256 <= BUFFER_FLUSH_SIZE) {
-                        buffer_index += 256;
-                    } else {
-                        // Flush to network
-                        int err = sendto(sock, buffer, buffer_index, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-                        buffer_index = 0;
-
-                        if (err < 0) {
-                            ESP_LOGE(TAG, "Connection lost: errno %d", errno);
-                            break;
-                        }               
-                    }
-                } else {
-                    // Reset watchdog
-                }
-            }
+    uint8_t mac[6];
+    esp_efuse_mac_get_default(mac);
+    uint32_t device_id = (mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5];
+    ESP_ERROR_CHECK(proto_encoder_init(&encoder, frame_buffer, sizeof(frame_buffer), device_id, dr, n_channels, gain));
+#if BASE_RICE_ENABLE
+    proto_encoder_set_rice(&encoder, rice_buffer, sizeof(rice_buffer));
+#endif
+#if BASE_REPLAY_ENABLE
+    ESP_ERROR_CHECK(proto_replay_init(&replay, replay_buffer, sizeof(replay_buffer), FRAME_BUFFER_SIZE));
+#endif
+    stream_configure(ads1299_handle);
 
-            // Error with UDP, go back to SERVER_CONNECTING
-            shutdown(sock, 0);
-            close(sock);
-            ads1299_release_bus(ads1299_handle);
-            base_state = SERVER_CONNECTING;
-            break;
-        }
+    spsc_ring_config_t ring_config = {
+        .elem_size = sizeof(ads1299_sample_t),
+        .capacity = SAMPLE_RING_LEN,
+    };
+    if (spsc_ring_init(&ring_config, &sample_ring) != SPSC_RING_OK) {
+        ESP_LOGE(TAG, "Failed to allocate sample ring");
+        abort();
+    }
+#if BASE_DSP_TASK
+    ring_config.capacity = DSP_RING_LEN;
+    if (spsc_ring_init(&ring_config, &stream_ring) != SPSC_RING_OK) {
+        ESP_LOGE(TAG, "Failed to allocate DSP ring");
+        abort();
     }
+#else
+    stream_ring = sample_ring;
+#endif
+
+    base_ctx = (base_context_t) {
+        .status = status_handle,
+        .ads1299 = ads1299_handle,
+        .electrodes = electrodes,
+        .acq_config = {
+            .on_sample = on_sample,
+            .ctx = NULL,
+            .task_priority = ADS1299_ACQ_TASK_PRIORITY,
+            .task_core = ADS1299_ACQ_TASK_CORE,
+        },
+    };
+    // The supervisor takes over from here, app_main returns and its task is deleted
+    xTaskCreatePinnedToCore(supervisor_task, "supervisor", SUPERVISOR_TASK_STACK, &base_ctx, SUPERVISOR_TASK_PRIORITY,
+                            &base_ctx.supervisor_task, SUPERVISOR_TASK_CORE);
 }
@@ -0,0 +1,131 @@
+// Reading a selection of trials through the dataset index against loading every
+// .npy with npy::load, from a cold page cache (the files are evicted with
+// POSIX_FADV_DONTNEED before each pass) and warm. Both sum every sample, and the
+// sums must agree. npy::load takes row major files only, column major ones are
+// read through the index alone and left out of the comparison.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../tools/dataset.hpp"
+#include "../tools/npy.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: dataset-bench [options] <datasets root>\n"
+        "  --dataset NAME    only this dataset, repeatable (all)\n"
+        "  --cls C           only this class, repeatable (all)\n"
+        "  --threads N       prefetch threads, 0 for one per core (0)\n");
+}
+
+static double since(clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+static void evict(const std::vector<std::string>& paths)
+{
+    for (const std::string& p : paths) {
+        int fd = open(p.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    nexus::Filter filter;
+    unsigned threads = 0;
+    std::string root;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--dataset" && more) filter.datasets.push_back(argv[++i]);
+        else if (a == "--cls" && more) filter.classes.push_back(argv[++i]);
+        else if (a == "--threads" && more) threads = std::atoi(argv[++i]);
+        else if (a[0] != '-' && root.empty()) root = a;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (root.empty()) {
+        usage();
+        return 2;
+    }
+
+    try {
+        auto start = clock_type::now();
+        nexus::Dataset ds(root);
+        double t_index = since(start);
+
+        start = clock_type::now();
+        std::vector<size_t> sel = ds.select(filter);
+        double t_select = since(start);
+
+        std::vector<std::string> paths, row_major;
+        size_t bytes = 0;
+        for (size_t i : sel) {
+            const nexus::Trial& t = ds.trials()[i];
+            paths.push_back(t.path);
+            if (!t.fortran && t.dtype == nexus::Dtype::F8) row_major.push_back(t.path);
+            bytes += t.rows * t.cols * nexus::dtype_size(t.dtype);
+        }
+        std::printf("%zu trials indexed in %.1f ms (%zu skipped), %zu selected in %.3f ms, %.1f MB, "
+                    "%zu column major\n", ds.trials().size(), t_index, ds.skipped().size(), sel.size(),
+                    t_select, bytes / 1e6, sel.size() - row_major.size());
+
+        // npy::load copies every file into a vector
+        double sum_load = 0, t_load[2];
+        evict(paths);
+        for (int pass = 0; pass < 2; pass++) {
+            start = clock_type::now();
+            double sum = 0;
+            for (const std::string& p : row_major) {
+                npy::Array a = npy::load(p);
+                for (double v : a.data) sum += v;
+            }
+            t_load[pass] = since(start);
+            sum_load = sum;
+        }
+
+        // Prefetch, then read the samples in place
+        evict(paths);
+        start = clock_type::now();
+        ds.prefetch(sel, threads);
+        double t_prefetch = since(start);
+        double sum_view = 0, t_view[2];
+        for (int pass = 0; pass < 2; pass++) {
+            start = clock_type::now();
+            double sum = 0, other = 0;
+            for (size_t i : sel) {
+                nexus::View v = ds.view(i);
+                const double* x = v.f8();
+                if (!x) continue;
+                double& s = v.fortran ? other : sum;
+                for (size_t r = 0; r < v.rows; r++)
+                    for (size_t c = 0; c < v.cols; c++) s += x[v.index(r, c)];
+            }
+            t_view[pass] = since(start);
+            sum_view = sum;
+        }
+
+        std::printf("npy::load          cold %8.1f ms  warm %8.1f ms\n", t_load[0], t_load[1]);
+        std::printf("prefetch + view    cold %8.1f ms  warm %8.1f ms  (prefetch %.1f ms)\n",
+                    t_prefetch + t_view[0], t_view[1], t_prefetch);
+        std::printf("sums %s (%.6g)\n", sum_load == sum_view ? "match" : "DIFFER", sum_view);
+        return sum_load == sum_view ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,152 @@
+// Throughput of the incremental MAV/WL/ZC/SSC extractor over recordings in
+// datasets/, against recomputing every window from scratch the way
+// feature_extractors.py does. Both must agree; --out writes the features of the
+// first file for code/ml/features_bench.py to check against NumPy.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../tools/npy.hpp"
+
+extern "C" {
+#include "emg_features_interface.h"
+}
+
+using clock_type = std::chrono::steady_clock;
+
+static int sign(float v)
+{
+    return (v > 0) - (v < 0);
+}
+
+// Every window from scratch, the C equivalent of window_generator() then mav/wl/zc/ssc
+static void windows_from_scratch(const std::vector<float>& x, size_t rows, const feat_config_t& c,
+                                 std::vector<feat_vector_t>& out)
+{
+    const int n_ch = c.n_channels;
+    out.clear();
+    for (size_t start = 0; start + c.window <= rows; start += c.stride) {
+        feat_vector_t v = {};
+        v.end = start + c.window - 1;
+        for (int ch = 0; ch < n_ch; ch++) {
+            float abs_sum = 0, wl = 0;
+            for (size_t i = start; i < start + c.window; i++) {
+                float s = x[i * n_ch + ch];
+                abs_sum += std::fabs(s);
+                if (i == start) continue;
+                float p = x[(i - 1) * n_ch + ch];
+                float d = s - p;
+                wl += std::fabs(d);
+                v.zc[ch] += std::fabs(d) >= c.zc_threshold && sign(s) != sign(p);
+                if (i == start + 1) continue;
+                float dp = p - x[(i - 2) * n_ch + ch];
+                v.ssc[ch] += std::fabs(d - dp) >= c.ssc_threshold && sign(d) != sign(dp);
+            }
+            v.mav[ch] = abs_sum / c.window;
+            v.wl[ch] = wl;
+        }
+        out.push_back(v);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    feat_config_t config = {};
+    config.window = 100;
+    config.stride = 25;
+    config.zc_threshold = 20;
+    config.ssc_threshold = 20;
+    int repeat = 20;
+    const char* out_path = nullptr;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--window" && i + 1 < argc) config.window = std::atoi(argv[++i]);
+        else if (a == "--stride" && i + 1 < argc) config.stride = std::atoi(argv[++i]);
+        else if (a == "--repeat" && i + 1 < argc) repeat = std::atoi(argv[++i]);
+        else if (a == "--out" && i + 1 < argc) out_path = argv[++i];
+        else files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "usage: features-bench [--window N] [--stride N] [--repeat N] [--out feats.npy] <rec.npy>...\n");
+        return 2;
+    }
+
+    double t_inc = 0, t_scratch = 0, max_rel = 0;
+    size_t samples = 0, windows = 0, mismatched_counts = 0;
+
+    for (size_t f = 0; f < files.size(); f++) {
+        npy::Array rec = npy::load(files[f]);
+        config.n_channels = rec.cols;
+        std::vector<float> x(rec.data.begin(), rec.data.end());
+
+        feat_handle_t* feat;
+        if (feat_init(&config, &feat) != FEAT_OK) {
+            std::fprintf(stderr, "%s: cannot extract %zu channels\n", files[f], rec.cols);
+            return 1;
+        }
+
+        std::vector<feat_vector_t> inc, ref;
+        auto t0 = clock_type::now();
+        for (int r = 0; r < repeat; r++) {
+            inc.clear();
+            feat_reset(feat);
+            feat_vector_t v;
+            for (size_t i = 0; i < rec.rows; i++)
+                if (feat_push(feat, &x[i * rec.cols], &v))
+                    inc.push_back(v);
+        }
+        auto t1 = clock_type::now();
+        for (int r = 0; r < repeat; r++)
+            windows_from_scratch(x, rec.rows, config, ref);
+        auto t2 = clock_type::now();
+        feat_deinit(feat);
+
+        t_inc += std::chrono::duration<double>(t1 - t0).count();
+        t_scratch += std::chrono::duration<double>(t2 - t1).count();
+        samples += rec.rows * repeat;
+        windows += inc.size() * repeat;
+
+        if (inc.size() != ref.size()) {
+            std::fprintf(stderr, "%s: %zu windows, expected %zu\n", files[f], inc.size(), ref.size());
+            return 1;
+        }
+        for (size_t w = 0; w < inc.size(); w++) {
+            for (size_t ch = 0; ch < rec.cols; ch++) {
+                max_rel = std::fmax(max_rel, std::fabs(inc[w].mav[ch] - ref[w].mav[ch]) / std::fmax(ref[w].mav[ch], 1e-6f));
+                max_rel = std::fmax(max_rel, std::fabs(inc[w].wl[ch] - ref[w].wl[ch]) / std::fmax(ref[w].wl[ch], 1e-6f));
+                mismatched_counts += inc[w].zc[ch] != ref[w].zc[ch];
+                mismatched_counts += inc[w].ssc[ch] != ref[w].ssc[ch];
+            }
+        }
+
+        if (f == 0 && out_path) {
+            // Same layout as np.concatenate((mav, wl, zc, ssc), axis=1)
+            npy::Array out;
+            out.rows = inc.size();
+            out.cols = 4 * rec.cols;
+            out.data.resize(out.rows * out.cols);
+            for (size_t w = 0; w < inc.size(); w++) {
+                for (size_t ch = 0; ch < rec.cols; ch++) {
+                    out.row(w)[ch] = inc[w].mav[ch];
+                    out.row(w)[rec.cols + ch] = inc[w].wl[ch];
+                    out.row(w)[2 * rec.cols + ch] = inc[w].zc[ch];
+                    out.row(w)[3 * rec.cols + ch] = inc[w].ssc[ch];
+                }
+            }
+            npy::save(out_path, out);
+        }
+    }
+
+    std::printf("%zu files, %zu samples, %zu windows of %u/%u\n", files.size(), samples, windows,
+                config.window, config.stride);
+    std::printf("incremental  %8.1f ns/sample  %8.0f windows/s\n", t_inc * 1e9 / samples, windows / t_inc);
+    std::printf("from scratch %8.1f ns/sample  %8.0f windows/s  (%.1fx slower)\n", t_scratch * 1e9 / samples,
+                windows / t_scratch, t_scratch / t_inc);
+    std::printf("max relative difference of mav/wl %.3g, zc/ssc mismatches %zu\n", max_rel, mismatched_counts);
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Scaling of the batch feature extraction (nexus-features) with the thread count:
+// the same trials, already in the page cache, on 1, 2, 4 ... threads up to --max.
+// Prints the time, speedup and parallel efficiency of each run, how much work was
+// stolen, and checks every run produced the same matrix as the single thread one.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../tools/batch_features.hpp"
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: features-scaling-bench [options] <datasets root | dataset dir>\n"
+        "  --features SPEC   F1, F2 or a list of mav,wl,zc,ssc,mfcc,f1 (F2)\n"
+        "  --max N           most threads to try (one per core)\n"
+        "  --repeat N        runs per thread count, the best is kept (3)\n"
+        "  --dataset NAME    only trials of this dataset, repeatable\n");
+}
+
+int main(int argc, char** argv)
+{
+    nexus::FeatureSpec spec;
+    nexus::Filter filter;
+    std::string features = "F2", root;
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    int repeat = 3;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--features" && more) features = argv[++i];
+        else if (a == "--max" && more) max_threads = std::atoi(argv[++i]);
+        else if (a == "--repeat" && more) repeat = std::atoi(argv[++i]);
+        else if (a == "--dataset" && more) filter.datasets.push_back(argv[++i]);
+        else if (a[0] != '-' && root.empty()) root = a;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (root.empty() || max_threads < 1 || repeat < 1) {
+        usage();
+        return 2;
+    }
+
+    try {
+        spec.blocks = nexus::parse_feature_blocks(features);
+        nexus::Dataset ds(root);
+        std::vector<size_t> trials = ds.select(filter);
+        ds.prefetch(trials);
+
+        std::vector<unsigned> counts;
+        for (unsigned n = 1; n < max_threads; n *= 2) counts.push_back(n);
+        counts.push_back(max_threads);
+
+        std::printf("%zu trials, %s, %u cores\n", trials.size(), features.c_str(), std::thread::hardware_concurrency());
+        std::printf("threads   seconds  speedup  efficiency  tasks  stolen  output\n");
+        npy::Array reference;
+        double base = 0;
+        bool all_same = true;
+        for (unsigned n : counts) {
+            nexus::FeatureRunStats best;
+            nexus::FeatureMatrix m;
+            for (int r = 0; r < repeat; r++) {
+                nexus::FeatureRunStats stats;
+                m = nexus::extract_features(ds, trials, spec, n, &stats);
+                if (r == 0 || stats.seconds < best.seconds) best = stats;
+            }
+            uint64_t tasks = 0, steals = 0;
+            for (const auto& w : best.workers) {
+                tasks += w.tasks;
+                steals += w.steals;
+            }
+            if (n == 1) {
+                reference = m.x;
+                base = best.seconds;
+            }
+            bool same = m.x.data == reference.data;
+            all_same = all_same && same;
+            std::printf("%7u  %8.3f  %7.2f  %10.2f  %5llu  %6llu  %s\n", n, best.seconds, base / best.seconds,
+                        base / best.seconds / n, (unsigned long long)tasks, (unsigned long long)steals,
+                        same ? "same" : "DIFFERS");
+        }
+        return all_same ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
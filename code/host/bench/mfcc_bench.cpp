@@ -0,0 +1,96 @@
+// Per window compute time of the MFCC engine over recordings in datasets/, using
+// the F2 windows (400ms every 100ms at 250SPS). --out writes the coefficients of
+// the first file, (windows, n_mfcc * channels) in the order F2 flattens them, for
+// code/ml/mfcc_reference.py to check against librosa.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../tools/npy.hpp"
+
+extern "C" {
+#include "mfcc_interface.h"
+}
+
+static int64_t now_us()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv)
+{
+    mfcc_config_t config = {};
+    config.n_fft = 100;
+    config.n_mels = 15;
+    config.n_mfcc = 6;
+    config.sample_rate = 250;
+    config.top_db = 80;
+    config.pad = MFCC_PAD_CONSTANT;
+    config.now_us = now_us;
+    int stride = 25;
+    const char* out_path = nullptr;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--window" && i + 1 < argc) config.n_fft = std::atoi(argv[++i]);
+        else if (a == "--stride" && i + 1 < argc) stride = std::atoi(argv[++i]);
+        else if (a == "--fs" && i + 1 < argc) config.sample_rate = std::atof(argv[++i]);
+        else if (a == "--reflect") config.pad = MFCC_PAD_REFLECT;
+        else if (a == "--out" && i + 1 < argc) out_path = argv[++i];
+        else files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "usage: mfcc-bench [--window N] [--stride N] [--fs HZ] [--reflect] [--out mfcc.npy] <rec.npy>...\n");
+        return 2;
+    }
+
+    mfcc_stats_t total = {};
+    total.min_us = INT64_MAX;
+    size_t windows = 0;
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (size_t f = 0; f < files.size(); f++) {
+        npy::Array rec = npy::load(files[f]);
+        config.n_channels = rec.cols;
+        std::vector<float> x(rec.data.begin(), rec.data.end());
+
+        mfcc_handle_t* mfcc;
+        if (mfcc_init(&config, &mfcc) != MFCC_OK) {
+            std::fprintf(stderr, "%s: bad configuration for %zu channels\n", files[f], rec.cols);
+            return 1;
+        }
+
+        npy::Array out;
+        out.cols = (size_t)config.n_mfcc * rec.cols;
+        std::vector<float> coeffs(out.cols);
+        for (size_t start = 0; start + config.n_fft <= rec.rows; start += stride) {
+            mfcc_compute(mfcc, &x[start * rec.cols], coeffs.data());
+            out.data.insert(out.data.end(), coeffs.begin(), coeffs.end());
+            out.rows++;
+        }
+
+        mfcc_stats_t s;
+        mfcc_get_stats(mfcc, &s);
+        mfcc_deinit(mfcc);
+        total.count += s.count;
+        total.total_us += s.total_us;
+        if (s.count && s.min_us < total.min_us) total.min_us = s.min_us;
+        if (s.max_us > total.max_us) total.max_us = s.max_us;
+        windows += out.rows;
+
+        if (f == 0 && out_path) npy::save(out_path, out);
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::printf("%zu files, %zu windows of %u samples, %u mels, %u coefficients\n", files.size(), windows,
+                config.n_fft, config.n_mels, config.n_mfcc);
+    if (total.count)
+        std::printf("per window us min/mean/max: %lld/%.2f/%lld, %.0f windows/s including file loading\n",
+                    (long long)total.min_us, (double)total.total_us / total.count, (long long)total.max_us,
+                    windows / wall);
+    return 0;
+}
@@ -0,0 +1,431 @@
+// Stands in for one or more base boards on the network: frames samples with the
+// firmware's encoder, sized as stream_configure() sizes them, and sends them at the
+// data rate with sendmmsg. Samples are a replayed recording or synthetic tones and
+// noise. Frames can be dropped or swapped with the next one to exercise a receiver's
+// gap and reordering handling; what was sent is printed for comparison.
+//
+// Each board also has an esp_timer clock, off from the host's by --clock-offset and
+// running --clock-drift fast. Frames carry the DRDY time of their first sample on it,
+// and clock exchanges on the sync port are answered from it like sync_task() does.
+// The unix time of sample 0 is printed so the receiver's times can be checked.
+//
+// Every --telemetry seconds each board sends a telemetry frame with its counters and
+// the time its frames took to encode, counted in cycles of a nominal 240 MHz CPU.
+//
+// Frames follow the firmware's flush policy: they go out with --latency ms of samples,
+// or fewer when more would not fit a datagram of --mtu.
+//
+// Boards keep their last --window frames, dropped ones included, and resend those a
+// receiver NACKs, from the socket the frames come from. After the last frame they
+// keep answering NACKs for --linger seconds.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../tools/npy.hpp"
+
+extern "C" {
+#include "protocol_interface.h"
+}
+
+using clock_type = std::chrono::steady_clock;
+
+static const size_t FRAME_BUFFER_SIZE = 1472;  // As in main.c
+static const int UDP_IP_HEADERS = 28;
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-loadgen [options]\n"
+        "  --host IP         receiver address (127.0.0.1)\n"
+        "  --port N          receiver port (8080)\n"
+        "  --devices N       boards to simulate, ids 0x4e580001 up (1)\n"
+        "  --rate SPS        ADS1299 data rate, 250 to 16000 (16000)\n"
+        "  --channels N      channels per sample (8)\n"
+        "  --seconds S       streaming time (10)\n"
+        "  --gain CODE       ads1299_gain_t of every channel (6, x24)\n"
+        "  --rice            Rice code the frames like BASE_RICE_ENABLE\n"
+        "  --loss P          probability a frame is dropped (0)\n"
+        "  --reorder P       probability a frame is sent after the next one (0)\n"
+        "  --replay REC.npy  loop a recording in microvolts instead of synthetic samples\n"
+        "  --seed N          random seed (1)\n"
+        "  --clock-offset S  board clock reading when streaming starts (0)\n"
+        "  --clock-drift PPM how much faster the board clock runs (0)\n"
+        "  --sync-port N     port clock exchanges are answered on, 0 for none (8081)\n"
+        "  --telemetry S     seconds between telemetry frames, 0 for none (5)\n"
+        "  --latency MS      samples a frame holds, as FLUSH_MAX_LATENCY_MS (100)\n"
+        "  --mtu BYTES       path MTU the frames fit, as FLUSH_MTU (1500)\n"
+        "  --window N        frames kept for resending on a NACK, 0 for none (64)\n"
+        "  --linger S        seconds NACKs are still answered after the last frame (1)\n");
+}
+
+struct Board {
+    uint32_t id;
+    proto_encoder_t enc;
+    std::vector<uint8_t> buf, scratch;
+    uint16_t frame_samples;
+    uint64_t next = 0;       // Sample index of the next sample to generate
+    std::vector<uint8_t> held;  // Frame waiting to be sent after the next one
+    uint64_t frames = 0, dropped = 0, swapped = 0, samples = 0, bytes = 0;
+    proto_tlm_stats_t encode = {};
+    double next_telemetry = 0;
+    std::vector<uint8_t> window;  // Of the replay
+    proto_replay_t replay = {};
+    uint64_t nacks = 0, retransmits = 0, replay_misses = 0;
+};
+
+// Like the firmware's answer_nacks(), queues the frames NACKed so far for sending
+static void answer_nacks(int sock, std::vector<Board>& boards, std::vector<std::vector<uint8_t>>& out)
+{
+    uint8_t buf[PROTO_NACK_SIZE(PROTO_NACK_MAX_RANGES)];
+    ssize_t len;
+    while ((len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        proto_nack_t nack;
+        if (proto_decode_nack(buf, len, &nack) != PROTO_OK) continue;
+        auto b = std::find_if(boards.begin(), boards.end(), [&](const Board& b) { return b.id == nack.device_id; });
+        if (b == boards.end() || b->window.empty()) continue;
+        b->nacks++;
+        if (b->enc.header.seq == 0) continue;
+        uint32_t latest = b->enc.header.seq - 1;
+        const int64_t slots = b->replay.n_slots;
+        for (int r = 0; r < nack.n_ranges; r++) {
+            if (nack.ranges[r].count == 0) continue;
+            // Clamped to the window by age back from the latest frame, as the firmware does
+            int64_t oldest = (int32_t)(latest - nack.ranges[r].first_seq);
+            int64_t newest = std::max<int64_t>(oldest - (nack.ranges[r].count - 1), 0);
+            if (oldest < 0) continue;
+            oldest = std::min<int64_t>(oldest, latest);
+            if (oldest >= slots) {
+                b->replay_misses += oldest - std::max(newest, slots) + 1;
+                oldest = slots - 1;
+            }
+            for (int64_t age = oldest; age >= newest; age--) {
+                const uint8_t* frame;
+                size_t frame_len = proto_replay_get(&b->replay, latest - (uint32_t)age, &frame);
+                if (!frame_len) {
+                    b->replay_misses++;
+                    continue;
+                }
+                out.emplace_back(frame, frame + frame_len);
+                b->retransmits++;
+            }
+        }
+    }
+}
+
+static const uint8_t TELEMETRY_CPU_MHZ = 240;
+
+// As tlm_timer_add() does on the board
+static void add_duration(proto_tlm_stats_t& s, double seconds)
+{
+    uint32_t cycles = (uint32_t)std::min(seconds * TELEMETRY_CPU_MHZ * 1e6, 4e9);
+    if (!s.count || cycles < s.min_cycles) s.min_cycles = cycles;
+    s.max_cycles = std::max(s.max_cycles, cycles);
+    s.count++;
+    s.total_cycles += cycles;
+    uint32_t units = cycles >> PROTO_TLM_HIST_SHIFT;
+    int bin = units ? 32 - __builtin_clz(units) : 0;
+    s.hist[std::min(bin, PROTO_TLM_HIST_BINS - 1)]++;
+}
+
+// The simulated esp_timer, microseconds on the board at a host time since start
+struct BoardClock {
+    clock_type::time_point start;
+    double offset_us, rate;
+
+    int64_t at(double host_us) const { return std::llround(offset_us + rate * host_us); }
+    int64_t now() const { return at(std::chrono::duration<double, std::micro>(clock_type::now() - start).count()); }
+};
+
+// Answers clock exchanges like the firmware's sync_task()
+static void answer_sync(int sock, const BoardClock& clock, const std::atomic<bool>& stop, std::atomic<uint64_t>& answered)
+{
+    uint8_t buf[64];
+    while (!stop) {
+        sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(sock, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &from_len);
+        int64_t t2 = clock.now();
+        proto_sync_t sync;
+        if (len < 0 || proto_decode_sync(buf, len, &sync) != PROTO_OK || sync.type != PROTO_TYPE_SYNC_REQUEST)
+            continue;
+        sync.type = PROTO_TYPE_SYNC_REPLY;
+        sync.t2_us = t2;
+        sync.t3_us = clock.now();
+        size_t n = proto_encode_sync(buf, sizeof(buf), &sync);
+        sendto(sock, buf, n, 0, reinterpret_cast<sockaddr*>(&from), from_len);
+        answered++;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string host = "127.0.0.1", replay;
+    int port = 8080, n_devices = 1, rate = 16000, n_ch = 8, gain = 6;
+    double seconds = 10, loss = 0, reorder = 0, clock_offset = 0, clock_drift = 0, telemetry = 5;
+    int sync_port = 8081, window = 64, latency_ms = 100, mtu = 1500;
+    double linger = 1;
+    bool rice = false;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--host" && more) host = argv[++i];
+        else if (a == "--port" && more) port = std::atoi(argv[++i]);
+        else if (a == "--devices" && more) n_devices = std::atoi(argv[++i]);
+        else if (a == "--rate" && more) rate = std::atoi(argv[++i]);
+        else if (a == "--channels" && more) n_ch = std::atoi(argv[++i]);
+        else if (a == "--seconds" && more) seconds = std::atof(argv[++i]);
+        else if (a == "--gain" && more) gain = std::atoi(argv[++i]);
+        else if (a == "--rice") rice = true;
+        else if (a == "--loss" && more) loss = std::atof(argv[++i]);
+        else if (a == "--reorder" && more) reorder = std::atof(argv[++i]);
+        else if (a == "--replay" && more) replay = argv[++i];
+        else if (a == "--seed" && more) seed = std::atoi(argv[++i]);
+        else if (a == "--clock-offset" && more) clock_offset = std::atof(argv[++i]);
+        else if (a == "--clock-drift" && more) clock_drift = std::atof(argv[++i]);
+        else if (a == "--sync-port" && more) sync_port = std::atoi(argv[++i]);
+        else if (a == "--telemetry" && more) telemetry = std::atof(argv[++i]);
+        else if (a == "--window" && more) window = std::atoi(argv[++i]);
+        else if (a == "--linger" && more) linger = std::atof(argv[++i]);
+        else if (a == "--latency" && more) latency_ms = std::atoi(argv[++i]);
+        else if (a == "--mtu" && more) mtu = std::atoi(argv[++i]);
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    // ads1299_data_rate_t code of the rate
+    int data_rate = -1;
+    for (int code = 0; code <= PROTO_MAX_DATA_RATE; code++)
+        if ((int)proto_data_rate_sps(code) == rate) data_rate = code;
+    if (data_rate < 0 || n_ch < 1 || n_ch > PROTO_MAX_CHANNELS || n_devices < 1 || window < 0 ||
+        latency_ms < 1 || mtu - UDP_IP_HEADERS < (int)PROTO_HEADER_SIZE + 3 * n_ch ||
+        mtu - UDP_IP_HEADERS > (int)FRAME_BUFFER_SIZE) {
+        usage();
+        return 2;
+    }
+
+    // Samples as ADS1299 codes, one second of them looped unless replaying
+    double lsb_uv = proto_to_volts(1, gain) * 1e6;
+    size_t period;
+    std::vector<int32_t> codes;
+    std::mt19937 rng(seed);
+    try {
+        if (!replay.empty()) {
+            npy::Array rec = npy::load(replay);
+            n_ch = rec.cols;
+            period = rec.rows;
+            codes.resize(rec.data.size());
+            for (size_t i = 0; i < rec.data.size(); i++)
+                codes[i] = std::lrint(std::clamp(rec.data[i] / lsb_uv, -8388608.0, 8388607.0));
+        } else {
+            period = rate;
+            codes.resize(period * n_ch);
+            std::normal_distribution<double> noise(0, 5);
+            for (size_t s = 0; s < period; s++)
+                for (int c = 0; c < n_ch; c++)
+                    codes[s * n_ch + c] = std::lrint((100 * std::sin(2 * M_PI * (10 + c) * s / rate) + noise(rng)) / lsb_uv);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in dest = {};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(port);
+    if (sock < 0 || inet_pton(AF_INET, host.c_str(), &dest.sin_addr) != 1) {
+        std::fprintf(stderr, "Cannot send to %s\n", host.c_str());
+        return 1;
+    }
+    int sndbuf = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    std::vector<uint8_t> gains(n_ch, gain);
+    std::vector<Board> boards(n_devices);
+    for (int i = 0; i < n_devices; i++) {
+        Board& b = boards[i];
+        b.id = 0x4E580001 + i;
+        b.buf.resize(FRAME_BUFFER_SIZE);
+        b.scratch.resize(FRAME_BUFFER_SIZE);
+        proto_encoder_init(&b.enc, b.buf.data(), b.buf.size(), b.id, data_rate, n_ch, gains.data());
+        if (rice) proto_encoder_set_rice(&b.enc, b.scratch.data(), b.scratch.size());
+        uint16_t cap = proto_frame_capacity(mtu - UDP_IP_HEADERS, n_ch);
+        b.frame_samples = std::clamp<int>(rate * latency_ms / 1000, 1, cap);
+        b.next_telemetry = telemetry;
+        if (window > 0) {
+            b.window.resize((size_t)window * (FRAME_BUFFER_SIZE + 2));
+            proto_replay_init(&b.replay, b.window.data(), b.window.size(), FRAME_BUFFER_SIZE);
+        }
+    }
+
+    int sync_sock = -1;
+    if (sync_port > 0) {
+        sync_sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(sync_port);
+        timeval timeout = {0, 200000};   // To notice the end
+        if (sync_sock < 0 || bind(sync_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            std::fprintf(stderr, "Cannot bind sync port %d: %s\n", sync_port, std::strerror(errno));
+            return 1;
+        }
+        setsockopt(sync_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    std::bernoulli_distribution drop(loss), swap(reorder);
+    std::vector<std::vector<uint8_t>> out;   // Datagrams of this round
+    std::vector<iovec> iov;
+    std::vector<mmsghdr> msgs;
+    uint64_t calls = 0, datagrams = 0;
+    uint64_t total = (uint64_t)(seconds * rate);
+    timespec start_unix;
+    auto start = clock_type::now();
+    clock_gettime(CLOCK_REALTIME, &start_unix);
+    const BoardClock clock = {start, clock_offset * 1e6, 1 + clock_drift * 1e-6};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> answered{0};
+    std::thread responder;
+    if (sync_sock >= 0) responder = std::thread(answer_sync, sync_sock, std::cref(clock), std::cref(stop), std::ref(answered));
+
+    // Sends this round's datagrams, false on an error
+    auto send_out = [&]() {
+        iov.resize(out.size());
+        msgs.resize(out.size());
+        for (size_t i = 0; i < out.size(); i++) {
+            iov[i] = {out[i].data(), out[i].size()};
+            msgs[i].msg_hdr = {};
+            msgs[i].msg_hdr.msg_name = &dest;
+            msgs[i].msg_hdr.msg_namelen = sizeof(dest);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        for (size_t sent = 0; sent < out.size();) {
+            int n = sendmmsg(sock, msgs.data() + sent, out.size() - sent, 0);
+            if (n < 0) {
+                if (errno == ENOBUFS || errno == EAGAIN) continue;
+                std::perror("sendmmsg");
+                return false;
+            }
+            sent += n;
+            calls++;
+            datagrams += n;
+        }
+        return true;
+    };
+
+    for (bool done = false; !done;) {
+        // Every board has sampled up to now, emit the frames that are complete
+        double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+        uint64_t due = std::min<uint64_t>(elapsed * rate, total);
+        done = due >= total;
+        out.clear();
+        if (window > 0) answer_nacks(sock, boards, out);
+
+        for (Board& b : boards) {
+            while (b.next + b.frame_samples <= due || (done && b.next < total)) {
+                uint16_t n = std::min<uint64_t>(b.frame_samples, total - b.next);
+                auto encode_start = clock_type::now();
+                proto_encoder_begin(&b.enc, (uint32_t)b.next, clock.at(b.next * 1e6 / rate));
+                for (int s = 0; s < n; s++)
+                    proto_encoder_add(&b.enc, 0, &codes[((b.next + s) % period) * n_ch]);
+                size_t len = proto_encoder_finish(&b.enc);
+                add_duration(b.encode, std::chrono::duration<double>(clock_type::now() - encode_start).count());
+                b.next += n;
+                b.samples += n;
+                b.frames++;
+                if (!b.window.empty()) proto_replay_store(&b.replay, b.buf.data(), len);
+
+                std::vector<uint8_t> frame(b.buf.begin(), b.buf.begin() + len);
+                if (drop(rng)) {
+                    b.dropped++;
+                    continue;
+                }
+                b.bytes += len;
+                if (b.held.empty() && swap(rng)) {
+                    b.held = std::move(frame);
+                    b.swapped++;
+                    continue;
+                }
+                out.push_back(std::move(frame));
+                if (!b.held.empty()) out.push_back(std::move(b.held)), b.held.clear();
+            }
+            if (done && !b.held.empty()) out.push_back(std::move(b.held)), b.held.clear();
+
+            if (telemetry > 0 && (elapsed >= b.next_telemetry || done)) {
+                b.next_telemetry += telemetry;
+                proto_telemetry_t t = {};
+                t.drdy_count = t.sample_count = (uint32_t)b.next;
+                t.ring_capacity = 512;
+                t.cpu_mhz = TELEMETRY_CPU_MHZ;
+                t.frames_sent = (uint32_t)(b.frames - b.dropped);
+                t.samples_sent = (uint32_t)b.samples;
+                t.sent_bytes = (uint32_t)b.bytes;
+                t.retransmits = (uint32_t)b.retransmits;
+                t.replay_misses = (uint32_t)b.replay_misses;
+                t.timers[PROTO_TLM_ENCODE] = b.encode;
+                std::vector<uint8_t> frame(PROTO_TELEMETRY_SIZE(PROTO_MAX_CHANNELS));
+                uint64_t last = b.next ? b.next - 1 : 0;
+                frame.resize(proto_encode_telemetry(&b.enc, frame.data(), frame.size(), (uint32_t)last,
+                                                    clock.at(last * 1e6 / rate), &t));
+                if (!b.window.empty()) proto_replay_store(&b.replay, frame.data(), frame.size());
+                out.push_back(std::move(frame));
+            }
+        }
+
+        if (!send_out()) return 1;
+        if (!done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    // The receiver may still be asking for the last frames
+    if (window > 0) {
+        for (auto end = clock_type::now() + std::chrono::duration<double>(linger); clock_type::now() < end;) {
+            out.clear();
+            answer_nacks(sock, boards, out);
+            if (!send_out()) return 1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    stop = true;
+    if (responder.joinable()) responder.join();
+
+    std::printf("%d devices, %d SPS x %d channels, %.1f s, %.1f datagrams per sendmmsg\n",
+                n_devices, rate, n_ch, elapsed, calls ? (double)datagrams / calls : 0.0);
+    for (const Board& b : boards)
+        std::printf("%08x: %llu samples in %llu frames of %u, %llu dropped, %llu sent late\n", b.id,
+                    (unsigned long long)b.samples, (unsigned long long)b.frames, b.frame_samples,
+                    (unsigned long long)b.dropped, (unsigned long long)b.swapped);
+    for (const Board& b : boards)
+        if (b.nacks)
+            std::printf("%08x: %llu NACKs answered with %llu frames, %llu asked for too late\n", b.id,
+                        (unsigned long long)b.nacks, (unsigned long long)b.retransmits,
+                        (unsigned long long)b.replay_misses);
+    std::printf("sample 0 at unix time %lld.%06ld, board clocks %+.3f s off and %+.1f ppm fast, "
+                "%llu clock exchanges answered\n", (long long)start_unix.tv_sec, start_unix.tv_nsec / 1000,
+                clock_offset, clock_drift, (unsigned long long)answered.load());
+    if (sync_sock >= 0) close(sync_sock);
+    close(sock);
+    return 0;
+}
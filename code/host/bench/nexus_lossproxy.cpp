@@ -0,0 +1,223 @@
+// A UDP relay that loses datagrams on purpose, to put the NACK path between boards
+// (or nexus-loadgen) and nexus-ingest under test on one machine. Datagrams arriving
+// on --listen are forwarded to --to from one socket per sender, so the receiver sees
+// each board at its own address and whatever it sends there, NACKs included, is
+// relayed back to that board.
+//
+// Loss towards the receiver follows a two state Gilbert model: --loss of the
+// datagrams are dropped in bursts --burst datagrams long on average, 1 for
+// independent losses. Datagrams relayed back are dropped independently with
+// --back-loss. Both directions can be held up by --delay milliseconds.
+// Runs until interrupted, then prints what it forwarded and dropped.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using clock_type = std::chrono::steady_clock;
+
+static const size_t MAX_DATAGRAM = 65536;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) { stop_requested = 1; }
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-lossproxy [options]\n"
+        "  --listen N        port the boards send to (8090)\n"
+        "  --to IP:PORT      receiver the datagrams are forwarded to (127.0.0.1:8080)\n"
+        "  --loss P          fraction of datagrams to the receiver dropped (0.01)\n"
+        "  --burst L         mean length of a run of drops, 1 for independent drops (1)\n"
+        "  --back-loss P     probability a datagram back to a board is dropped (0)\n"
+        "  --delay MS        time datagrams are held in both directions (0)\n"
+        "  --seed N          random seed (1)\n");
+}
+
+struct Key {
+    uint32_t ip;
+    uint16_t port;
+    bool operator<(const Key& o) const { return std::tie(ip, port) < std::tie(o.ip, o.port); }
+};
+
+// A board and the socket its datagrams are forwarded from
+struct Client {
+    sockaddr_in addr;
+    int sock;
+    bool bad = false;  // Gilbert state, dropping while in it
+    uint64_t forwarded = 0, dropped = 0, back = 0, back_dropped = 0;
+};
+
+struct Delayed {
+    clock_type::time_point due;
+    int sock;
+    sockaddr_in to;
+    std::vector<uint8_t> data;
+};
+
+int main(int argc, char** argv)
+{
+    int listen_port = 8090;
+    std::string to = "127.0.0.1:8080";
+    double loss = 0.01, burst = 1, back_loss = 0, delay_ms = 0;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--listen" && more) listen_port = std::atoi(argv[++i]);
+        else if (a == "--to" && more) to = argv[++i];
+        else if (a == "--loss" && more) loss = std::atof(argv[++i]);
+        else if (a == "--burst" && more) burst = std::atof(argv[++i]);
+        else if (a == "--back-loss" && more) back_loss = std::atof(argv[++i]);
+        else if (a == "--delay" && more) delay_ms = std::atof(argv[++i]);
+        else if (a == "--seed" && more) seed = std::atoi(argv[++i]);
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (loss < 0 || loss >= 1 || burst < 1 || back_loss < 0 || back_loss > 1 || delay_ms < 0) {
+        usage();
+        return 2;
+    }
+
+    sockaddr_in dest = {};
+    dest.sin_family = AF_INET;
+    size_t colon = to.rfind(':');
+    if (colon == std::string::npos || inet_pton(AF_INET, to.substr(0, colon).c_str(), &dest.sin_addr) != 1) {
+        std::fprintf(stderr, "Cannot forward to %s\n", to.c_str());
+        return 1;
+    }
+    dest.sin_port = htons(std::atoi(to.c_str() + colon + 1));
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(listen_port);
+    if (sock < 0 || bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::fprintf(stderr, "Cannot bind port %d: %s\n", listen_port, std::strerror(errno));
+        return 1;
+    }
+    int rcvbuf = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    // Good to bad with a probability that makes the bad state's share of datagrams loss,
+    // bad to good after burst datagrams on average
+    std::mt19937 rng(seed);
+    std::bernoulli_distribution enter_bad(loss / (burst * (1 - loss))), leave_bad(1 / burst), drop_back(back_loss);
+    const auto delay = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double, std::milli>(delay_ms));
+
+    std::map<Key, Client> clients;
+    std::deque<Delayed> queue;  // Same delay for all, so in order of due
+    std::vector<uint8_t> buf(MAX_DATAGRAM);
+    std::vector<pollfd> fds;
+    std::vector<Client*> by_fd;
+
+    auto forward = [&](int from_sock, const sockaddr_in& to_addr, const uint8_t* data, size_t len) {
+        if (delay_ms > 0) {
+            queue.push_back({clock_type::now() + delay, from_sock, to_addr, std::vector<uint8_t>(data, data + len)});
+            return;
+        }
+        sendto(from_sock, data, len, 0, reinterpret_cast<const sockaddr*>(&to_addr), sizeof(to_addr));
+    };
+
+    while (!stop_requested) {
+        fds.assign(1, {sock, POLLIN, 0});
+        by_fd.assign(1, nullptr);
+        for (auto& [key, c] : clients) {
+            fds.push_back({c.sock, POLLIN, 0});
+            by_fd.push_back(&c);
+        }
+        int timeout_ms = 200;  // To notice signals
+        if (!queue.empty()) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(queue.front().due - clock_type::now()).count();
+            timeout_ms = std::max<int>(0, std::min<long long>(timeout_ms, wait));
+        }
+        if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR) {
+            std::perror("poll");
+            return 1;
+        }
+
+        // Towards the receiver
+        if (fds[0].revents & POLLIN) {
+            sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t len;
+            while ((len = recvfrom(sock, buf.data(), buf.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from),
+                                   &from_len)) >= 0) {
+                Key key = {from.sin_addr.s_addr, from.sin_port};
+                auto it = clients.find(key);
+                if (it == clients.end()) {
+                    int up = socket(AF_INET, SOCK_DGRAM, 0);
+                    if (up < 0) {
+                        std::perror("socket");
+                        return 1;
+                    }
+                    it = clients.emplace(key, Client{from, up}).first;
+                    std::fprintf(stderr, "New board at %s:%d\n", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+                }
+                Client& c = it->second;
+                c.bad = c.bad ? !leave_bad(rng) : enter_bad(rng);
+                if (c.bad) {
+                    c.dropped++;
+                } else {
+                    c.forwarded++;
+                    forward(c.sock, dest, buf.data(), len);
+                }
+                from_len = sizeof(from);
+            }
+        }
+
+        // Back to the boards
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (!(fds[i].revents & POLLIN)) continue;
+            Client& c = *by_fd[i];
+            ssize_t len;
+            while ((len = recv(c.sock, buf.data(), buf.size(), MSG_DONTWAIT)) >= 0) {
+                if (drop_back(rng)) {
+                    c.back_dropped++;
+                    continue;
+                }
+                c.back++;
+                forward(sock, c.addr, buf.data(), len);
+            }
+        }
+
+        for (auto now = clock_type::now(); !queue.empty() && queue.front().due <= now; queue.pop_front()) {
+            const Delayed& d = queue.front();
+            sendto(d.sock, d.data.data(), d.data.size(), 0, reinterpret_cast<const sockaddr*>(&d.to), sizeof(d.to));
+        }
+    }
+
+    for (auto& [key, c] : clients) {
+        uint64_t n = c.forwarded + c.dropped;
+        std::printf("%s:%d: %llu forwarded, %llu dropped (%.2f%%), %llu relayed back, %llu dropped\n",
+                    inet_ntoa(c.addr.sin_addr), ntohs(c.addr.sin_port), (unsigned long long)c.forwarded,
+                    (unsigned long long)c.dropped, n ? 100.0 * c.dropped / n : 0.0, (unsigned long long)c.back,
+                    (unsigned long long)c.back_dropped);
+        close(c.sock);
+    }
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,171 @@
+// Compression ratio and encode cost of the Rice coded frames (PROTO_FLAG_RICE) on
+// recordings in datasets/. Samples are converted back to ADS1299 codes, optionally
+// filtered the way the board does before streaming, then framed and coded exactly
+// as the firmware's encoder does and decoded again to check the round trip. Frames
+// of full scale noise show the worst case, which falls back to raw samples.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#include "../tools/npy.hpp"
+
+extern "C" {
+#include "iir_interface.h"
+#include "protocol_interface.h"
+}
+
+using clock_type = std::chrono::steady_clock;
+
+static uint64_t cycles()
+{
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Totals {
+    uint64_t frames = 0, coded_frames = 0, samples = 0;
+    uint64_t raw_bytes = 0, sent_bytes = 0, raw_payload = 0, sent_payload = 0;
+    double encode_s = 0, decode_s = 0;
+    std::vector<double> frame_us;
+    uint64_t encode_cycles = 0;
+    bool mismatch = false;
+};
+
+// Frames codes[rows][n_ch] like the firmware and accumulates sizes and timings
+static void run(const std::vector<int32_t>& codes, size_t rows, uint8_t n_ch, uint16_t frame_samples, Totals& t)
+{
+    std::vector<uint8_t> buf(proto_frame_size(n_ch, frame_samples)), scratch(buf.size());
+    std::vector<uint8_t> gain(n_ch, 6);
+    std::vector<int32_t> decoded((size_t)frame_samples * n_ch);
+    proto_encoder_t enc;
+    proto_encoder_init(&enc, buf.data(), buf.size(), 1, 6, n_ch, gain.data());
+    proto_encoder_set_rice(&enc, scratch.data(), scratch.size());
+
+    for (size_t start = 0; start < rows; start += frame_samples) {
+        uint16_t n = std::min<size_t>(frame_samples, rows - start);
+        proto_encoder_begin(&enc, start, 0);
+        for (int s = 0; s < n; s++)
+            proto_encoder_add(&enc, 0, &codes[(start + s) * n_ch]);
+
+        // The Rice stage is all of finish() that matters
+        auto t0 = clock_type::now();
+        uint64_t c0 = cycles();
+        size_t len = proto_encoder_finish(&enc);
+        uint64_t c1 = cycles();
+        double us = std::chrono::duration<double, std::micro>(clock_type::now() - t0).count();
+
+        proto_header_t h;
+        t0 = clock_type::now();
+        bool ok = proto_decode_header(buf.data(), len, &h) == PROTO_OK &&
+                  proto_decode_samples(buf.data(), len, &h, decoded.data()) == PROTO_OK;
+        t.decode_s += std::chrono::duration<double>(clock_type::now() - t0).count();
+        if (!ok || !std::equal(decoded.begin(), decoded.begin() + (size_t)n * n_ch, codes.begin() + start * n_ch))
+            t.mismatch = true;
+
+        size_t raw = proto_frame_size(n_ch, n), header = proto_frame_size(n_ch, 0);
+        t.frames++;
+        t.coded_frames += (h.flags & PROTO_FLAG_RICE) != 0;
+        t.samples += n;
+        t.raw_bytes += raw;
+        t.sent_bytes += len;
+        t.raw_payload += raw - header;
+        t.sent_payload += len - header;
+        t.encode_s += us * 1e-6;
+        t.encode_cycles += c1 - c0;
+        t.frame_us.push_back(us);
+    }
+}
+
+static void report(const char* name, Totals& t)
+{
+    // The host is not real time, the 99.9th percentile is the meaningful worst case
+    std::sort(t.frame_us.begin(), t.frame_us.end());
+    double p999 = t.frame_us.empty() ? 0 : t.frame_us[t.frame_us.size() * 999 / 1000];
+    double worst = t.frame_us.empty() ? 0 : t.frame_us.back();
+
+    std::printf("%s: %llu frames, %.1f%% Rice coded, ratio %.2f on samples, %.2f on datagrams\n", name,
+                (unsigned long long)t.frames, 100.0 * t.coded_frames / std::max<uint64_t>(t.frames, 1),
+                (double)t.raw_payload / std::max<uint64_t>(t.sent_payload, 1),
+                (double)t.raw_bytes / std::max<uint64_t>(t.sent_bytes, 1));
+    std::printf("%s: encode %.1f ns/sample", name, t.encode_s * 1e9 / std::max<uint64_t>(t.samples, 1));
+#ifdef HAVE_RDTSC
+    std::printf(" (%.0f TSC cycles)", (double)t.encode_cycles / std::max<uint64_t>(t.samples, 1));
+#endif
+    std::printf(", frame p99.9 %.1f us (max %.1f), decode %.1f ns/sample%s\n", p999, worst,
+                t.decode_s * 1e9 / std::max<uint64_t>(t.samples, 1), t.mismatch ? ", ROUND TRIP MISMATCH" : "");
+}
+
+int main(int argc, char** argv)
+{
+    int frame_samples = 25, gain = 6;
+    bool filter = false;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--frame" && i + 1 < argc) frame_samples = std::atoi(argv[++i]);
+        else if (a == "--gain" && i + 1 < argc) gain = std::atoi(argv[++i]);
+        else if (a == "--filter") filter = true;
+        else files.push_back(argv[i]);
+    }
+    if (files.empty() || frame_samples < 1) {
+        std::fprintf(stderr, "usage: rice-bench [--frame N] [--gain CODE] [--filter] <rec.npy>...\n");
+        return 2;
+    }
+
+    Totals data, noise;
+    double lsb_uv = proto_to_volts(1, gain) * 1e6;
+    std::mt19937 rng(1);
+
+    for (const char* path : files) {
+        npy::Array rec = npy::load(path);
+        uint8_t n_ch = rec.cols;
+
+        // Recordings are in microvolts, back to the codes the ADS1299 produced
+        std::vector<int32_t> codes(rec.data.size());
+        for (size_t i = 0; i < rec.data.size(); i++)
+            codes[i] = std::lrint(std::clamp(rec.data[i] / lsb_uv, -8388608.0, 8388607.0));
+
+        if (filter) {
+            // filter_sample() in main.c
+            iir_config_t config = {};
+            config.n_channels = n_ch;
+            iir_butter(&config, 4, IIR_HIGHPASS, 0.5, 0, 250);
+            iir_butter(&config, 4, IIR_BANDSTOP, 48, 52, 250);
+            iir_handle_t* iir;
+            iir_init(&config, &iir);
+            std::vector<iir_float_t> x(n_ch);
+            for (size_t r = 0; r < rec.rows; r++) {
+                for (int c = 0; c < n_ch; c++) x[c] = codes[r * n_ch + c];
+                iir_process(iir, x.data(), x.data(), 1);
+                for (int c = 0; c < n_ch; c++)
+                    codes[r * n_ch + c] = std::clamp<long>(std::lrint(x[c]), -0x800000, 0x7FFFFF);
+            }
+            iir_deinit(iir);
+        }
+        run(codes, rec.rows, n_ch, frame_samples, data);
+
+        // Same amount of full scale noise, nothing to predict
+        std::uniform_int_distribution<int32_t> full_scale(-0x800000, 0x7FFFFF);
+        for (int32_t& c : codes) c = full_scale(rng);
+        run(codes, rec.rows, n_ch, frame_samples, noise);
+    }
+
+    std::printf("%zu files, %d samples per frame%s\n", files.size(), frame_samples, filter ? ", filtered" : "");
+    report("recordings", data);
+    report("noise", noise);
+    return data.mismatch || noise.mismatch ? 1 : 0;
+}
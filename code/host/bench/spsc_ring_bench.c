@@ -0,0 +1,88 @@
+// Throughput of the SPSC ring with the producer and consumer on separate
+// threads, for a range of capacities. Elements are the size of an
+// ads1299_sample_t so the numbers carry over to the firmware.
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spsc_ring_interface.h"
+
+#define ELEM_SIZE 48
+#define ELEMENTS (5 * 1000 * 1000)
+
+typedef struct {
+    spsc_ring_handle_t* ring;
+    unsigned long long checksum;
+} bench_ctx_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void* producer(void* arg)
+{
+    bench_ctx_t* ctx = (bench_ctx_t*)arg;
+    uint8_t elem[ELEM_SIZE] = {0};
+
+    for (uint32_t i = 0; i < ELEMENTS; i++) {
+        memcpy(elem, &i, sizeof(i));
+        while (!spsc_ring_push(ctx->ring, elem))
+            sched_yield(); // Full, let the consumer drain
+    }
+    return NULL;
+}
+
+static void* consumer(void* arg)
+{
+    bench_ctx_t* ctx = (bench_ctx_t*)arg;
+    uint8_t elem[ELEM_SIZE];
+
+    for (uint32_t i = 0; i < ELEMENTS; ) {
+        if (!spsc_ring_pop(ctx->ring, elem)) {
+            sched_yield();
+            continue;
+        }
+        uint32_t v;
+        memcpy(&v, elem, sizeof(v));
+        ctx->checksum += v;
+        i++;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    const uint32_t capacities[] = {16, 64, 256, 1024, 4096, 65536};
+    const unsigned long long expected = (unsigned long long)ELEMENTS * (ELEMENTS - 1) / 2;
+
+    printf("%10s %12s %12s %12s %10s\n", "capacity", "Melem/s", "ns/elem", "overflows", "checksum");
+    for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+        spsc_ring_config_t config = {.elem_size = ELEM_SIZE, .capacity = capacities[c]};
+        bench_ctx_t ctx = {0};
+        if (spsc_ring_init(&config, &ctx.ring) != SPSC_RING_OK) {
+            fprintf(stderr, "Failed to create ring\n");
+            return 1;
+        }
+
+        pthread_t prod, cons;
+        double start = now_s();
+        pthread_create(&cons, NULL, consumer, &ctx);
+        pthread_create(&prod, NULL, producer, &ctx);
+        pthread_join(prod, NULL);
+        pthread_join(cons, NULL);
+        double elapsed = now_s() - start;
+
+        spsc_ring_stats_t stats;
+        spsc_ring_get_stats(ctx.ring, &stats);
+        printf("%10u %12.2f %12.2f %12u %10s\n", capacities[c], ELEMENTS / elapsed / 1e6,
+               elapsed * 1e9 / ELEMENTS, stats.overflows, ctx.checksum == expected ? "ok" : "BAD");
+        spsc_ring_deinit(ctx.ring);
+    }
+    return 0;
+}
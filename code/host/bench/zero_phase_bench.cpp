@@ -0,0 +1,183 @@
+// Latency against accuracy of the streamed zero phase filter (nexus-filtfilt): every
+// selected trial is streamed through ZeroPhaseFilter at a range of look-aheads and
+// compared with the exact sosfiltfilt of the whole trial. Prints the latency, the
+// worst and mean error relative to each trial's output, and the throughput in
+// samples (of every channel) per second, with the offline filter's throughput first.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../tools/dataset.hpp"
+#include "../tools/zero_phase.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: zero-phase-bench [options] <datasets root | dataset dir>\n"
+        "  --dataset NAME      only trials of this dataset, repeatable (all)\n"
+        "  --fs HZ             sample rate (250)\n"
+        "  --pad TYPE          sosfiltfilt padtype: constant, even, odd or none (constant)\n"
+        "  --block N           samples per output block (25)\n"
+        "  --lookahead N,N...  look-aheads to try (0,25,50,100,250,500,1000,2000)\n"
+        "  --accuracy X,X...   also the look-aheads lookahead_for() gives (1e-2,1e-3,1e-4)\n"
+        "  --repeat N          timed runs per setting, the best is kept (3)\n");
+}
+
+static std::vector<double> split_numbers(const std::string& list)
+{
+    std::vector<double> v;
+    std::stringstream ss(list);
+    for (std::string f; std::getline(ss, f, ',');) v.push_back(std::atof(f.c_str()));
+    return v;
+}
+
+struct Recording {
+    std::vector<double> x, exact;
+    size_t rows = 0;
+    double rms = 0;
+};
+
+int main(int argc, char** argv)
+{
+    nexus::Filter filter;
+    nexus::ZeroPhaseConfig config;
+    double fs = 250;
+    int repeat = 3;
+    std::string pad = "constant", root;
+    std::vector<double> lookaheads = split_numbers("0,25,50,100,250,500,1000,2000");
+    std::vector<double> accuracies = split_numbers("1e-2,1e-3,1e-4");
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--dataset" && more) filter.datasets.push_back(argv[++i]);
+        else if (a == "--fs" && more) fs = std::atof(argv[++i]);
+        else if (a == "--pad" && more) pad = argv[++i];
+        else if (a == "--block" && more) config.block = std::atoi(argv[++i]);
+        else if (a == "--lookahead" && more) lookaheads = split_numbers(argv[++i]);
+        else if (a == "--accuracy" && more) accuracies = split_numbers(argv[++i]);
+        else if (a == "--repeat" && more) repeat = std::atoi(argv[++i]);
+        else if (a[0] != '-' && root.empty()) root = a;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (root.empty() || config.block == 0 || repeat < 1) {
+        usage();
+        return 2;
+    }
+
+    try {
+        config.pad = nexus::parse_pad_type(pad);
+        // The notebooks' preprocessing, high-pass then notch as separate sosfiltfilt calls
+        nexus::ZeroPhaseStage highpass, notch;
+        if (iir_butter(&highpass.sos, 4, IIR_HIGHPASS, 0.5, 0, fs) != IIR_OK ||
+            iir_butter(&notch.sos, 4, IIR_BANDSTOP, 48, 52, fs) != IIR_OK)
+            throw std::runtime_error("bad filter design");
+        config.stages = {highpass, notch};
+
+        nexus::Dataset ds(root);
+        std::vector<size_t> trials = ds.select(filter);
+        ds.prefetch(trials);
+        std::vector<Recording> recs;
+        size_t total = 0;
+        const size_t n_ch = 8;
+        for (size_t t : trials) {
+            nexus::View v = ds.view(t);
+            if (!v.f8() || v.cols != n_ch || v.rows <= nexus::default_padlen(notch.sos)) continue;
+            Recording r;
+            r.rows = v.rows;
+            r.x.resize(v.rows * n_ch);
+            for (size_t i = 0; i < v.rows; i++)
+                for (size_t c = 0; c < n_ch; c++) r.x[i * n_ch + c] = v.f8()[v.index(i, c)];
+            recs.push_back(std::move(r));
+            total += v.rows;
+        }
+        if (recs.empty()) throw std::runtime_error("no 8 channel f8 trials selected");
+
+        // Offline, the reference for every setting
+        double best = 0;
+        for (int k = 0; k < repeat; k++) {
+            auto start = clock_type::now();
+            for (Recording& r : recs) {
+                r.exact = r.x;
+                for (const nexus::ZeroPhaseStage& s : config.stages)
+                    nexus::sosfiltfilt(s.sos, config.pad, r.exact.data(), r.rows, n_ch);
+            }
+            double s = std::chrono::duration<double>(clock_type::now() - start).count();
+            if (k == 0 || s < best) best = s;
+        }
+        for (Recording& r : recs) {
+            double sum = 0;
+            for (double v : r.exact) sum += v * v;
+            r.rms = std::sqrt(sum / r.exact.size());
+        }
+        std::printf("%zu trials, %zu samples x %zu channels, padtype %s, blocks of %zu\n", recs.size(), total, n_ch,
+                    pad.c_str(), config.block);
+        std::printf("offline sosfiltfilt: %.1f Msamples/s (%.0fx real time at %.0f Hz)\n\n",
+                    total * n_ch / best / 1e6, total / best / fs, fs);
+
+        struct Setting {
+            std::string name;
+            std::vector<size_t> lookahead;   // Per stage
+        };
+        std::vector<Setting> settings;
+        char name[64];
+        for (double l : lookaheads) {
+            std::snprintf(name, sizeof(name), "%.0f", l);
+            settings.push_back({name, {(size_t)l, (size_t)l}});
+        }
+        for (double a : accuracies) {
+            std::snprintf(name, sizeof(name), "tol %g", a);
+            settings.push_back({name, {nexus::lookahead_for(highpass.sos, a), nexus::lookahead_for(notch.sos, a)}});
+        }
+
+        std::printf("look-ahead        stages  latency ms  max err  mean rms err  Msamples/s  real time\n");
+        std::vector<double> out;
+        for (const Setting& set : settings) {
+            for (size_t s = 0; s < config.stages.size(); s++) config.stages[s].lookahead = set.lookahead[s];
+            nexus::ZeroPhaseFilter zp(config, n_ch);
+            double seconds = 0, worst = 0, rms_sum = 0;
+            for (int k = 0; k < repeat; k++) {
+                double t = 0;
+                for (Recording& r : recs) {
+                    out.clear();
+                    auto start = clock_type::now();
+                    for (size_t i = 0; i < r.rows; i += config.block)
+                        zp.push(&r.x[i * n_ch], std::min(config.block, r.rows - i), out);
+                    zp.flush(out);
+                    t += std::chrono::duration<double>(clock_type::now() - start).count();
+                    if (k) continue;
+                    if (out.size() != r.exact.size()) throw std::runtime_error("stream lost samples");
+                    double max_diff = 0, full_scale = 0, sum = 0;
+                    for (size_t i = 0; i < out.size(); i++) {
+                        double d = out[i] - r.exact[i];
+                        max_diff = std::fmax(max_diff, std::fabs(d));
+                        full_scale = std::fmax(full_scale, std::fabs(r.exact[i]));
+                        sum += d * d;
+                    }
+                    if (full_scale > 0) worst = std::fmax(worst, max_diff / full_scale);
+                    if (r.rms > 0) rms_sum += std::sqrt(sum / out.size()) / r.rms;
+                }
+                if (k == 0 || t < seconds) seconds = t;
+            }
+            char stages[32];
+            std::snprintf(stages, sizeof(stages), "%zu+%zu", set.lookahead[0], set.lookahead[1]);
+            std::printf("%-12s %11s  %10.0f  %7.2g  %12.2g  %10.1f  %8.0fx\n", set.name.c_str(), stages,
+                        zp.latency() * 1e3 / fs, worst, rms_sum / recs.size(), total * n_ch / seconds / 1e6,
+                        total / seconds / fs);
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,296 @@
+// Python bindings of the dataset index (tools/dataset.hpp), on the CPython API alone.
+// Views are exported through the buffer protocol, so numpy.asarray(ds.view(i)) is the
+// memory mapped file itself, no copy:
+//
+//   import numpy as np, nexus_dataset
+//   ds = nexus_dataset.Dataset('../../datasets')
+//   trials = ds.select(dataset='star-array-50x3', session=[0, 1])
+//   ds.prefetch(trials)
+//   x = [np.asarray(ds.view(i)) for i in trials]
+//   y = [ds.info(i)['cls'] for i in trials]
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdexcept>
+
+#include "dataset.hpp"
+
+struct DatasetObject {
+    PyObject_HEAD
+    nexus::Dataset* ds;
+};
+
+// Exporter of one view, keeps the Dataset and with it the mapping alive
+struct ViewObject {
+    PyObject_HEAD
+    PyObject* owner;
+    nexus::View view;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+static const char* format_of(nexus::Dtype dtype)
+{
+    // Native codes, memoryview indexes no others and the files are little endian like the hosts
+    return dtype == nexus::Dtype::F8 ? "d" : (dtype == nexus::Dtype::F4 ? "f" : "i");
+}
+
+static int view_getbuffer(PyObject* obj, Py_buffer* buf, int flags)
+{
+    ViewObject* self = reinterpret_cast<ViewObject*>(obj);
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "dataset views are read only");
+        return -1;
+    }
+    if (self->view.fortran && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+        PyErr_SetString(PyExc_BufferError, "column major view needs strides");
+        return -1;
+    }
+    Py_ssize_t item = nexus::dtype_size(self->view.dtype);
+    buf->buf = const_cast<void*>(self->view.data);
+    buf->obj = obj;
+    Py_INCREF(obj);
+    buf->len = self->shape[0] * self->shape[1] * item;
+    buf->readonly = 1;
+    buf->itemsize = item;
+    buf->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(format_of(self->view.dtype)) : nullptr;
+    buf->ndim = 2;
+    buf->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : nullptr;
+    buf->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    buf->suboffsets = nullptr;
+    buf->internal = nullptr;
+    return 0;
+}
+
+static void view_dealloc(PyObject* obj)
+{
+    PyTypeObject* type = Py_TYPE(obj);
+    Py_XDECREF(reinterpret_cast<ViewObject*>(obj)->owner);
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+static PyTypeObject* view_type;
+
+// Accepts None, one value or an iterable of them
+template <typename T, typename Convert>
+static bool to_list(PyObject* arg, std::vector<T>& out, Convert convert)
+{
+    if (!arg || arg == Py_None) return true;
+    if (PyUnicode_Check(arg) || PyLong_Check(arg)) {
+        out.push_back(convert(arg));
+        return !PyErr_Occurred();
+    }
+    PyObject* it = PyObject_GetIter(arg);
+    if (!it) return false;
+    for (PyObject* item; (item = PyIter_Next(it));) {
+        out.push_back(convert(item));
+        Py_DECREF(item);
+        if (PyErr_Occurred()) break;
+    }
+    Py_DECREF(it);
+    return !PyErr_Occurred();
+}
+
+static std::string as_string(PyObject* o)
+{
+    const char* s = PyUnicode_AsUTF8(o);
+    return s ? s : "";
+}
+
+static int as_int(PyObject* o)
+{
+    return (int)PyLong_AsLong(o);
+}
+
+static bool check_index(DatasetObject* self, Py_ssize_t i)
+{
+    if (i < 0 || (size_t)i >= self->ds->trials().size()) {
+        PyErr_SetString(PyExc_IndexError, "trial index out of range");
+        return false;
+    }
+    return true;
+}
+
+static int dataset_init(PyObject* obj, PyObject* args, PyObject* kwargs)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    static const char* keywords[] = {"root", nullptr};
+    const char* root;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s", const_cast<char**>(keywords), &root)) return -1;
+    try {
+        nexus::Dataset* ds;
+        Py_BEGIN_ALLOW_THREADS
+        ds = new nexus::Dataset(root);
+        Py_END_ALLOW_THREADS
+        delete self->ds;
+        self->ds = ds;
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+        return -1;
+    }
+    return 0;
+}
+
+static void dataset_dealloc(PyObject* obj)
+{
+    PyTypeObject* type = Py_TYPE(obj);
+    delete reinterpret_cast<DatasetObject*>(obj)->ds;
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+static Py_ssize_t dataset_len(PyObject* obj)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    return self->ds ? self->ds->trials().size() : 0;
+}
+
+static PyObject* dataset_select(PyObject* obj, PyObject* args, PyObject* kwargs)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    static const char* keywords[] = {"dataset", "cls", "speaker", "session", nullptr};
+    PyObject *dataset = nullptr, *cls = nullptr, *speaker = nullptr, *session = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOOO", const_cast<char**>(keywords),
+                                     &dataset, &cls, &speaker, &session))
+        return nullptr;
+
+    nexus::Filter filter;
+    if (!to_list(dataset, filter.datasets, as_string) || !to_list(cls, filter.classes, as_string) ||
+        !to_list(speaker, filter.speakers, as_string) || !to_list(session, filter.sessions, as_int))
+        return nullptr;
+
+    std::vector<size_t> indices = self->ds->select(filter);
+    PyObject* list = PyList_New(indices.size());
+    for (size_t i = 0; list && i < indices.size(); i++)
+        PyList_SET_ITEM(list, i, PyLong_FromSize_t(indices[i]));
+    return list;
+}
+
+static PyObject* dataset_info(PyObject* obj, PyObject* arg)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    Py_ssize_t i = PyLong_AsSsize_t(arg);
+    if (PyErr_Occurred() || !check_index(self, i)) return nullptr;
+    const nexus::Trial& t = self->ds->trials()[i];
+    return Py_BuildValue("{s:s,s:s,s:s,s:i,s:K,s:s,s:(nn),s:O}",
+                         "dataset", t.dataset.c_str(), "cls", t.cls.c_str(), "speaker", t.speaker.c_str(),
+                         "session", t.session, "id", (unsigned long long)t.id, "path", t.path.c_str(),
+                         "shape", (Py_ssize_t)t.rows, (Py_ssize_t)t.cols, "fortran", t.fortran ? Py_True : Py_False);
+}
+
+static PyObject* dataset_view(PyObject* obj, PyObject* arg)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    Py_ssize_t i = PyLong_AsSsize_t(arg);
+    if (PyErr_Occurred() || !check_index(self, i)) return nullptr;
+
+    nexus::View v;
+    try {
+        v = self->ds->view(i);
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_OSError, e.what());
+        return nullptr;
+    }
+    ViewObject* view = PyObject_New(ViewObject, view_type);
+    if (!view) return nullptr;
+    Py_INCREF(obj);
+    view->owner = obj;
+    view->view = v;
+    view->shape[0] = v.rows;
+    view->shape[1] = v.cols;
+    view->strides[0] = v.index(1, 0) * nexus::dtype_size(v.dtype);
+    view->strides[1] = v.index(0, 1) * nexus::dtype_size(v.dtype);
+
+    PyObject* mv = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(view));
+    Py_DECREF(view);
+    return mv;
+}
+
+static PyObject* dataset_prefetch(PyObject* obj, PyObject* args, PyObject* kwargs)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    static const char* keywords[] = {"indices", "threads", nullptr};
+    PyObject* arg = nullptr;
+    unsigned threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OI", const_cast<char**>(keywords), &arg, &threads))
+        return nullptr;
+
+    std::vector<size_t> indices;
+    if (!arg || arg == Py_None) {
+        for (size_t i = 0; i < self->ds->trials().size(); i++) indices.push_back(i);
+    } else {
+        std::vector<int> list;
+        if (!to_list(arg, list, as_int)) return nullptr;
+        for (int i : list) {
+            if (!check_index(self, i)) return nullptr;
+            indices.push_back(i);
+        }
+    }
+    Py_BEGIN_ALLOW_THREADS
+    self->ds->prefetch(indices, threads);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+static PyObject* dataset_skipped(PyObject* obj, PyObject*)
+{
+    DatasetObject* self = reinterpret_cast<DatasetObject*>(obj);
+    const std::vector<std::string>& skipped = self->ds->skipped();
+    PyObject* list = PyList_New(skipped.size());
+    for (size_t i = 0; list && i < skipped.size(); i++)
+        PyList_SET_ITEM(list, i, PyUnicode_FromString(skipped[i].c_str()));
+    return list;
+}
+
+static PyMethodDef dataset_methods[] = {
+    {"select", (PyCFunction)(void (*)(void))dataset_select, METH_VARARGS | METH_KEYWORDS,
+     "select(dataset=None, cls=None, speaker=None, session=None) -> trial indices. "
+     "Each filter is a value or a list of values, None matches anything."},
+    {"info", dataset_info, METH_O, "info(i) -> dict of dataset, cls, speaker, session, id, path, shape and fortran"},
+    {"view", dataset_view, METH_O, "view(i) -> read only memoryview of the (samples, channels) array, no copy"},
+    {"prefetch", (PyCFunction)(void (*)(void))dataset_prefetch, METH_VARARGS | METH_KEYWORDS,
+     "prefetch(indices=None, threads=0) maps the trials and reads them into the page cache in parallel"},
+    {"skipped", dataset_skipped, METH_NOARGS, "skipped() -> .npy files listed in metadata.csv that could not be indexed"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+static PyType_Slot view_slots[] = {
+    {Py_tp_dealloc, (void*)view_dealloc},
+    {Py_bf_getbuffer, (void*)view_getbuffer},
+    {Py_tp_doc, (void*)"Buffer over one memory mapped trial"},
+    {0, nullptr},
+};
+
+static PyType_Spec view_spec = {"nexus_dataset.View", sizeof(ViewObject), 0, Py_TPFLAGS_DEFAULT, view_slots};
+
+static PyType_Slot dataset_slots[] = {
+    {Py_tp_new, (void*)PyType_GenericNew},
+    {Py_tp_init, (void*)dataset_init},
+    {Py_tp_dealloc, (void*)dataset_dealloc},
+    {Py_tp_methods, dataset_methods},
+    {Py_sq_length, (void*)dataset_len},
+    {Py_tp_doc, (void*)"Dataset(root): index of every metadata.csv under root"},
+    {0, nullptr},
+};
+
+static PyType_Spec dataset_spec = {"nexus_dataset.Dataset", sizeof(DatasetObject), 0, Py_TPFLAGS_DEFAULT, dataset_slots};
+
+static PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "nexus_dataset", "Memory mapped, indexed access to the datasets/ tree", -1,
+    nullptr, nullptr, nullptr, nullptr, nullptr,
+};
+
+PyMODINIT_FUNC PyInit_nexus_dataset(void)
+{
+    PyObject* m = PyModule_Create(&module_def);
+    if (!m) return nullptr;
+    view_type = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&view_spec));
+    PyObject* dataset_type = PyType_FromSpec(&dataset_spec);
+    if (!view_type || !dataset_type || PyModule_AddObject(m, "Dataset", dataset_type) < 0) {
+        Py_XDECREF(dataset_type);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef struct i2c_master_bus_t* i2c_master_bus_handle_t;
+typedef struct i2c_master_dev_t* i2c_master_dev_handle_t;
+
+typedef enum { I2C_ADDR_BIT_LEN_7, I2C_ADDR_BIT_LEN_10 } i2c_addr_bit_len_t;
+
+typedef struct {
+    i2c_addr_bit_len_t dev_addr_length;
+    uint16_t device_address;
+    uint32_t scl_speed_hz;
+} i2c_device_config_t;
+
+// The bus has nothing attached: devices can be added, but nothing acknowledges
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus, uint16_t addr, int timeout_ms);
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t* config,
+                                    i2c_master_dev_handle_t* ret_device);
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t device);
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t device, const uint8_t* buf, size_t len, int timeout_ms);
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t device, uint8_t* buf, size_t len, int timeout_ms);
@@ -0,0 +1,57 @@
+#pragma once
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int spi_host_device_t;
+enum { SPI1_HOST, SPI2_HOST, SPI3_HOST };
+typedef struct spi_device_t* spi_device_handle_t;
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    int clock_speed_hz;
+    int spics_io_num;
+    uint8_t cs_ena_posttrans;
+    int queue_size;
+    int input_delay_ns;
+    uint32_t flags;
+} spi_device_interface_config_t;
+
+#define SPI_TRANS_USE_RXDATA    (1 << 2)
+#define SPI_TRANS_USE_TXDATA    (1 << 3)
+#define SPI_TRANS_VARIABLE_CMD  (1 << 4)
+
+typedef struct {
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;              ///< Bits to shift out and in, after the command
+    size_t rxlength;
+    void* user;
+    union {
+        const void* tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union {
+        void* rx_buffer;
+        uint8_t rx_data[4];
+    };
+} spi_transaction_t;
+
+typedef struct {
+    spi_transaction_t base;
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+} spi_transaction_ext_t;
+
+// The bus has nothing attached: transactions succeed and read zeros
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* config,
+                             spi_device_handle_t* ret_device);
+esp_err_t spi_bus_remove_device(spi_device_handle_t device);
+esp_err_t spi_device_transmit(spi_device_handle_t device, spi_transaction_t* trans);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t device, spi_transaction_t* trans);
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait);
+void spi_device_release_bus(spi_device_handle_t device);
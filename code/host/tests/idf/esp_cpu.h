@@ -0,0 +1,5 @@
+#pragma once
+#include "esp_err.h"
+
+/// Cycles of a simulated 240MHz clock, from the host's monotonic clock
+uint32_t esp_cpu_get_cycle_count(void);
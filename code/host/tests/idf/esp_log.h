@@ -0,0 +1,10 @@
+#pragma once
+#include <stdio.h>
+
+#include "esp_err.h"
+
+// Warnings and errors go to stderr, the chattier levels are dropped
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) (void)(tag)
+#define ESP_LOGD(tag, fmt, ...) (void)(tag)
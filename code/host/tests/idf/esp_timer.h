@@ -0,0 +1,5 @@
+#pragma once
+#include "esp_err.h"
+
+/// Microseconds of the host's monotonic clock
+int64_t esp_timer_get_time(void);
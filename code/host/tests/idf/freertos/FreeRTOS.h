@@ -0,0 +1,30 @@
+#pragma once
+#include "esp_err.h"
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct sim_task* TaskHandle_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       0xFFFFFFFFu
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY      0x7FFFFFFF
+#define configMAX_PRIORITIES 25
+
+// Critical sections of every spinlock share one recursive mutex, interrupts are
+// simulated on ordinary threads
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void sim_enter_critical(void);
+void sim_exit_critical(void);
+#define portENTER_CRITICAL(mux)     do { (void)(mux); sim_enter_critical(); } while (0)
+#define portEXIT_CRITICAL(mux)      do { (void)(mux); sim_exit_critical(); } while (0)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(woken)   (void)(woken)
@@ -0,0 +1,372 @@
+// Host stand-ins for the parts of ESP-IDF and FreeRTOS the driver components use,
+// so they can be built and driven by the unit tests. See idf_sim.h.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_sys.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/i2c_master.h"
+#include "driver/spi_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "idf_sim.h"
+
+#define SIM_CPU_MHZ 240
+
+struct sim_task {
+    TaskFunction_t fn;
+    void* arg;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_count;
+};
+
+struct spi_device_t {
+    spi_host_device_t host;
+};
+
+struct i2c_master_dev_t {
+    i2c_master_bus_handle_t bus;
+    uint16_t addr;
+};
+
+typedef struct {
+    gpio_isr_t isr;
+    void* arg;
+    gpio_int_type_t intr_type;
+    int level;
+    int falls;      // Output driven from high to low
+} sim_pin_t;
+
+static pthread_mutex_t critical_lock;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+static __thread struct sim_task* current_task;
+
+static pthread_mutex_t gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_pin_t pins[GPIO_NUM_MAX];
+static bool isr_service;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_us(int64_t us)
+{
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/******** esp_timer, esp_cpu, esp_rom **********/
+int64_t esp_timer_get_time(void) { return now_ns() / 1000; }
+uint32_t esp_cpu_get_cycle_count(void) { return (uint32_t)(now_ns() * SIM_CPU_MHZ / 1000); }
+uint32_t esp_rom_get_cpu_ticks_per_us(void) { return SIM_CPU_MHZ; }
+void esp_rom_delay_us(uint32_t us) { sleep_us(us); }
+
+/******** Heap **********/
+void* heap_caps_malloc(size_t size, uint32_t caps) { (void)caps; return malloc(size); }
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) { (void)caps; return calloc(n, size); }
+void heap_caps_free(void* ptr) { free(ptr); }
+
+/******** Task watchdog **********/
+esp_err_t esp_task_wdt_add(TaskHandle_t task) { (void)task; return ESP_ERR_INVALID_STATE; }
+esp_err_t esp_task_wdt_delete(TaskHandle_t task) { (void)task; return ESP_ERR_INVALID_STATE; }
+esp_err_t esp_task_wdt_reset(void) { return ESP_ERR_INVALID_STATE; }
+
+/******** FreeRTOS **********/
+static void critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void sim_enter_critical(void)
+{
+    pthread_once(&critical_once, critical_init);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void sim_exit_critical(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+static struct sim_task* task_new(TaskFunction_t fn, void* arg)
+{
+    struct sim_task* task = calloc(1, sizeof(*task));
+    if (!task) return NULL;
+    task->fn = fn;
+    task->arg = arg;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->notified, NULL);
+    return task;
+}
+
+static void* task_main(void* arg)
+{
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_size, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* ret_task, BaseType_t core)
+{
+    (void)name, (void)stack_size, (void)priority, (void)core;
+    struct sim_task* task = task_new(fn, arg);
+    if (!task) return pdFAIL;
+
+    // Like FreeRTOS the handle is out before the task first runs
+    if (ret_task) *ret_task = task;
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        if (ret_task) *ret_task = NULL;
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Only a task deleting itself. Its control block stays, so a late notification
+    // lands on valid memory.
+    if (task && task != current_task) abort();
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0)
+        sched_yield();
+    else
+        sleep_us((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // Threads the tests start themselves become tasks the first time they ask
+    if (!current_task) current_task = task_new(NULL, NULL);
+    return current_task;
+}
+
+TickType_t xTaskGetTickCount(void) { return (TickType_t)(now_ns() / 1000000 / portTICK_PERIOD_MS); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct sim_task* task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t ns = deadline.tv_nsec + (int64_t)ticks * portTICK_PERIOD_MS * 1000000;
+    deadline.tv_sec += ns / 1000000000;
+    deadline.tv_nsec = ns % 1000000000;
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_count == 0 && ticks) {
+        if (ticks == portMAX_DELAY)
+            pthread_cond_wait(&task->notified, &task->lock);
+        else if (pthread_cond_timedwait(&task->notified, &task->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    uint32_t count = task->notify_count;
+    if (count) task->notify_count = clear ? 0 : count - 1;
+    pthread_mutex_unlock(&task->lock);
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify_count++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdTRUE;
+}
+
+/******** GPIO **********/
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+    pthread_mutex_lock(&gpio_lock);
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++)
+        if (config->pin_bit_mask & (1ULL << pin)) pins[pin].intr_type = config->intr_type;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    pins[pin] = (sim_pin_t) {0};
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    if (pins[pin].level && !level) pins[pin].falls++;
+    pins[pin].level = level ? 1 : 0;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    return (pin < 0 || pin >= GPIO_NUM_MAX) ? 0 : pins[pin].level;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    (void)flags;
+    pthread_mutex_lock(&gpio_lock);
+    esp_err_t err = isr_service ? ESP_ERR_INVALID_STATE : ESP_OK;
+    isr_service = true;
+    pthread_mutex_unlock(&gpio_lock);
+    return err;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void* arg)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    if (!isr_service) return ESP_ERR_INVALID_STATE;
+    pthread_mutex_lock(&gpio_lock);
+    pins[pin].isr = isr;
+    pins[pin].arg = arg;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin)
+{
+    return gpio_isr_handler_add(pin, NULL, NULL);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    pins[pin].intr_type = type;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+bool idf_sim_gpio_edge(gpio_num_t pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return false;
+    pthread_mutex_lock(&gpio_lock);
+    sim_pin_t p = pins[pin];
+    pthread_mutex_unlock(&gpio_lock);
+    if (!p.isr || p.intr_type == GPIO_INTR_DISABLE) return false;
+    p.isr(p.arg);
+    return true;
+}
+
+int idf_sim_gpio_falls(gpio_num_t pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return 0;
+    pthread_mutex_lock(&gpio_lock);
+    int falls = pins[pin].falls;
+    pthread_mutex_unlock(&gpio_lock);
+    return falls;
+}
+
+/******** SPI master **********/
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* config,
+                             spi_device_handle_t* ret_device)
+{
+    (void)config;
+    struct spi_device_t* device = calloc(1, sizeof(*device));
+    if (!device) return ESP_ERR_NO_MEM;
+    device->host = host;
+    *ret_device = device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t device)
+{
+    free(device);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t device, spi_transaction_t* trans)
+{
+    (void)device;
+    if (trans->rx_buffer) memset(trans->rx_buffer, 0, (trans->rxlength ? trans->rxlength : trans->length) / 8);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t device, spi_transaction_t* trans)
+{
+    return spi_device_transmit(device, trans);
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, TickType_t wait)
+{
+    (void)device, (void)wait;
+    return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t device) { (void)device; }
+
+/******** I2C master **********/
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus, uint16_t addr, int timeout_ms)
+{
+    (void)bus, (void)addr, (void)timeout_ms;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t* config,
+                                    i2c_master_dev_handle_t* ret_device)
+{
+    struct i2c_master_dev_t* device = calloc(1, sizeof(*device));
+    if (!device) return ESP_ERR_NO_MEM;
+    device->bus = bus;
+    device->addr = config->device_address;
+    *ret_device = device;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t device)
+{
+    free(device);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t device, const uint8_t* buf, size_t len, int timeout_ms)
+{
+    (void)device, (void)buf, (void)len, (void)timeout_ms;
+    return ESP_FAIL;
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t device, uint8_t* buf, size_t len, int timeout_ms)
+{
+    (void)device, (void)buf, (void)len, (void)timeout_ms;
+    return ESP_FAIL;
+}
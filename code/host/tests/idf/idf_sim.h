@@ -0,0 +1,19 @@
+#pragma once
+#include <stdbool.h>
+
+#include "driver/gpio.h"
+
+/*
+ * Test side controls of the ESP-IDF stand-ins in this directory.
+ *
+ * FreeRTOS tasks are host threads with a task notification count each, a tick is a
+ * millisecond and critical sections share one recursive mutex. GPIO interrupts fire
+ * only when a test calls idf_sim_gpio_edge(), on the calling thread, which plays the
+ * part of the interrupt.
+ */
+
+/// Runs the handler attached to pin as its interrupt would, false when none is attached
+bool idf_sim_gpio_edge(gpio_num_t pin);
+
+/// Times the pin was driven from high to low by gpio_set_level, a reset pulse each
+int idf_sim_gpio_falls(gpio_num_t pin);
@@ -0,0 +1,218 @@
+// The ADG715 driver and its groups against mock switches counting I2C transfers:
+// skipping devices already switched, a NACK leaving its device's shadow alone while
+// the rest of the group is written, read-modify-write from the shadow, the stats, and
+// resetting devices that share one reset line.
+#include <stdio.h>
+
+#include "adg715_interface.h"
+#include "check.h"
+#include "idf_sim.h"
+
+#define N_DEVICES 3
+#define RESET_PIN 20   // Shared by every device, as ADG715_RESET_PIN is on the board
+
+typedef struct {
+    uint8_t state;     // The device's switches
+    bool nack;         // Refuse writes
+    bool absent;       // Refuse the probe
+    int writes, reads, probes;
+} mock_t;
+
+static mock_t mocks[N_DEVICES];
+
+static esp_err_t mock_probe(i2c_master_bus_handle_t bus, uint16_t addr, int timeout_ms, void* ctx)
+{
+    mock_t* m = ctx;
+    m->probes++;
+    return m->absent ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+static esp_err_t mock_transmit(i2c_master_dev_handle_t dev, const uint8_t* buf, size_t len, int timeout_ms, void* ctx)
+{
+    mock_t* m = ctx;
+    CHECK_EQ(len, 1);
+    m->writes++;
+    if (m->nack) return ESP_FAIL;
+    m->state = buf[0];
+    return ESP_OK;
+}
+
+static esp_err_t mock_receive(i2c_master_dev_handle_t dev, uint8_t* buf, size_t len, int timeout_ms, void* ctx)
+{
+    mock_t* m = ctx;
+    CHECK_EQ(len, 1);
+    m->reads++;
+    buf[0] = m->state;
+    return ESP_OK;
+}
+
+static void reset_counts(void)
+{
+    for (int i = 0; i < N_DEVICES; i++)
+        mocks[i].writes = mocks[i].reads = mocks[i].probes = 0;
+}
+
+static int total_reads(void)
+{
+    int n = 0;
+    for (int i = 0; i < N_DEVICES; i++)
+        n += mocks[i].reads;
+    return n;
+}
+
+int main(void)
+{
+    adg715_i2c_ops_t ops[N_DEVICES];
+    adg715_handle_t* devs[N_DEVICES];
+    const uint8_t power_on[N_DEVICES] = {0x00, 0x5A, 0xFF};
+
+    for (int i = 0; i < N_DEVICES; i++) {
+        mocks[i].state = power_on[i];
+        ops[i] = (adg715_i2c_ops_t) {mock_probe, mock_transmit, mock_receive, &mocks[i]};
+        adg715_config_t config = {.i2c_addr = 0x48 + i, .reset_pin = RESET_PIN, .i2c_ops = &ops[i]};
+        CHECK_EQ(adg715_init(&config, &devs[i]), ESP_OK);
+
+        // The shadow starts from one read of the device
+        uint8_t cached;
+        CHECK_EQ(adg715_get_cached(devs[i], &cached), ESP_OK);
+        CHECK_EQ(cached, power_on[i]);
+        CHECK_EQ(mocks[i].probes, 1);
+        CHECK_EQ(mocks[i].reads, 1);
+        CHECK_EQ(mocks[i].writes, 0);
+    }
+
+    // A device that does not answer the probe is never added
+    mock_t absent = {.absent = true};
+    adg715_i2c_ops_t absent_ops = {mock_probe, mock_transmit, mock_receive, &absent};
+    adg715_config_t absent_config = {.i2c_addr = 0x4F, .reset_pin = 30, .i2c_ops = &absent_ops};
+    adg715_handle_t* none = NULL;
+    CHECK_EQ(adg715_init(&absent_config, &none), ESP_ERR_NOT_FOUND);
+    CHECK(none == NULL);
+    CHECK_EQ(absent.reads, 0);
+
+    adg715_group_config_t group_config = {.n_devices = N_DEVICES};
+    for (int i = 0; i < N_DEVICES; i++)
+        group_config.devices[i] = devs[i];
+    adg715_group_t* group = NULL;
+    CHECK_EQ(adg715_group_init(&group_config, &group), ESP_OK);
+    adg715_group_config_t bad_config = {.n_devices = 0};
+    CHECK_EQ(adg715_group_init(&bad_config, &group), ESP_ERR_INVALID_ARG);
+
+    // Device 0 already matches and is skipped, device 2 NACKs and keeps its shadow,
+    // device 1 is written all the same
+    reset_counts();
+    mocks[2].nack = true;
+    uint8_t states[N_DEVICES] = {0x00, 0x0F, 0x81};
+    CHECK_EQ(adg715_group_set(group, states), ESP_FAIL);
+    CHECK_EQ(mocks[0].writes, 0);
+    CHECK_EQ(mocks[1].writes, 1);
+    CHECK_EQ(mocks[2].writes, 1);
+    CHECK_EQ(mocks[1].state, 0x0F);
+    CHECK_EQ(mocks[2].state, 0xFF);
+    uint8_t cached[N_DEVICES];
+    CHECK_EQ(adg715_group_get_cached(group, cached), ESP_OK);
+    CHECK_EQ(cached[0], 0x00);
+    CHECK_EQ(cached[1], 0x0F);
+    CHECK_EQ(cached[2], 0xFF);
+
+    adg715_group_stats_t stats;
+    CHECK_EQ(adg715_group_get_stats(group, &stats), ESP_OK);
+    CHECK_EQ(stats.count, 1);
+    CHECK_EQ(stats.writes, 2);
+    CHECK_EQ(stats.skipped, 1);
+    CHECK(stats.last_us >= 0);
+    CHECK_EQ(stats.min_us, stats.last_us);
+    CHECK_EQ(stats.max_us, stats.last_us);
+    CHECK_EQ(stats.total_us, stats.last_us);
+
+    // Retried once the device answers again, only it is written
+    mocks[2].nack = false;
+    CHECK_EQ(adg715_group_set(group, states), ESP_OK);
+    CHECK_EQ(mocks[0].writes, 0);
+    CHECK_EQ(mocks[1].writes, 1);
+    CHECK_EQ(mocks[2].writes, 2);
+    CHECK_EQ(mocks[2].state, 0x81);
+    CHECK_EQ(adg715_group_get_stats(group, &stats), ESP_OK);
+    CHECK_EQ(stats.count, 2);
+    CHECK_EQ(stats.writes, 3);
+    CHECK_EQ(stats.skipped, 3);
+    CHECK(stats.min_us <= stats.max_us);
+    CHECK(stats.total_us >= stats.max_us);
+
+    // Nothing to change, nothing on the bus and no update counted
+    CHECK_EQ(adg715_group_set(group, states), ESP_OK);
+    CHECK_EQ(mocks[1].writes + mocks[2].writes, 3);
+    CHECK_EQ(adg715_group_get_stats(group, &stats), ESP_OK);
+    CHECK_EQ(stats.count, 2);
+    CHECK_EQ(stats.writes, 3);
+    CHECK_EQ(stats.skipped, 6);
+    CHECK_EQ(total_reads(), 0);
+
+    CHECK_EQ(adg715_group_reset_stats(group), ESP_OK);
+    CHECK_EQ(adg715_group_get_stats(group, &stats), ESP_OK);
+    CHECK_EQ(stats.count, 0);
+    CHECK_EQ(stats.skipped, 0);
+    CHECK_EQ(stats.min_us, INT64_MAX);
+
+    // Read-modify-write works from the shadow, never reading the device
+    reset_counts();
+    CHECK_EQ(adg715_update(devs[1], 0xF0, 0xA0), ESP_OK);
+    CHECK_EQ(mocks[1].state, 0xAF);
+    CHECK_EQ(adg715_update(devs[1], 0x03, 0x00), ESP_OK);
+    CHECK_EQ(mocks[1].state, 0xAC);
+    CHECK_EQ(adg715_update(devs[1], 0xF0, 0xA5), ESP_OK);  // Bits outside the mask ignored, no change
+    CHECK_EQ(mocks[1].writes, 2);
+    CHECK_EQ(total_reads(), 0);
+
+    // A NACKed update leaves the shadow, so the next one writes from the old state
+    mocks[1].nack = true;
+    CHECK_EQ(adg715_update(devs[1], 0x01, 0x01), ESP_FAIL);
+    uint8_t state;
+    CHECK_EQ(adg715_get_cached(devs[1], &state), ESP_OK);
+    CHECK_EQ(state, 0xAC);
+    mocks[1].nack = false;
+    CHECK_EQ(adg715_update(devs[1], 0x02, 0x02), ESP_OK);
+    CHECK_EQ(mocks[1].state, 0xAE);
+    CHECK_EQ(total_reads(), 0);
+
+    // Reading resyncs the shadow with whatever the device holds
+    mocks[0].state = 0x33;
+    CHECK_EQ(adg715_get(devs[0], &state), ESP_OK);
+    CHECK_EQ(state, 0x33);
+    CHECK_EQ(adg715_get_cached(devs[0], &state), ESP_OK);
+    CHECK_EQ(state, 0x33);
+    CHECK_EQ(mocks[0].reads, 1);
+
+    // Resetting one device pulses the shared line but only follows in its own shadow,
+    // device 0 still claims switches the pulse opened
+    int falls = idf_sim_gpio_falls(RESET_PIN);
+    CHECK_EQ(adg715_reset(devs[1]), ESP_OK);
+    CHECK_EQ(idf_sim_gpio_falls(RESET_PIN), falls + 1);
+    CHECK_EQ(adg715_get_cached(devs[0], &state), ESP_OK);
+    CHECK_EQ(state, 0x33);
+
+    // A group reset pulses the line once and opens every shadow, so the next update
+    // writes every device that should close a switch
+    CHECK_EQ(adg715_group_reset(group), ESP_OK);
+    CHECK_EQ(idf_sim_gpio_falls(RESET_PIN), falls + 2);
+    CHECK_EQ(gpio_get_level(RESET_PIN), 1);
+    for (int i = 0; i < N_DEVICES; i++)
+        mocks[i].state = 0x00;  // What the pulse did to the devices
+    CHECK_EQ(adg715_group_get_cached(group, cached), ESP_OK);
+    for (int i = 0; i < N_DEVICES; i++)
+        CHECK_EQ(cached[i], 0x00);
+    reset_counts();
+    CHECK_EQ(adg715_group_set(group, states), ESP_OK);
+    for (int i = 0; i < N_DEVICES; i++)
+        CHECK_EQ(mocks[i].state, states[i]);
+    CHECK_EQ(mocks[0].writes, 0);
+    CHECK_EQ(mocks[1].writes, 1);
+    CHECK_EQ(mocks[2].writes, 1);
+    CHECK_EQ(total_reads(), 0);
+
+    CHECK_EQ(adg715_group_deinit(group), ESP_OK);
+    for (int i = 0; i < N_DEVICES; i++)
+        CHECK_EQ(adg715_deinit(devs[i]), ESP_OK);
+    printf("adg715: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,213 @@
+// The DRDY driven acquisition task of the ADS1299 driver, fed simulated DRDY edges.
+// Every conversion read returns the number of edges fired so far on channel 0, so a
+// sample shows which edge it was read after.
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "ads1299_interface.h"
+#include "idf_sim.h"
+#include "check.h"
+
+#define DRDY_PIN    10
+#define RESET_PIN   11
+#define EDGES       200
+#define MAX_SAMPLES (EDGES + 8)
+#define WAIT_MS     2000
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    atomic_uint fired;             // DRDY edges fired
+    bool hold_read;                // Conversion reads wait while set
+    bool in_read;                  // A read is waiting on hold_read
+    int n;
+    ads1299_sample_t samples[MAX_SAMPLES];
+    bool on_task[MAX_SAMPLES];     // Callback ran in the acquisition task
+    ads1299_handle_t* ads;
+} sim_t;
+
+static sim_t sim = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER,
+};
+
+static esp_err_t sim_transmit(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx)
+{
+    // Register reads come back as zeros
+    if (trans->rx_buffer) memset(trans->rx_buffer, 0, trans->length / 8);
+    return ESP_OK;
+}
+
+static esp_err_t sim_read(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx)
+{
+    sim_t* s = ctx;
+    pthread_mutex_lock(&s->lock);
+    s->in_read = true;
+    pthread_cond_broadcast(&s->changed);
+    while (s->hold_read)
+        pthread_cond_wait(&s->changed, &s->lock);
+    s->in_read = false;
+    pthread_mutex_unlock(&s->lock);
+
+    // Status word then channel 0 holds the edges fired, the other channels their index
+    uint8_t* rx = trans->rx_buffer;
+    memset(rx, 0, trans->length / 8);
+    uint32_t fired = atomic_load(&s->fired);
+    rx[0] = 0xC0;
+    rx[3] = fired >> 16, rx[4] = fired >> 8, rx[5] = fired;
+    for (int ch = 1; ch < ADS1299_CHANNELS_PER_DEVICE; ch++)
+        rx[3 + 3 * ch + 2] = ch;
+    return ESP_OK;
+}
+
+static void on_sample(const ads1299_sample_t* sample, void* ctx)
+{
+    sim_t* s = ctx;
+    bool on_task = xTaskGetCurrentTaskHandle() == s->ads->acq_task;
+    pthread_mutex_lock(&s->lock);
+    CHECK(s->n < MAX_SAMPLES);
+    s->samples[s->n] = *sample;
+    s->on_task[s->n] = on_task;
+    s->n++;
+    pthread_cond_broadcast(&s->changed);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Waits until pred holds, false after WAIT_MS
+static bool wait_for(bool (*pred)(sim_t*, int), int arg)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += WAIT_MS / 1000;
+    pthread_mutex_lock(&sim.lock);
+    bool ok = true;
+    while (ok && !pred(&sim, arg))
+        ok = pthread_cond_timedwait(&sim.changed, &sim.lock, &deadline) == 0;
+    ok = pred(&sim, arg);
+    pthread_mutex_unlock(&sim.lock);
+    return ok;
+}
+
+static bool has_samples(sim_t* s, int n) { return s->n >= n; }
+static bool reading(sim_t* s, int unused) { return s->in_read; }
+
+static void fire_edge(void)
+{
+    atomic_fetch_add(&sim.fired, 1);
+    CHECK(idf_sim_gpio_edge(DRDY_PIN));
+}
+
+static void set_hold(bool hold)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.hold_read = hold;
+    pthread_cond_broadcast(&sim.changed);
+    pthread_mutex_unlock(&sim.lock);
+}
+
+int main(void)
+{
+    const ads1299_spi_ops_t ops = {.transmit = sim_transmit, .polling_transmit = sim_read, .ctx = &sim};
+    const ads1299_config_t config = {
+        .spi_host = SPI2_HOST,
+        .spi_clock_speed_hz = 4000000,
+        .cs_pin = 9,
+        .drdy_pin = DRDY_PIN,
+        .reset_pin = RESET_PIN,
+        .spi_ops = &ops,
+    };
+    CHECK_EQ(ads1299_init(&config, &sim.ads), ESP_OK);
+
+    const ads1299_acq_config_t acq = {.on_sample = on_sample, .ctx = &sim, .task_core = tskNO_AFFINITY};
+    CHECK_EQ(ads1299_acq_start(sim.ads, &acq), ESP_OK);
+    CHECK_EQ(ads1299_acq_start(sim.ads, &acq), ESP_ERR_INVALID_STATE);
+
+    // One edge at a time, each read before the next fires
+    for (int i = 0; i < EDGES; i++) {
+        fire_edge();
+        CHECK(wait_for(has_samples, i + 1));
+    }
+    for (int i = 0; i < EDGES; i++) {
+        const ads1299_sample_t* s = &sim.samples[i];
+        CHECK(sim.on_task[i]);
+        CHECK_EQ(s->counter, i);
+        CHECK_EQ(s->data[0], i + 1);
+        for (int ch = 1; ch < ADS1299_CHANNELS_PER_DEVICE; ch++)
+            CHECK_EQ(s->data[ch], ch);
+        CHECK_EQ(s->status[0], 0xC00000);
+        if (i) CHECK(s->timestamp_us >= sim.samples[i - 1].timestamp_us);
+    }
+
+    ads1299_acq_stats_t stats;
+    CHECK_EQ(ads1299_acq_get_stats(sim.ads, &stats), ESP_OK);
+    CHECK_EQ(stats.drdy_count, EDGES);
+    CHECK_EQ(stats.sample_count, EDGES);
+    CHECK_EQ(stats.missed_drdy, 0);
+    CHECK(stats.latency_min_us >= 0 && stats.latency_min_us <= stats.latency_max_us);
+    CHECK(stats.period_min_us >= 0 && stats.period_min_us <= stats.period_max_us);
+
+    // An edge during a read: the sample is stamped with the edge it was woken for, and the
+    // next one is read for the edge that came in meanwhile
+    set_hold(true);
+    fire_edge();
+    CHECK(wait_for(reading, 0));
+    fire_edge();
+    set_hold(false);
+    CHECK(wait_for(has_samples, EDGES + 2));
+
+    CHECK_EQ(ads1299_acq_get_stats(sim.ads, &stats), ESP_OK);
+    CHECK_EQ(stats.drdy_count, EDGES + 2);
+    CHECK_EQ(stats.sample_count, EDGES + 2);
+    CHECK_EQ(stats.missed_drdy, 0);
+    for (int i = EDGES; i < EDGES + 2; i++) {
+        CHECK(sim.on_task[i]);
+        CHECK_EQ(sim.samples[i].counter, i);
+        CHECK(sim.samples[i].timestamp_us >= sim.samples[i - 1].timestamp_us);
+    }
+
+    // Overrun: two more edges while a read is held up. The second read picks up the latest
+    // edge, the one between is missed and left as a gap in the counters.
+    set_hold(true);
+    fire_edge();
+    CHECK(wait_for(reading, 0));
+    fire_edge();
+    fire_edge();
+    set_hold(false);
+    CHECK(wait_for(has_samples, EDGES + 4));
+
+    CHECK_EQ(ads1299_acq_get_stats(sim.ads, &stats), ESP_OK);
+    CHECK_EQ(stats.drdy_count, EDGES + 5);
+    CHECK_EQ(stats.sample_count, EDGES + 4);
+    CHECK_EQ(stats.missed_drdy, 1);
+    CHECK_EQ(sim.samples[EDGES + 2].counter, EDGES + 2);
+    CHECK_EQ(sim.samples[EDGES + 3].counter, EDGES + 4);
+    CHECK_EQ(sim.samples[EDGES + 3].data[0], EDGES + 5);
+
+    // No two samples share a counter, and every gap is a missed edge
+    uint32_t gaps = 0;
+    for (int i = 1; i < EDGES + 4; i++) {
+        CHECK(sim.samples[i].counter > sim.samples[i - 1].counter);
+        gaps += sim.samples[i].counter - sim.samples[i - 1].counter - 1;
+    }
+    CHECK_EQ(gaps, stats.missed_drdy);
+
+    // Stopped, the interrupt is detached and nothing more is read
+    CHECK_EQ(ads1299_acq_stop(sim.ads), ESP_OK);
+    CHECK(sim.ads->acq_task == NULL);
+    CHECK(!idf_sim_gpio_edge(DRDY_PIN));
+    CHECK_EQ(sim.n, EDGES + 4);
+
+    // Restarting begins the counts afresh
+    CHECK_EQ(ads1299_acq_start(sim.ads, &acq), ESP_OK);
+    fire_edge();
+    CHECK(wait_for(has_samples, EDGES + 5));
+    CHECK_EQ(sim.samples[EDGES + 4].counter, 0);
+    CHECK_EQ(ads1299_acq_get_stats(sim.ads, &stats), ESP_OK);
+    CHECK_EQ(stats.drdy_count, 1);
+    CHECK_EQ(stats.sample_count, 1);
+    CHECK_EQ(ads1299_deinit(sim.ads), ESP_OK);
+
+    printf("ads1299_acq: all checks passed\n");
+    return 0;
+}
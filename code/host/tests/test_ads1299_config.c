@@ -0,0 +1,237 @@
+// Register writes of the ADS1299 driver against a mock device counting SPI transactions:
+// batched commits against one write per setter, burst writes bridging short gaps of
+// clean registers, and the shadow skipping writes that change nothing.
+#include <stdio.h>
+
+#include "ads1299.h"
+#include "ads1299_interface.h"
+#include "check.h"
+
+typedef struct {
+    uint8_t regs[ADS1299_REG_COUNT];  // The device's registers
+    int sdatac, rdatac, start, reset; // Commands seen
+    int wreg, rreg;                   // Register access transactions
+    int wreg_regs;                    // Registers written over all WREGs
+    uint32_t written;                 // Registers any WREG covered
+    int total;
+} mock_t;
+
+static mock_t mock;
+
+static esp_err_t mock_transmit(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx)
+{
+    mock_t* m = ctx;
+    m->total++;
+    if (!(trans->flags & SPI_TRANS_VARIABLE_CMD)) {
+        switch (trans->cmd) {
+        case ADS_SDATAC: m->sdatac++; break;
+        case ADS_RDATAC: m->rdatac++; break;
+        case ADS_START: m->start++; break;
+        case ADS_RESET: m->reset++; break;
+        }
+        return ESP_OK;
+    }
+
+    // RREG and WREG take the register count less one in a second command byte
+    const spi_transaction_ext_t* ext = (const spi_transaction_ext_t*)trans;
+    CHECK_EQ(ext->command_bits, 16);
+    uint8_t op = trans->cmd >> 8, n = (trans->cmd & 0xFF) + 1, addr = op & 0x1F;
+    CHECK(addr + n <= ADS1299_REG_COUNT);
+    CHECK_EQ(trans->length, n * 8);
+    if ((op & 0xE0) == ADS_WREG) {
+        m->wreg++;
+        m->wreg_regs += n;
+        memcpy(m->regs + addr, trans->tx_buffer, n);
+        for (int i = 0; i < n; i++) {
+            CHECK(ADS_WRITABLE_REGS & (1UL << (addr + i)));
+            m->written |= 1UL << (addr + i);
+        }
+    } else if ((op & 0xE0) == ADS_RREG) {
+        m->rreg++;
+        memcpy(trans->rx_buffer, m->regs + addr, n);
+    } else {
+        CHECK(!"unknown command");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t mock_read(spi_device_handle_t spi, spi_transaction_t* trans, void* ctx)
+{
+    memset(trans->rx_buffer, 0, trans->length / 8);
+    return ESP_OK;
+}
+
+static void mock_reset_counts(void)
+{
+    uint8_t regs[ADS1299_REG_COUNT];
+    memcpy(regs, mock.regs, sizeof(regs));
+    mock = (mock_t) {0};
+    memcpy(mock.regs, regs, sizeof(regs));
+}
+
+static void check_in_sync(ads1299_handle_t* ads)
+{
+    CHECK_EQ(ads->regs_dirty, 0);
+    for (int r = 0; r < ADS1299_REG_COUNT; r++)
+        CHECK_EQ(mock.regs[r], ads->regs[r]);
+}
+
+static void test_init(ads1299_handle_t* ads)
+{
+    // Power on defaults from the data sheet seed the shadow with a single burst read
+    CHECK_EQ(mock.reset, 1);
+    CHECK_EQ(mock.rreg, 1);
+    CHECK_EQ(ads->id, 0x3E);
+    // CONFIG2, CONFIG3 and CH1SET..CH8SET in one burst over the clean LOFF between them
+    CHECK_EQ(mock.sdatac, 2);
+    CHECK_EQ(mock.wreg, 1);
+    CHECK_EQ(mock.wreg_regs, 11);
+    CHECK_EQ(mock.rdatac, 1);
+    CHECK_EQ(mock.start, 1);
+    CHECK_EQ(mock.regs[ADS_CONFIG3], 0xFC);
+    CHECK_EQ(mock.regs[ADS_CH8SET], 0x60);
+    check_in_sync(ads);
+}
+
+static void test_batched(ads1299_handle_t* ads)
+{
+    // One write per setter: a SDATAC, WREG and RDATAC each
+    mock_reset_counts();
+    for (int ch = 0; ch < 8; ch++)
+        CHECK_EQ(ads1299_set_ch_gain(ads, ch, GAIN_8), ESP_OK);
+    CHECK_EQ(ads1299_set_datarate(ads, DR_1KSPS), ESP_OK);
+    CHECK_EQ(mock.sdatac, 9);
+    CHECK_EQ(mock.wreg, 9);
+    CHECK_EQ(mock.rdatac, 9);
+    CHECK_EQ(mock.total, 27);
+    check_in_sync(ads);
+
+    // The same changes batched: one SDATAC window, CONFIG1 and the CHnSET run
+    mock_reset_counts();
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    for (int ch = 0; ch < 8; ch++)
+        CHECK_EQ(ads1299_set_ch_gain(ads, ch, GAIN_12), ESP_OK);
+    CHECK_EQ(ads1299_set_datarate(ads, DR_500SPS), ESP_OK);
+    CHECK_EQ(mock.total, 0);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.sdatac, 1);
+    CHECK_EQ(mock.wreg, 2);
+    CHECK_EQ(mock.wreg_regs, 9);
+    CHECK_EQ(mock.rdatac, 1);
+    CHECK_EQ(mock.total, 4);
+    check_in_sync(ads);
+
+    // Nested blocks write once, at the outermost commit
+    mock_reset_counts();
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    CHECK_EQ(ads1299_set_ch(ads, 2, false), ESP_OK);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.total, 0);
+    CHECK_EQ(ads1299_set_ch(ads, 3, false), ESP_OK);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.sdatac, 1);
+    CHECK_EQ(mock.wreg, 1);
+    CHECK_EQ(mock.wreg_regs, 2);
+    CHECK_EQ(mock.rdatac, 1);
+    check_in_sync(ads);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_ERR_INVALID_STATE);
+}
+
+static void test_gaps(ads1299_handle_t* ads)
+{
+    // Two clean registers between dirty ones are rewritten rather than a second WREG
+    mock_reset_counts();
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_input(ads, 0, SHORTED), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_input(ads, ADS_WREG_MAX_GAP + 1, SHORTED), ESP_OK);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.wreg, 1);
+    CHECK_EQ(mock.wreg_regs, ADS_WREG_MAX_GAP + 2);
+    CHECK_EQ(mock.written, 0xFUL << ADS_CH1SET);
+    check_in_sync(ads);
+
+    // One more and it is cheaper to send two
+    mock_reset_counts();
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_input(ads, 0, NORMAL), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_input(ads, ADS_WREG_MAX_GAP + 2, TESTSIG), ESP_OK);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.wreg, 2);
+    CHECK_EQ(mock.wreg_regs, 2);
+    CHECK_EQ(mock.written, (1UL << ADS_CH1SET) | (1UL << (ADS_CH1SET + ADS_WREG_MAX_GAP + 2)));
+    check_in_sync(ads);
+
+    // Bursts never cross the read only lead off status, however short the gap
+    mock_reset_counts();
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    _ads1299_update_reg(ads, ADS_LOFF_FLIP, 0xFF, 0x0F);
+    _ads1299_update_reg(ads, ADS_GPIO, 0xFF, 0x00);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.wreg, 2);
+    CHECK_EQ(mock.written, (1UL << ADS_LOFF_FLIP) | (1UL << ADS_GPIO));
+    check_in_sync(ads);
+}
+
+static void test_unchanged(ads1299_handle_t* ads)
+{
+    // Setting what the shadow already holds sends nothing, batched or not
+    CHECK_EQ(ads1299_set_ch_all(ads, true), ESP_OK);
+    mock_reset_counts();
+    ads1299_gain_t gain;
+    CHECK_EQ(ads1299_get_ch_gain(ads, 5, &gain), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_gain(ads, 5, gain), ESP_OK);
+    ads1299_data_rate_t dr;
+    CHECK_EQ(ads1299_get_datarate(ads, &dr), ESP_OK);
+    CHECK_EQ(ads1299_set_datarate(ads, dr), ESP_OK);
+    CHECK_EQ(ads1299_config_begin(ads), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_all(ads, true), ESP_OK);
+    CHECK_EQ(ads1299_set_ch_gain(ads, 5, gain), ESP_OK);
+    CHECK_EQ(ads1299_config_commit(ads), ESP_OK);
+    CHECK_EQ(mock.total, 0);
+    CHECK_EQ(ads1299_set_ch(ads, 2, false), ESP_OK);  // Changed, written alone
+    CHECK_EQ(mock.sdatac, 1);
+    CHECK_EQ(mock.wreg, 1);
+    CHECK_EQ(mock.wreg_regs, 1);
+    CHECK_EQ(mock.written, 1UL << (ADS_CH1SET + 2));
+    check_in_sync(ads);
+
+    // Only the bits masked in change
+    mock_reset_counts();
+    uint8_t before = ads->regs[ADS_CH1SET + 4];
+    CHECK_EQ(ads1299_set_srb2_ch(ads, 4, true), ESP_OK);
+    CHECK_EQ(mock.regs[ADS_CH1SET + 4], before | 0x08);
+    CHECK_EQ(ads1299_set_srb2_ch(ads, 4, true), ESP_OK);
+    CHECK_EQ(mock.wreg, 1);
+}
+
+int main(void)
+{
+    // Power on register values, ID of an ADS1299
+    static const uint8_t defaults[ADS1299_REG_COUNT] = {
+        0x3E, 0x96, 0xC0, 0x60, 0x00, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+        0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00,
+    };
+    memcpy(mock.regs, defaults, sizeof(defaults));
+
+    const ads1299_spi_ops_t ops = {.transmit = mock_transmit, .polling_transmit = mock_read, .ctx = &mock};
+    const ads1299_config_t config = {
+        .spi_host = SPI2_HOST,
+        .spi_clock_speed_hz = 4000000,
+        .cs_pin = 9,
+        .drdy_pin = 10,
+        .reset_pin = 11,
+        .spi_ops = &ops,
+    };
+    ads1299_handle_t* ads = NULL;
+    CHECK_EQ(ads1299_init(&config, &ads), ESP_OK);
+
+    test_init(ads);
+    test_batched(ads);
+    test_gaps(ads);
+    test_unchanged(ads);
+
+    CHECK_EQ(ads1299_deinit(ads), ESP_OK);
+    printf("ads1299_config: all checks passed\n");
+    return 0;
+}
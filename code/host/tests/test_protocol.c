@@ -0,0 +1,586 @@
+// Round trips through the protocol encoder and decoder, and the decoder's answer
+// to frames it must refuse.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "protocol_interface.h"
+#include "check.h"
+
+#define MTU_PAYLOAD 1472   // 1500 byte Ethernet MTU less the IP and UDP headers
+#define CODE_MIN (-(1 << 23))
+#define CODE_MAX ((1 << 23) - 1)
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    // xorshift32, the same sequence on every run
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Full scale, zero, -1 and random 24 bit codes, so every byte and the sign extension is exercised
+static int32_t test_code(uint32_t s, int ch)
+{
+    switch ((s + ch) % 5) {
+    case 0: return CODE_MIN;
+    case 1: return CODE_MAX;
+    case 2: return -1;
+    case 3: return 0;
+    default: return (int32_t)(rng() & 0xFFFFFF) + CODE_MIN;
+    }
+}
+
+static size_t encode_data(proto_encoder_t* enc, uint8_t n_ch, uint16_t n_samples, uint32_t counter,
+                          int64_t t_us, int32_t* ret_data)
+{
+    CHECK_EQ(proto_encoder_begin(enc, counter, t_us), PROTO_OK);
+    for (uint16_t s = 0; s < n_samples; s++) {
+        int32_t* data = ret_data + (size_t)s * n_ch;
+        for (int ch = 0; ch < n_ch; ch++)
+            data[ch] = test_code(s, ch);
+        CHECK_EQ(proto_encoder_add(enc, 0xC00000 | s, data), PROTO_OK);
+    }
+    return proto_encoder_finish(enc);
+}
+
+static void test_data_round_trip(void)
+{
+    static uint8_t buf[MTU_PAYLOAD];
+    static int32_t sent[PROTO_MAX_CHANNELS * MTU_PAYLOAD], got[PROTO_MAX_CHANNELS * MTU_PAYLOAD];
+    uint8_t gain[PROTO_MAX_CHANNELS];
+    for (int ch = 0; ch < PROTO_MAX_CHANNELS; ch++)
+        gain[ch] = ch % 7;
+
+    for (uint8_t n_ch = 1; n_ch <= PROTO_MAX_CHANNELS; n_ch++) {
+        proto_encoder_t enc;
+        CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 0xDEADBEEF, 4, n_ch, gain), PROTO_OK);
+        CHECK_EQ(proto_encoder_set_flags(&enc, PROTO_FLAG_FILTERED), PROTO_OK);
+        uint16_t capacity = proto_frame_capacity(sizeof(buf), n_ch);
+        CHECK(capacity > 0);
+        CHECK(proto_frame_size(n_ch, capacity) <= sizeof(buf));
+        CHECK(proto_frame_size(n_ch, capacity + 1) > sizeof(buf));
+
+        const uint16_t lengths[] = {1, 2, capacity / 2, capacity};
+        uint32_t counter = 1000u * n_ch;
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+            uint16_t n = lengths[i] ? lengths[i] : 1;
+            int64_t t_us = (int64_t)1 << 40 | counter;
+            size_t len = encode_data(&enc, n_ch, n, counter, t_us, sent);
+            CHECK_EQ(len, proto_frame_size(n_ch, n));
+
+            proto_header_t h;
+            CHECK_EQ(proto_decode_header(buf, len, &h), PROTO_OK);
+            CHECK_EQ(h.version, PROTO_VERSION);
+            CHECK_EQ(h.type, PROTO_TYPE_DATA);
+            CHECK_EQ(h.flags, PROTO_FLAG_FILTERED);
+            CHECK_EQ(h.device_id, 0xDEADBEEF);
+            CHECK_EQ(h.seq, i);
+            CHECK_EQ(h.sample_counter, counter);
+            CHECK_EQ(h.n_samples, n);
+            CHECK_EQ(h.data_rate, 4);
+            CHECK_EQ(h.n_channels, n_ch);
+            CHECK_EQ(h.status, 0xC00000 | (n - 1));
+            CHECK_EQ(h.timestamp_us, t_us);
+            CHECK(memcmp(h.gain, gain, n_ch) == 0);
+
+            CHECK_EQ(proto_decode_samples(buf, len, &h, got), PROTO_OK);
+            CHECK(memcmp(got, sent, (size_t)n * n_ch * sizeof(int32_t)) == 0);
+            counter += n;
+        }
+
+        // A full frame takes no more
+        CHECK_EQ(proto_encoder_begin(&enc, counter, 0), PROTO_OK);
+        for (uint16_t s = 0; s < capacity; s++)
+            CHECK_EQ(proto_encoder_add(&enc, 0, sent), PROTO_OK);
+        CHECK_EQ(proto_encoder_add(&enc, 0, sent), PROTO_ERR_FULL);
+        CHECK_EQ(proto_encoder_finish(&enc), proto_frame_size(n_ch, capacity));
+    }
+}
+
+static void test_data_errors(void)
+{
+    uint8_t buf[256], gain[4] = {0};
+    int32_t data[4 * 8];
+    proto_encoder_t enc;
+    proto_header_t h;
+
+    CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 1, 6, 0, gain), PROTO_ERR_INVALID);
+    CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 1, 6, PROTO_MAX_CHANNELS + 1, gain), PROTO_ERR_INVALID);
+    CHECK_EQ(proto_encoder_init(&enc, buf, proto_frame_size(4, 1) - 1, 1, 6, 4, gain), PROTO_ERR_SHORT);
+    CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 1, 6, 4, gain), PROTO_OK);
+    size_t len = encode_data(&enc, 4, 8, 0, 0, data);
+
+    // Truncated anywhere, in the header or in the samples
+    for (size_t cut = 0; cut < len; cut++) {
+        proto_err_t err = proto_decode_header(buf, cut, &h);
+        CHECK_EQ(err, PROTO_ERR_SHORT);
+    }
+    CHECK_EQ(proto_decode_header(buf, len, &h), PROTO_OK);
+    CHECK_EQ(proto_decode_samples(buf, len - 1, &h, data), PROTO_ERR_SHORT);
+
+    uint8_t bad[256];
+    memcpy(bad, buf, len);
+    bad[0] ^= 0xFF;
+    CHECK_EQ(proto_decode_header(bad, len, &h), PROTO_ERR_MAGIC);
+
+    memcpy(bad, buf, len);
+    bad[2] = PROTO_VERSION + 1;
+    CHECK_EQ(proto_decode_header(bad, len, &h), PROTO_ERR_VERSION);
+    bad[2] = PROTO_VERSION - 1;
+    CHECK_EQ(proto_decode_header(bad, len, &h), PROTO_ERR_VERSION);
+
+    // No channels, or more than a frame may carry
+    memcpy(bad, buf, len);
+    bad[19] = 0;
+    CHECK_EQ(proto_decode_header(bad, len, &h), PROTO_ERR_INVALID);
+    bad[19] = PROTO_MAX_CHANNELS + 1;
+    CHECK_EQ(proto_decode_header(bad, len, &h), PROTO_ERR_INVALID);
+}
+
+static void test_decision(void)
+{
+    uint8_t buf[MTU_PAYLOAD], frame[MTU_PAYLOAD], gain[PROTO_MAX_CHANNELS] = {0};
+    int32_t data[PROTO_MAX_CHANNELS * 4];
+
+    for (uint8_t n_ch = 1; n_ch <= PROTO_MAX_CHANNELS; n_ch += 7) {
+        proto_encoder_t enc;
+        CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 42, 5, n_ch, gain), PROTO_OK);
+        for (uint8_t n_classes = 1; n_classes <= PROTO_MAX_CLASSES; n_classes++) {
+            proto_decision_t d = {.best = n_classes - 1, .n_classes = n_classes, .n_frames = 1000u + n_classes};
+            for (int i = 0; i < n_classes; i++)
+                d.log_likelihood[i] = -1234.5f * i - 0.125f;
+
+            // Decisions take their sequence numbers from the same stream as the data frames
+            uint32_t seq = enc.header.seq;
+            size_t len = proto_encode_decision(&enc, frame, sizeof(frame), 777, -5, &d);
+            CHECK_EQ(len, PROTO_DECISION_SIZE(n_ch, n_classes));
+            encode_data(&enc, n_ch, 4, 778, 0, data);
+
+            proto_header_t h;
+            proto_decision_t got;
+            CHECK_EQ(proto_decode_header(frame, len, &h), PROTO_OK);
+            CHECK_EQ(h.type, PROTO_TYPE_DECISION);
+            CHECK_EQ(h.seq, seq);
+            CHECK_EQ(h.n_samples, 0);
+            CHECK_EQ(h.sample_counter, 777);
+            CHECK_EQ(h.timestamp_us, -5);
+            CHECK_EQ(proto_decode_decision(frame, len, &h, &got), PROTO_OK);
+            CHECK_EQ(got.best, d.best);
+            CHECK_EQ(got.n_classes, n_classes);
+            CHECK_EQ(got.n_frames, d.n_frames);
+            CHECK(memcmp(got.log_likelihood, d.log_likelihood, n_classes * sizeof(float)) == 0);
+            CHECK_EQ(proto_decode_decision(frame, len - 1, &h, &got), PROTO_ERR_SHORT);
+
+            CHECK_EQ(proto_decode_header(buf, sizeof(buf), &h), PROTO_OK);
+            CHECK_EQ(h.seq, seq + 1);
+            CHECK_EQ(proto_decode_decision(buf, sizeof(buf), &h, &got), PROTO_ERR_INVALID);
+        }
+    }
+
+    proto_encoder_t enc;
+    CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 42, 5, 8, gain), PROTO_OK);
+    proto_decision_t d = {.best = 0, .n_classes = PROTO_MAX_CLASSES + 1};
+    CHECK_EQ(proto_encode_decision(&enc, frame, sizeof(frame), 0, 0, &d), 0);
+    d.n_classes = 4;
+    CHECK_EQ(proto_encode_decision(&enc, frame, PROTO_DECISION_SIZE(8, 4) - 1, 0, 0, &d), 0);
+
+    // A winner outside the classes scored is refused
+    size_t len = proto_encode_decision(&enc, frame, sizeof(frame), 0, 0, &d);
+    frame[PROTO_HEADER_SIZE + 8] = 4;
+    proto_header_t h;
+    proto_decision_t got;
+    CHECK_EQ(proto_decode_header(frame, len, &h), PROTO_OK);
+    CHECK_EQ(proto_decode_decision(frame, len, &h, &got), PROTO_ERR_INVALID);
+}
+
+static void test_summary(void)
+{
+    uint8_t buf[MTU_PAYLOAD], frame[MTU_PAYLOAD], gain[PROTO_MAX_CHANNELS] = {0};
+
+    for (uint8_t n_ch = 1; n_ch <= PROTO_MAX_CHANNELS; n_ch++) {
+        proto_encoder_t enc;
+        CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 7, 6, n_ch, gain), PROTO_OK);
+        CHECK_EQ(proto_encoder_set_flags(&enc, PROTO_FLAG_FILTERED), PROTO_OK);
+        proto_summary_t sum = {
+            .n_samples = 250000,
+            .active_samples = 1234 * n_ch,
+            .segments = 65535,
+            .floor = 1.5e-3f,
+            .peak = 8.25e6f,
+        };
+        for (int ch = 0; ch < n_ch; ch++)
+            sum.rms[ch] = 100.0f * ch + 0.5f;
+
+        size_t len = proto_encode_summary(&enc, frame, sizeof(frame), 0xFFFFFFF0u, 123456789, &sum);
+        CHECK_EQ(len, PROTO_SUMMARY_SIZE(n_ch));
+        CHECK_EQ(proto_encode_summary(&enc, frame, len - 1, 0, 0, &sum), 0);
+
+        proto_header_t h;
+        proto_summary_t got;
+        CHECK_EQ(proto_decode_header(frame, len, &h), PROTO_OK);
+        CHECK_EQ(h.type, PROTO_TYPE_SUMMARY);
+        CHECK_EQ(h.flags, PROTO_FLAG_FILTERED);
+        CHECK_EQ(h.seq, 0);
+        CHECK_EQ(h.n_samples, 0);
+        CHECK_EQ(h.sample_counter, 0xFFFFFFF0u);
+        CHECK_EQ(proto_decode_summary(frame, len, &h, &got), PROTO_OK);
+        CHECK_EQ(got.n_samples, sum.n_samples);
+        CHECK_EQ(got.active_samples, sum.active_samples);
+        CHECK_EQ(got.segments, sum.segments);
+        CHECK(got.floor == sum.floor && got.peak == sum.peak);
+        CHECK(memcmp(got.rms, sum.rms, n_ch * sizeof(float)) == 0);
+
+        CHECK_EQ(proto_decode_summary(frame, len - 1, &h, &got), PROTO_ERR_SHORT);
+        h.type = PROTO_TYPE_DECISION;
+        CHECK_EQ(proto_decode_summary(frame, len, &h, &got), PROTO_ERR_INVALID);
+    }
+}
+
+typedef enum { SIG_NOISE, SIG_RAMP, SIG_FULL_SCALE, SIG_EXTREMES } signal_t;
+
+static int32_t signal_code(signal_t sig, uint32_t s, int ch)
+{
+    switch (sig) {
+    case SIG_NOISE: return 1000 * ch - 5000 + (int32_t)(rng() % 33) - 16;
+    case SIG_RAMP: return (int32_t)((s * 37 + ch * 1000) % 20000) - 10000;
+    case SIG_FULL_SCALE: return (int32_t)(rng() & 0xFFFFFF) + CODE_MIN;
+    default: return ((s + ch) & 1) ? CODE_MAX : CODE_MIN;
+    }
+}
+
+static void test_rice(void)
+{
+    static uint8_t buf[MTU_PAYLOAD], scratch[MTU_PAYLOAD];
+    static int32_t sent[PROTO_MAX_CHANNELS * MTU_PAYLOAD], got[PROTO_MAX_CHANNELS * MTU_PAYLOAD];
+    uint8_t gain[PROTO_MAX_CHANNELS] = {0};
+    const uint8_t channels[] = {1, 2, 4, 8, 16, 32};
+
+    for (size_t c = 0; c < sizeof(channels); c++) {
+        uint8_t n_ch = channels[c];
+        uint16_t n = proto_frame_capacity(sizeof(buf), n_ch);
+        for (signal_t sig = SIG_NOISE; sig <= SIG_EXTREMES; sig++) {
+            proto_encoder_t enc;
+            CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 3, 2, n_ch, gain), PROTO_OK);
+            CHECK_EQ(proto_encoder_set_flags(&enc, PROTO_FLAG_FILTERED), PROTO_OK);
+            CHECK_EQ(proto_encoder_set_rice(&enc, scratch, sizeof(scratch)), PROTO_OK);
+            CHECK_EQ(proto_encoder_begin(&enc, 99, 0), PROTO_OK);
+            for (uint16_t s = 0; s < n; s++) {
+                for (int ch = 0; ch < n_ch; ch++)
+                    sent[s * n_ch + ch] = signal_code(sig, s, ch);
+                CHECK_EQ(proto_encoder_add(&enc, 0, sent + s * n_ch), PROTO_OK);
+            }
+            size_t len = proto_encoder_finish(&enc);
+
+            // Coded only when smaller, and the flag says which
+            proto_header_t h;
+            CHECK_EQ(proto_decode_header(buf, len, &h), PROTO_OK);
+            CHECK(h.flags & PROTO_FLAG_FILTERED);
+            if (h.flags & PROTO_FLAG_RICE)
+                CHECK(len < proto_frame_size(n_ch, n));
+            else
+                CHECK_EQ(len, proto_frame_size(n_ch, n));
+            if (sig == SIG_NOISE || sig == SIG_RAMP) CHECK(h.flags & PROTO_FLAG_RICE);
+            if (sig == SIG_FULL_SCALE) CHECK(!(h.flags & PROTO_FLAG_RICE));
+
+            memset(got, 0, (size_t)n * n_ch * sizeof(int32_t));
+            CHECK_EQ(proto_decode_samples(buf, len, &h, got), PROTO_OK);
+            CHECK(memcmp(got, sent, (size_t)n * n_ch * sizeof(int32_t)) == 0);
+            if (h.flags & PROTO_FLAG_RICE)
+                CHECK_EQ(proto_decode_samples(buf, len - 1, &h, got), PROTO_ERR_SHORT);
+        }
+    }
+
+    // The flag is the encoder's alone to set
+    proto_encoder_t enc;
+    CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 3, 2, 8, gain), PROTO_OK);
+    CHECK_EQ(proto_encoder_set_flags(&enc, PROTO_FLAG_RICE), PROTO_ERR_INVALID);
+
+    // Without room to code into, samples that would compress go out raw
+    const size_t scratch_caps[] = {8, sizeof(scratch)};
+    for (int i = 0; i < 2; i++) {
+        CHECK_EQ(proto_encoder_set_rice(&enc, scratch, scratch_caps[i]), PROTO_OK);
+        CHECK_EQ(proto_encoder_begin(&enc, 0, 0), PROTO_OK);
+        for (uint16_t s = 0; s < 20; s++) {
+            for (int ch = 0; ch < 8; ch++)
+                sent[ch] = signal_code(SIG_NOISE, s, ch);
+            CHECK_EQ(proto_encoder_add(&enc, 0, sent), PROTO_OK);
+        }
+        size_t len = proto_encoder_finish(&enc);
+        CHECK_EQ(len == proto_frame_size(8, 20), i == 0);
+        CHECK_EQ(buf[23] & PROTO_FLAG_RICE, i == 0 ? 0 : PROTO_FLAG_RICE);
+    }
+}
+
+static void test_sync(void)
+{
+    uint8_t buf[64];
+    const proto_sync_t req = {
+        .type = PROTO_TYPE_SYNC_REQUEST,
+        .device_id = 0x01020304,
+        .seq = 0xFFFFFFFF,
+        .t1_us = 1700000000123456LL,
+    };
+    const proto_sync_t reply = {
+        .type = PROTO_TYPE_SYNC_REPLY,
+        .device_id = 0xA0B0C0D0,
+        .seq = 17,
+        .t1_us = -1,
+        .t2_us = INT64_MAX,
+        .t3_us = INT64_MIN,
+    };
+    const proto_sync_t* syncs[] = {&req, &reply};
+
+    for (int i = 0; i < 2; i++) {
+        const proto_sync_t* sync = syncs[i];
+        proto_sync_t got;
+        CHECK_EQ(proto_encode_sync(buf, PROTO_SYNC_SIZE - 1, sync), 0);
+        CHECK_EQ(proto_encode_sync(buf, sizeof(buf), sync), PROTO_SYNC_SIZE);
+        CHECK_EQ(proto_decode_sync(buf, PROTO_SYNC_SIZE, &got), PROTO_OK);
+        CHECK_EQ(got.type, sync->type);
+        CHECK_EQ(got.device_id, sync->device_id);
+        CHECK_EQ(got.seq, sync->seq);
+        CHECK_EQ(got.t1_us, sync->t1_us);
+        CHECK_EQ(got.t2_us, sync->t2_us);
+        CHECK_EQ(got.t3_us, sync->t3_us);
+
+        // Not a frame with a stream header
+        proto_header_t h;
+        CHECK_EQ(proto_decode_header(buf, PROTO_SYNC_SIZE, &h), PROTO_ERR_INVALID);
+
+        CHECK_EQ(proto_decode_sync(buf, PROTO_SYNC_SIZE - 1, &got), PROTO_ERR_SHORT);
+        CHECK_EQ(proto_decode_sync(buf, 3, &got), PROTO_ERR_SHORT);
+        buf[2] = PROTO_VERSION + 1;
+        CHECK_EQ(proto_decode_sync(buf, PROTO_SYNC_SIZE, &got), PROTO_ERR_VERSION);
+        buf[0] ^= 0xFF;
+        CHECK_EQ(proto_decode_sync(buf, PROTO_SYNC_SIZE, &got), PROTO_ERR_MAGIC);
+    }
+
+    proto_sync_t bad = req;
+    bad.type = PROTO_TYPE_DATA;
+    CHECK_EQ(proto_encode_sync(buf, sizeof(buf), &bad), 0);
+
+    // A data frame is not a sync frame
+    uint8_t frame[256], gain[4] = {0};
+    int32_t data[4 * 2];
+    proto_encoder_t enc;
+    proto_sync_t got;
+    CHECK_EQ(proto_encoder_init(&enc, frame, sizeof(frame), 1, 6, 4, gain), PROTO_OK);
+    size_t len = encode_data(&enc, 4, 2, 0, 0, data);
+    CHECK_EQ(proto_decode_sync(frame, len, &got), PROTO_ERR_INVALID);
+}
+
+static void test_telemetry(void)
+{
+    static uint8_t buf[MTU_PAYLOAD], frame[MTU_PAYLOAD];
+    uint8_t gain[PROTO_MAX_CHANNELS] = {0};
+    proto_telemetry_t t = {
+        .drdy_count = 4000000000u,
+        .sample_count = 3999999000u,
+        .missed_drdy = 1000,
+        .ring_overflows = 17,
+        .ring_count = 12,
+        .ring_high_water = 511,
+        .ring_capacity = 512,
+        .rssi = -67,
+        .cpu_mhz = 240,
+        .frames_sent = 123456,
+        .samples_sent = 7654321,
+        .send_retries = 3,
+        .send_errors = 2,
+        .samples_dropped = 1,
+        .sent_bytes = 0xFFFFFFFF,
+        .latency_max_us = 850,
+        .heap_min_free = 150000,
+        .retransmits = 44,
+        .replay_misses = 5,
+    };
+    for (int i = 0; i < PROTO_TLM_TIMERS; i++) {
+        proto_tlm_stats_t* st = &t.timers[i];
+        st->count = 1000u * (i + 1);
+        st->min_cycles = 100u + i;
+        st->max_cycles = 0xF0000000u + i;
+        st->total_cycles = 0x123456789ABCull * (i + 1);
+        for (int b = 0; b < PROTO_TLM_HIST_BINS; b++)
+            st->hist[b] = (uint32_t)(i * 100 + b);
+    }
+
+    for (uint8_t n_ch = 1; n_ch <= PROTO_MAX_CHANNELS; n_ch += 31) {
+        proto_encoder_t enc;
+        CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 9, 4, n_ch, gain), PROTO_OK);
+        size_t len = proto_encode_telemetry(&enc, frame, sizeof(frame), 5000, 6000, &t);
+        CHECK_EQ(len, PROTO_TELEMETRY_SIZE(n_ch));
+        CHECK(len <= MTU_PAYLOAD);
+        CHECK_EQ(proto_encode_telemetry(&enc, frame, len - 1, 0, 0, &t), 0);
+
+        proto_header_t h;
+        proto_telemetry_t got;
+        CHECK_EQ(proto_decode_header(frame, len, &h), PROTO_OK);
+        CHECK_EQ(h.type, PROTO_TYPE_TELEMETRY);
+        CHECK_EQ(h.sample_counter, 5000);
+        CHECK_EQ(h.timestamp_us, 6000);
+        CHECK_EQ(proto_decode_telemetry(frame, len, &h, &got), PROTO_OK);
+        CHECK_EQ(got.drdy_count, t.drdy_count);
+        CHECK_EQ(got.sample_count, t.sample_count);
+        CHECK_EQ(got.missed_drdy, t.missed_drdy);
+        CHECK_EQ(got.ring_overflows, t.ring_overflows);
+        CHECK_EQ(got.ring_count, t.ring_count);
+        CHECK_EQ(got.ring_high_water, t.ring_high_water);
+        CHECK_EQ(got.ring_capacity, t.ring_capacity);
+        CHECK_EQ(got.rssi, t.rssi);
+        CHECK_EQ(got.cpu_mhz, t.cpu_mhz);
+        CHECK_EQ(got.frames_sent, t.frames_sent);
+        CHECK_EQ(got.samples_sent, t.samples_sent);
+        CHECK_EQ(got.send_retries, t.send_retries);
+        CHECK_EQ(got.send_errors, t.send_errors);
+        CHECK_EQ(got.samples_dropped, t.samples_dropped);
+        CHECK_EQ(got.sent_bytes, t.sent_bytes);
+        CHECK_EQ(got.latency_max_us, t.latency_max_us);
+        CHECK_EQ(got.heap_min_free, t.heap_min_free);
+        CHECK_EQ(got.retransmits, t.retransmits);
+        CHECK_EQ(got.replay_misses, t.replay_misses);
+        for (int i = 0; i < PROTO_TLM_TIMERS; i++) {
+            CHECK_EQ(got.timers[i].count, t.timers[i].count);
+            CHECK_EQ(got.timers[i].min_cycles, t.timers[i].min_cycles);
+            CHECK_EQ(got.timers[i].max_cycles, t.timers[i].max_cycles);
+            CHECK_EQ(got.timers[i].total_cycles, t.timers[i].total_cycles);
+            CHECK(memcmp(got.timers[i].hist, t.timers[i].hist, sizeof(t.timers[i].hist)) == 0);
+        }
+
+        CHECK_EQ(proto_decode_telemetry(frame, len - 1, &h, &got), PROTO_ERR_SHORT);
+        h.type = PROTO_TYPE_SUMMARY;
+        CHECK_EQ(proto_decode_telemetry(frame, len, &h, &got), PROTO_ERR_INVALID);
+    }
+}
+
+static void test_nack(void)
+{
+    uint8_t buf[PROTO_NACK_SIZE(PROTO_NACK_MAX_RANGES)];
+    const uint8_t range_counts[] = {0, 1, 5, PROTO_NACK_MAX_RANGES};
+
+    for (size_t r = 0; r < sizeof(range_counts); r++) {
+        proto_nack_t nack = {.device_id = 0xCAFEF00D, .seq = 1000 + r, .n_ranges = range_counts[r]};
+        for (int i = 0; i < nack.n_ranges; i++)
+            nack.ranges[i] = (proto_nack_range_t) {.first_seq = 0xFFFFFF00u + 7 * i, .count = 1 + i * 2000};
+
+        size_t len = proto_encode_nack(buf, sizeof(buf), &nack);
+        CHECK_EQ(len, PROTO_NACK_SIZE(nack.n_ranges));
+        CHECK_EQ(proto_encode_nack(buf, len - 1, &nack), 0);
+
+        proto_nack_t got;
+        CHECK_EQ(proto_decode_nack(buf, len, &got), PROTO_OK);
+        CHECK_EQ(got.device_id, nack.device_id);
+        CHECK_EQ(got.seq, nack.seq);
+        CHECK_EQ(got.n_ranges, nack.n_ranges);
+        for (int i = 0; i < nack.n_ranges; i++) {
+            CHECK_EQ(got.ranges[i].first_seq, nack.ranges[i].first_seq);
+            CHECK_EQ(got.ranges[i].count, nack.ranges[i].count);
+        }
+        CHECK_EQ(proto_decode_nack(buf, len - 1, &got), PROTO_ERR_SHORT);
+        proto_header_t h;
+        CHECK_EQ(proto_decode_header(buf, len, &h), len < PROTO_HEADER_SIZE ? PROTO_ERR_SHORT : PROTO_ERR_INVALID);
+    }
+
+    // More ranges than a NACK holds, the wrong type, version and magic
+    proto_nack_t nack = {.n_ranges = PROTO_NACK_MAX_RANGES + 1};
+    CHECK_EQ(proto_encode_nack(buf, sizeof(buf), &nack), 0);
+    nack.n_ranges = 1;
+    size_t len = proto_encode_nack(buf, sizeof(buf), &nack);
+    proto_nack_t got;
+    buf[12] = PROTO_NACK_MAX_RANGES + 1;
+    CHECK_EQ(proto_decode_nack(buf, sizeof(buf), &got), PROTO_ERR_INVALID);
+    buf[12] = 1;
+    buf[3] = PROTO_TYPE_SYNC_REQUEST;
+    CHECK_EQ(proto_decode_nack(buf, len, &got), PROTO_ERR_INVALID);
+    buf[3] = PROTO_TYPE_NACK;
+    buf[2] = PROTO_VERSION + 1;
+    CHECK_EQ(proto_decode_nack(buf, len, &got), PROTO_ERR_VERSION);
+    buf[0] ^= 0xFF;
+    CHECK_EQ(proto_decode_nack(buf, len, &got), PROTO_ERR_MAGIC);
+}
+
+static void test_replay(void)
+{
+    static uint8_t buf[MTU_PAYLOAD], window[8 * 1024], sent[64][MTU_PAYLOAD];
+    static size_t sent_len[64];
+    int32_t data[8 * 40], got[8 * 40];
+    uint8_t gain[8] = {0};
+    const size_t max_frame = proto_frame_size(8, 40);
+
+    proto_replay_t replay;
+    CHECK_EQ(proto_replay_init(&replay, window, sizeof(window), PROTO_HEADER_SIZE - 1), PROTO_ERR_INVALID);
+    CHECK_EQ(proto_replay_init(&replay, window, max_frame + 1, max_frame), PROTO_ERR_SHORT);
+    CHECK_EQ(proto_replay_init(&replay, window, sizeof(window), max_frame), PROTO_OK);
+    const uint32_t n_slots = replay.n_slots;
+    CHECK_EQ(n_slots, sizeof(window) / (max_frame + 2));
+
+    // Frames of varying lengths, more than the window holds
+    proto_encoder_t enc;
+    CHECK_EQ(proto_encoder_init(&enc, buf, sizeof(buf), 5, 3, 8, gain), PROTO_OK);
+    CHECK_EQ(proto_encoder_set_flags(&enc, PROTO_FLAG_FILTERED), PROTO_OK);
+    const uint32_t n_frames = 3 * n_slots + 1;
+    CHECK(n_frames <= 64);
+    for (uint32_t seq = 0; seq < n_frames; seq++) {
+        size_t len = encode_data(&enc, 8, 1 + seq % 40, seq * 100, seq, data);
+        CHECK_EQ(proto_replay_store(&replay, buf, len), PROTO_OK);
+        memcpy(sent[seq], buf, len);
+        sent_len[seq] = len;
+    }
+
+    // The latest n_slots frames come back as sent, but for the retransmit flag
+    for (uint32_t seq = 0; seq < n_frames + 5; seq++) {
+        const uint8_t* frame = NULL;
+        size_t len = proto_replay_get(&replay, seq, &frame);
+        if (seq + n_slots < n_frames || seq >= n_frames) {
+            CHECK_EQ(len, 0);
+            continue;
+        }
+        CHECK_EQ(len, sent_len[seq]);
+        CHECK_EQ(frame[23], PROTO_FLAG_FILTERED | PROTO_FLAG_RETRANSMIT);
+        CHECK(memcmp(frame, sent[seq], 23) == 0);
+        CHECK(memcmp(frame + 24, sent[seq] + 24, len - 24) == 0);
+
+        proto_header_t h;
+        CHECK_EQ(proto_decode_header(frame, len, &h), PROTO_OK);
+        CHECK_EQ(h.seq, seq);
+        CHECK_EQ(h.flags, PROTO_FLAG_FILTERED | PROTO_FLAG_RETRANSMIT);
+        CHECK_EQ(proto_decode_samples(frame, len, &h, got), PROTO_OK);
+        proto_header_t orig;
+        CHECK_EQ(proto_decode_header(sent[seq], sent_len[seq], &orig), PROTO_OK);
+        CHECK_EQ(proto_decode_samples(sent[seq], sent_len[seq], &orig, data), PROTO_OK);
+        CHECK(memcmp(got, data, (size_t)h.n_samples * 8 * sizeof(int32_t)) == 0);
+
+        // Asked again, still there and flagged once
+        CHECK_EQ(proto_replay_get(&replay, seq, &frame), len);
+        CHECK_EQ(frame[23], PROTO_FLAG_FILTERED | PROTO_FLAG_RETRANSMIT);
+    }
+
+    CHECK_EQ(proto_replay_store(&replay, buf, PROTO_HEADER_SIZE - 1), PROTO_ERR_SHORT);
+    CHECK_EQ(proto_replay_store(&replay, buf, max_frame + 1), PROTO_ERR_FULL);
+
+    proto_replay_clear(&replay);
+    const uint8_t* frame;
+    for (uint32_t seq = 0; seq < n_frames; seq++)
+        CHECK_EQ(proto_replay_get(&replay, seq, &frame), 0);
+
+    // Only the encoder's own frames are ever marked as resent
+    CHECK_EQ(proto_encoder_set_flags(&enc, PROTO_FLAG_RETRANSMIT), PROTO_ERR_INVALID);
+}
+
+int main(void)
+{
+    test_data_round_trip();
+    test_data_errors();
+    test_decision();
+    test_summary();
+    test_rice();
+    test_sync();
+    test_telemetry();
+    test_nack();
+    test_replay();
+    printf("protocol: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+// The SPSC ring: full and empty edges, slot and index wrap-around, the statistics, and
+// strict FIFO order between a producer and a consumer thread.
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spsc_ring_interface.h"
+#include "check.h"
+
+#define ELEM_SIZE 12
+#define THREADED_ITEMS (4 * 1000 * 1000)
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check;
+    uint32_t pad;
+} elem_t;
+
+static elem_t make_elem(uint32_t seq)
+{
+    return (elem_t) {.seq = seq, .check = ~seq * 2654435761u};
+}
+
+static spsc_ring_handle_t* new_ring(uint32_t capacity)
+{
+    spsc_ring_config_t config = {.elem_size = sizeof(elem_t), .capacity = capacity};
+    spsc_ring_handle_t* ring = NULL;
+    CHECK_EQ(spsc_ring_init(&config, &ring), SPSC_RING_OK);
+    return ring;
+}
+
+static void test_init(void)
+{
+    spsc_ring_handle_t* ring = NULL;
+    spsc_ring_config_t config = {.elem_size = ELEM_SIZE, .capacity = 0};
+    CHECK_EQ(spsc_ring_init(&config, &ring), SPSC_RING_ERR_INVALID);
+    config.capacity = 12;
+    CHECK_EQ(spsc_ring_init(&config, &ring), SPSC_RING_ERR_INVALID);
+    config.capacity = 16;
+    config.elem_size = 0;
+    CHECK_EQ(spsc_ring_init(&config, &ring), SPSC_RING_ERR_INVALID);
+    CHECK(ring == NULL);
+}
+
+static void test_empty(void)
+{
+    spsc_ring_handle_t* ring = new_ring(4);
+    elem_t e = make_elem(7), got = make_elem(99);
+    CHECK(!spsc_ring_pop(ring, &got));
+    CHECK_EQ(got.seq, 99);  // Untouched
+    CHECK_EQ(spsc_ring_count(ring), 0);
+
+    CHECK(spsc_ring_push(ring, &e));
+    CHECK(spsc_ring_pop(ring, &got));
+    CHECK_EQ(got.seq, 7);
+    CHECK(!spsc_ring_pop(ring, &got));
+    spsc_ring_deinit(ring);
+}
+
+static void test_full(void)
+{
+    const uint32_t cap = 8;
+    spsc_ring_handle_t* ring = new_ring(cap);
+    for (uint32_t i = 0; i < cap; i++) {
+        elem_t e = make_elem(i);
+        CHECK(spsc_ring_push(ring, &e));
+    }
+    for (uint32_t i = 0; i < 5; i++) {
+        elem_t e = make_elem(100 + i);
+        CHECK(!spsc_ring_push(ring, &e));
+    }
+
+    spsc_ring_stats_t stats;
+    spsc_ring_get_stats(ring, &stats);
+    CHECK_EQ(stats.capacity, cap);
+    CHECK_EQ(stats.count, cap);
+    CHECK_EQ(stats.high_water, cap);
+    CHECK_EQ(stats.overflows, 5);
+    CHECK_EQ(stats.pushed, cap);
+
+    // Rejected pushes never overwrote anything
+    for (uint32_t i = 0; i < cap; i++) {
+        elem_t got;
+        CHECK(spsc_ring_pop(ring, &got));
+        CHECK_EQ(got.seq, i);
+    }
+
+    // One slot free takes exactly one more
+    elem_t e = make_elem(200);
+    CHECK(spsc_ring_push(ring, &e));
+    spsc_ring_get_stats(ring, &stats);
+    CHECK_EQ(stats.count, 1);
+    CHECK_EQ(stats.overflows, 5);
+
+    spsc_ring_reset_stats(ring);
+    spsc_ring_get_stats(ring, &stats);
+    CHECK_EQ(stats.overflows, 0);
+    CHECK_EQ(stats.high_water, 1);  // What it holds now
+    spsc_ring_deinit(ring);
+}
+
+static void test_wrap(void)
+{
+    // Slots wrap many times over at every power of two, with the fill level varying
+    for (uint32_t cap = 1; cap <= 64; cap *= 2) {
+        spsc_ring_handle_t* ring = new_ring(cap);
+        uint32_t next_push = 0, next_pop = 0, high = 0;
+        for (int round = 0; round < 200; round++) {
+            uint32_t n = 1 + (round * 7) % cap;
+            for (uint32_t i = 0; i < n; i++) {
+                elem_t e = make_elem(next_push);
+                if (spsc_ring_push(ring, &e)) next_push++;
+            }
+            uint32_t count = next_push - next_pop;
+            CHECK_EQ(spsc_ring_count(ring), count);
+            if (count > high) high = count;
+            uint32_t m = 1 + (round * 5) % cap;
+            for (uint32_t i = 0; i < m && next_pop < next_push; i++) {
+                elem_t got;
+                CHECK(spsc_ring_pop(ring, &got));
+                CHECK_EQ(got.seq, next_pop);
+                CHECK_EQ(got.check, make_elem(next_pop).check);
+                next_pop++;
+            }
+        }
+        spsc_ring_stats_t stats;
+        spsc_ring_get_stats(ring, &stats);
+        CHECK_EQ(stats.high_water, high);
+        CHECK_EQ(stats.pushed, next_push);
+        spsc_ring_deinit(ring);
+    }
+
+    // The free running indices wrap too
+    spsc_ring_handle_t* ring = new_ring(4);
+    atomic_store(&ring->head, UINT32_MAX - 2);
+    atomic_store(&ring->tail, UINT32_MAX - 2);
+    for (uint32_t i = 0; i < 4; i++) {
+        elem_t e = make_elem(i);
+        CHECK(spsc_ring_push(ring, &e));
+    }
+    elem_t e = make_elem(4);
+    CHECK(!spsc_ring_push(ring, &e));
+    CHECK_EQ(spsc_ring_count(ring), 4);
+    for (uint32_t i = 0; i < 4; i++) {
+        elem_t got;
+        CHECK(spsc_ring_pop(ring, &got));
+        CHECK_EQ(got.seq, i);
+    }
+    CHECK_EQ(spsc_ring_count(ring), 0);
+    spsc_ring_deinit(ring);
+}
+
+static void test_clear(void)
+{
+    spsc_ring_handle_t* ring = new_ring(8);
+    for (uint32_t i = 0; i < 5; i++) {
+        elem_t e = make_elem(i);
+        CHECK(spsc_ring_push(ring, &e));
+    }
+    spsc_ring_clear(ring);
+    CHECK_EQ(spsc_ring_count(ring), 0);
+    elem_t got;
+    CHECK(!spsc_ring_pop(ring, &got));
+    spsc_ring_deinit(ring);
+}
+
+static void* producer(void* arg)
+{
+    spsc_ring_handle_t* ring = arg;
+    for (uint32_t i = 0; i < THREADED_ITEMS; i++) {
+        elem_t e = make_elem(i);
+        while (!spsc_ring_push(ring, &e))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    // A small ring so both the full and the empty side are hit often
+    spsc_ring_handle_t* ring = new_ring(64);
+    pthread_t thread;
+    CHECK_EQ(pthread_create(&thread, NULL, producer, ring), 0);
+
+    for (uint32_t i = 0; i < THREADED_ITEMS; ) {
+        elem_t got;
+        if (!spsc_ring_pop(ring, &got)) {
+            sched_yield();
+            continue;
+        }
+        CHECK_EQ(got.seq, i);
+        CHECK_EQ(got.check, make_elem(i).check);
+        i++;
+    }
+    pthread_join(thread, NULL);
+
+    spsc_ring_stats_t stats;
+    spsc_ring_get_stats(ring, &stats);
+    CHECK_EQ(stats.count, 0);
+    CHECK_EQ(stats.pushed, THREADED_ITEMS);
+    CHECK(stats.high_water <= 64);
+    spsc_ring_deinit(ring);
+}
+
+int main(void)
+{
+    test_init();
+    test_empty();
+    test_full();
+    test_wrap();
+    test_clear();
+    test_threads();
+    printf("spsc_ring: all checks passed\n");
+    return 0;
+}
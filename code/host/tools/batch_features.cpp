@@ -0,0 +1,327 @@
+#include "batch_features.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include "zero_phase.hpp"
+
+extern "C" {
+#include "emg_features_interface.h"
+#include "iir_interface.h"
+#include "mfcc_interface.h"
+}
+
+namespace nexus {
+
+static_assert(sizeof(iir_float_t) == sizeof(double), "batch features filter in double precision, link nexus_iir_f64");
+
+std::vector<FeatureBlock> parse_feature_blocks(const std::string& spec)
+{
+    if (spec == "F1") return {FeatureBlock::F1};
+    if (spec == "F2") return {FeatureBlock::MAV, FeatureBlock::WL, FeatureBlock::MFCC};
+
+    std::vector<FeatureBlock> blocks;
+    std::stringstream ss(spec);
+    for (std::string name; std::getline(ss, name, ',');) {
+        if (name == "mav") blocks.push_back(FeatureBlock::MAV);
+        else if (name == "wl") blocks.push_back(FeatureBlock::WL);
+        else if (name == "zc") blocks.push_back(FeatureBlock::ZC);
+        else if (name == "ssc") blocks.push_back(FeatureBlock::SSC);
+        else if (name == "mfcc") blocks.push_back(FeatureBlock::MFCC);
+        else if (name == "f1") blocks.push_back(FeatureBlock::F1);
+        else throw std::invalid_argument("unknown feature " + name);
+    }
+    if (blocks.empty()) throw std::invalid_argument("no features in " + spec);
+    return blocks;
+}
+
+static size_t block_width(const FeatureSpec& spec, FeatureBlock block, size_t n_ch)
+{
+    switch (block) {
+    case FeatureBlock::MFCC: return spec.n_mfcc * n_ch;
+    case FeatureBlock::F1: return 5 * n_ch;
+    default: return n_ch;
+    }
+}
+
+size_t feature_width(const FeatureSpec& spec, size_t n_channels)
+{
+    size_t width = 0;
+    for (FeatureBlock b : spec.blocks) width += block_width(spec, b, n_channels);
+    return width;
+}
+
+namespace {
+
+// Engines of one worker, built before the run so tasks never allocate them
+struct Scratch {
+    iir_handle_t* iir = nullptr;      // One channel
+    feat_handle_t* feat = nullptr;    // One channel
+    mfcc_handle_t* mfcc = nullptr;    // Every channel
+    std::vector<double> x;            // Channel being filtered
+    std::vector<float> mfcc_out;
+
+    ~Scratch()
+    {
+        if (iir) iir_deinit(iir);
+        if (feat) feat_deinit(feat);
+        if (mfcc) mfcc_deinit(mfcc);
+    }
+};
+
+struct TrialJob {
+    size_t index;                     // In the dataset
+    size_t row;                       // First output row
+    size_t start, len;                // Trimmed samples
+    size_t windows;
+    std::vector<float> filtered;      // Trimmed samples of every channel, for the MFCCs
+    std::atomic<size_t> channels_left;
+};
+
+struct Job {
+    Job(Dataset& ds, const FeatureSpec& spec, size_t n_ch)
+        : ds(ds), spec(spec), n_ch(n_ch), width(feature_width(spec, n_ch)) {}
+
+    Dataset& ds;
+    const FeatureSpec& spec;
+    size_t n_ch;
+    size_t width;
+    long offset[6] = {-1, -1, -1, -1, -1, -1};   // Column of each FeatureBlock, -1 when absent
+    double* x = nullptr;
+    iir_config_t highpass = {}, bandstop = {};   // The two sosfiltfilt calls of hmm.ipynb, for zero_phase
+    std::vector<std::unique_ptr<Scratch>> scratch;
+    std::vector<std::unique_ptr<TrialJob>> trials;
+
+    std::mutex error_mutex;
+    std::string error;
+};
+
+double sample(const View& v, size_t row, size_t col)
+{
+    size_t i = v.index(row, col);
+    switch (v.dtype) {
+    case Dtype::F8: return static_cast<const double*>(v.data)[i];
+    case Dtype::F4: return static_cast<const float*>(v.data)[i];
+    default: return static_cast<const int32_t*>(v.data)[i];
+    }
+}
+
+// 9 point moving average of F1, zero padded to the same length
+void moving_average(const double* in, double* out, int n)
+{
+    const int half = 4;
+    for (int i = 0; i < n; i++) {
+        double acc = 0;
+        for (int j = std::max(0, i - half); j <= std::min(n - 1, i + half); j++) acc += in[j];
+        out[i] = acc / (2 * half + 1);
+    }
+}
+
+// F1() of one channel of one window, ret[0..4] = x_bar, w_bar, r_bar, P_w, P_r
+void f1_window(const double* a, int n, double fs, double* ret)
+{
+    std::vector<double> d(n), v(n), w(n);
+    double mean = 0;
+    for (int i = 0; i < n; i++) mean += a[i];
+    mean /= n;
+    for (int i = 0; i < n; i++) d[i] = a[i] - mean;
+    moving_average(d.data(), v.data(), n);
+    moving_average(v.data(), w.data(), n);
+
+    double x_bar = 0, w_bar = 0, r_bar = 0, p_w = 0, p_r = 0;
+    for (int i = 0; i < n; i++) {
+        double r = std::fabs(d[i] - w[i]);
+        x_bar += d[i];
+        w_bar += w[i];
+        r_bar += r;
+        p_w += w[i] * w[i];
+        p_r += r * r;
+    }
+    double seconds = n / fs;
+    ret[0] = x_bar / n;
+    ret[1] = w_bar / n;
+    ret[2] = r_bar / n;
+    ret[3] = p_w / seconds;
+    ret[4] = p_r / seconds;
+}
+
+void mfcc_task(Job& job, TrialJob& t, unsigned worker)
+{
+    Scratch& s = *job.scratch[worker];
+    const FeatureSpec& spec = job.spec;
+    for (size_t k = 0; k < t.windows; k++) {
+        mfcc_compute(s.mfcc, t.filtered.data() + k * spec.stride * job.n_ch, s.mfcc_out.data());
+        double* out = job.x + (t.row + k) * job.width + job.offset[(int)FeatureBlock::MFCC];
+        for (size_t i = 0; i < s.mfcc_out.size(); i++) out[i] = s.mfcc_out[i];
+    }
+    std::vector<float>().swap(t.filtered);
+}
+
+void channel_task(WorkPool& pool, Job& job, TrialJob& t, size_t ch, unsigned worker)
+{
+    Scratch& s = *job.scratch[worker];
+    const FeatureSpec& spec = job.spec;
+    const size_t n_ch = job.n_ch;
+    View v = job.ds.view(t.index);
+
+    // DC removal over the whole recording, then causal filtering as lda.ipynb does, or
+    // forward-backward with even padding, one filter at a time, as hmm.ipynb does
+    s.x.resize(v.rows);
+    double mean = 0;
+    for (size_t r = 0; r < v.rows; r++) mean += s.x[r] = sample(v, r, ch);
+    mean /= v.rows;
+    for (size_t r = 0; r < v.rows; r++) s.x[r] -= mean;
+    if (spec.filter && spec.zero_phase) {
+        try {
+            sosfiltfilt(job.highpass, PadType::Even, s.x.data(), v.rows, 1);
+            sosfiltfilt(job.bandstop, PadType::Even, s.x.data(), v.rows, 1);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("features: " + job.ds.trials()[t.index].path + ": " + e.what());
+        }
+    } else if (spec.filter) {
+        iir_reset(s.iir);
+        iir_process(s.iir, s.x.data(), s.x.data(), v.rows);
+    }
+    const double* x = s.x.data() + t.start;
+
+    if (!t.filtered.empty())
+        for (size_t i = 0; i < t.len; i++) t.filtered[i * n_ch + ch] = x[i];
+
+    const long* off = job.offset;
+    bool td = off[(int)FeatureBlock::MAV] >= 0 || off[(int)FeatureBlock::WL] >= 0 ||
+              off[(int)FeatureBlock::ZC] >= 0 || off[(int)FeatureBlock::SSC] >= 0;
+    if (td) {
+        feat_reset(s.feat);
+        feat_vector_t vec;
+        size_t k = 0;
+        for (size_t i = 0; i < t.len && k < t.windows; i++) {
+            float f = x[i];
+            if (!feat_push(s.feat, &f, &vec)) continue;
+            double* out = job.x + (t.row + k++) * job.width + ch;
+            if (off[(int)FeatureBlock::MAV] >= 0) out[off[(int)FeatureBlock::MAV]] = vec.mav[0];
+            if (off[(int)FeatureBlock::WL] >= 0) out[off[(int)FeatureBlock::WL]] = vec.wl[0];
+            if (off[(int)FeatureBlock::ZC] >= 0) out[off[(int)FeatureBlock::ZC]] = vec.zc[0];
+            if (off[(int)FeatureBlock::SSC] >= 0) out[off[(int)FeatureBlock::SSC]] = vec.ssc[0];
+        }
+    }
+    if (off[(int)FeatureBlock::F1] >= 0) {
+        double f1[5];
+        for (size_t k = 0; k < t.windows; k++) {
+            f1_window(x + k * spec.stride, spec.window, spec.fs, f1);
+            double* out = job.x + (t.row + k) * job.width + off[(int)FeatureBlock::F1] + ch;
+            for (int q = 0; q < 5; q++) out[q * n_ch] = f1[q];
+        }
+    }
+
+    // The last channel in hands the trial to the MFCC engine, on this worker's deque
+    if (t.channels_left.fetch_sub(1, std::memory_order_acq_rel) == 1 && !t.filtered.empty())
+        pool.push([&job, &t](unsigned w) { mfcc_task(job, t, w); });
+}
+
+} // namespace
+
+FeatureMatrix extract_features(Dataset& ds, const std::vector<size_t>& trials, const FeatureSpec& spec,
+                               unsigned n_threads, FeatureRunStats* stats)
+{
+    FeatureMatrix m;
+    if (trials.empty()) return m;
+    const size_t n_ch = ds.trials()[trials[0]].cols;
+    for (size_t i : trials)
+        if (ds.trials()[i].cols != n_ch)
+            throw std::runtime_error("features: " + ds.trials()[i].path + " has " + std::to_string(ds.trials()[i].cols) +
+                                     " channels, the first trial " + std::to_string(n_ch));
+
+    Job job(ds, spec, n_ch);
+    size_t col = 0;
+    for (FeatureBlock b : spec.blocks) {
+        job.offset[(int)b] = col;
+        col += block_width(spec, b, n_ch);
+    }
+    bool mfcc = job.offset[(int)FeatureBlock::MFCC] >= 0;
+
+    // Rows of every trial are known from the headers, so the matrix is laid out up front
+    size_t rows = 0;
+    for (size_t i : trials) {
+        const Trial& t = ds.trials()[i];
+        auto job_t = std::make_unique<TrialJob>();
+        job_t->index = i;
+        job_t->row = rows;
+        // A trial ending before the trim starts gives no rows rather than wrapping round
+        job_t->start = std::min<size_t>(spec.trim_start * spec.fs, t.rows);
+        size_t end = std::min<size_t>(spec.trim_end * spec.fs, t.rows);
+        job_t->len = end > job_t->start ? end - job_t->start : 0;
+        job_t->windows = job_t->len >= (size_t)spec.window ? (job_t->len - spec.window) / spec.stride + 1 : 0;
+        job_t->channels_left = n_ch;
+        if (mfcc && job_t->windows) job_t->filtered.resize(job_t->len * n_ch);
+        m.trials.push_back(i);
+        m.first.push_back(rows);
+        m.windows.push_back(job_t->windows);
+        rows += job_t->windows;
+        job.trials.push_back(std::move(job_t));
+    }
+    m.x.rows = rows;
+    m.x.cols = job.width;
+    m.x.data.assign(rows * job.width, 0.0);
+    job.x = m.x.data.data();
+
+    WorkPool pool(n_threads);
+    iir_config_t iir_config = {};
+    iir_config.n_channels = 1;
+    iir_butter(&iir_config, 4, IIR_HIGHPASS, 0.5, 0, spec.fs);
+    iir_butter(&iir_config, 4, IIR_BANDSTOP, 48, 52, spec.fs);
+    job.highpass.n_channels = job.bandstop.n_channels = 1;
+    iir_butter(&job.highpass, 4, IIR_HIGHPASS, 0.5, 0, spec.fs);
+    iir_butter(&job.bandstop, 4, IIR_BANDSTOP, 48, 52, spec.fs);
+    feat_config_t feat_config = {};
+    feat_config.n_channels = 1;
+    feat_config.window = spec.window;
+    feat_config.stride = spec.stride;
+    feat_config.zc_threshold = 20;
+    feat_config.ssc_threshold = 20;
+    mfcc_config_t mfcc_config = {};
+    mfcc_config.n_channels = n_ch;
+    mfcc_config.n_fft = spec.window;
+    mfcc_config.n_mels = spec.n_mels;
+    mfcc_config.n_mfcc = spec.n_mfcc;
+    mfcc_config.sample_rate = spec.fs;
+    mfcc_config.top_db = 80;
+    mfcc_config.pad = MFCC_PAD_CONSTANT;
+    for (unsigned w = 0; w < pool.size(); w++) {
+        auto s = std::make_unique<Scratch>();
+        if (iir_init(&iir_config, &s->iir) != IIR_OK || feat_init(&feat_config, &s->feat) != FEAT_OK ||
+            (mfcc && mfcc_init(&mfcc_config, &s->mfcc) != MFCC_OK))
+            throw std::runtime_error("features: bad window, stride or MFCC size for " + std::to_string(n_ch) + " channels");
+        s->mfcc_out.resize(spec.n_mfcc * n_ch);
+        job.scratch.push_back(std::move(s));
+    }
+
+    for (auto& t : job.trials) {
+        if (!t->windows) continue;
+        for (size_t ch = 0; ch < n_ch; ch++) {
+            TrialJob* tp = t.get();
+            pool.push([&pool, &job, tp, ch](unsigned w) {
+                try {
+                    channel_task(pool, job, *tp, ch, w);
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(job.error_mutex);
+                    job.error = e.what();
+                }
+            });
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run();
+    if (!job.error.empty()) throw std::runtime_error(job.error);
+    if (stats) {
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->workers.clear();
+        for (unsigned w = 0; w < pool.size(); w++) stats->workers.push_back(pool.stats(w));
+    }
+    return m;
+}
+
+} // namespace nexus
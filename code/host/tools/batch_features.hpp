@@ -0,0 +1,66 @@
+// Batch feature extraction over dataset trials, the pipeline of lda.ipynb and
+// hmm.ipynb: DC removal, 0.5 Hz high-pass and 48-52 Hz band-stop, trim to
+// INITIALIZATION_WINDOW, window_generator() windows, and per window the blocks of F1()
+// or F2() in feature_extractors.py. The filters run causally by default, as the
+// cascaded sosfilt of lda.ipynb (bit for bit); zero_phase runs each as
+// sosfiltfilt(padtype='even'), as hmm.ipynb does.
+//
+// Work is split over a WorkPool per trial and channel: filtering, the time domain
+// features and F1 only see their own channel. The MFCCs of F2 do not, librosa floors
+// every channel of a window at the same top_db, so the last channel of a trial to
+// finish spawns one task for the trial's MFCCs. Every trial writes into its own rows
+// of one preallocated matrix, so the output does not depend on the thread count.
+#pragma once
+#include <string>
+#include <vector>
+
+#include "dataset.hpp"
+#include "npy.hpp"
+#include "work_pool.hpp"
+
+namespace nexus {
+
+enum class FeatureBlock {
+    MAV,    // mav(), per channel
+    WL,     // wl()
+    ZC,     // zc(), threshold 20
+    SSC,    // ssc(), threshold 20
+    MFCC,   // n_mfcc coefficients per channel, [coefficient][channel] as F2 flattens them
+    F1,     // F1(): x_bar, w_bar, r_bar, P_w, P_r per channel, in that order
+};
+
+struct FeatureSpec {
+    std::vector<FeatureBlock> blocks;    // In output order
+    double fs = 250;
+    int window = 100;                    // 400 ms
+    int stride = 25;                     // 100 ms
+    double trim_start = 0.5, trim_end = 4.5;  // INITIALIZATION_WINDOW, seconds
+    bool filter = true;
+    bool zero_phase = false;             // sosfiltfilt as hmm.ipynb, rather than sosfilt as lda.ipynb
+    int n_mfcc = 6, n_mels = 15;
+};
+
+// "F1", "F2" (mav,wl,mfcc) or a comma separated list of mav, wl, zc, ssc, mfcc and f1.
+// Throws std::invalid_argument.
+std::vector<FeatureBlock> parse_feature_blocks(const std::string& spec);
+
+// Columns of a window's feature vector
+size_t feature_width(const FeatureSpec& spec, size_t n_channels);
+
+struct FeatureMatrix {
+    npy::Array x;                  // (windows of every trial, feature_width), trial after trial
+    std::vector<size_t> trials;    // Dataset index of each trial
+    std::vector<size_t> first;     // First row of each trial in x
+    std::vector<size_t> windows;   // Rows of each trial
+};
+
+struct FeatureRunStats {
+    double seconds = 0;
+    std::vector<WorkPool::Stats> workers;
+};
+
+// Trials must share a channel count. Throws std::runtime_error.
+FeatureMatrix extract_features(Dataset& ds, const std::vector<size_t>& trials, const FeatureSpec& spec,
+                               unsigned n_threads = 0, FeatureRunStats* stats = nullptr);
+
+} // namespace nexus
@@ -0,0 +1,113 @@
+#include "clock_sync.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace nexus {
+
+static const double MIN_DRIFT_SPAN_US = 10e6;  // Board time the fastest exchanges span before drift is fitted
+
+ClockSync::ClockSync(size_t window, double keep) : size_(std::max<size_t>(window, 1)), keep_(keep) {}
+
+void ClockSync::clear()
+{
+    window_.clear();
+    a_ = 0;
+    b_ = 1;
+    estimate_ = ClockEstimate();
+}
+
+void ClockSync::add(const SyncExchange& e)
+{
+    if (e.rtt() < 0 || e.t4 < e.t1) return;
+    if (!window_.empty() && e.t1 <= window_.back().t1) return;
+    if (window_.empty() && !estimate_.valid) {
+        board0_ = (e.t2 + e.t3) / 2;
+        host0_ = (e.t1 + e.t4) / 2;
+    }
+    window_.push_back(e);
+    if (window_.size() > size_) window_.pop_front();
+    fit();
+}
+
+double ClockSync::to_host(double board_us) const
+{
+    return host0_ + a_ + b_ * (board_us - board0_);
+}
+
+void ClockSync::fit()
+{
+    // Round trips up to the keep_ quantile
+    std::vector<int64_t> rtts;
+    for (const SyncExchange& e : window_) rtts.push_back(e.rtt());
+    std::sort(rtts.begin(), rtts.end());
+    size_t k = std::max<size_t>(1, (size_t)std::ceil(keep_ * rtts.size()));
+    int64_t limit = rtts[k - 1];
+
+    std::vector<double> xs, ys;
+    for (const SyncExchange& e : window_) {
+        if (e.rtt() > limit) continue;
+        xs.push_back(0.5 * (double)(e.t2 - board0_) + 0.5 * (double)(e.t3 - board0_));
+        ys.push_back(0.5 * (double)(e.t1 - host0_) + 0.5 * (double)(e.t4 - host0_));
+    }
+    const size_t n = xs.size();
+    double mx = 0, my = 0;
+    for (size_t i = 0; i < n; i++) {
+        mx += xs[i] / n;
+        my += ys[i] / n;
+    }
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; i++) {
+        sxx += (xs[i] - mx) * (xs[i] - mx);
+        sxy += (xs[i] - mx) * (ys[i] - my);
+    }
+    auto span = std::minmax_element(xs.begin(), xs.end());
+    // Offset alone until the points are far enough apart for the slope to mean something
+    b_ = n >= 2 && *span.second - *span.first >= MIN_DRIFT_SPAN_US ? sxy / sxx : 1;
+    a_ = my - b_ * mx;
+
+    double sq = 0;
+    for (size_t i = 0; i < n; i++) {
+        double r = ys[i] - (a_ + b_ * xs[i]);
+        sq += r * r;
+    }
+    const SyncExchange& last = window_.back();
+    double board = 0.5 * (double)last.t2 + 0.5 * (double)last.t3;
+    estimate_.valid = true;
+    estimate_.offset_us = board - to_host(board);
+    estimate_.drift_ppm = (1 / b_ - 1) * 1e6;
+    estimate_.rtt_min_us = rtts.front();
+    estimate_.residual_us = std::sqrt(sq / n);
+    estimate_.used = n;
+    estimate_.exchanges = window_.size();
+}
+
+void SampleClock::add(int64_t row, int64_t board_us)
+{
+    if (n_ == 0) {
+        row0_ = row;
+        t0_ = board_us;
+    }
+    double x = row - row0_, y = board_us - t0_;
+    n_++;
+    sx_ += x;
+    sy_ += y;
+    sxx_ += x * x;
+    sxy_ += x * y;
+}
+
+double SampleClock::period_us() const
+{
+    double d = n_ * sxx_ - sx_ * sx_;
+    return n_ >= 2 && d > 0 ? (n_ * sxy_ - sx_ * sy_) / d : nominal_us_;
+}
+
+double SampleClock::at(double row) const
+{
+    double slope = period_us();
+    double intercept = n_ ? (sy_ - slope * sx_) / n_ : 0;
+    return t0_ + intercept + slope * (row - row0_);
+}
+
+} // namespace nexus
@@ -0,0 +1,77 @@
+// Board to host clock alignment. ClockSync estimates the offset and drift of a
+// board's esp_timer clock against the host's from sync exchanges (protocol_interface.h):
+// every exchange gives the round trip, and the midpoints of its two legs are one
+// point on the line between the clocks. Exchanges held up on the way, the slowest
+// round trips, are left out and a line is fitted through the rest of a sliding
+// window, so the error is the asymmetry of the fastest exchanges plus the fit.
+//
+// SampleClock fits the other line, from a recording's rows to the DRDY times in its
+// frame headers, which smooths the interrupt latency out of the sample times.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace nexus {
+
+// One exchange, microseconds: t1 and t4 on the host, t2 and t3 on the board
+struct SyncExchange {
+    int64_t t1, t2, t3, t4;
+
+    int64_t rtt() const { return (t4 - t1) - (t3 - t2); }
+};
+
+struct ClockEstimate {
+    bool valid = false;
+    double offset_us = 0;      // Board minus host time at the latest exchange
+    double drift_ppm = 0;      // How much faster the board's clock runs
+    double rtt_min_us = 0;     // Fastest round trip in the window
+    double residual_us = 0;    // RMS distance of the exchanges used from the line
+    size_t used = 0, exchanges = 0;
+};
+
+class ClockSync {
+public:
+    // window: exchanges kept, keep: share of the fastest of them the line goes through
+    explicit ClockSync(size_t window = 64, double keep = 0.25);
+
+    // Exchanges with a negative round trip or out of order are ignored
+    void add(const SyncExchange& e);
+    void clear();
+
+    bool valid() const { return !window_.empty(); }
+    // Host time of a board time, microseconds
+    double to_host(double board_us) const;
+    ClockEstimate estimate() const { return estimate_; }
+
+private:
+    void fit();
+
+    size_t size_;
+    double keep_;
+    std::deque<SyncExchange> window_;
+    int64_t board0_ = 0, host0_ = 0;   // Origin of the line, the first exchange
+    double a_ = 0, b_ = 1;             // host - host0 = a + b (board - board0)
+    ClockEstimate estimate_;
+};
+
+// Least squares line through (row, DRDY time) of a recording's frames
+class SampleClock {
+public:
+    void add(int64_t row, int64_t board_us);
+    void clear() { *this = SampleClock(); }
+
+    bool valid() const { return n_ > 0; }
+    // Board time of a row, microseconds. One frame's worth of points gives its nominal period.
+    double at(double row) const;
+    double period_us() const;
+    void set_nominal_period(double us) { nominal_us_ = us; }
+
+private:
+    size_t n_ = 0;
+    int64_t row0_ = 0, t0_ = 0;
+    double sx_ = 0, sy_ = 0, sxx_ = 0, sxy_ = 0;
+    double nominal_us_ = 0;
+};
+
+} // namespace nexus
@@ -0,0 +1,207 @@
+#include "dataset.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "npy.hpp"
+
+namespace fs = std::filesystem;
+
+namespace nexus {
+
+size_t dtype_size(Dtype dtype)
+{
+    return dtype == Dtype::F8 ? 8 : 4;
+}
+
+// One CSV line, fields unquoted. The electrode-brace/50x3 metadata quotes every string, the rest none.
+static std::vector<std::string> split_csv(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (char c : line) {
+        if (c == '"') quoted = !quoted;
+        else if (c == ',' && !quoted) fields.emplace_back();
+        else if (c != '\r') fields.back() += c;
+    }
+    return fields;
+}
+
+// Shape, dtype and data offset from the .npy header, false if it cannot be mapped as is
+static bool read_header(Trial& t)
+{
+    int fd = open(t.path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    uint8_t preamble[12];
+    bool ok = pread(fd, preamble, sizeof(preamble), 0) == sizeof(preamble) &&
+              std::memcmp(preamble, "\x93NUMPY", 6) == 0;
+    size_t header_len = 0, start = 10;
+    if (ok) {
+        header_len = preamble[8] | (preamble[9] << 8);
+        if (preamble[6] >= 2) {
+            header_len |= (size_t)preamble[10] << 16 | (size_t)preamble[11] << 24;
+            start = 12;
+        }
+    }
+    std::string header(header_len, '\0');
+    ok = ok && pread(fd, &header[0], header_len, start) == (ssize_t)header_len;
+    struct stat st;
+    ok = ok && fstat(fd, &st) == 0;
+    close(fd);
+    if (!ok) return false;
+
+    try {
+        std::string descr = npy::header_field(header, "descr");
+        t.fortran = npy::header_field(header, "fortran_order") == "True";
+        if (descr == "'<f8'") t.dtype = Dtype::F8;
+        else if (descr == "'<f4'") t.dtype = Dtype::F4;
+        else if (descr == "'<i4'") t.dtype = Dtype::I4;
+        else return false;
+
+        size_t dims[2] = {0, 1};
+        if (std::sscanf(npy::header_field(header, "shape").c_str(), "(%zu, %zu", &dims[0], &dims[1]) < 1) return false;
+        t.rows = dims[0];
+        t.cols = dims[1];
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    t.offset = start + header_len;
+    return t.offset + t.rows * t.cols * dtype_size(t.dtype) <= (size_t)st.st_size;
+}
+
+Dataset::Dataset(const std::string& root) : root_(root)
+{
+    std::vector<fs::path> dirs;
+    if (fs::exists(fs::path(root) / "metadata.csv")) {
+        dirs.push_back(root);
+    } else {
+        for (const auto& entry : fs::recursive_directory_iterator(root))
+            if (entry.is_regular_file() && entry.path().filename() == "metadata.csv")
+                dirs.push_back(entry.path().parent_path());
+    }
+    if (dirs.empty()) throw std::runtime_error("dataset: no metadata.csv under " + root);
+    std::sort(dirs.begin(), dirs.end());
+
+    for (const fs::path& dir : dirs) {
+        std::string name = fs::relative(dir, root).generic_string();
+        index_dataset(dir.string(), name == "." ? dir.filename().string() : name);
+    }
+    for (size_t i = 0; i < trials_.size(); i++)
+        maps_.push_back(std::make_unique<Mapping>());
+}
+
+Dataset::~Dataset()
+{
+    for (auto& m : maps_)
+        if (m->base) munmap(const_cast<uint8_t*>(m->base), m->size);
+}
+
+void Dataset::index_dataset(const std::string& dir, const std::string& name)
+{
+    std::ifstream f(dir + "/metadata.csv");
+    std::string line;
+    if (!std::getline(f, line)) return;
+
+    // Columns by name, they are in the same order everywhere today but need not be
+    std::vector<std::string> header = split_csv(line);
+    auto column = [&](const char* key) {
+        auto it = std::find(header.begin(), header.end(), key);
+        if (it == header.end()) throw std::runtime_error("dataset: " + dir + "/metadata.csv has no " + key);
+        return (size_t)(it - header.begin());
+    };
+    size_t cls = column("cls"), id = column("id"), speaker = column("speaker"), session = column("session");
+    size_t n_fields = std::max({cls, id, speaker, session}) + 1;
+
+    while (std::getline(f, line)) {
+        std::vector<std::string> fields = split_csv(line);
+        if (fields.size() < n_fields) continue;
+        Trial t;
+        t.dataset = name;
+        t.cls = fields[cls];
+        t.speaker = fields[speaker];
+        t.session = std::atoi(fields[session].c_str());
+        t.id = std::strtoull(fields[id].c_str(), nullptr, 10);
+        t.path = dir + "/" + fields[id] + ".npy";
+        if (read_header(t)) trials_.push_back(std::move(t));
+        else skipped_.push_back(t.path);
+    }
+}
+
+std::vector<size_t> Dataset::select(const Filter& filter) const
+{
+    auto match = [](const auto& allowed, const auto& value) {
+        return allowed.empty() || std::find(allowed.begin(), allowed.end(), value) != allowed.end();
+    };
+    std::vector<size_t> out;
+    for (size_t i = 0; i < trials_.size(); i++) {
+        const Trial& t = trials_[i];
+        if (match(filter.datasets, t.dataset) && match(filter.classes, t.cls) &&
+            match(filter.speakers, t.speaker) && match(filter.sessions, t.session))
+            out.push_back(i);
+    }
+    return out;
+}
+
+const uint8_t* Dataset::map(size_t index)
+{
+    Mapping& m = *maps_.at(index);
+    std::call_once(m.once, [&] {
+        const Trial& t = trials_[index];
+        int fd = open(t.path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("dataset: cannot open " + t.path);
+        size_t size = t.offset + t.rows * t.cols * dtype_size(t.dtype);
+        void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("dataset: cannot map " + t.path);
+        m.base = static_cast<const uint8_t*>(p);
+        m.size = size;
+    });
+    return m.base;
+}
+
+View Dataset::view(size_t index)
+{
+    const uint8_t* base = map(index);
+    const Trial& t = trials_[index];
+    return View{base + t.offset, t.rows, t.cols, t.dtype, t.fortran};
+}
+
+void Dataset::prefetch(const std::vector<size_t>& indices, unsigned n_threads)
+{
+    if (n_threads == 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+    n_threads = std::min<size_t>(n_threads, std::max<size_t>(indices.size(), 1));
+
+    // Reading a byte per page faults it in, the readahead of MADV_WILLNEED alone is only a hint
+    const size_t page = sysconf(_SC_PAGESIZE);
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < indices.size();) {
+            const uint8_t* base;
+            try {
+                base = map(indices[i]);
+            } catch (const std::runtime_error&) {
+                continue;  // view() reports it
+            }
+            size_t size = maps_[indices[i]]->size;
+            madvise(const_cast<uint8_t*>(base), size, MADV_WILLNEED);
+            volatile uint8_t sink = 0;
+            for (size_t off = 0; off < size; off += page) sink += base[off];
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < n_threads; i++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+}
+
+} // namespace nexus
@@ -0,0 +1,85 @@
+// Index over the datasets/ tree. Every directory with a metadata.csv ("cls","id",
+// "speaker","session", quoted or not) is a dataset, each row a trial in <id>.npy.
+// Opening reads the metadata and the .npy headers only; the samples are memory
+// mapped on first use and handed out as views into the mapping, never copied.
+// prefetch() maps a selection and pulls it into the page cache on a pool of threads.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nexus {
+
+enum class Dtype { F8, F4, I4 };
+
+struct Trial {
+    std::string dataset;   // Directory relative to the root, e.g. electrode-brace/50x3
+    std::string cls;
+    std::string speaker;
+    int session = 0;
+    uint64_t id = 0;
+    std::string path;      // The .npy
+    size_t rows = 0, cols = 0;
+    Dtype dtype = Dtype::F8;
+    bool fortran = false;  // Column major, as np.save writes a transposed array
+    size_t offset = 0;     // Of the data in the file
+};
+
+// Samples of a trial (rows, cols), row major unless fortran, valid while the Dataset lives
+struct View {
+    const void* data = nullptr;
+    size_t rows = 0, cols = 0;
+    Dtype dtype = Dtype::F8;
+    bool fortran = false;
+
+    const double* f8() const { return dtype == Dtype::F8 ? static_cast<const double*>(data) : nullptr; }
+    // Offset of a sample in elements
+    size_t index(size_t row, size_t col) const { return fortran ? col * rows + row : row * cols + col; }
+};
+
+// Which trials to select, an empty list matches anything
+struct Filter {
+    std::vector<std::string> datasets, classes, speakers;
+    std::vector<int> sessions;
+};
+
+class Dataset {
+public:
+    // Indexes every dataset under root, or root itself when it holds a metadata.csv
+    explicit Dataset(const std::string& root);
+    ~Dataset();
+    Dataset(const Dataset&) = delete;
+    Dataset& operator=(const Dataset&) = delete;
+
+    const std::string& root() const { return root_; }
+    const std::vector<Trial>& trials() const { return trials_; }
+    // Rows of metadata.csv skipped because the .npy is missing or unreadable
+    const std::vector<std::string>& skipped() const { return skipped_; }
+
+    std::vector<size_t> select(const Filter& filter) const;
+    View view(size_t index);
+    // Maps the trials and touches every page on n_threads, 0 for one per core
+    void prefetch(const std::vector<size_t>& indices, unsigned n_threads = 0);
+
+private:
+    struct Mapping {
+        std::once_flag once;
+        const uint8_t* base = nullptr;
+        size_t size = 0;
+    };
+
+    void index_dataset(const std::string& dir, const std::string& name);
+    const uint8_t* map(size_t index);
+
+    std::string root_;
+    std::vector<Trial> trials_;
+    std::vector<std::string> skipped_;
+    std::vector<std::unique_ptr<Mapping>> maps_;
+};
+
+size_t dtype_size(Dtype dtype);
+
+} // namespace nexus
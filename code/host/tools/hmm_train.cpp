@@ -0,0 +1,494 @@
+#include "hmm_train.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+extern "C" {
+#include "classifier_interface.h"
+}
+
+namespace nexus {
+
+static const double NEG_INF = -std::numeric_limits<double>::infinity();
+
+void Lda::transform(const double* x, double* z) const
+{
+    for (size_t c = 0; c < n_components; c++) z[c] = b[c];
+    for (size_t f = 0; f < n_features; f++)
+        for (size_t c = 0; c < n_components; c++) z[c] += x[f] * w[f * n_components + c];
+}
+
+// Eigenvectors of a symmetric n x n matrix by cyclic Jacobi rotations, columns of v
+static void jacobi_eigen(std::vector<double> a, size_t n, std::vector<double>& values, std::vector<double>& v)
+{
+    v.assign(n * n, 0.0);
+    for (size_t i = 0; i < n; i++) v[i * n + i] = 1;
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double off = 0, diag = 0;
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = 0; j < n; j++) (i == j ? diag : off) += a[i * n + j] * a[i * n + j];
+        if (off <= 1e-30 * diag) break;
+
+        for (size_t p = 0; p < n; p++) {
+            for (size_t q = p + 1; q < n; q++) {
+                double apq = a[p * n + q];
+                if (std::fabs(apq) < 1e-300) continue;
+                double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+                double t = (theta >= 0 ? 1 : -1) / (std::fabs(theta) + std::sqrt(theta * theta + 1));
+                double c = 1 / std::sqrt(t * t + 1), s = t * c;
+                for (size_t k = 0; k < n; k++) {
+                    double akp = a[k * n + p], akq = a[k * n + q];
+                    a[k * n + p] = c * akp - s * akq;
+                    a[k * n + q] = s * akp + c * akq;
+                }
+                for (size_t k = 0; k < n; k++) {
+                    double apk = a[p * n + k], aqk = a[q * n + k];
+                    a[p * n + k] = c * apk - s * aqk;
+                    a[q * n + k] = s * apk + c * aqk;
+                }
+                for (size_t k = 0; k < n; k++) {
+                    double vkp = v[k * n + p], vkq = v[k * n + q];
+                    v[k * n + p] = c * vkp - s * vkq;
+                    v[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    values.resize(n);
+    for (size_t i = 0; i < n; i++) values[i] = a[i * n + i];
+}
+
+Lda fit_lda(const double* x, size_t rows, size_t cols, const std::vector<int>& labels, int n_classes,
+            size_t n_components)
+{
+    if (n_classes < 2 || n_components < 1 || n_components > (size_t)n_classes - 1 || n_components > cols)
+        throw std::runtime_error("lda: " + std::to_string(n_components) + " components need at least that many features and one more class");
+    if (rows <= (size_t)n_classes) throw std::runtime_error("lda: too few samples");
+
+    const size_t d = cols;
+    std::vector<double> means(n_classes * d, 0.0), mean(d, 0.0);
+    std::vector<size_t> count(n_classes, 0);
+    for (size_t r = 0; r < rows; r++) {
+        count[labels[r]]++;
+        for (size_t f = 0; f < d; f++) means[labels[r] * d + f] += x[r * d + f];
+    }
+    for (int k = 0; k < n_classes; k++) {
+        if (!count[k]) throw std::runtime_error("lda: class " + std::to_string(k) + " has no samples");
+        for (size_t f = 0; f < d; f++) {
+            mean[f] += means[k * d + f];
+            means[k * d + f] /= count[k];
+        }
+    }
+    for (size_t f = 0; f < d; f++) mean[f] /= rows;
+
+    // Within class covariance, pooled over rows - classes degrees of freedom, and between class scatter
+    std::vector<double> sw(d * d, 0.0), sb(d * d, 0.0), dev(d);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t f = 0; f < d; f++) dev[f] = x[r * d + f] - means[labels[r] * d + f];
+        for (size_t i = 0; i < d; i++)
+            for (size_t j = 0; j <= i; j++) sw[i * d + j] += dev[i] * dev[j];
+    }
+    for (int k = 0; k < n_classes; k++) {
+        for (size_t f = 0; f < d; f++) dev[f] = means[k * d + f] - mean[f];
+        for (size_t i = 0; i < d; i++)
+            for (size_t j = 0; j <= i; j++) sb[i * d + j] += count[k] * dev[i] * dev[j] / (n_classes - 1);
+    }
+    double trace = 0;
+    for (size_t i = 0; i < d; i++) {
+        for (size_t j = 0; j <= i; j++) {
+            sw[i * d + j] /= rows - n_classes;
+            sw[j * d + i] = sw[i * d + j];
+            sb[j * d + i] = sb[i * d + j];
+        }
+        trace += sw[i * d + i];
+    }
+
+    // Whiten with the Cholesky factor of Sw (a touch of ridge for collinear features),
+    // then the leading eigenvectors of the whitened Sb
+    std::vector<double> l(d * d, 0.0);
+    for (size_t i = 0; i < d; i++) sw[i * d + i] += 1e-12 * trace / d;
+    for (size_t j = 0; j < d; j++) {
+        double s = sw[j * d + j];
+        for (size_t k = 0; k < j; k++) s -= l[j * d + k] * l[j * d + k];
+        if (!(s > 0)) throw std::runtime_error("lda: within class covariance is singular");
+        l[j * d + j] = std::sqrt(s);
+        for (size_t i = j + 1; i < d; i++) {
+            double t = sw[i * d + j];
+            for (size_t k = 0; k < j; k++) t -= l[i * d + k] * l[j * d + k];
+            l[i * d + j] = t / l[j * d + j];
+        }
+    }
+    // m = L^-1 Sb L^-T, by forward substitution on the columns and then the rows
+    std::vector<double> m = sb;
+    for (size_t c = 0; c < d; c++)
+        for (size_t i = 0; i < d; i++) {
+            double t = m[i * d + c];
+            for (size_t k = 0; k < i; k++) t -= l[i * d + k] * m[k * d + c];
+            m[i * d + c] = t / l[i * d + i];
+        }
+    for (size_t r = 0; r < d; r++)
+        for (size_t i = 0; i < d; i++) {
+            double t = m[r * d + i];
+            for (size_t k = 0; k < i; k++) t -= l[i * d + k] * m[r * d + k];
+            m[r * d + i] = t / l[i * d + i];
+        }
+
+    std::vector<double> values, vectors;
+    jacobi_eigen(m, d, values, vectors);
+    std::vector<size_t> order(d);
+    for (size_t i = 0; i < d; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return values[a] > values[b]; });
+
+    Lda lda;
+    lda.n_features = d;
+    lda.n_components = n_components;
+    lda.w.assign(d * n_components, 0.0);
+    lda.b.assign(n_components, 0.0);
+    for (size_t c = 0; c < n_components; c++) {
+        // Scalings solve L^T s = u
+        std::vector<double> s(d);
+        for (size_t i = d; i-- > 0;) {
+            double t = vectors[i * d + order[c]];
+            for (size_t k = i + 1; k < d; k++) t -= l[k * d + i] * s[k];
+            s[i] = t / l[i * d + i];
+        }
+        // Sign is arbitrary, as in sklearn; fix it so retraining gives the same model
+        size_t big = 0;
+        for (size_t f = 1; f < d; f++) if (std::fabs(s[f]) > std::fabs(s[big])) big = f;
+        double sign = s[big] < 0 ? -1 : 1;
+        for (size_t f = 0; f < d; f++) {
+            lda.w[f * n_components + c] = sign * s[f];
+            lda.b[c] -= sign * s[f] * mean[f];
+        }
+    }
+    return lda;
+}
+
+static inline double log_sum_exp(const double* a, int n)
+{
+    double m = a[0];
+    for (int i = 1; i < n; i++) m = std::max(m, a[i]);
+    if (m == NEG_INF) return NEG_INF;
+    double s = 0;
+    for (int i = 0; i < n; i++) s += std::exp(a[i] - m);
+    return m + std::log(s);
+}
+
+static double safe_log(double v)
+{
+    return v > 0 ? std::log(v) : NEG_INF;
+}
+
+namespace {
+
+// Parameters in the form the lattices use
+struct LogModel {
+    int S, D;
+    std::vector<double> log_start, log_trans, log_trans_t, inv_var, log_norm;
+
+    explicit LogModel(const GaussianHmm& m) : S(m.n_states), D(m.dim)
+    {
+        log_start.resize(S);
+        log_trans.resize(S * S);
+        log_trans_t.resize(S * S);
+        inv_var.resize(S * D);
+        log_norm.resize(S);
+        for (int i = 0; i < S; i++) {
+            log_start[i] = safe_log(m.start[i]);
+            double norm = D * std::log(2 * M_PI);
+            for (int d = 0; d < D; d++) {
+                inv_var[i * D + d] = 1 / m.vars[i * D + d];
+                norm += std::log(m.vars[i * D + d]);
+            }
+            log_norm[i] = -0.5 * norm;
+            for (int j = 0; j < S; j++) {
+                log_trans[i * S + j] = safe_log(m.trans[i * S + j]);
+                log_trans_t[j * S + i] = log_trans[i * S + j];
+            }
+        }
+    }
+};
+
+// Sufficient statistics of an E step
+struct Stats {
+    std::vector<double> post, obs, obs2, trans;
+    double log_likelihood = 0;
+
+    Stats(int S, int D) : post(S, 0.0), obs(S * D, 0.0), obs2(S * D, 0.0), trans(S * S, 0.0) {}
+};
+
+struct Lattice {
+    std::vector<double> log_b, alpha, beta, tmp;
+};
+
+void emission(const GaussianHmm& m, const LogModel& lm, const Sequence& seq, std::vector<double>& log_b)
+{
+    const int S = lm.S, D = lm.D;
+    log_b.resize(seq.len * S);
+    for (size_t t = 0; t < seq.len; t++) {
+        const double* x = seq.obs + t * D;
+        for (int s = 0; s < S; s++) {
+            const double* mu = m.means.data() + s * D;
+            const double* iv = lm.inv_var.data() + s * D;
+            double acc = 0;
+            for (int d = 0; d < D; d++) acc += (x[d] - mu[d]) * (x[d] - mu[d]) * iv[d];
+            log_b[t * S + s] = lm.log_norm[s] - 0.5 * acc;
+        }
+    }
+}
+
+double forward(const LogModel& lm, size_t T, Lattice& l)
+{
+    const int S = lm.S;
+    l.alpha.resize(T * S);
+    l.tmp.resize(S);
+    for (int j = 0; j < S; j++) l.alpha[j] = lm.log_start[j] + l.log_b[j];
+    for (size_t t = 1; t < T; t++) {
+        const double* prev = l.alpha.data() + (t - 1) * S;
+        for (int j = 0; j < S; j++) {
+            const double* a = lm.log_trans_t.data() + j * S;
+            for (int i = 0; i < S; i++) l.tmp[i] = prev[i] + a[i];
+            l.alpha[t * S + j] = log_sum_exp(l.tmp.data(), S) + l.log_b[t * S + j];
+        }
+    }
+    return log_sum_exp(l.alpha.data() + (T - 1) * S, S);
+}
+
+void backward(const LogModel& lm, size_t T, Lattice& l)
+{
+    const int S = lm.S;
+    l.beta.assign(T * S, 0.0);
+    for (size_t t = T - 1; t-- > 0;) {
+        const double* next = l.beta.data() + (t + 1) * S;
+        const double* b = l.log_b.data() + (t + 1) * S;
+        for (int i = 0; i < S; i++) {
+            const double* a = lm.log_trans.data() + i * S;
+            for (int j = 0; j < S; j++) l.tmp[j] = a[j] + b[j] + next[j];
+            l.beta[t * S + i] = log_sum_exp(l.tmp.data(), S);
+        }
+    }
+}
+
+void accumulate(const GaussianHmm& m, const LogModel& lm, const Sequence& seq, Lattice& l, Stats& st)
+{
+    const int S = lm.S, D = lm.D;
+    const size_t T = seq.len;
+    if (T == 0) return;
+    emission(m, lm, seq, l.log_b);
+    double ll = forward(lm, T, l);
+    backward(lm, T, l);
+    st.log_likelihood += ll;
+
+    // State posteriors, normalised per frame as hmmlearn does
+    for (size_t t = 0; t < T; t++) {
+        for (int s = 0; s < S; s++) l.tmp[s] = l.alpha[t * S + s] + l.beta[t * S + s];
+        double norm = log_sum_exp(l.tmp.data(), S);
+        const double* x = seq.obs + t * D;
+        for (int s = 0; s < S; s++) {
+            double g = std::exp(l.tmp[s] - norm);
+            st.post[s] += g;
+            for (int d = 0; d < D; d++) {
+                st.obs[s * D + d] += g * x[d];
+                st.obs2[s * D + d] += g * x[d] * x[d];
+            }
+        }
+    }
+    // Transition posteriors
+    for (size_t t = 0; t + 1 < T; t++)
+        for (int i = 0; i < S; i++)
+            for (int j = 0; j < S; j++) {
+                double v = l.alpha[t * S + i] + lm.log_trans[i * S + j] + l.log_b[(t + 1) * S + j] +
+                           l.beta[(t + 1) * S + j] - ll;
+                if (v != NEG_INF) st.trans[i * S + j] += std::exp(v);
+            }
+}
+
+} // namespace
+
+GaussianHmm init_ltr_hmm(const std::vector<Sequence>& seqs, int dim, const HmmConfig& config, std::mt19937_64& rng)
+{
+    const int S = config.n_states, D = dim;
+    GaussianHmm m;
+    m.n_states = S;
+    m.dim = D;
+    m.start.assign(S, 0.0);
+    m.start[0] = 1;
+    m.trans.assign(S * S, 0.0);
+    for (int i = 0; i < S; i++) {
+        if (i == S - 1) m.trans[i * S + i] = 1;
+        else m.trans[i * S + i] = m.trans[i * S + i + 1] = 0.5;
+    }
+
+    std::vector<const double*> x;
+    for (const Sequence& s : seqs)
+        for (size_t t = 0; t < s.len; t++) x.push_back(s.obs + t * D);
+    const size_t n = x.size();
+    if (n < (size_t)S + 1) throw std::runtime_error("hmm: fewer observations than states");
+
+    // np.cov(X.T) diagonal, ddof 1, plus min_covar for every state
+    std::vector<double> mean(D, 0.0), var(D, 0.0);
+    for (const double* p : x)
+        for (int d = 0; d < D; d++) mean[d] += p[d];
+    for (int d = 0; d < D; d++) mean[d] /= n;
+    for (const double* p : x)
+        for (int d = 0; d < D; d++) var[d] += (p[d] - mean[d]) * (p[d] - mean[d]);
+    m.vars.resize(S * D);
+    for (int s = 0; s < S; s++)
+        for (int d = 0; d < D; d++) m.vars[s * D + d] = var[d] / (n - 1) + config.min_covar;
+
+    // Greedy k-means++ seeding as sklearn's KMeans, then Lloyd iterations
+    auto dist2 = [D](const double* a, const double* b) {
+        double acc = 0;
+        for (int d = 0; d < D; d++) acc += (a[d] - b[d]) * (a[d] - b[d]);
+        return acc;
+    };
+    std::vector<double> centers(S * D);
+    std::vector<double> closest(n);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    const double* first = x[pick(rng)];
+    std::copy(first, first + D, centers.begin());
+    for (size_t i = 0; i < n; i++) closest[i] = dist2(x[i], first);
+    const int trials = 2 + (int)std::log((double)S);
+    for (int k = 1; k < S; k++) {
+        double potential = 0;
+        for (double v : closest) potential += v;
+        std::uniform_real_distribution<double> uniform(0, potential);
+        size_t best = 0;
+        double best_potential = std::numeric_limits<double>::infinity();
+        for (int trial = 0; trial < trials; trial++) {
+            double r = uniform(rng), acc = 0;
+            size_t cand = 0;
+            for (; cand + 1 < n; cand++) if ((acc += closest[cand]) >= r) break;
+            double pot = 0;
+            for (size_t i = 0; i < n; i++) pot += std::min(closest[i], dist2(x[i], x[cand]));
+            if (pot < best_potential) best_potential = pot, best = cand;
+        }
+        std::copy(x[best], x[best] + D, centers.begin() + k * D);
+        for (size_t i = 0; i < n; i++) closest[i] = std::min(closest[i], dist2(x[i], x[best]));
+    }
+
+    double tol = 0;
+    for (int d = 0; d < D; d++) tol += var[d] / n;
+    tol *= 1e-4 / D;
+    std::vector<int> assign(n, -1);
+    for (int iter = 0; iter < 300; iter++) {
+        for (size_t i = 0; i < n; i++) {
+            double best = std::numeric_limits<double>::infinity();
+            for (int k = 0; k < S; k++) {
+                double v = dist2(x[i], centers.data() + k * D);
+                if (v < best) best = v, assign[i] = k;
+            }
+        }
+        std::vector<double> sum(S * D, 0.0);
+        std::vector<size_t> count(S, 0);
+        for (size_t i = 0; i < n; i++) {
+            count[assign[i]]++;
+            for (int d = 0; d < D; d++) sum[assign[i] * D + d] += x[i][d];
+        }
+        double shift = 0;
+        for (int k = 0; k < S; k++) {
+            if (!count[k]) continue;  // An empty cluster keeps its centre
+            for (int d = 0; d < D; d++) {
+                double c = sum[k * D + d] / count[k];
+                shift += (c - centers[k * D + d]) * (c - centers[k * D + d]);
+                centers[k * D + d] = c;
+            }
+        }
+        if (shift <= tol) break;
+    }
+    m.means = centers;
+    return m;
+}
+
+HmmFit fit_hmm(GaussianHmm model, const std::vector<Sequence>& seqs, const HmmConfig& config)
+{
+    const int S = model.n_states, D = model.dim;
+    HmmFit fit;
+    Lattice lattice;
+    double prev = NEG_INF;
+
+    for (int iter = 0; iter < config.n_iter; iter++) {
+        LogModel lm(model);
+        Stats st(S, D);
+        for (const Sequence& seq : seqs) accumulate(model, lm, seq, lattice, st);
+        if (!std::isfinite(st.log_likelihood)) throw std::runtime_error("hmm: log-likelihood is not finite");
+
+        // M step. A state nobody visits keeps its mean, where hmmlearn would divide by zero.
+        for (int s = 0; s < S; s++) {
+            double denom = st.post[s];
+            for (int d = 0; d < D; d++) {
+                double& mu = model.means[s * D + d];
+                if (denom > 0) mu = st.obs[s * D + d] / denom;
+                double c_n = st.obs2[s * D + d] - 2 * mu * st.obs[s * D + d] + mu * mu * denom;
+                model.vars[s * D + d] = (config.covars_prior + c_n) / std::max(denom, 1e-5);
+            }
+            double row = 0;
+            for (int j = 0; j < S; j++) row += st.trans[s * S + j];
+            if (row > 0)
+                for (int j = 0; j < S; j++) model.trans[s * S + j] = st.trans[s * S + j] / row;
+        }
+
+        fit.iterations = iter + 1;
+        if (iter > 0 && st.log_likelihood - prev < config.tol) {
+            fit.converged = true;
+            break;
+        }
+        prev = st.log_likelihood;
+    }
+
+    fit.log_likelihood = 0;
+    for (const Sequence& seq : seqs) fit.log_likelihood += score_hmm(model, seq);
+    fit.model = std::move(model);
+    return fit;
+}
+
+double score_hmm(const GaussianHmm& model, const Sequence& seq)
+{
+    if (seq.len == 0) return 0;
+    LogModel lm(model);
+    Lattice l;
+    emission(model, lm, seq, l.log_b);
+    return forward(lm, seq.len, l);
+}
+
+static void put_f32(std::vector<uint8_t>& out, double v)
+{
+    float f = (float)v;
+    uint8_t b[4];
+    std::memcpy(b, &f, 4);
+    out.insert(out.end(), b, b + 4);
+}
+
+std::vector<uint8_t> classifier_model(const Lda& lda, const std::vector<std::string>& names,
+                                      const std::vector<GaussianHmm>& models)
+{
+    if (models.empty() || models.size() != names.size()) throw std::runtime_error("model: one HMM per class needed");
+    const int S = models[0].n_states;
+    if (names.size() > CLF_MAX_CLASSES || S > CLF_MAX_STATES || lda.n_components > CLF_MAX_COMPONENTS ||
+        lda.n_features > CLF_MAX_FEATURES)
+        throw std::runtime_error("model: too big for the classifier");
+
+    std::vector<uint8_t> out = {'N', 'X', 'H', 'M', CLF_VERSION, (uint8_t)names.size(), (uint8_t)S,
+                                (uint8_t)lda.n_components, (uint8_t)(lda.n_features & 0xFF),
+                                (uint8_t)(lda.n_features >> 8), 0, 0};
+    for (double v : lda.w) put_f32(out, v);
+    for (double v : lda.b) put_f32(out, v);
+    for (size_t c = 0; c < models.size(); c++) {
+        const GaussianHmm& m = models[c];
+        if (m.n_states != S || (size_t)m.dim != lda.n_components)
+            throw std::runtime_error("model: every class needs the same states and LDA output size");
+        char name[CLF_NAME_LEN] = {};
+        std::strncpy(name, names[c].c_str(), CLF_NAME_LEN - 1);
+        out.insert(out.end(), name, name + CLF_NAME_LEN);
+        for (double v : m.start) put_f32(out, safe_log(v));
+        for (double v : m.trans) put_f32(out, safe_log(v));
+        for (double v : m.means) put_f32(out, v);
+        for (double v : m.vars) put_f32(out, v);
+    }
+    return out;
+}
+
+} // namespace nexus
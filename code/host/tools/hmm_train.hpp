@@ -0,0 +1,74 @@
+// Training side of the word classifier (components/classifier): the LDA and the
+// per class left-to-right Gaussian HMMs of hmm.ipynb, without sklearn and hmmlearn.
+//
+// fit_hmm() is hmmlearn's GaussianHMM(covariance_type="diag", init_params="c",
+// params="cmt") fit: Baum-Welch in log space, the start probabilities held, the
+// transitions re-estimated from their posteriors (so zeros of the left-to-right
+// topology stay zero), means and variances with hmmlearn's covars_prior, and the
+// same convergence test on the log-likelihood gain. Given the same initial means it
+// follows hmmlearn iteration for iteration.
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace nexus {
+
+// sklearn's LinearDiscriminantAnalysis transform: z = x w + b, unit within class variance
+struct Lda {
+    size_t n_features = 0, n_components = 0;
+    std::vector<double> w;    // [n_features][n_components]
+    std::vector<double> b;    // [n_components]
+
+    void transform(const double* x, double* z) const;
+};
+
+// labels in [0, n_classes), one per row of x (rows, cols). Throws std::runtime_error.
+Lda fit_lda(const double* x, size_t rows, size_t cols, const std::vector<int>& labels, int n_classes,
+            size_t n_components);
+
+// One observation sequence, [len][dim] row major
+struct Sequence {
+    const double* obs;
+    size_t len;
+};
+
+struct HmmConfig {
+    int n_states = 3;
+    int n_iter = 100;            // EM iterations at most
+    double tol = 1e-2;           // Stop once an iteration gains less log-likelihood
+    double min_covar = 1e-3;     // Added to the initial variances
+    double covars_prior = 1e-2;  // Added to the variance numerator every M step
+};
+
+struct GaussianHmm {
+    int n_states = 0, dim = 0;
+    std::vector<double> start;   // [n_states]
+    std::vector<double> trans;   // [from][to]
+    std::vector<double> means;   // [n_states][dim]
+    std::vector<double> vars;    // [n_states][dim]
+};
+
+struct HmmFit {
+    GaussianHmm model;
+    double log_likelihood = 0;   // Of the training sequences under the final model
+    int iterations = 0;
+    bool converged = false;
+};
+
+// Start in state 0, stay or move on with probability 0.5 (make_ltr_transition), variances from
+// the data and means from k-means++ seeded by rng, as hmmlearn initialises an unset means_
+GaussianHmm init_ltr_hmm(const std::vector<Sequence>& seqs, int dim, const HmmConfig& config, std::mt19937_64& rng);
+
+HmmFit fit_hmm(GaussianHmm model, const std::vector<Sequence>& seqs, const HmmConfig& config);
+
+// Forward log-likelihood, hmmlearn's score()
+double score_hmm(const GaussianHmm& model, const Sequence& seq);
+
+// Model blob in the format clf_init() loads (classifier_interface.h). Throws std::runtime_error
+// when the sizes do not fit the classifier.
+std::vector<uint8_t> classifier_model(const Lda& lda, const std::vector<std::string>& names,
+                                      const std::vector<GaussianHmm>& models);
+
+} // namespace nexus
@@ -0,0 +1,207 @@
+// Classifies recordings with a model from code/ml/export_classifier.py, running the
+// same C pipeline as the board: causal IIR cascade, F2 features window by window,
+// LDA projection and the per class HMM forward pass. Given a dataset directory the
+// labels in its metadata.csv are checked and the accuracy is reported.
+//
+// hmm.ipynb filters with sosfiltfilt, which needs the whole recording. The board
+// cannot look ahead, so expect a small drop in accuracy against the notebook when
+// the models were trained on zero phase filtered data.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "npy.hpp"
+
+extern "C" {
+#include "classifier_interface.h"
+#include "iir_interface.h"
+}
+
+struct Recording {
+    std::string path;
+    std::string label;
+};
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-classify [options] <model.bin> <dataset dir | rec.npy...>\n"
+        "  --fs HZ           sample rate (250)\n"
+        "  --window N        samples per window (100)\n"
+        "  --stride N        samples between windows (25)\n"
+        "  --trim START END  seconds of each recording to classify (0.5 4.5)\n"
+        "  --no-filter       skip the 0.5 Hz high-pass and 48-52 Hz band-stop\n"
+        "  --verbose         print every recording\n");
+}
+
+static std::string unquote(std::string s)
+{
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') s = s.substr(1, s.size() - 2);
+    return s;
+}
+
+static std::vector<Recording> load_dataset(const std::string& dir)
+{
+    // metadata.csv: "cls","id","speaker","session"
+    std::ifstream f(dir + "/metadata.csv");
+    if (!f) throw std::runtime_error("cannot open " + dir + "/metadata.csv");
+
+    std::vector<Recording> recs;
+    std::string line;
+    std::getline(f, line);
+    while (std::getline(f, line)) {
+        std::stringstream ss(line);
+        std::string cls, id;
+        if (!std::getline(ss, cls, ',') || !std::getline(ss, id, ',')) continue;
+        recs.push_back({dir + "/" + unquote(id) + ".npy", unquote(cls)});
+    }
+    return recs;
+}
+
+static std::vector<uint8_t> load_model(const char* path)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error(std::string("cannot open ") + path);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char** argv)
+{
+    double fs = 250, trim_start = 0.5, trim_end = 4.5;
+    int window = 100, stride = 25;
+    bool filter_enabled = true, verbose = false;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--fs" && more) fs = std::atof(argv[++i]);
+        else if (a == "--window" && more) window = std::atoi(argv[++i]);
+        else if (a == "--stride" && more) stride = std::atoi(argv[++i]);
+        else if (a == "--trim" && i + 2 < argc) {
+            trim_start = std::atof(argv[++i]);
+            trim_end = std::atof(argv[++i]);
+        }
+        else if (a == "--no-filter") filter_enabled = false;
+        else if (a == "--verbose") verbose = true;
+        else if (a[0] == '-') {
+            usage();
+            return 2;
+        }
+        else args.push_back(argv[i]);
+    }
+    if (args.size() < 2) {
+        usage();
+        return 2;
+    }
+
+    try {
+        std::vector<uint8_t> model = load_model(args[0]);
+        clf_handle_t* clf;
+        clf_err_t err = clf_init(model.data(), model.size(), &clf);
+        if (err != CLF_OK) {
+            std::fprintf(stderr, "Cannot load %s: error %d\n", args[0], err);
+            return 1;
+        }
+        std::fprintf(stderr, "%s: %d classes, %d states, LDA %d -> %d\n", args[0],
+                     clf->n_classes, clf->n_states, clf->n_features, clf->n_components);
+
+        std::vector<Recording> recs;
+        std::string first = args[1];
+        if (args.size() == 2 && first.size() > 4 && first.substr(first.size() - 4) != ".npy")
+            recs = load_dataset(first);
+        else
+            for (size_t i = 1; i < args.size(); i++) recs.push_back({args[i], ""});
+
+        size_t labelled = 0, correct = 0;
+        double total_us = 0, worst_us = 0;
+        clf_f2_t* f2 = nullptr;
+        iir_handle_t* filter = nullptr;
+        uint8_t n_channels = 0;
+
+        for (const Recording& rec : recs) {
+            npy::Array emg = npy::load(rec.path);
+            if (emg.cols != n_channels) {
+                // Channel count is fixed per dataset, set up on the first recording
+                if (f2) clf_f2_deinit(f2);
+                if (filter) iir_deinit(filter);
+                n_channels = emg.cols;
+
+                clf_f2_config_t f2_config = {};
+                f2_config.n_channels = n_channels;
+                f2_config.window = window;
+                f2_config.stride = stride;
+                f2_config.sample_rate = fs;
+                iir_config_t iir_config = {};
+                iir_config.n_channels = n_channels;
+                if (filter_enabled) {
+                    iir_butter(&iir_config, 4, IIR_HIGHPASS, 0.5, 0, fs);
+                    iir_butter(&iir_config, 4, IIR_BANDSTOP, 48, 52, fs);
+                }
+                if (clf_f2_init(&f2_config, &f2) != CLF_OK || iir_init(&iir_config, &filter) != IIR_OK) {
+                    std::fprintf(stderr, "Cannot run F2 over %d channels\n", n_channels);
+                    return 1;
+                }
+                if (CLF_F2_SIZE(n_channels) != clf->n_features) {
+                    std::fprintf(stderr, "Model takes %d features, F2 of %d channels gives %d\n",
+                                 clf->n_features, n_channels, CLF_F2_SIZE(n_channels));
+                    return 1;
+                }
+            }
+
+            // DC removal over the whole recording as in the notebook, then causal filtering
+            std::vector<iir_float_t> x(emg.data.size());
+            for (size_t c = 0; c < emg.cols; c++) {
+                double mean = 0;
+                for (size_t r = 0; r < emg.rows; r++) mean += emg.row(r)[c];
+                mean /= emg.rows;
+                for (size_t r = 0; r < emg.rows; r++) x[r * emg.cols + c] = emg.row(r)[c] - mean;
+            }
+            iir_reset(filter);
+            if (filter_enabled) iir_process(filter, x.data(), x.data(), emg.rows);
+
+            size_t start = trim_start * fs, end = std::min<size_t>(trim_end * fs, emg.rows);
+            std::vector<float> sample(n_channels), features(clf->n_features);
+            clf_f2_reset(f2);
+            clf_reset(clf);
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (size_t r = start; r < end; r++) {
+                for (int c = 0; c < n_channels; c++) sample[c] = x[r * n_channels + c];
+                if (clf_f2_push(f2, sample.data(), features.data()))
+                    clf_push(clf, features.data());
+            }
+            clf_result_t result;
+            clf_get_result(clf, &result);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+            total_us += us;
+            worst_us = std::max(worst_us, us);
+
+            const char* best = clf->hmm[result.best].name;
+            if (!rec.label.empty()) {
+                labelled++;
+                if (rec.label == best) correct++;
+            }
+            if (verbose || rec.label.empty())
+                std::printf("%s: %s (margin %.1f, %u windows)%s%s\n", rec.path.c_str(), best, result.margin,
+                            result.n_frames, rec.label.empty() ? "" : ", labelled ", rec.label.c_str());
+        }
+
+        std::printf("%zu recordings, %.0f us per recording on average, %.0f us worst\n",
+                    recs.size(), recs.empty() ? 0 : total_us / recs.size(), worst_us);
+        if (labelled)
+            std::printf("accuracy %zu/%zu = %.3f\n", correct, labelled, (double)correct / labelled);
+
+        if (f2) clf_f2_deinit(f2);
+        if (filter) iir_deinit(filter);
+        clf_deinit(clf);
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,85 @@
+// Receives frames from the base board and prints them as CSV, one row per
+// sample: device id, sample counter, board time in seconds (the frame's DRDY time
+// stepped by the sample period), then each channel in volts. Decisions of the
+// on-board classifier and keep-alive summaries of a gated stream are printed to stderr.
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+#include "protocol_interface.h"
+}
+
+int main(int argc, char** argv)
+{
+    int port = argc > 1 ? std::atoi(argv[1]) : 8080;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        std::perror("socket");
+        return 1;
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("bind");
+        return 1;
+    }
+    std::fprintf(stderr, "Listening on UDP port %d\n", port);
+
+    std::vector<uint8_t> buf(65536);
+    std::vector<int32_t> data;
+    while (true) {
+        ssize_t len = recv(sock, buf.data(), buf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            std::perror("recv");
+            return 1;
+        }
+
+        proto_header_t h;
+        proto_err_t err = proto_decode_header(buf.data(), len, &h);
+        if (err != PROTO_OK) {
+            std::fprintf(stderr, "Dropping datagram of %zd bytes: error %d\n", len, err);
+            continue;
+        }
+        if (h.type == PROTO_TYPE_DECISION) {
+            // Words from the on-board classifier go to stderr, stdout stays plain CSV
+            proto_decision_t d;
+            if (proto_decode_decision(buf.data(), len, &h, &d) != PROTO_OK) continue;
+            std::fprintf(stderr, "%08x,%u: class %u of %u after %u windows, log-likelihood %.1f\n",
+                         h.device_id, h.sample_counter, d.best, d.n_classes, d.n_frames, d.log_likelihood[d.best]);
+            continue;
+        }
+        if (h.type == PROTO_TYPE_SUMMARY) {
+            proto_summary_t s;
+            if (proto_decode_summary(buf.data(), len, &h, &s) != PROTO_OK) continue;
+            std::fprintf(stderr, "%08x,%u: %u samples, %u sent in %u segments, activity floor %.0f peak %.0f\n",
+                         h.device_id, h.sample_counter, s.n_samples, s.active_samples, s.segments, s.floor, s.peak);
+            continue;
+        }
+        if (h.type != PROTO_TYPE_DATA) continue;
+
+        data.resize(static_cast<size_t>(h.n_samples) * h.n_channels);
+        proto_decode_samples(buf.data(), len, &h, data.data());
+
+        double period_us = 1e6 / proto_data_rate_sps(h.data_rate);
+        for (int s = 0; s < h.n_samples; s++) {
+            std::printf("%08x,%u,%.6f", h.device_id, h.sample_counter + s, (h.timestamp_us + s * period_us) * 1e-6);
+            for (int c = 0; c < h.n_channels; c++)
+                std::printf(",%.9f", proto_to_volts(data[s * h.n_channels + c], h.gain[c]));
+            std::printf("\n");
+        }
+        std::fflush(stdout);
+    }
+}
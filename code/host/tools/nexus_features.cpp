@@ -0,0 +1,110 @@
+// Extracts the F1 or F2 features of every trial in a dataset in one go, on all
+// cores, into one feature matrix and a CSV of labels: the feature loop of lda.ipynb
+// and hmm.ipynb without the notebook. Row r of the matrix belongs to the trial of
+// the CSV line whose first <= r < first + windows.
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "batch_features.hpp"
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-features [options] <datasets root | dataset dir>\n"
+        "  --features SPEC   F1, F2 or a list of mav,wl,zc,ssc,mfcc,f1 (F2)\n"
+        "  --out X.npy       feature matrix, labels go next to it as X.csv (features.npy)\n"
+        "  --threads N       worker threads, 0 for one per core (0)\n"
+        "  --fs HZ           sample rate (250)\n"
+        "  --window N        samples per window (100)\n"
+        "  --stride N        samples between windows (25)\n"
+        "  --trim START END  seconds of each trial to use (0.5 4.5)\n"
+        "  --mfcc N          MFCCs per channel (6)\n"
+        "  --mels N          mel bands (15)\n"
+        "  --no-filter       skip the 0.5 Hz high-pass and 48-52 Hz band-stop\n"
+        "  --zero-phase      filter forward and backward with even padding, as hmm.ipynb\n"
+        "                    (sosfiltfilt), rather than causally as lda.ipynb (sosfilt)\n"
+        "  --dataset NAME    only trials of this dataset, repeatable\n"
+        "  --cls C           only this class, repeatable\n"
+        "  --speaker S       only this speaker, repeatable\n"
+        "  --session N       only this session, repeatable\n");
+}
+
+int main(int argc, char** argv)
+{
+    nexus::FeatureSpec spec;
+    nexus::Filter filter;
+    std::string features = "F2", out = "features.npy", root;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--features" && more) features = argv[++i];
+        else if (a == "--out" && more) out = argv[++i];
+        else if (a == "--threads" && more) threads = std::atoi(argv[++i]);
+        else if (a == "--fs" && more) spec.fs = std::atof(argv[++i]);
+        else if (a == "--window" && more) spec.window = std::atoi(argv[++i]);
+        else if (a == "--stride" && more) spec.stride = std::atoi(argv[++i]);
+        else if (a == "--trim" && i + 2 < argc) {
+            spec.trim_start = std::atof(argv[++i]);
+            spec.trim_end = std::atof(argv[++i]);
+        }
+        else if (a == "--mfcc" && more) spec.n_mfcc = std::atoi(argv[++i]);
+        else if (a == "--mels" && more) spec.n_mels = std::atoi(argv[++i]);
+        else if (a == "--no-filter") spec.filter = false;
+        else if (a == "--zero-phase") spec.zero_phase = true;
+        else if (a == "--dataset" && more) filter.datasets.push_back(argv[++i]);
+        else if (a == "--cls" && more) filter.classes.push_back(argv[++i]);
+        else if (a == "--speaker" && more) filter.speakers.push_back(argv[++i]);
+        else if (a == "--session" && more) filter.sessions.push_back(std::atoi(argv[++i]));
+        else if (a[0] != '-' && root.empty()) root = a;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (root.empty() || spec.window < 2 || spec.stride < 1 || spec.trim_start < 0 || spec.trim_end <= spec.trim_start) {
+        usage();
+        return 2;
+    }
+
+    try {
+        spec.blocks = nexus::parse_feature_blocks(features);
+        nexus::Dataset ds(root);
+        std::vector<size_t> trials = ds.select(filter);
+        for (const std::string& path : ds.skipped()) std::fprintf(stderr, "Skipping %s\n", path.c_str());
+
+        ds.prefetch(trials, threads);
+        nexus::FeatureRunStats stats;
+        nexus::FeatureMatrix m = nexus::extract_features(ds, trials, spec, threads, &stats);
+        npy::save(out, m.x);
+
+        std::string labels = out.size() > 4 && out.substr(out.size() - 4) == ".npy" ? out.substr(0, out.size() - 4) : out;
+        labels += ".csv";
+        std::ofstream f(labels);
+        f << "dataset,cls,id,speaker,session,first,windows\n";
+        for (size_t k = 0; k < m.trials.size(); k++) {
+            const nexus::Trial& t = ds.trials()[m.trials[k]];
+            f << t.dataset << ',' << t.cls << ',' << t.id << ',' << t.speaker << ',' << t.session << ','
+              << m.first[k] << ',' << m.windows[k] << '\n';
+        }
+        if (!f.flush()) throw std::runtime_error("cannot write " + labels);
+
+        uint64_t tasks = 0, steals = 0;
+        for (const auto& w : stats.workers) {
+            tasks += w.tasks;
+            steals += w.steals;
+        }
+        std::printf("%zu trials, %zu windows x %zu features in %.3f s on %zu threads (%llu tasks, %llu stolen)\n",
+                    m.trials.size(), m.x.rows, m.x.cols, stats.seconds, stats.workers.size(),
+                    (unsigned long long)tasks, (unsigned long long)steals);
+        std::printf("%s, %s\n", out.c_str(), labels.c_str());
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,147 @@
+// Runs the firmware IIR cascade over a .npy recording (samples, channels), the
+// same causal filtering the board applies before streaming. With --ref the output
+// is compared against scipy.signal.sosfilt output for the same coefficients, see
+// code/ml/filter_reference.py. nexus-filter-f64 is the bit exact double build.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "npy.hpp"
+
+extern "C" {
+#include "iir_interface.h"
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-filter [options] <in.npy> <out.npy>\n"
+        "  --fs HZ           sample rate (250)\n"
+        "  --highpass HZ     Butterworth high-pass cutoff, 0 to disable (0.5)\n"
+        "  --bandstop LO HI  Butterworth band-stop edges, 0 0 to disable (48 52)\n"
+        "  --order N         order of both designs (4)\n"
+        "  --sos FILE        coefficients as numpy.savetxt(sos) rows, replaces the designs\n"
+        "  --ref FILE        reference output to compare against\n"
+        "  --tol X           largest absolute difference accepted with --ref (0)\n");
+}
+
+static bool load_sos(const char* path, iir_config_t* config)
+{
+    FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+    double r[6];
+    while (std::fscanf(f, "%lf %lf %lf %lf %lf %lf", &r[0], &r[1], &r[2], &r[3], &r[4], &r[5]) == 6) {
+        if (config->n_sections >= IIR_MAX_SECTIONS) break;
+        iir_sos_t& s = config->sos[config->n_sections++];
+        // sosfilt normalises by a0 the same way
+        s.b0 = r[0] / r[3];
+        s.b1 = r[1] / r[3];
+        s.b2 = r[2] / r[3];
+        s.a1 = r[4] / r[3];
+        s.a2 = r[5] / r[3];
+    }
+    std::fclose(f);
+    return config->n_sections > 0;
+}
+
+int main(int argc, char** argv)
+{
+    double fs = 250, highpass = 0.5, stop_lo = 48, stop_hi = 52, tol = 0;
+    int order = 4;
+    const char* sos_path = nullptr;
+    const char* ref_path = nullptr;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--fs" && more) fs = std::atof(argv[++i]);
+        else if (a == "--highpass" && more) highpass = std::atof(argv[++i]);
+        else if (a == "--bandstop" && i + 2 < argc) {
+            stop_lo = std::atof(argv[++i]);
+            stop_hi = std::atof(argv[++i]);
+        }
+        else if (a == "--order" && more) order = std::atoi(argv[++i]);
+        else if (a == "--sos" && more) sos_path = argv[++i];
+        else if (a == "--ref" && more) ref_path = argv[++i];
+        else if (a == "--tol" && more) tol = std::atof(argv[++i]);
+        else if (a[0] == '-') {
+            usage();
+            return 2;
+        }
+        else files.push_back(argv[i]);
+    }
+    if (files.size() != 2) {
+        usage();
+        return 2;
+    }
+
+    try {
+        npy::Array in = npy::load(files[0]);
+
+        iir_config_t config = {};
+        config.n_channels = in.cols;
+        if (sos_path) {
+            if (!load_sos(sos_path, &config)) {
+                std::fprintf(stderr, "No coefficients in %s\n", sos_path);
+                return 1;
+            }
+        } else {
+            // Same cascade as signal_processing.py, high-pass then power line band-stop
+            if (highpass > 0 && iir_butter(&config, order, IIR_HIGHPASS, highpass, 0, fs) != IIR_OK) {
+                std::fprintf(stderr, "Bad high-pass design\n");
+                return 1;
+            }
+            if (stop_hi > 0 && iir_butter(&config, order, IIR_BANDSTOP, stop_lo, stop_hi, fs) != IIR_OK) {
+                std::fprintf(stderr, "Bad band-stop design\n");
+                return 1;
+            }
+        }
+
+        iir_handle_t* filter;
+        if (iir_init(&config, &filter) != IIR_OK) {
+            std::fprintf(stderr, "Cannot filter %zu channels with %d sections\n", in.cols, config.n_sections);
+            return 1;
+        }
+        for (int s = 0; s < config.n_sections; s++) {
+            const iir_sos_t& c = config.sos[s];
+            std::fprintf(stderr, "sos[%d] = %.17g %.17g %.17g 1 %.17g %.17g\n", s,
+                         (double)c.b0, (double)c.b1, (double)c.b2, (double)c.a1, (double)c.a2);
+        }
+
+        // Sample by sample like the firmware, in the build's precision
+        std::vector<iir_float_t> frame(in.cols);
+        npy::Array out = in;
+        for (size_t r = 0; r < in.rows; r++) {
+            for (size_t c = 0; c < in.cols; c++) frame[c] = in.row(r)[c];
+            iir_process(filter, frame.data(), frame.data(), 1);
+            for (size_t c = 0; c < in.cols; c++) out.row(r)[c] = frame[c];
+        }
+        iir_deinit(filter);
+        npy::save(files[1], out);
+
+        if (!ref_path) return 0;
+        npy::Array ref = npy::load(ref_path);
+        if (ref.rows != out.rows || ref.cols != out.cols) {
+            std::fprintf(stderr, "Reference shape (%zu, %zu) does not match (%zu, %zu)\n",
+                         ref.rows, ref.cols, out.rows, out.cols);
+            return 1;
+        }
+        size_t identical = 0;
+        double max_diff = 0, max_ref = 0;
+        for (size_t i = 0; i < out.data.size(); i++) {
+            if (std::memcmp(&out.data[i], &ref.data[i], sizeof(double)) == 0) identical++;
+            max_diff = std::fmax(max_diff, std::fabs(out.data[i] - ref.data[i]));
+            max_ref = std::fmax(max_ref, std::fabs(ref.data[i]));
+        }
+        std::printf("%s: %zu/%zu bit identical, max abs diff %.3g (%.3g of full scale)\n", files[0],
+                    identical, out.data.size(), max_diff, max_ref > 0 ? max_diff / max_ref : 0.0);
+        return max_diff <= tol ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
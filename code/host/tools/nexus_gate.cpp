@@ -0,0 +1,305 @@
+// Replays recordings through the firmware's activity gating: the causal IIR cascade,
+// the activity detector and the pre-roll, with frames and keep-alive summaries
+// sized as the board would send them under its flush policy (--latency, --mtu).
+// Recordings play back to back as one session.
+// Reports how many samples and bytes reach the network and, per recording, which
+// parts were sent, so the thresholds can be tuned against datasets/.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "npy.hpp"
+
+extern "C" {
+#include "activity_interface.h"
+#include "iir_interface.h"
+#include "protocol_interface.h"
+}
+
+static const size_t FRAME_BUFFER_SIZE = 1472;  // As in main.c
+static const int UDP_IP_HEADERS = 28;
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-gate [options] <dataset dir | rec.npy...>\n"
+        "  --fs HZ           sample rate (250)\n"
+        "  --channels N      leading channels the energy is taken over (4)\n"
+        "  --window MS       RMS time constant (50)\n"
+        "  --on X            energy over the noise floor that starts a segment (2.5)\n"
+        "  --off X           energy over the noise floor that keeps it going (2)\n"
+        "  --min-on MS       time above --on before a segment starts (40)\n"
+        "  --pre MS          pre-roll (500)\n"
+        "  --post MS         post-roll (500)\n"
+        "  --max MS          longest segment, 0 for no limit (5000)\n"
+        "  --rise MS         time constant the noise floor rises with (2000)\n"
+        "  --fall MS         time constant the noise floor falls with (1000)\n"
+        "  --skip S          seconds dropped from the start of each recording (0.5)\n"
+        "  --speech S E      seconds of each recording expected to hold the word (0.5 4.5)\n"
+        "  --latency MS      samples a frame holds and longest it waits, as FLUSH_MAX_LATENCY_MS (100)\n"
+        "  --mtu BYTES       path MTU the frames fit, as FLUSH_MTU (1500)\n"
+        "  --segments FILE   write every segment as CSV: recording, start and end in seconds\n");
+}
+
+static std::string unquote(std::string s)
+{
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') s = s.substr(1, s.size() - 2);
+    return s;
+}
+
+static std::vector<std::string> list_dataset(const std::string& dir)
+{
+    // metadata.csv: "cls","id","speaker","session"
+    std::ifstream f(dir + "/metadata.csv");
+    if (!f) throw std::runtime_error("cannot open " + dir + "/metadata.csv");
+
+    std::vector<std::string> paths;
+    std::string line;
+    std::getline(f, line);
+    while (std::getline(f, line)) {
+        std::stringstream ss(line);
+        std::string cls, id;
+        if (!std::getline(ss, cls, ',') || !std::getline(ss, id, ',')) continue;
+        paths.push_back(dir + "/" + unquote(id) + ".npy");
+    }
+    return paths;
+}
+
+// The board's frame builder: frames of up to frame_samples consecutive samples, flushed early on a
+// gap, and a partial frame once its first sample is deadline samples old
+struct Framer {
+    uint8_t n_channels;
+    uint16_t frame_samples;
+    double deadline = 0;  // FLUSH_MAX_LATENCY_MS in samples
+    uint16_t pending = 0;
+    uint64_t first = 0, next = 0;
+    uint64_t frames = 0, bytes = 0, samples = 0;
+
+    void flush()
+    {
+        if (!pending) return;
+        frames++;
+        bytes += proto_frame_size(n_channels, pending);
+        pending = 0;
+    }
+
+    void add(uint64_t index)
+    {
+        if (pending && index != next) flush();
+        if (!pending) first = index;
+        pending++;
+        samples++;
+        next = index + 1;
+        if (pending >= frame_samples) flush();
+    }
+
+    // The network task finding the ring drained at sample now
+    void tick(uint64_t now)
+    {
+        if (pending && now - first >= deadline) flush();
+    }
+};
+
+int main(int argc, char** argv)
+{
+    double fs = 250, window_ms = 50, on = 2.5, off = 2, min_on_ms = 40, pre_ms = 500, post_ms = 500;
+    double max_ms = 5000, rise_ms = 2000, fall_ms = 1000;
+    double skip = 0.5, speech_start = 0.5, speech_end = 4.5;
+    int n_detect = 4, latency_ms = 100, mtu = 1500;
+    const char* segments_path = nullptr;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--fs" && more) fs = std::atof(argv[++i]);
+        else if (a == "--channels" && more) n_detect = std::atoi(argv[++i]);
+        else if (a == "--window" && more) window_ms = std::atof(argv[++i]);
+        else if (a == "--on" && more) on = std::atof(argv[++i]);
+        else if (a == "--off" && more) off = std::atof(argv[++i]);
+        else if (a == "--min-on" && more) min_on_ms = std::atof(argv[++i]);
+        else if (a == "--pre" && more) pre_ms = std::atof(argv[++i]);
+        else if (a == "--post" && more) post_ms = std::atof(argv[++i]);
+        else if (a == "--max" && more) max_ms = std::atof(argv[++i]);
+        else if (a == "--rise" && more) rise_ms = std::atof(argv[++i]);
+        else if (a == "--fall" && more) fall_ms = std::atof(argv[++i]);
+        else if (a == "--skip" && more) skip = std::atof(argv[++i]);
+        else if (a == "--speech" && i + 2 < argc) {
+            speech_start = std::atof(argv[++i]);
+            speech_end = std::atof(argv[++i]);
+        }
+        else if (a == "--latency" && more) latency_ms = std::atoi(argv[++i]);
+        else if (a == "--mtu" && more) mtu = std::atoi(argv[++i]);
+        else if (a == "--segments" && more) segments_path = argv[++i];
+        else if (a[0] == '-') {
+            usage();
+            return 2;
+        }
+        else args.push_back(argv[i]);
+    }
+    if (args.empty() || latency_ms < 1 || mtu - UDP_IP_HEADERS > (int)FRAME_BUFFER_SIZE) {
+        usage();
+        return 2;
+    }
+
+    try {
+        std::vector<std::string> paths;
+        std::string first = args[0];
+        if (args.size() == 1 && first.size() > 4 && first.substr(first.size() - 4) != ".npy")
+            paths = list_dataset(first);
+        else
+            paths.assign(args.begin(), args.end());
+
+        FILE* segments = segments_path ? std::fopen(segments_path, "w") : nullptr;
+        if (segments) std::fprintf(segments, "recording,start,end\n");
+
+        act_handle_t* activity = nullptr;
+        iir_handle_t* filter = nullptr;
+        Framer framer = {};
+        std::deque<uint64_t> pre_roll; // Sample indices waiting, the board keeps whole samples
+        size_t pre_roll_cap = 0;
+        uint64_t index = 0, summaries = 0, summary_bytes = 0;
+        uint32_t summary_period = fs * 1.0;
+        size_t hit = 0, missed = 0, total_segments = 0;
+        // Segments can run into the next recording, they are reported against the one they start in
+        std::string seg_path;
+        double seg_start = 0, seg_origin = 0;
+
+        for (const std::string& path : paths) {
+            npy::Array emg = npy::load(path);
+            if (!activity) {
+                act_config_t config = {};
+                config.n_channels = emg.cols;
+                config.n_detect = std::min<int>(n_detect, emg.cols);
+                config.window = fs * window_ms / 1000;
+                config.on_ratio = on;
+                config.off_ratio = off;
+                config.min_on = std::max(1.0, fs * min_on_ms / 1000);
+                config.pre_roll = fs * pre_ms / 1000;
+                config.post_roll = fs * post_ms / 1000;
+                config.max_segment = fs * max_ms / 1000;
+                config.floor_rise_tc = fs * rise_ms / 1000;
+                config.floor_fall_tc = fs * fall_ms / 1000;
+                iir_config_t iir_config = {};
+                iir_config.n_channels = emg.cols;
+                iir_butter(&iir_config, 4, IIR_HIGHPASS, 0.5, 0, fs);
+                iir_butter(&iir_config, 4, IIR_BANDSTOP, 48, 52, fs);
+                if (act_init(&config, &activity) != ACT_OK || iir_init(&iir_config, &filter) != IIR_OK) {
+                    std::fprintf(stderr, "Bad activity or filter configuration\n");
+                    return 1;
+                }
+                // Raw frames bound the size, as in stream_configure()
+                uint16_t cap = proto_frame_capacity(std::max(mtu - UDP_IP_HEADERS, 0), emg.cols);
+                if (cap < 1) {
+                    std::fprintf(stderr, "No sample of %zu channels fits an MTU of %d\n", emg.cols, mtu);
+                    return 1;
+                }
+                framer.n_channels = emg.cols;
+                framer.frame_samples = std::clamp<int>(fs * latency_ms / 1000, 1, cap);
+                framer.deadline = fs * latency_ms / 1000;
+                pre_roll_cap = 1;
+                while (pre_roll_cap < (size_t)config.pre_roll + config.min_on) pre_roll_cap <<= 1;
+            }
+            if (emg.cols != activity->config.n_channels) {
+                std::fprintf(stderr, "%s: %zu channels, expected %d\n", path.c_str(), emg.cols, activity->config.n_channels);
+                return 1;
+            }
+
+            // Recordings open with an initialization transient, the notebooks drop it too
+            size_t first_row = std::min<size_t>(skip * fs, emg.rows);
+            uint64_t rec_start = index - first_row, sent_before = framer.samples;
+            uint64_t speech_lo = rec_start + (uint64_t)(speech_start * fs), speech_hi = rec_start + (uint64_t)(speech_end * fs);
+            bool speech_sent = false;
+            int rec_segments = 0;
+            std::vector<iir_float_t> x(emg.cols);
+            std::vector<float> f(emg.cols);
+
+            // Recordings are separate captures, take out each one's offset so the joins do not
+            // step the high-pass. On the board the stream is continuous.
+            for (size_t c = 0; c < emg.cols; c++) {
+                double mean = 0;
+                for (size_t r = first_row; r < emg.rows; r++) mean += emg.row(r)[c];
+                mean /= std::max<size_t>(emg.rows - first_row, 1);
+                for (size_t r = first_row; r < emg.rows; r++) emg.row(r)[c] -= mean;
+            }
+
+            for (size_t r = first_row; r < emg.rows; r++, index++) {
+                for (size_t c = 0; c < emg.cols; c++) x[c] = emg.row(r)[c];
+                iir_process(filter, x.data(), x.data(), 1);
+                for (size_t c = 0; c < emg.cols; c++) f[c] = x[c];
+
+                act_event_t event = act_push(activity, f.data());
+                if (event == ACT_EVENT_START) {
+                    size_t backlog = act_backlog(activity);
+                    while (pre_roll.size() > backlog) pre_roll.pop_front();
+                    seg_path = path;
+                    seg_origin = rec_start;
+                    seg_start = pre_roll.empty() ? index : pre_roll.front();
+                    for (uint64_t i : pre_roll) {
+                        framer.add(i);
+                        if (i >= speech_lo && i < speech_hi) speech_sent = true;
+                    }
+                    pre_roll.clear();
+                    rec_segments++;
+                }
+                if (activity->state == ACT_ACTIVE || event == ACT_EVENT_END) {
+                    framer.add(index);
+                    if (index >= speech_lo && index < speech_hi) speech_sent = true;
+                    if (event == ACT_EVENT_END) {
+                        framer.flush();
+                        if (segments)
+                            std::fprintf(segments, "%s,%.3f,%.3f\n", seg_path.c_str(),
+                                         (seg_start - seg_origin) / fs, (index + 1.0 - seg_origin) / fs);
+                    }
+                } else {
+                    if (pre_roll.size() == pre_roll_cap) pre_roll.pop_front();
+                    pre_roll.push_back(index);
+                }
+                framer.tick(index);
+                if (activity->summary.n_samples >= summary_period) {
+                    act_reset_summary(activity);
+                    summaries++;
+                    summary_bytes += PROTO_SUMMARY_SIZE(emg.cols);
+                }
+            }
+
+            total_segments += rec_segments;
+            (speech_sent ? hit : missed)++;
+            if (rec_segments == 0 || !speech_sent)
+                std::fprintf(stderr, "%s: %d segments, %.0f%% sent, word window %s\n", path.c_str(), rec_segments,
+                             100.0 * (framer.samples - sent_before) / std::max<size_t>(emg.rows - first_row, 1), speech_sent ? "sent" : "missed");
+        }
+        framer.flush();
+        if (segments) std::fclose(segments);
+
+        uint64_t raw_bytes = 0;
+        Framer all = framer;
+        all.frames = all.bytes = all.samples = all.pending = 0;
+        for (uint64_t i = 0; i < index; i++) all.add(i);
+        all.flush();
+        raw_bytes = all.bytes;
+
+        uint64_t gated_bytes = framer.bytes + summary_bytes;
+        std::printf("%zu recordings, %.1f s, %zu segments\n", paths.size(), index / fs, total_segments);
+        std::printf("samples sent %llu/%llu (%.1f%%), word window sent in %zu/%zu recordings\n",
+                    (unsigned long long)framer.samples, (unsigned long long)index,
+                    index ? 100.0 * framer.samples / index : 0.0, hit, hit + missed);
+        std::printf("datagrams %llu + %llu summaries vs %llu ungated, bytes %llu vs %llu (%.1f%%)\n",
+                    (unsigned long long)framer.frames, (unsigned long long)summaries, (unsigned long long)all.frames,
+                    (unsigned long long)gated_bytes, (unsigned long long)raw_bytes,
+                    raw_bytes ? 100.0 * gated_bytes / raw_bytes : 0.0);
+
+        act_deinit(activity);
+        iir_deinit(filter);
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,807 @@
+// Receives the board's stream and writes it straight into the datasets/ layout: one
+// <unix time>.npy per recording, (samples, channels) float64 microvolts, and a row in
+// metadata.csv once the recording is closed. Datagrams are read in batches with
+// recvmmsg and converted from the receive buffers directly into preallocated, memory
+// mapped files. Frames are placed by their sample counter, so reordered frames land
+// where they belong and samples that never arrive stay NaN.
+//
+// A recording ends when its device goes quiet for --idle seconds, skips more than that
+// many samples (a gated stream between segments), restarts, changes channel count,
+// data rate, gain or whether it filters on the board, or reaches --split seconds.
+//
+// metadata.csv gets a "filtered" column, 1 for recordings the board's IIR cascade ran
+// on. An existing metadata.csv without it only takes raw recordings, filtered streams
+// are refused rather than mixed in with nothing to tell them apart.
+//
+// Every --sync seconds each device gets a clock exchange on its sync port, and the
+// replies (kernel receive timestamps) fit its clock to the host's. A closed recording
+// then gets <id>.times.npy beside it: the unix time in seconds of every row, its DRDY
+// time on the board mapped to the host's clock.
+//
+// The board's telemetry frames are appended to the --telemetry CSV, as nexus-telemetry
+// logs them.
+//
+// Frames missing from a device's sequence for --nack milliseconds are asked for again
+// with NACK frames, every --nack milliseconds up to --nack-tries times, and the board
+// resends them from its replay window. Resent frames are placed like reordered ones,
+// however far behind they arrive. The statistics count what was recovered, what was
+// given up on and how long recovery took.
+//
+// With --latency the statistics also give the end to end latency of the samples, from
+// their DRDY edge on the board's fitted clock to the kernel's receive timestamp, for the
+// oldest and newest sample of each frame. It needs clock exchanges (--sync) and leaves
+// out resent frames.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock_sync.hpp"
+#include "npy.hpp"
+#include "telemetry_log.hpp"
+
+extern "C" {
+#include "protocol_interface.h"
+}
+
+static const size_t HEADER_SIZE = 128;  // Fixed so the shape can be rewritten in place
+static const size_t SLOT_SIZE = 2048;   // Receive buffer per datagram, the board sends at most 1472 bytes
+static const int SEQ_WINDOW = 64;       // Frames a late frame may trail by and still be placed
+static const size_t MAX_PENDING = 4096; // Missing frames tracked per device, a longer gap is not NACKed
+
+using clock_type = std::chrono::steady_clock;
+
+static volatile std::sig_atomic_t stop = 0;
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-ingest [options] <dataset dir>\n"
+        "  --port N          UDP port (8080)\n"
+        "  --batch N         datagrams per recvmmsg (64)\n"
+        "  --rcvbuf BYTES    socket receive buffer (8 MB)\n"
+        "  --prealloc S      seconds of samples a new file is allocated for, grows by doubling (60)\n"
+        "  --idle S          quiet time or sample gap that ends a recording (2)\n"
+        "  --split S         longest recording, 0 for no limit (0)\n"
+        "  --stats S         seconds between statistics on stderr, 0 for none (5)\n"
+        "  --cls NAME        label written to metadata.csv (unlabelled)\n"
+        "  --speaker NAME    speaker written to metadata.csv (unknown)\n"
+        "  --session N       session written to metadata.csv (0)\n"
+        "  --sync S          seconds between clock exchanges with each device, 0 for none (1)\n"
+        "  --sync-port N     UDP port the boards answer exchanges on (8081)\n"
+        "  --telemetry FILE  CSV to append the boards' telemetry frames to\n"
+        "  --nack MS         wait before asking for a missing frame again and between asks, 0 never (20)\n"
+        "  --nack-tries N    asks before a missing frame is given up on (5)\n"
+        "  --latency         report end to end sample latency with the statistics\n");
+}
+
+struct Options {
+    int port = 8080;
+    int batch = 64;
+    int rcvbuf = 8 << 20;
+    double prealloc = 60, idle = 2, split = 0, stats = 5, sync = 1;
+    int sync_port = 8081;
+    double nack = 20;
+    int nack_tries = 5;
+    bool latency = false;
+    std::string dir, cls = "unlabelled", speaker = "unknown", telemetry;
+    int session = 0;
+};
+
+// A memory mapped .npy being written, rows past the end of the header
+struct Recording {
+    std::string path;
+    uint64_t id = 0;
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t map_size = 0;
+    size_t cols = 0;
+    size_t capacity = 0;    // Rows the file has room for
+    size_t rows = 0;        // Rows written or NaN filled, the final shape
+    size_t received = 0;    // Samples that arrived
+    bool filtered = false;  // PROTO_FLAG_FILTERED, the board's IIR cascade ran on the samples
+
+    double* row(size_t r) { return reinterpret_cast<double*>(map + HEADER_SIZE) + r * cols; }
+};
+
+struct DeviceStats {
+    uint64_t frames = 0, samples = 0;
+    uint64_t lost = 0;          // Frames skipped in the sequence and not seen since
+    uint64_t reordered = 0;     // Frames that arrived after a later one
+    uint64_t duplicates = 0;
+    uint64_t late = 0;          // Frames too old to place, dropped
+    uint64_t recordings = 0;
+    uint64_t restarts = 0;
+    uint64_t syncs = 0;         // Exchanges answered
+    uint64_t nacks = 0;         // NACK frames sent
+    uint64_t nacked = 0;        // Frames asked for at least once
+    uint64_t recovered = 0;     // Of them arrived after all
+    uint64_t given_up = 0;      // Of them asked for --nack-tries times without an answer
+};
+
+// A frame missing from the sequence
+struct Pending {
+    clock_type::time_point missed, nacked;
+    int nacks = 0;
+};
+
+struct Device {
+    uint32_t id = 0;
+    bool synced = false;         // Sequence and counter tracking started
+    uint32_t next_seq = 0;
+    uint64_t seen = 0;           // Bit i: frame next_seq - 1 - i arrived
+    int64_t counter = 0;         // Highest sample counter seen, extended past 32 bits
+    int64_t first_counter = 0;   // Extended counter of the frame tracking started from
+    int far_behind = 0;          // Frames in a row from too far behind to place
+    clock_type::time_point last_rx;
+
+    bool open = false;
+    Recording rec;
+    int64_t first = 0;           // Extended counter of row 0
+    uint8_t n_channels = 0, data_rate = 0;
+    bool filtered = false;
+    bool refused = false;        // Told about a filtered stream metadata.csv cannot take
+    uint8_t gain[PROTO_MAX_CHANNELS] = {};
+    double scale[PROTO_MAX_CHANNELS] = {};  // Codes to microvolts
+    uint32_t sps = 0;
+    DeviceStats stats, reported;
+
+    sockaddr_in addr = {};       // Where its frames come from
+    nexus::ClockSync clock;
+    nexus::SampleClock timing;   // Of the open recording
+    uint32_t sync_seq = 0;
+    clock_type::time_point last_sync;
+
+    std::map<uint32_t, Pending> pending;  // By sequence number
+    uint32_t nack_seq = 0;
+    std::vector<double> recovery_ms;      // Since the last statistics
+
+    std::vector<double> oldest_ms, newest_ms;  // End to end latency per frame, since the last statistics
+    uint64_t latency_samples = 0;
+};
+
+static int64_t unix_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void write_header(Recording& r)
+{
+    std::string h = npy::header(r.rows, r.cols, HEADER_SIZE);
+    std::memcpy(r.map, h.data(), h.size());
+}
+
+static bool map_file(Recording& r, size_t capacity)
+{
+    size_t size = HEADER_SIZE + capacity * r.cols * sizeof(double);
+    // Reserve the blocks now, a full disk fails here rather than as SIGBUS in the middle of a write
+    int err = posix_fallocate(r.fd, 0, size);
+    if (err != 0 && err != EOPNOTSUPP && err != EINVAL) {
+        errno = err;
+        return false;
+    }
+    if (err && ftruncate(r.fd, size) < 0) return false;
+
+    void* map = r.map ? mremap(r.map, r.map_size, size, MREMAP_MAYMOVE)
+                      : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, r.fd, 0);
+    if (map == MAP_FAILED) return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+    r.map = static_cast<uint8_t*>(map);
+    r.map_size = size;
+    r.capacity = capacity;
+    return true;
+}
+
+static bool open_recording(Recording& r, const std::string& dir, size_t cols, size_t capacity)
+{
+    // Named by the unix time it starts at like the rest of datasets/, the next free second on a clash
+    r = Recording();
+    r.cols = cols;
+    for (r.id = std::time(nullptr);; r.id++) {
+        r.path = dir + "/" + std::to_string(r.id) + ".npy";
+        r.fd = open(r.path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (r.fd >= 0) break;
+        if (errno != EEXIST) return false;
+    }
+    if (!map_file(r, capacity)) {
+        close(r.fd);
+        unlink(r.path.c_str());
+        return false;
+    }
+    write_header(r);
+    return true;
+}
+
+// Whether metadata.csv in dir has the filtered column, a new one is written with it
+static bool metadata_has_filtered(const std::string& dir)
+{
+    std::ifstream f(dir + "/metadata.csv");
+    std::string header;
+    if (!std::getline(f, header)) return true;
+    return header.find("\"filtered\"") != std::string::npos;
+}
+
+static void close_recording(Recording& r, const Options& opt)
+{
+    write_header(r);
+    munmap(r.map, r.map_size);
+    bool keep = r.rows > 0 && ftruncate(r.fd, HEADER_SIZE + r.rows * r.cols * sizeof(double)) == 0;
+    close(r.fd);
+    if (!keep) {
+        unlink(r.path.c_str());
+        return;
+    }
+
+    std::string meta = opt.dir + "/metadata.csv";
+    bool fresh = access(meta.c_str(), F_OK) != 0;
+    bool column = metadata_has_filtered(opt.dir);
+    FILE* f = std::fopen(meta.c_str(), "a");
+    if (!f) {
+        std::perror(meta.c_str());
+        return;
+    }
+    if (fresh) std::fprintf(f, "\"cls\",\"id\",\"speaker\",\"session\",\"filtered\"\n");
+    std::fprintf(f, "\"%s\",%llu,\"%s\",%d", opt.cls.c_str(), (unsigned long long)r.id, opt.speaker.c_str(), opt.session);
+    if (column) std::fprintf(f, ",%d", r.filtered ? 1 : 0);
+    std::fprintf(f, "\n");
+    std::fclose(f);
+}
+
+// Unix time of every row from the board's clock and the fit to the host's
+static void write_times(const Device& d)
+{
+    const Recording& r = d.rec;
+    std::string path = r.path.substr(0, r.path.size() - 4) + ".times.npy";
+    if (!d.clock.valid() || !d.timing.valid()) {
+        std::fprintf(stderr, "%08x: no clock exchanges answered, %s not written\n", d.id, path.c_str());
+        return;
+    }
+    npy::Array t;
+    t.rows = r.rows;
+    t.cols = 1;
+    t.data.resize(r.rows);
+    for (size_t i = 0; i < r.rows; i++) t.data[i] = d.clock.to_host(d.timing.at(i)) * 1e-6;
+    try {
+        npy::save(path, t);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+    }
+}
+
+static void end_recording(Device& d, const Options& opt)
+{
+    if (!d.open) return;
+    close_recording(d.rec, opt);
+    if (d.rec.rows && opt.sync > 0) write_times(d);
+    std::fprintf(stderr, "%08x: closed %s, %zu samples, %zu missing\n", d.id, d.rec.path.c_str(),
+                 d.rec.rows, d.rec.rows - d.rec.received);
+    d.open = false;
+}
+
+static bool start_recording(Device& d, const proto_header_t& h, int64_t first, const Options& opt)
+{
+    bool filtered = h.flags & PROTO_FLAG_FILTERED;
+    if (filtered && !metadata_has_filtered(opt.dir)) {
+        if (!d.refused)
+            std::fprintf(stderr, "%08x: filtered on the board, but %s/metadata.csv has no filtered column; "
+                         "not recording until it streams raw samples\n", d.id, opt.dir.c_str());
+        d.refused = true;
+        return false;
+    }
+    d.refused = false;
+    d.filtered = filtered;
+    d.n_channels = h.n_channels;
+    d.data_rate = h.data_rate;
+    d.sps = proto_data_rate_sps(h.data_rate);
+    std::memcpy(d.gain, h.gain, sizeof(d.gain));
+    for (int c = 0; c < h.n_channels; c++)
+        d.scale[c] = proto_to_volts(1, h.gain[c]) * 1e6;
+
+    size_t capacity = std::max<size_t>(d.sps * opt.prealloc, 1024);
+    if (!open_recording(d.rec, opt.dir, h.n_channels, capacity)) {
+        std::fprintf(stderr, "%08x: cannot create a recording in %s: %s\n", d.id, opt.dir.c_str(), std::strerror(errno));
+        return false;
+    }
+    d.rec.filtered = filtered;
+    d.open = true;
+    d.first = first;
+    d.timing.clear();
+    d.timing.set_nominal_period(1e6 / d.sps);
+    d.stats.recordings++;
+    std::fprintf(stderr, "%08x: recording %s, %u SPS, %u channels%s\n", d.id, d.rec.path.c_str(), d.sps, h.n_channels,
+                 filtered ? ", filtered on the board" : "");
+    return true;
+}
+
+static bool same_format(const Device& d, const proto_header_t& h)
+{
+    return h.n_channels == d.n_channels && h.data_rate == d.data_rate &&
+           (bool)(h.flags & PROTO_FLAG_FILTERED) == d.filtered && std::memcmp(h.gain, d.gain, h.n_channels) == 0;
+}
+
+// A missing frame turned up, NACKed or not. False when it was not missing.
+static bool found_pending(Device& d, uint32_t seq, clock_type::time_point now)
+{
+    auto it = d.pending.find(seq);
+    if (it == d.pending.end()) return false;
+    if (it->second.nacks) {
+        d.stats.recovered++;
+        d.recovery_ms.push_back(std::chrono::duration<double, std::milli>(now - it->second.missed).count());
+    }
+    d.pending.erase(it);
+    return true;
+}
+
+// Sequence tracking. False for duplicates and frames too late to place, which are dropped.
+static bool track_seq(Device& d, const proto_header_t& h, const Options& opt, clock_type::time_point now)
+{
+    if (!d.synced) {
+        d.synced = true;
+        d.next_seq = h.seq + 1;
+        d.seen = 1;
+        d.counter = d.first_counter = h.sample_counter;
+        d.far_behind = 0;
+        d.pending.clear();
+        return true;
+    }
+
+    int32_t ahead = (int32_t)(h.seq - d.next_seq);
+    if (ahead >= 0) {
+        d.far_behind = 0;
+        // Frames in between are lost until they turn up
+        d.stats.lost += ahead;
+        d.seen = ahead + 1 >= 64 ? 1 : (d.seen << (ahead + 1)) | 1;
+        if (opt.nack > 0)
+            for (uint32_t seq = d.next_seq; seq != h.seq && d.pending.size() < MAX_PENDING; seq++)
+                d.pending[seq].missed = now;
+        d.next_seq = h.seq + 1;
+        return true;
+    }
+
+    int behind = -ahead - 1;  // Bit of this frame in seen
+    if (behind < SEQ_WINDOW) {
+        uint64_t bit = 1ull << behind;
+        if (d.seen & bit) {
+            d.stats.duplicates++;
+            return false;
+        }
+        d.seen |= bit;
+        d.stats.reordered++;
+        if (d.stats.lost) d.stats.lost--;
+        found_pending(d, h.seq, now);
+        return true;
+    }
+
+    // Further behind than seen covers, a resend of a frame that is still missing or one already placed
+    if (found_pending(d, h.seq, now)) {
+        d.stats.reordered++;
+        if (d.stats.lost) d.stats.lost--;
+        return true;
+    }
+    if (h.flags & PROTO_FLAG_RETRANSMIT) {
+        d.stats.duplicates++;
+        return false;
+    }
+
+    // Far behind with its sample counter back at or before where tracking started, or
+    // nothing but such frames for a while: the board restarted, start over from this frame.
+    // Otherwise a frame held up somewhere, too late to place.
+    int64_t counter = d.counter + (int32_t)(h.sample_counter - (uint32_t)d.counter);
+    if (counter > d.first_counter && ++d.far_behind < SEQ_WINDOW) {
+        d.stats.late++;
+        return false;
+    }
+    end_recording(d, opt);
+    d.stats.restarts++;
+    d.synced = false;
+    return track_seq(d, h, opt, now);
+}
+
+static void place_samples(Device& d, const uint8_t* buf, size_t len, const proto_header_t& h, const Options& opt,
+                          std::vector<int32_t>& scratch)
+{
+    // 32 bit counter extended around the highest one seen, so it survives wrapping
+    int64_t counter = d.counter + (int32_t)(h.sample_counter - (uint32_t)d.counter);
+    if (counter > d.counter) d.counter = counter;
+
+    int64_t idle_samples = (int64_t)(opt.idle * d.sps);
+    if (d.open) {
+        int64_t row = counter - d.first;
+        bool gap = row > (int64_t)d.rec.rows + idle_samples;
+        bool full = opt.split > 0 && row >= (int64_t)(opt.split * d.sps);
+        if (!same_format(d, h) || gap || full) end_recording(d, opt);
+    }
+    if (!d.open && !start_recording(d, h, counter, opt)) return;
+
+    Recording& r = d.rec;
+    int64_t row = counter - d.first;
+    if (row < 0) {
+        d.stats.late++;  // Belongs before the start of the recording
+        return;
+    }
+    size_t end = row + h.n_samples;
+    if (end > r.capacity) {
+        size_t capacity = r.capacity;
+        while (capacity < end) capacity *= 2;
+        if (!map_file(r, capacity)) {
+            std::fprintf(stderr, "%s: cannot grow to %zu samples: %s\n", r.path.c_str(), capacity, std::strerror(errno));
+            end_recording(d, opt);
+            return;
+        }
+    }
+    // Missing samples read as NaN until a late frame fills them in
+    for (size_t i = r.rows; i < (size_t)row; i++)
+        std::fill_n(r.row(i), r.cols, std::numeric_limits<double>::quiet_NaN());
+
+    const uint8_t n_ch = h.n_channels;
+    double* out = r.row(row);
+    if (h.flags & PROTO_FLAG_RICE) {
+        // Coded samples need a pass through the decoder, a few kB that stay in cache
+        scratch.resize((size_t)h.n_samples * n_ch);
+        if (proto_decode_samples(buf, len, &h, scratch.data()) != PROTO_OK) return;
+        for (size_t i = 0; i < scratch.size(); i++)
+            out[i] = scratch[i] * d.scale[i % n_ch];
+    } else {
+        // Packed 24 bit samples straight from the receive buffer into the mapped file
+        if (len < proto_frame_size(n_ch, h.n_samples)) return;
+        const uint8_t* p = buf + PROTO_HEADER_SIZE + n_ch;
+        for (int s = 0; s < h.n_samples; s++)
+            for (int c = 0; c < n_ch; c++, p += PROTO_SAMPLE_BYTES) {
+                int32_t v = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+                *out++ = v * d.scale[c];
+            }
+    }
+
+    if (end > r.rows) r.rows = end;
+    r.received += h.n_samples;
+    d.timing.add(row, h.timestamp_us);
+    d.stats.samples += h.n_samples;
+}
+
+static void handle_sync(std::unordered_map<uint32_t, Device>& devices, const uint8_t* buf, size_t len, int64_t rx_us)
+{
+    proto_sync_t sync;
+    if (proto_decode_sync(buf, len, &sync) != PROTO_OK || sync.type != PROTO_TYPE_SYNC_REPLY) return;
+    auto it = devices.find(sync.device_id);
+    if (it == devices.end()) return;
+    it->second.clock.add({sync.t1_us, sync.t2_us, sync.t3_us, rx_us});
+    it->second.stats.syncs++;
+}
+
+static void send_sync(int sock, Device& d, const Options& opt)
+{
+    proto_sync_t sync = {};
+    sync.type = PROTO_TYPE_SYNC_REQUEST;
+    sync.device_id = d.id;
+    sync.seq = d.sync_seq++;
+    uint8_t buf[PROTO_SYNC_SIZE];
+    sockaddr_in to = d.addr;
+    to.sin_port = htons(opt.sync_port);
+    sync.t1_us = unix_us();
+    size_t len = proto_encode_sync(buf, sizeof(buf), &sync);
+    sendto(sock, buf, len, 0, reinterpret_cast<sockaddr*>(&to), sizeof(to));
+}
+
+// Asks for the frames missing for --nack ms and not asked for in as long, in runs of consecutive ones
+static void send_nacks(int sock, Device& d, const Options& opt, clock_type::time_point now)
+{
+    const auto wait = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double, std::milli>(opt.nack));
+    proto_nack_t nack = {};
+    nack.device_id = d.id;
+    auto flush = [&]() {
+        if (!nack.n_ranges) return;
+        nack.seq = d.nack_seq++;
+        uint8_t buf[PROTO_NACK_SIZE(PROTO_NACK_MAX_RANGES)];
+        size_t len = proto_encode_nack(buf, sizeof(buf), &nack);
+        sendto(sock, buf, len, 0, reinterpret_cast<const sockaddr*>(&d.addr), sizeof(d.addr));
+        d.stats.nacks++;
+        nack.n_ranges = 0;
+    };
+
+    for (auto it = d.pending.begin(); it != d.pending.end();) {
+        Pending& p = it->second;
+        if (now - p.missed < wait || (p.nacks && now - p.nacked < wait)) {
+            ++it;
+            continue;
+        }
+        if (p.nacks >= opt.nack_tries) {
+            d.stats.given_up++;
+            it = d.pending.erase(it);
+            continue;
+        }
+        if (!p.nacks) d.stats.nacked++;
+        p.nacks++;
+        p.nacked = now;
+
+        proto_nack_range_t* last = nack.n_ranges ? &nack.ranges[nack.n_ranges - 1] : nullptr;
+        if (last && it->first == last->first_seq + last->count && last->count < UINT16_MAX) {
+            last->count++;
+        } else {
+            if (nack.n_ranges == PROTO_NACK_MAX_RANGES) flush();
+            nack.ranges[nack.n_ranges++] = {it->first, 1};
+        }
+        ++it;
+    }
+    flush();
+}
+
+static void handle_datagram(std::unordered_map<uint32_t, Device>& devices, const uint8_t* buf, size_t len,
+                            const sockaddr_in& from, const Options& opt, std::vector<int32_t>& scratch,
+                            nexus::TelemetryLog* telemetry, clock_type::time_point now, int64_t rx_us)
+{
+    proto_header_t h;
+    proto_err_t err = proto_decode_header(buf, len, &h);
+    if (err != PROTO_OK) {
+        std::fprintf(stderr, "Dropping datagram of %zu bytes: error %d\n", len, err);
+        return;
+    }
+
+    Device& d = devices[h.device_id];
+    d.id = h.device_id;
+    d.addr = from;
+    d.last_rx = now;
+    d.stats.frames++;
+    if (!track_seq(d, h, opt, now)) return;
+
+    if (h.type == PROTO_TYPE_DATA) {
+        place_samples(d, buf, len, h, opt, scratch);
+        if (opt.latency && d.clock.valid() && !(h.flags & PROTO_FLAG_RETRANSMIT) && h.n_samples) {
+            double first_us = d.clock.to_host(h.timestamp_us);
+            double last_us = d.clock.to_host(h.timestamp_us + (h.n_samples - 1) * 1e6 / proto_data_rate_sps(h.data_rate));
+            d.oldest_ms.push_back((rx_us - first_us) * 1e-3);
+            d.newest_ms.push_back((rx_us - last_us) * 1e-3);
+            d.latency_samples += h.n_samples;
+        }
+    } else if (h.type == PROTO_TYPE_DECISION) {
+        proto_decision_t dec;
+        if (proto_decode_decision(buf, len, &h, &dec) == PROTO_OK)
+            std::fprintf(stderr, "%08x,%u: class %u of %u after %u windows\n",
+                         h.device_id, h.sample_counter, dec.best, dec.n_classes, dec.n_frames);
+    } else if (h.type == PROTO_TYPE_TELEMETRY && telemetry) {
+        proto_telemetry_t t;
+        if (proto_decode_telemetry(buf, len, &h, &t) == PROTO_OK) telemetry->add(h, t, nullptr);
+    }
+    // Summaries only keep the device from going idle
+}
+
+static void print_stats(std::unordered_map<uint32_t, Device>& devices, double elapsed_s,
+                        uint64_t datagrams, uint64_t calls, uint64_t truncated)
+{
+    std::fprintf(stderr, "%.1f datagrams per recvmmsg, %llu truncated\n",
+                 calls ? (double)datagrams / calls : 0.0, (unsigned long long)truncated);
+    for (auto& [id, d] : devices) {
+        const DeviceStats& s = d.stats;
+        std::fprintf(stderr, "%08x: %.0f samples/s, frames %llu, lost %llu, reordered %llu, duplicates %llu, late %llu, "
+                     "recordings %llu, restarts %llu\n", id,
+                     (s.samples - d.reported.samples) / elapsed_s, (unsigned long long)s.frames,
+                     (unsigned long long)s.lost, (unsigned long long)s.reordered, (unsigned long long)s.duplicates,
+                     (unsigned long long)s.late, (unsigned long long)s.recordings, (unsigned long long)s.restarts);
+        if (s.nacked || !d.pending.empty()) {
+            std::vector<double>& ms = d.recovery_ms;
+            std::sort(ms.begin(), ms.end());
+            std::fprintf(stderr, "%08x: %llu frames NACKed in %llu NACKs, %llu recovered, %llu given up, %zu missing",
+                         id, (unsigned long long)s.nacked, (unsigned long long)s.nacks,
+                         (unsigned long long)s.recovered, (unsigned long long)s.given_up, d.pending.size());
+            // Time from noticing the gap to the frame, of those recovered since the last statistics
+            if (!ms.empty()) {
+                auto at = [&](double q) { return ms[std::min(ms.size() - 1, (size_t)(q * ms.size()))]; };
+                std::fprintf(stderr, ", recovered in ms p50/p90/max %.1f/%.1f/%.1f", at(0.5), at(0.9), ms.back());
+            }
+            std::fputc('\n', stderr);
+            ms.clear();
+        }
+        if (!d.oldest_ms.empty()) {
+            auto quantiles = [](std::vector<double>& ms, char* out, size_t size) {
+                std::sort(ms.begin(), ms.end());
+                auto at = [&](double q) { return ms[std::min(ms.size() - 1, (size_t)(q * ms.size()))]; };
+                std::snprintf(out, size, "%.1f/%.1f/%.1f", at(0.5), at(0.99), ms.back());
+            };
+            char oldest[64], newest[64];
+            quantiles(d.oldest_ms, oldest, sizeof(oldest));
+            quantiles(d.newest_ms, newest, sizeof(newest));
+            std::fprintf(stderr, "%08x: end to end ms p50/p99/max, oldest sample of a frame %s, newest %s, "
+                         "%.1f samples per frame\n", id, oldest, newest, (double)d.latency_samples / d.oldest_ms.size());
+            d.oldest_ms.clear();
+            d.newest_ms.clear();
+            d.latency_samples = 0;
+        }
+        nexus::ClockEstimate c = d.clock.estimate();
+        if (c.valid)
+            std::fprintf(stderr, "%08x: clock offset %.3f ms, drift %.1f ppm, fastest round trip %.0f us, "
+                         "fit %.0f us RMS over %zu of %zu exchanges\n", id, c.offset_us * 1e-3, c.drift_ppm,
+                         c.rtt_min_us, c.residual_us, c.used, c.exchanges);
+        d.reported = s;
+    }
+}
+
+static void on_signal(int)
+{
+    stop = 1;
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--port" && more) opt.port = std::atoi(argv[++i]);
+        else if (a == "--batch" && more) opt.batch = std::atoi(argv[++i]);
+        else if (a == "--rcvbuf" && more) opt.rcvbuf = std::atoi(argv[++i]);
+        else if (a == "--prealloc" && more) opt.prealloc = std::atof(argv[++i]);
+        else if (a == "--idle" && more) opt.idle = std::atof(argv[++i]);
+        else if (a == "--split" && more) opt.split = std::atof(argv[++i]);
+        else if (a == "--stats" && more) opt.stats = std::atof(argv[++i]);
+        else if (a == "--cls" && more) opt.cls = argv[++i];
+        else if (a == "--speaker" && more) opt.speaker = argv[++i];
+        else if (a == "--session" && more) opt.session = std::atoi(argv[++i]);
+        else if (a == "--sync" && more) opt.sync = std::atof(argv[++i]);
+        else if (a == "--sync-port" && more) opt.sync_port = std::atoi(argv[++i]);
+        else if (a == "--telemetry" && more) opt.telemetry = argv[++i];
+        else if (a == "--nack" && more) opt.nack = std::atof(argv[++i]);
+        else if (a == "--nack-tries" && more) opt.nack_tries = std::atoi(argv[++i]);
+        else if (a == "--latency") opt.latency = true;
+        else if (a[0] == '-') {
+            usage();
+            return 2;
+        }
+        else opt.dir = a;
+    }
+    if (opt.dir.empty() || opt.batch < 1) {
+        usage();
+        return 2;
+    }
+    mkdir(opt.dir.c_str(), 0755);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    // Bursts from several boards at 16kSPS outrun the default buffer between two batches
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &opt.rcvbuf, sizeof(opt.rcvbuf));
+    // Wake to close idle recordings, notice signals and NACK in time
+    timeval timeout = {0, opt.nack > 0 ? std::clamp<long>(opt.nack * 1000, 1000, 200000) : 200000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(opt.port);
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("bind");
+        return 1;
+    }
+    int rcvbuf = 0;
+    socklen_t optlen = sizeof(rcvbuf);
+    getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen);
+    std::fprintf(stderr, "Listening on UDP port %d, receive buffer %d bytes, writing to %s\n",
+                 opt.port, rcvbuf, opt.dir.c_str());
+    // Clock exchange replies are stamped by the kernel as they arrive
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+    std::unique_ptr<nexus::TelemetryLog> telemetry;
+    try {
+        if (!opt.telemetry.empty()) telemetry = std::make_unique<nexus::TelemetryLog>(opt.telemetry);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    // One slot per datagram of a batch, allocated once
+    const size_t control_size = CMSG_SPACE(sizeof(timespec));
+    std::vector<uint8_t> slab((size_t)opt.batch * SLOT_SIZE), control((size_t)opt.batch * control_size);
+    std::vector<iovec> iov(opt.batch);
+    std::vector<sockaddr_in> from(opt.batch);
+    std::vector<mmsghdr> msgs(opt.batch);
+    for (int i = 0; i < opt.batch; i++) {
+        iov[i] = {slab.data() + (size_t)i * SLOT_SIZE, SLOT_SIZE};
+        msgs[i].msg_hdr = {};
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &from[i];
+    }
+
+    std::unordered_map<uint32_t, Device> devices;
+    std::vector<int32_t> scratch;
+    uint64_t datagrams = 0, calls = 0, truncated = 0;
+    auto last_stats = clock_type::now();
+
+    while (!stop) {
+        for (int i = 0; i < opt.batch; i++) {
+            // recvmmsg writes the sizes back
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_control = control.data() + (size_t)i * control_size;
+            msgs[i].msg_hdr.msg_controllen = control_size;
+        }
+        int n = recvmmsg(sock, msgs.data(), opt.batch, MSG_WAITFORONE, nullptr);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            std::perror("recvmmsg");
+            break;
+        }
+        auto now = clock_type::now();
+        if (n > 0) {
+            calls++;
+            datagrams += n;
+        }
+        for (int i = 0; i < n; i++) {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                truncated++;
+                continue;
+            }
+            const uint8_t* buf = (const uint8_t*)iov[i].iov_base;
+            size_t len = msgs[i].msg_len;
+            int64_t rx_us = 0;
+            for (cmsghdr* c = CMSG_FIRSTHDR(&msgs[i].msg_hdr); c; c = CMSG_NXTHDR(&msgs[i].msg_hdr, c))
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+                    timespec ts;
+                    std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                    rx_us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+                }
+            if (!rx_us) rx_us = unix_us();
+            if (len >= 4 && buf[3] == PROTO_TYPE_SYNC_REPLY) {
+                handle_sync(devices, buf, len, rx_us);
+                continue;
+            }
+            handle_datagram(devices, buf, len, from[i], opt, scratch, telemetry.get(), now, rx_us);
+        }
+
+        if (opt.nack > 0)
+            for (auto& [id, d] : devices)
+                if (!d.pending.empty()) send_nacks(sock, d, opt, now);
+
+        if (opt.sync > 0)
+            for (auto& [id, d] : devices)
+                if (std::chrono::duration<double>(now - d.last_sync).count() >= opt.sync &&
+                    std::chrono::duration<double>(now - d.last_rx).count() <= opt.idle) {
+                    send_sync(sock, d, opt);
+                    d.last_sync = now;
+                }
+
+        for (auto& [id, d] : devices)
+            if (d.open && std::chrono::duration<double>(now - d.last_rx).count() > opt.idle)
+                end_recording(d, opt);
+
+        double since = std::chrono::duration<double>(now - last_stats).count();
+        if (opt.stats > 0 && since >= opt.stats) {
+            print_stats(devices, since, datagrams, calls, truncated);
+            last_stats = now;
+        }
+    }
+
+    for (auto& [id, d] : devices)
+        end_recording(d, opt);
+    if (opt.stats > 0)
+        print_stats(devices, std::chrono::duration<double>(clock_type::now() - last_stats).count(), datagrams, calls,
+                    truncated);
+    close(sock);
+    return 0;
+}
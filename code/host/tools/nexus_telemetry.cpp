@@ -0,0 +1,87 @@
+// Listens for the board's telemetry frames and prints each one: ring occupancy, RSSI,
+// the rates of the counters since the last frame, and per timer the durations of the
+// interval (mean, median and 99th percentile from the histogram) with the longest
+// ever. --log appends every frame to a CSV. Other frames are only counted; while
+// nexus-ingest has the port, use its --telemetry instead.
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "telemetry_log.hpp"
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-telemetry [options]\n"
+        "  --port N          UDP port (8080)\n"
+        "  --log FILE        CSV to append every frame to\n"
+        "  --quiet           only log, print nothing\n");
+}
+
+int main(int argc, char** argv)
+{
+    int port = 8080;
+    std::string log_path;
+    bool quiet = false;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--port" && more) port = std::atoi(argv[++i]);
+        else if (a == "--log" && more) log_path = argv[++i];
+        else if (a == "--quiet") quiet = true;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("bind");
+        return 1;
+    }
+
+    try {
+        nexus::TelemetryLog log(log_path);
+        std::fprintf(stderr, "Listening on UDP port %d\n", port);
+        std::vector<uint8_t> buf(65536);
+        uint64_t others = 0;
+        while (true) {
+            ssize_t len = recv(sock, buf.data(), buf.size(), 0);
+            if (len < 0) {
+                if (errno == EINTR) continue;
+                std::perror("recv");
+                return 1;
+            }
+            proto_header_t h;
+            proto_telemetry_t t;
+            if (proto_decode_header(buf.data(), len, &h) != PROTO_OK || h.type != PROTO_TYPE_TELEMETRY ||
+                proto_decode_telemetry(buf.data(), len, &h, &t) != PROTO_OK) {
+                // A streaming board sends thousands of these between telemetry frames
+                if (++others % 100000 == 0)
+                    std::fprintf(stderr, "%llu other datagrams\n", (unsigned long long)others);
+                continue;
+            }
+            log.add(h, t, quiet ? nullptr : stdout);
+            std::fflush(stdout);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,268 @@
+// Trains the word classifier of hmm.ipynb from nexus-features output and writes the
+// model blob clf_init() loads, in place of the notebook's get_model() and
+// export_classifier.py. An LDA is fitted on every training window, then one
+// left-to-right Gaussian HMM per class, keeping the best of several restarts like
+// get_model(). Classes and restarts all run in parallel on a WorkPool, and each
+// restart seeds its own generator, so the result does not depend on the thread count.
+// hmm.ipynb filters with sosfiltfilt, so its features come from nexus-features
+// --zero-phase.
+//
+//   nexus-features --features F2 --zero-phase --dataset electrode-brace/50x3 --out f2.npy ../../datasets
+//   nexus-train --out classifier.bin f2.npy
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hmm_train.hpp"
+#include "npy.hpp"
+#include "work_pool.hpp"
+
+struct TrialRow {
+    std::string line;     // As read from the labels CSV
+    std::string cls;
+    size_t first, windows;
+    bool test = false;
+};
+
+struct Restart {
+    int cls, index;
+    nexus::GaussianHmm init = {};
+    nexus::HmmFit fit = {};
+    bool ok = false;
+    double seconds = 0;
+};
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "usage: nexus-train [options] <features.npy>   (labels from features.csv beside it)\n"
+        "  --out MODEL.bin       classifier model (classifier.bin)\n"
+        "  --header MODEL.h      also write the model as a C header for the firmware\n"
+        "  --states N            HMM states per class (3)\n"
+        "  --restarts N          random restarts per class, the best is kept (5)\n"
+        "  --iter N              EM iterations at most (100)\n"
+        "  --tol X               stop when an iteration gains less log-likelihood (0.01)\n"
+        "  --components N        LDA output size (2)\n"
+        "  --test F              share of each class held out to test, 0 for none (0.2)\n"
+        "  --seed N              split and restart seed (1)\n"
+        "  --threads N           worker threads, 0 for one per core (0)\n"
+        "  --report R.csv        initial means, iterations and log-likelihood of every restart\n"
+        "  --observations Z.npy  LDA output of every window, with Z.csv of the trials and split;\n"
+        "                        python ../ml/hmm_train_reference.py Z.npy R.csv reruns the restarts in hmmlearn\n");
+}
+
+static std::string base_of(const std::string& path)
+{
+    return path.size() > 4 && path.substr(path.size() - 4) == ".npy" ? path.substr(0, path.size() - 4) : path;
+}
+
+static std::vector<std::string> split(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    for (std::string f; std::getline(ss, f, ',');) fields.push_back(f);
+    return fields;
+}
+
+int main(int argc, char** argv)
+{
+    std::string out = "classifier.bin", header, report, observations, input;
+    nexus::HmmConfig config;
+    int restarts = 5, components = 2;
+    double test_share = 0.2;
+    unsigned seed = 1, threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--out" && more) out = argv[++i];
+        else if (a == "--header" && more) header = argv[++i];
+        else if (a == "--states" && more) config.n_states = std::atoi(argv[++i]);
+        else if (a == "--restarts" && more) restarts = std::atoi(argv[++i]);
+        else if (a == "--iter" && more) config.n_iter = std::atoi(argv[++i]);
+        else if (a == "--tol" && more) config.tol = std::atof(argv[++i]);
+        else if (a == "--components" && more) components = std::atoi(argv[++i]);
+        else if (a == "--test" && more) test_share = std::atof(argv[++i]);
+        else if (a == "--seed" && more) seed = std::atoi(argv[++i]);
+        else if (a == "--threads" && more) threads = std::atoi(argv[++i]);
+        else if (a == "--report" && more) report = argv[++i];
+        else if (a == "--observations" && more) observations = argv[++i];
+        else if (a[0] != '-' && input.empty()) input = a;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (input.empty() || config.n_states < 1 || restarts < 1 || components < 1 || test_share < 0 || test_share >= 1) {
+        usage();
+        return 2;
+    }
+
+    try {
+        npy::Array x = npy::load(input);
+        std::ifstream f(base_of(input) + ".csv");
+        std::string csv_header, line;
+        if (!std::getline(f, csv_header)) throw std::runtime_error("cannot read " + base_of(input) + ".csv");
+        std::vector<std::string> columns = split(csv_header);
+        auto column = [&](const char* name) {
+            for (size_t i = 0; i < columns.size(); i++) if (columns[i] == name) return i;
+            throw std::runtime_error(std::string("labels have no ") + name + " column");
+        };
+        size_t c_cls = column("cls"), c_first = column("first"), c_windows = column("windows");
+
+        // Classes sorted as LabelEncoder sorts them, model i is class i
+        std::vector<TrialRow> trials;
+        std::map<std::string, int> class_index;
+        while (std::getline(f, line)) {
+            std::vector<std::string> fields = split(line);
+            if (fields.size() < columns.size()) continue;
+            TrialRow t = {line, fields[c_cls], std::stoul(fields[c_first]), std::stoul(fields[c_windows])};
+            if (t.first + t.windows > x.rows) throw std::runtime_error("labels point past the features");
+            if (t.windows) trials.push_back(t), class_index[t.cls] = 0;
+        }
+        std::vector<std::string> names;
+        for (auto& kv : class_index) {
+            kv.second = names.size();
+            names.push_back(kv.first);
+        }
+        const int n_classes = names.size();
+
+        // Stratified hold out
+        std::mt19937_64 rng(seed);
+        for (int c = 0; c < n_classes; c++) {
+            std::vector<size_t> members;
+            for (size_t i = 0; i < trials.size(); i++) if (class_index[trials[i].cls] == c) members.push_back(i);
+            std::shuffle(members.begin(), members.end(), rng);
+            size_t n_test = (size_t)(test_share * members.size() + 0.5);
+            for (size_t k = 0; k < n_test; k++) trials[members[k]].test = true;
+        }
+
+        // LDA over every training window, labelled with its trial's class
+        std::vector<double> lda_x;
+        std::vector<int> lda_y;
+        for (const TrialRow& t : trials) {
+            if (t.test) continue;
+            lda_x.insert(lda_x.end(), x.row(t.first), x.row(t.first + t.windows));
+            lda_y.insert(lda_y.end(), t.windows, class_index[t.cls]);
+        }
+        auto start = std::chrono::steady_clock::now();
+        nexus::Lda lda = nexus::fit_lda(lda_x.data(), lda_y.size(), x.cols, lda_y, n_classes, components);
+        double lda_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        npy::Array z;
+        z.rows = x.rows;
+        z.cols = components;
+        z.data.resize(z.rows * z.cols);
+        for (size_t r = 0; r < x.rows; r++) lda.transform(x.row(r), z.row(r));
+
+        std::vector<std::vector<nexus::Sequence>> sequences(n_classes);
+        for (const TrialRow& t : trials)
+            if (!t.test) sequences[class_index[t.cls]].push_back({z.row(t.first), t.windows});
+
+        // Every restart of every class is a task
+        std::vector<Restart> runs;
+        for (int c = 0; c < n_classes; c++)
+            for (int r = 0; r < restarts; r++) runs.push_back({c, r});
+        nexus::WorkPool pool(threads);
+        for (Restart& run : runs) {
+            pool.push([&, p = &run](unsigned) {
+                auto t0 = std::chrono::steady_clock::now();
+                std::seed_seq seq{seed, (unsigned)p->cls, (unsigned)p->index};
+                std::mt19937_64 gen(seq);
+                try {
+                    p->init = nexus::init_ltr_hmm(sequences[p->cls], components, config, gen);
+                    p->fit = nexus::fit_hmm(p->init, sequences[p->cls], config);
+                    p->ok = std::isfinite(p->fit.log_likelihood);
+                } catch (const std::runtime_error&) {
+                    p->ok = false;  // Skipped like get_model() skips a failed fit
+                }
+                p->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            });
+        }
+        start = std::chrono::steady_clock::now();
+        pool.run();
+        double hmm_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<nexus::GaussianHmm> models(n_classes);
+        std::vector<const Restart*> best(n_classes, nullptr);
+        double cpu_seconds = 0;
+        for (const Restart& run : runs) {
+            cpu_seconds += run.seconds;
+            if (run.ok && (!best[run.cls] || run.fit.log_likelihood > best[run.cls]->fit.log_likelihood))
+                best[run.cls] = &run;
+        }
+        for (int c = 0; c < n_classes; c++) {
+            if (!best[c]) throw std::runtime_error("every restart of " + names[c] + " failed");
+            models[c] = best[c]->fit.model;
+            std::printf("%-12s %3zu trials  log-likelihood %10.2f  %d iterations%s\n", names[c].c_str(),
+                        sequences[c].size(), best[c]->fit.log_likelihood, best[c]->fit.iterations,
+                        best[c]->fit.converged ? "" : " (not converged)");
+        }
+        std::printf("LDA %zu -> %d in %.3f s, %zu HMM fits in %.3f s on %u threads (%.3f s of fitting)\n",
+                    x.cols, components, lda_seconds, runs.size(), hmm_seconds, pool.size(), cpu_seconds);
+
+        // Held out trials, scored as hmm.ipynb scores them
+        size_t n_test = 0, correct = 0;
+        for (const TrialRow& t : trials) {
+            if (!t.test) continue;
+            int best_class = 0;
+            double best_ll = -INFINITY;
+            for (int c = 0; c < n_classes; c++) {
+                double ll = nexus::score_hmm(models[c], {z.row(t.first), t.windows});
+                if (ll > best_ll) best_ll = ll, best_class = c;
+            }
+            n_test++;
+            correct += best_class == class_index[t.cls];
+        }
+        if (n_test) std::printf("held out accuracy %zu/%zu = %.3f\n", correct, n_test, (double)correct / n_test);
+
+        std::vector<uint8_t> blob = nexus::classifier_model(lda, names, models);
+        std::ofstream mf(out, std::ios::binary);
+        mf.write((const char*)blob.data(), blob.size());
+        if (!mf.flush()) throw std::runtime_error("cannot write " + out);
+        std::printf("%s: %d classes, %d states, LDA %zu -> %d, %zu bytes\n", out.c_str(), n_classes,
+                    config.n_states, x.cols, components, blob.size());
+
+        if (!header.empty()) {
+            std::ofstream hf(header);
+            hf << "// Generated by code/host nexus-train, do not edit\n#pragma once\n#include <stdint.h>\n\n"
+               << "static const uint8_t classifier_model[" << blob.size() << "] = {\n";
+            char byte[8];
+            for (size_t i = 0; i < blob.size(); i++) {
+                std::snprintf(byte, sizeof(byte), "0x%02x", blob[i]);
+                hf << (i % 16 ? ", " : "    ") << byte << (i % 16 == 15 || i + 1 == blob.size() ? ",\n" : "");
+            }
+            hf << "};\n";
+            if (!hf.flush()) throw std::runtime_error("cannot write " + header);
+        }
+
+        if (!observations.empty()) {
+            npy::save(observations, z);
+            std::ofstream of(base_of(observations) + ".csv");
+            of << csv_header << ",split\n";
+            for (const TrialRow& t : trials) of << t.line << ',' << (t.test ? "test" : "train") << '\n';
+        }
+        if (!report.empty()) {
+            std::ofstream rf(report);
+            rf << "cls,restart,states,n_iter,tol,iterations,converged,log_likelihood,seconds,init_means\n";
+            rf.precision(17);
+            for (const Restart& run : runs) {
+                rf << names[run.cls] << ',' << run.index << ',' << config.n_states << ',' << config.n_iter << ','
+                   << config.tol << ',' << run.fit.iterations << ',' << run.fit.converged << ','
+                   << (run.ok ? run.fit.log_likelihood : NAN) << ',' << run.seconds << ',';
+                for (size_t i = 0; i < run.init.means.size(); i++) rf << (i ? " " : "") << run.init.means[i];
+                rf << '\n';
+            }
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
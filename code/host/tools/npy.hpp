@@ -0,0 +1,135 @@
+// Minimal reader/writer for the 2-D .npy arrays in datasets/, (samples, channels)
+// float64 in C order. float32 and int32 arrays are read and widened to double.
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace npy {
+
+struct Array {
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<double> data;   // Row major, rows * cols
+
+    double* row(size_t r) { return data.data() + r * cols; }
+    const double* row(size_t r) const { return data.data() + r * cols; }
+};
+
+inline std::string header_field(const std::string& header, const std::string& key)
+{
+    size_t pos = header.find("'" + key + "'");
+    if (pos == std::string::npos) throw std::runtime_error("npy: header has no " + key);
+    pos = header.find(':', pos);
+    size_t start = header.find_first_not_of(" ", pos + 1);
+    size_t end = (header[start] == '(') ? header.find(')', start) + 1 : header.find_first_of(",}", start);
+    return header.substr(start, end - start);
+}
+
+inline Array load(const std::string& path)
+{
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) throw std::runtime_error("npy: cannot open " + path);
+
+    uint8_t preamble[10];
+    if (std::fread(preamble, 1, 10, f) != 10 || std::memcmp(preamble, "\x93NUMPY", 6) != 0) {
+        std::fclose(f);
+        throw std::runtime_error("npy: not a numpy file: " + path);
+    }
+
+    // Version 1 has a 2 byte header length, 2 and 3 a 4 byte one
+    size_t header_len = preamble[8] | (preamble[9] << 8);
+    if (preamble[6] >= 2) {
+        uint8_t ext[2];
+        if (std::fread(ext, 1, 2, f) != 2) {
+            std::fclose(f);
+            throw std::runtime_error("npy: truncated header: " + path);
+        }
+        header_len |= (size_t)ext[0] << 16 | (size_t)ext[1] << 24;
+    }
+    std::string header(header_len, '\0');
+    if (std::fread(&header[0], 1, header_len, f) != header_len) {
+        std::fclose(f);
+        throw std::runtime_error("npy: truncated header: " + path);
+    }
+
+    std::string descr = header_field(header, "descr");
+    std::string order = header_field(header, "fortran_order");
+    std::string shape = header_field(header, "shape");
+    if (order != "False") {
+        std::fclose(f);
+        throw std::runtime_error("npy: fortran order is not supported: " + path);
+    }
+
+    Array a;
+    size_t dims[2] = {0, 1};
+    int n_dims = std::sscanf(shape.c_str(), "(%zu, %zu", &dims[0], &dims[1]);
+    if (n_dims < 1) {
+        std::fclose(f);
+        throw std::runtime_error("npy: bad shape " + shape);
+    }
+    a.rows = dims[0];
+    a.cols = dims[1];
+    a.data.resize(a.rows * a.cols);
+
+    size_t n = a.data.size();
+    size_t got = 0;
+    if (descr == "'<f8'") {
+        got = std::fread(a.data.data(), sizeof(double), n, f);
+    } else if (descr == "'<f4'" || descr == "'<i4'") {
+        std::vector<uint32_t> raw(n);
+        got = std::fread(raw.data(), 4, n, f);
+        for (size_t i = 0; i < got; i++) {
+            if (descr == "'<f4'") {
+                float v;
+                std::memcpy(&v, &raw[i], 4);
+                a.data[i] = v;
+            } else {
+                a.data[i] = (int32_t)raw[i];
+            }
+        }
+    } else {
+        std::fclose(f);
+        throw std::runtime_error("npy: unsupported dtype " + descr);
+    }
+    std::fclose(f);
+    if (got != n) throw std::runtime_error("npy: truncated data: " + path);
+    return a;
+}
+
+// Preamble and header of a (rows, cols) float64 array, padded so the data starts on a 64 byte
+// boundary and at least min_size bytes in. A fixed min_size lets the shape be rewritten in place.
+inline std::string header(size_t rows, size_t cols, size_t min_size = 0)
+{
+    char dict[128];
+    std::snprintf(dict, sizeof(dict), "{'descr': '<f8', 'fortran_order': False, 'shape': (%zu, %zu), }",
+                  rows, cols);
+
+    // Header ends with a newline
+    std::string header(dict);
+    size_t total = 10 + header.size() + 1;
+    size_t size = std::max(total + (64 - total % 64) % 64, min_size);
+    header.append(size - total, ' ');
+    header.push_back('\n');
+
+    size_t len = header.size();
+    const char preamble[10] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, (char)(len & 0xFF), (char)(len >> 8)};
+    return std::string(preamble, 10) + header;
+}
+
+inline void save(const std::string& path, const Array& a)
+{
+    std::string head = header(a.rows, a.cols);
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("npy: cannot create " + path);
+    bool ok = std::fwrite(head.data(), 1, head.size(), f) == head.size() &&
+              std::fwrite(a.data.data(), sizeof(double), a.data.size(), f) == a.data.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) throw std::runtime_error("npy: write failed: " + path);
+}
+
+} // namespace npy
@@ -0,0 +1,118 @@
+#include "telemetry_log.hpp"
+
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace nexus {
+
+const char* const TLM_TIMER_NAMES[PROTO_TLM_TIMERS] = {"read", "callback", "process", "encode", "send", "dsp", "latency"};
+
+double tlm_bin_end_us(int bin, double cpu_mhz)
+{
+    if (bin >= PROTO_TLM_HIST_BINS - 1) return std::numeric_limits<double>::infinity();
+    return std::ldexp(1.0, PROTO_TLM_HIST_SHIFT + bin) / cpu_mhz;
+}
+
+double tlm_quantile_us(const proto_tlm_stats_t& s, double q, double cpu_mhz)
+{
+    double max_us = (double)s.max_cycles / cpu_mhz;
+    uint64_t seen = 0, total = 0;
+    for (uint32_t n : s.hist) total += n;
+    if (!total) return 0;
+    for (int b = 0; b < PROTO_TLM_HIST_BINS; b++) {
+        seen += s.hist[b];
+        if (seen >= q * total) return std::fmin(tlm_bin_end_us(b, cpu_mhz), max_us);
+    }
+    return max_us;
+}
+
+// Durations recorded between two frames, the cumulative ones of b less those of a
+static proto_tlm_stats_t since(const proto_tlm_stats_t& a, const proto_tlm_stats_t& b)
+{
+    proto_tlm_stats_t d = b;
+    d.count = b.count - a.count;
+    d.total_cycles = b.total_cycles - a.total_cycles;
+    for (int i = 0; i < PROTO_TLM_HIST_BINS; i++) d.hist[i] = b.hist[i] - a.hist[i];
+    return d;
+}
+
+TelemetryLog::TelemetryLog(const std::string& csv_path)
+{
+    if (csv_path.empty()) return;
+    struct stat st;
+    bool fresh = stat(csv_path.c_str(), &st) != 0 || st.st_size == 0;
+    csv_ = std::fopen(csv_path.c_str(), "a");
+    if (!csv_) throw std::runtime_error("Cannot open " + csv_path);
+    if (!fresh) return;
+    std::fprintf(csv_, "unix_time,device,seq,board_time,sample_counter,drdy,read,missed_drdy,ring_overflows,"
+                 "ring_count,ring_high_water,ring_capacity,rssi,cpu_mhz,frames_sent,samples_sent,send_retries,"
+                 "send_errors,samples_dropped,sent_bytes,latency_max_us,heap_min_free,retransmits,replay_misses");
+    for (const char* name : TLM_TIMER_NAMES)
+        std::fprintf(csv_, ",%s_count,%s_min_us,%s_mean_us,%s_p50_us,%s_p99_us,%s_max_us", name, name, name, name,
+                     name, name);
+    std::fprintf(csv_, "\n");
+    std::fflush(csv_);
+}
+
+TelemetryLog::~TelemetryLog()
+{
+    if (csv_) std::fclose(csv_);
+}
+
+void TelemetryLog::add(const proto_header_t& h, const proto_telemetry_t& t, std::FILE* out)
+{
+    const double mhz = t.cpu_mhz ? t.cpu_mhz : 1;
+    auto found = last_.find(h.device_id);
+    const Last* last = found != last_.end() && found->second.telemetry.drdy_count <= t.drdy_count &&
+                       found->second.header.timestamp_us < h.timestamp_us ? &found->second : nullptr;
+
+    if (out) {
+        std::fprintf(out, "%08x at %.3f s: ring %u/%u (most %u), RSSI %d dBm, heap at least %u bytes, "
+                     "DRDY to read at most %u us\n", h.device_id, h.timestamp_us * 1e-6, t.ring_count,
+                     t.ring_capacity, t.ring_high_water, t.rssi, t.heap_min_free, t.latency_max_us);
+        if (last) {
+            const proto_telemetry_t& p = last->telemetry;
+            double s = (h.timestamp_us - last->header.timestamp_us) * 1e-6;
+            std::fprintf(out, "%08x over %.1f s: %.1f DRDY/s, %u missed, %u lost in the ring, %.1f frames/s, "
+                         "%.1f kB/s, %u send retries, %u errors, %u samples dropped, %u frames resent, "
+                         "%u NACKed too late\n", h.device_id, s,
+                         (t.drdy_count - p.drdy_count) / s, t.missed_drdy - p.missed_drdy,
+                         t.ring_overflows - p.ring_overflows, (t.frames_sent - p.frames_sent) / s,
+                         (uint32_t)(t.sent_bytes - p.sent_bytes) / s / 1e3, t.send_retries - p.send_retries,
+                         t.send_errors - p.send_errors, t.samples_dropped - p.samples_dropped,
+                         t.retransmits - p.retransmits, t.replay_misses - p.replay_misses);
+        }
+        for (int i = 0; i < PROTO_TLM_TIMERS; i++) {
+            // The interval's durations when there is a previous frame, all of them otherwise
+            proto_tlm_stats_t s = last ? since(last->telemetry.timers[i], t.timers[i]) : t.timers[i];
+            if (!s.count) continue;
+            std::fprintf(out, "%08x   %-8s %8u x, mean %7.1f us, median under %7.1f us, 99%% under %7.1f us, "
+                         "longest ever %7.1f us\n", h.device_id, TLM_TIMER_NAMES[i], s.count,
+                         s.total_cycles / mhz / s.count, tlm_quantile_us(s, 0.5, mhz),
+                         tlm_quantile_us(s, 0.99, mhz), s.max_cycles / mhz);
+        }
+    }
+
+    if (csv_) {
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        std::fprintf(csv_, "%.6f,%08x,%u,%.6f,%u,%u,%u,%u,%u,%u,%u,%u,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
+                     now.tv_sec + now.tv_nsec * 1e-9, h.device_id, h.seq, h.timestamp_us * 1e-6, h.sample_counter,
+                     t.drdy_count, t.sample_count, t.missed_drdy, t.ring_overflows, t.ring_count, t.ring_high_water,
+                     t.ring_capacity, t.rssi, t.cpu_mhz, t.frames_sent, t.samples_sent, t.send_retries,
+                     t.send_errors, t.samples_dropped, t.sent_bytes, t.latency_max_us, t.heap_min_free, t.retransmits,
+                     t.replay_misses);
+        for (const proto_tlm_stats_t& s : t.timers)
+            std::fprintf(csv_, ",%u,%.3f,%.3f,%.3f,%.3f,%.3f", s.count, s.count ? s.min_cycles / mhz : 0.0,
+                         s.count ? s.total_cycles / mhz / s.count : 0.0, tlm_quantile_us(s, 0.5, mhz),
+                         tlm_quantile_us(s, 0.99, mhz), s.max_cycles / mhz);
+        std::fprintf(csv_, "\n");
+        std::fflush(csv_);
+    }
+    last_[h.device_id] = {h, t};
+}
+
+} // namespace nexus
@@ -0,0 +1,45 @@
+// Telemetry frames of the board (protocol_interface.h) as text: a summary per frame
+// with the rates since the device's previous one, and optionally a CSV row of every
+// counter and timer. Counters are cumulative since the board started streaming, so
+// the rates skip a frame whose counters went backwards, a restart.
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+extern "C" {
+#include "protocol_interface.h"
+}
+
+namespace nexus {
+
+// Microseconds a timer bin ends at, infinity for the last
+double tlm_bin_end_us(int bin, double cpu_mhz);
+// Bound a share q of the durations stayed under, the end of the bin it is reached in
+// and never beyond the longest
+double tlm_quantile_us(const proto_tlm_stats_t& s, double q, double cpu_mhz);
+
+extern const char* const TLM_TIMER_NAMES[PROTO_TLM_TIMERS];
+
+class TelemetryLog {
+public:
+    // Appends CSV rows to csv_path when given, with a header line if the file is new
+    explicit TelemetryLog(const std::string& csv_path = "");
+    ~TelemetryLog();
+    TelemetryLog(const TelemetryLog&) = delete;
+    TelemetryLog& operator=(const TelemetryLog&) = delete;
+
+    // Prints the frame's summary to out, nullptr for none, and logs it
+    void add(const proto_header_t& h, const proto_telemetry_t& t, std::FILE* out);
+
+private:
+    struct Last {
+        proto_header_t header;
+        proto_telemetry_t telemetry;
+    };
+    std::FILE* csv_ = nullptr;
+    std::unordered_map<uint32_t, Last> last_;
+};
+
+} // namespace nexus
@@ -0,0 +1,125 @@
+// Work stealing thread pool for batch jobs over the datasets. Every worker owns a
+// deque: it pushes and pops its own tasks at the back, newest first so a task it
+// just spawned runs while its inputs are still in cache, and idle workers steal the
+// oldest task from the front of someone else's deque. Tasks may spawn more tasks;
+// run() returns once every task, spawned ones included, has finished.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nexus {
+
+class WorkPool {
+public:
+    // Runs on the worker with the given index, which can hold per worker scratch
+    using Task = std::function<void(unsigned worker)>;
+
+    struct Stats {
+        uint64_t tasks = 0;    // Run by the worker
+        uint64_t steals = 0;   // Of those, taken from another worker's deque
+    };
+
+    // 0 threads for one per core
+    explicit WorkPool(unsigned n_threads = 0)
+    {
+        if (n_threads == 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < n_threads; i++) workers_.push_back(std::make_unique<Worker>());
+    }
+
+    unsigned size() const { return workers_.size(); }
+
+    // From a task: onto the running worker's deque. From outside run(): dealt round robin.
+    void push(Task task)
+    {
+        unsigned w = current_ != nullptr && current_->pool == this ? current_->index : next_++ % size();
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(workers_[w]->mutex);
+        workers_[w]->tasks.push_back(std::move(task));
+    }
+
+    // Runs every queued task on the calling thread and size() - 1 others
+    void run()
+    {
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < size(); i++) threads.emplace_back([this, i] { work(i); });
+        work(0);
+        for (auto& t : threads) t.join();
+    }
+
+    Stats stats(unsigned worker) const { return workers_[worker]->stats; }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        Stats stats;
+    };
+
+    struct Current {
+        WorkPool* pool;
+        unsigned index;
+    };
+
+    bool pop(unsigned w, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(workers_[w]->mutex);
+        if (workers_[w]->tasks.empty()) return false;
+        task = std::move(workers_[w]->tasks.back());
+        workers_[w]->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned w, Task& task)
+    {
+        // Victims in turn from the next worker on, so thieves spread out
+        for (unsigned k = 1; k < size(); k++) {
+            Worker& victim = *workers_[(w + k) % size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void work(unsigned w)
+    {
+        Current self = {this, w};
+        Current* outer = current_;
+        current_ = &self;
+        Task task;
+        while (pending_.load(std::memory_order_acquire) > 0) {
+            bool stolen = false;
+            if (!pop(w, task)) {
+                if (!steal(w, task)) {
+                    // Everything left is running elsewhere and may still spawn
+                    std::this_thread::yield();
+                    continue;
+                }
+                stolen = true;
+            }
+            task(w);
+            task = nullptr;
+            workers_[w]->stats.tasks++;
+            workers_[w]->stats.steals += stolen;
+            pending_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        current_ = outer;
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> pending_{0};
+    unsigned next_ = 0;
+    static thread_local Current* current_;
+};
+
+inline thread_local WorkPool::Current* WorkPool::current_ = nullptr;
+
+} // namespace nexus
@@ -0,0 +1,301 @@
+#include "zero_phase.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace nexus {
+
+PadType parse_pad_type(const std::string& name)
+{
+    if (name == "none") return PadType::None;
+    if (name == "constant") return PadType::Constant;
+    if (name == "even") return PadType::Even;
+    if (name == "odd") return PadType::Odd;
+    throw std::runtime_error("unknown padding " + name + ", expected none, constant, even or odd");
+}
+
+size_t default_padlen(const iir_config_t& sos)
+{
+    int zero_b2 = 0, zero_a2 = 0;
+    for (int s = 0; s < sos.n_sections; s++) {
+        zero_b2 += sos.sos[s].b2 == 0;
+        zero_a2 += sos.sos[s].a2 == 0;
+    }
+    return 3 * (2 * sos.n_sections + 1 - std::min(zero_b2, zero_a2));
+}
+
+std::vector<double> sosfilt_zi(const iir_config_t& sos)
+{
+    std::vector<double> zi(2 * sos.n_sections);
+    double scale = 1;
+    for (int s = 0; s < sos.n_sections; s++) {
+        const iir_sos_t& c = sos.sos[s];
+        // lfilter_zi solves (I - companion(a).T) zi = b[1:] - a[1:] b0, here [[1 + a1, -1], [a2, 1]],
+        // by LU with partial pivoting as numpy.linalg.solve does
+        double r0[3] = {1 + c.a1, -1, c.b1 - c.a1 * c.b0};
+        double r1[3] = {c.a2, 1, c.b2 - c.a2 * c.b0};
+        if (std::fabs(r1[0]) > std::fabs(r0[0])) std::swap(r0, r1);
+        double l = r1[0] * (1 / r0[0]);
+        double z1 = (r1[2] - l * r0[2]) / (r1[1] - l * r0[1]);
+        double z0 = (r0[2] - r0[1] * z1) / r0[0];
+        zi[2 * s] = scale * z0;
+        zi[2 * s + 1] = scale * z1;
+        // Gain at DC of this section, the steady state input of the next
+        scale *= (c.b0 + c.b1 + c.b2) / (1 + c.a1 + c.a2);
+    }
+    return zi;
+}
+
+size_t lookahead_for(const iir_config_t& sos, double tol)
+{
+    double r = 0;
+    for (int s = 0; s < sos.n_sections; s++) {
+        const iir_sos_t& c = sos.sos[s];
+        double disc = c.a1 * c.a1 - 4 * c.a2;
+        if (disc < 0) r = std::max(r, std::sqrt(c.a2));
+        else r = std::max(r, std::max(std::fabs(-c.a1 + std::sqrt(disc)), std::fabs(-c.a1 - std::sqrt(disc))) / 2);
+    }
+    if (r >= 1) throw std::runtime_error("filter is not stable");
+    if (r == 0 || tol >= 1) return 0;
+    return (size_t)std::ceil(std::log(tol) / std::log(r));
+}
+
+// edge samples of padding before x, from x's first edge + 1 samples, as scipy's *_ext
+static void pad_front(PadType pad, const double* x, size_t edge, int n_ch, double* ext)
+{
+    for (size_t k = 0; k < edge; k++)
+        for (int ch = 0; ch < n_ch; ch++) {
+            double v = x[(edge - k) * n_ch + ch];
+            ext[k * n_ch + ch] = pad == PadType::Constant ? x[ch] : pad == PadType::Even ? v : 2 * x[ch] - v;
+        }
+}
+
+// edge samples of padding after x, from x's last edge + 1 samples (last points at them)
+static void pad_back(PadType pad, const double* last, size_t edge, int n_ch, double* ext)
+{
+    const double* end = last + edge * n_ch;
+    for (size_t k = 0; k < edge; k++)
+        for (int ch = 0; ch < n_ch; ch++) {
+            double v = end[-(ptrdiff_t)(k + 1) * n_ch + ch];
+            ext[k * n_ch + ch] = pad == PadType::Constant ? end[ch] : pad == PadType::Even ? v : 2 * end[ch] - v;
+        }
+}
+
+// State of a steady input x0 on every channel, sosfilt's zi * x_0
+static void set_state(iir_handle_t* h, const std::vector<double>& zi, const double* x0)
+{
+    const int n_ch = h->config.n_channels;
+    for (int s = 0; s < h->config.n_sections; s++)
+        for (int ch = 0; ch < n_ch; ch++) {
+            h->z[(2 * s) * n_ch + ch] = zi[2 * s] * x0[ch];
+            h->z[(2 * s + 1) * n_ch + ch] = zi[2 * s + 1] * x0[ch];
+        }
+}
+
+static void reverse_samples(double* x, size_t n, int n_ch)
+{
+    for (size_t i = 0, j = n - 1; i < j; i++, j--) std::swap_ranges(x + i * n_ch, x + (i + 1) * n_ch, x + j * n_ch);
+}
+
+// The backward pass over n samples, in place, starting from the steady state of the last one
+static void backward(iir_handle_t* h, const std::vector<double>& zi, double* x, size_t n)
+{
+    const int n_ch = h->config.n_channels;
+    reverse_samples(x, n, n_ch);
+    set_state(h, zi, x);
+    iir_process(h, x, x, n);
+    reverse_samples(x, n, n_ch);
+}
+
+static iir_handle_t* make_handle(const iir_config_t& sos, int n_channels)
+{
+    iir_config_t config = sos;
+    config.n_channels = n_channels;
+    iir_handle_t* h;
+    if (iir_init(&config, &h) != IIR_OK) throw std::runtime_error("cannot filter these channels and sections");
+    return h;
+}
+
+void sosfiltfilt(const iir_config_t& sos, PadType pad, double* x, size_t n, int n_channels)
+{
+    size_t edge = pad == PadType::None ? 0 : default_padlen(sos);
+    if (n <= edge) throw std::runtime_error("recording must be longer than the padding of " + std::to_string(edge));
+
+    std::vector<double> ext((n + 2 * edge) * n_channels);
+    pad_front(pad, x, edge, n_channels, ext.data());
+    std::copy(x, x + n * n_channels, ext.begin() + edge * n_channels);
+    pad_back(pad, x + (n - edge - 1) * n_channels, edge, n_channels, ext.data() + (n + edge) * n_channels);
+
+    std::vector<double> zi = sosfilt_zi(sos);
+    iir_handle_t* h = make_handle(sos, n_channels);
+    set_state(h, zi, ext.data());
+    iir_process(h, ext.data(), ext.data(), n + 2 * edge);
+    backward(h, zi, ext.data(), n + 2 * edge);
+    iir_deinit(h);
+    std::copy(ext.begin() + edge * n_channels, ext.begin() + (n + edge) * n_channels, x);
+}
+
+// One sosfiltfilt call, streamed
+struct ZeroPhaseFilter::Stage {
+    std::vector<double> zi;
+    iir_handle_t* fwd = nullptr;
+    iir_handle_t* bwd = nullptr;
+    PadType pad;
+    int n_ch;
+    size_t padlen, lookahead, block;
+
+    bool started = false;
+    size_t edge = 0;               // Padding in use, padlen unless the recording is shorter
+    size_t received = 0;
+    std::vector<double> head;      // Input until the front padding can be made
+    std::vector<double> tail;      // The last padlen + 1 input samples, for the end padding
+    std::vector<double> y;         // Forward output from sample base on
+    size_t base = 0, emitted = 0;
+    std::vector<double> scratch;
+
+    Stage(const ZeroPhaseStage& config, PadType pad_, int n_channels, size_t block_)
+        : zi(sosfilt_zi(config.sos)), pad(pad_), n_ch(n_channels), block(block_)
+    {
+        padlen = pad == PadType::None ? 0 : default_padlen(config.sos);
+        lookahead = config.lookahead == AUTO_LOOKAHEAD ? lookahead_for(config.sos, DEFAULT_LOOKAHEAD_TOL) : config.lookahead;
+        lookahead = (lookahead + block - 1) / block * block;
+        fwd = make_handle(config.sos, n_ch);
+        try {
+            bwd = make_handle(config.sos, n_ch);
+        } catch (...) {
+            iir_deinit(fwd);
+            throw;
+        }
+    }
+
+    ~Stage()
+    {
+        iir_deinit(fwd);
+        iir_deinit(bwd);
+    }
+
+    void reset()
+    {
+        started = false;
+        edge = received = base = emitted = 0;
+        head.clear();
+        tail.clear();
+        y.clear();
+    }
+
+    void start(size_t edge_)
+    {
+        edge = edge_;
+        scratch.resize(edge * n_ch);
+        pad_front(pad, head.data(), edge, n_ch, scratch.data());
+        set_state(fwd, zi, edge ? scratch.data() : head.data());
+        iir_process(fwd, scratch.data(), scratch.data(), edge);
+        size_t n = head.size() / n_ch;
+        y.resize(n * n_ch);
+        iir_process(fwd, head.data(), y.data(), n);
+        head.clear();
+        started = true;
+    }
+
+    void push(const double* x, size_t n, std::vector<double>& out)
+    {
+        received += n;
+        tail.insert(tail.end(), x, x + n * n_ch);
+        if (tail.size() > 2 * (padlen + 1) * n_ch) tail.erase(tail.begin(), tail.end() - (padlen + 1) * n_ch);
+
+        if (!started) {
+            head.insert(head.end(), x, x + n * n_ch);
+            if (head.size() >= (padlen + 1) * n_ch) start(padlen);
+        } else {
+            size_t at = y.size();
+            y.resize(at + n * n_ch);
+            iir_process(fwd, x, y.data() + at, n);
+        }
+        if (!started) return;
+
+        // Every block whose look-ahead has arrived
+        size_t have = base + y.size() / n_ch;
+        while (emitted + block + lookahead <= have) {
+            const double* from = y.data() + (emitted - base) * n_ch;
+            scratch.assign(from, from + (block + lookahead) * n_ch);
+            backward(bwd, zi, scratch.data(), block + lookahead);
+            out.insert(out.end(), scratch.begin(), scratch.begin() + block * n_ch);
+            emitted += block;
+        }
+        if (emitted - base > std::max<size_t>(4096, block + lookahead)) {
+            y.erase(y.begin(), y.begin() + (emitted - base) * n_ch);
+            base = emitted;
+        }
+    }
+
+    void flush(std::vector<double>& out)
+    {
+        if (received == 0) return;
+        if (!started) start(std::min(padlen, received - 1));
+
+        // Forward through the end padding, then the exact backward pass from its end
+        const double* last = tail.data() + tail.size() - (edge + 1) * n_ch;
+        size_t rest = received - emitted;
+        scratch.resize((rest + edge) * n_ch);
+        std::copy(y.begin() + (emitted - base) * n_ch, y.end(), scratch.begin());
+        double* ext = scratch.data() + rest * n_ch;
+        pad_back(pad, last, edge, n_ch, ext);
+        iir_process(fwd, ext, ext, edge);
+        backward(bwd, zi, scratch.data(), rest + edge);
+        out.insert(out.end(), scratch.begin(), scratch.begin() + rest * n_ch);
+        reset();
+    }
+};
+
+ZeroPhaseFilter::ZeroPhaseFilter(const ZeroPhaseConfig& config, int n_channels)
+    : n_ch_(n_channels), block_(config.block)
+{
+    if (config.stages.empty() || config.block == 0 || n_channels < 1 || n_channels > IIR_MAX_CHANNELS)
+        throw std::runtime_error("zero phase filter needs stages, a block size and 1 to " +
+                                 std::to_string(IIR_MAX_CHANNELS) + " channels");
+    for (const ZeroPhaseStage& s : config.stages)
+        stages_.emplace_back(new Stage(s, config.pad, n_channels, config.block));
+}
+
+ZeroPhaseFilter::~ZeroPhaseFilter() = default;
+
+size_t ZeroPhaseFilter::push(const double* x, size_t n, std::vector<double>& out)
+{
+    a_.assign(x, x + n * n_ch_);
+    for (auto& s : stages_) {
+        b_.clear();
+        if (!a_.empty()) s->push(a_.data(), a_.size() / n_ch_, b_);
+        std::swap(a_, b_);
+    }
+    out.insert(out.end(), a_.begin(), a_.end());
+    return a_.size() / n_ch_;
+}
+
+size_t ZeroPhaseFilter::flush(std::vector<double>& out)
+{
+    a_.clear();
+    for (auto& s : stages_) {
+        b_.clear();
+        if (!a_.empty()) s->push(a_.data(), a_.size() / n_ch_, b_);
+        s->flush(b_);
+        std::swap(a_, b_);
+    }
+    out.insert(out.end(), a_.begin(), a_.end());
+    return a_.size() / n_ch_;
+}
+
+void ZeroPhaseFilter::reset()
+{
+    for (auto& s : stages_) s->reset();
+}
+
+size_t ZeroPhaseFilter::latency() const
+{
+    // Stages see whole blocks from the one before, so their look-aheads add up
+    size_t n = block_ - 1;
+    for (const auto& s : stages_) n += s->lookahead;
+    return n;
+}
+
+} // namespace nexus
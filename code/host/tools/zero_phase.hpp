@@ -0,0 +1,99 @@
+// Zero phase (forward-backward) filtering with the firmware IIR sections, offline
+// as scipy.signal.sosfiltfilt does it and streamed in blocks for the live system.
+//
+// sosfiltfilt() follows scipy step for step: the recording is extended by padlen
+// samples at each end, filtered forward from sosfilt_zi scaled by the first sample,
+// then backward from sosfilt_zi scaled by the last forward output, and the padding
+// is cut off again.
+//
+// ZeroPhaseFilter gets the same result without the whole recording. The forward pass
+// is causal and exact. The backward pass of each output block starts `lookahead`
+// samples past the block's end, from the steady state sosfiltfilt itself assumes at
+// its starting point, and the start up error has decayed through those samples by
+// the time the block is reached. More look-ahead costs latency and buys accuracy;
+// lookahead_for() gives the look-ahead that bounds the start up error, and stages use
+// it at DEFAULT_LOOKAHEAD_TOL unless they set their own. flush() ends
+// the recording with sosfiltfilt's own end padding, so the tail is exact.
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "iir_interface.h"
+}
+
+namespace nexus {
+
+// scipy's padtype, None is padtype=None
+enum class PadType { None, Constant, Even, Odd };
+
+// "none", "constant", "even" or "odd". Throws std::runtime_error.
+PadType parse_pad_type(const std::string& name);
+
+// scipy's default padlen for the cascade, 3 * (2 * sections + 1) less trailing zero coefficients
+size_t default_padlen(const iir_config_t& sos);
+
+// scipy.signal.sosfilt_zi, [section][2]: the state of a unit step's steady state
+std::vector<double> sosfilt_zi(const iir_config_t& sos);
+
+// scipy.signal.sosfiltfilt(sos, x, axis=0, padtype=pad) in place, x is [n][n_channels].
+// Throws std::runtime_error when x is not longer than the padding, as scipy raises.
+void sosfiltfilt(const iir_config_t& sos, PadType pad, double* x, size_t n, int n_channels);
+
+// Look-ahead after which an error in the backward pass's initial state has decayed
+// below tol (relative), from the slowest pole of the cascade
+size_t lookahead_for(const iir_config_t& sos, double tol);
+
+// Start up error a stage's look-ahead is sized for unless it sets its own. Over the
+// datasets' 0.5 Hz high-pass and 48-52 Hz band-stop this leaves about 1.1% worst case
+// and 0.5% mean RMS error relative to the exact result, for 5 s of latency at 250 Hz;
+// a fixed 250 samples per stage leaves 46% and 36% (zero-phase-bench).
+const double DEFAULT_LOOKAHEAD_TOL = 1e-2;
+const size_t AUTO_LOOKAHEAD = SIZE_MAX;
+
+struct ZeroPhaseStage {
+    iir_config_t sos = {};       // n_channels is ignored
+    // Samples, rounded up to whole blocks. AUTO_LOOKAHEAD for lookahead_for(sos, DEFAULT_LOOKAHEAD_TOL).
+    size_t lookahead = AUTO_LOOKAHEAD;
+};
+
+struct ZeroPhaseConfig {
+    // Each stage is one sosfiltfilt call, in turn, like the notebooks' high-pass then notch
+    std::vector<ZeroPhaseStage> stages;
+    PadType pad = PadType::Constant;
+    size_t block = 25;           // Samples per output block
+};
+
+class ZeroPhaseFilter {
+public:
+    // Throws std::runtime_error on an empty or invalid configuration
+    ZeroPhaseFilter(const ZeroPhaseConfig& config, int n_channels);
+    ~ZeroPhaseFilter();
+
+    // Feeds n samples of [n][n_channels] and appends whatever output became ready to
+    // out, whole blocks at a time. Returns the samples appended.
+    size_t push(const double* x, size_t n, std::vector<double>& out);
+
+    // Ends the recording and appends the rest of the output. A recording shorter than
+    // the padding is padded with what there is, where sosfiltfilt would raise.
+    size_t flush(std::vector<double>& out);
+
+    // Ready for a new recording
+    void reset();
+
+    // Samples from an input to its output at most, once the first block is out
+    size_t latency() const;
+
+    int n_channels() const { return n_ch_; }
+
+private:
+    struct Stage;
+    std::vector<std::unique_ptr<Stage>> stages_;
+    std::vector<double> a_, b_;     // Between stages
+    int n_ch_;
+    size_t block_;
+};
+
+} // namespace nexus
@@ -0,0 +1,90 @@
+# Exports the LDA and per class HMMs trained in hmm.ipynb for the C classifier
+# (code/base-fw/components/classifier), as a binary model and optionally a C header
+# embedding the same bytes for the firmware:
+#   python export_classifier.py --metadata ../../datasets/electrode-brace/50x3/metadata.csv \
+#       --out ../demo/classifier.bin --header ../base-fw/main/classifier_model.h
+import argparse
+import struct
+import numpy as np
+import pandas as pd
+from joblib import load
+
+MAGIC = b'NXHM'
+VERSION = 1
+NAME_LEN = 16
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--lda', default='../demo/lda.joblib')
+parser.add_argument('--hmm', default='../demo/hmm_models.joblib')
+parser.add_argument('--metadata', required=True, help='metadata.csv the models were trained on, for the class names')
+parser.add_argument('--out', required=True)
+parser.add_argument('--header')
+args = parser.parse_args()
+
+lda = load(args.lda)
+models = load(args.hmm)
+# LabelEncoder sorts the labels, model i is class i
+classes = sorted(pd.read_csv(args.metadata)['cls'].unique())
+assert len(classes) == len(models), 'metadata has {} classes but there are {} models'.format(len(classes), len(models))
+
+# transform(x) is affine, recover it as w, b without depending on the solver
+n_features = lda.n_features_in_
+b = lda.transform(np.zeros((1, n_features)))[0]
+w = lda.transform(np.eye(n_features)) - b
+n_components = len(b)
+
+def diag_covars(model):
+    covars = model.covars_
+    return np.diagonal(covars, axis1=1, axis2=2) if covars.ndim == 3 else covars
+
+n_states = models[0].n_components
+blob = bytearray(MAGIC)
+blob += struct.pack('<BBBBHH', VERSION, len(models), n_states, n_components, n_features, 0)
+blob += w.astype('<f4').tobytes() + b.astype('<f4').tobytes()
+
+with np.errstate(divide='ignore'):
+    for name, model in zip(classes, models):
+        assert model.n_components == n_states, 'every class needs the same number of states'
+        blob += str(name).encode()[:NAME_LEN - 1].ljust(NAME_LEN, b'\0')
+        blob += np.log(model.startprob_).astype('<f4').tobytes()
+        blob += np.log(model.transmat_).astype('<f4').tobytes()
+        blob += model.means_.astype('<f4').tobytes()
+        blob += diag_covars(model).astype('<f4').tobytes()
+
+with open(args.out, 'wb') as f:
+    f.write(blob)
+print('{}: {} classes, {} states, LDA {} -> {}, {} bytes'.format(
+    args.out, len(models), n_states, n_features, n_components, len(blob)))
+
+if args.header:
+    lines = ['// Generated by code/ml/export_classifier.py, do not edit',
+             '#pragma once',
+             '#include <stdint.h>',
+             '',
+             'static const uint8_t classifier_model[{}] = {{'.format(len(blob))]
+    for i in range(0, len(blob), 16):
+        lines.append('    ' + ', '.join('0x{:02x}'.format(v) for v in blob[i:i + 16]) + ',')
+    lines += ['};', '']
+    with open(args.header, 'w') as f:
+        f.write('\n'.join(lines))
+    print('{}: C header'.format(args.header))
+
+# Check the float32 log space forward pass the firmware runs against hmmlearn
+def forward(model, z):
+    log_start = np.log(model.startprob_).astype(np.float32)
+    log_trans = np.log(model.transmat_).astype(np.float32)
+    var = diag_covars(model)
+    log_b = -0.5 * (np.log(2 * np.pi * var).sum(axis=1) + (((z[:, None, :] - model.means_) ** 2) / var).sum(axis=2))
+    alpha = log_start + log_b[0]
+    for t in range(1, len(z)):
+        alpha = np.logaddexp.reduce(alpha[:, None] + log_trans, axis=0) + log_b[t]
+    return np.logaddexp.reduce(alpha)
+
+rng = np.random.default_rng(0)
+with np.errstate(divide='ignore'):
+    worst = 0
+    for _ in range(10):
+        z = lda.transform(rng.normal(size=(37, n_features)))
+        for model in models:
+            worst = max(worst, abs(forward(model, z) - model.score(z)))
+print('forward pass vs hmmlearn score(): max abs diff {:.3g}'.format(worst))
@@ -0,0 +1,43 @@
+# NumPy side of code/host features-bench. Times window_generator + mav/wl/zc/ssc
+# over the same recordings and checks the C features written with --out:
+#   features-bench --out feats.npy rec1.npy rec2.npy ...
+#   python features_bench.py feats.npy rec1.npy rec2.npy ...
+import sys
+import time
+import numpy as np
+from feature_extractors import window_generator, mav, wl, zc, ssc
+
+WINDOW = 100 # 400ms at 250SPS
+STRIDE = 25  # 100ms
+REPEAT = 20
+
+if len(sys.argv) < 3:
+    print('usage: features_bench.py <c_features.npy> <rec.npy>...')
+    sys.exit(2)
+
+c_features = np.load(sys.argv[1])
+paths = sys.argv[2:]
+
+samples = 0
+windows = 0
+start = time.perf_counter()
+for path in paths:
+    emg = np.load(path)
+    for _ in range(REPEAT):
+        emg_windows = window_generator(emg, WINDOW, STRIDE)
+        features = np.concatenate((mav(emg_windows), wl(emg_windows), zc(emg_windows), ssc(emg_windows)), axis=1)
+    samples += len(emg) * REPEAT
+    windows += len(emg_windows) * REPEAT
+    if path == paths[0]:
+        first = features
+elapsed = time.perf_counter() - start
+
+print('{} files, {} samples, {} windows of {}/{}'.format(len(paths), samples, windows, WINDOW, STRIDE))
+print('numpy {:8.1f} ns/sample {:8.0f} windows/s'.format(elapsed * 1e9 / samples, windows / elapsed))
+
+# The C side runs in float32, counts must match exactly away from the thresholds
+n_ch = first.shape[1] // 4
+ok = np.allclose(c_features[:, :2 * n_ch], first[:, :2 * n_ch], rtol=1e-4, atol=1e-3)
+count_mismatch = np.count_nonzero(c_features[:, 2 * n_ch:] != first[:, 2 * n_ch:])
+print('mav/wl within tolerance: {}, zc/ssc mismatches: {}'.format(ok, count_mismatch))
+sys.exit(0 if ok else 1)
@@ -0,0 +1,37 @@
+# Reference output for the firmware IIR cascade (code/host nexus-filter).
+# Writes <name>.sos.txt with the coefficients and <name>.sosfilt.npy with the causal
+# scipy output, then check with:
+#   nexus-filter-f64 --sos <name>.sos.txt --ref <name>.sosfilt.npy <name>.npy out.npy
+# and <name>.sosfiltfilt.npy with the zero phase preprocessing of the notebooks, for
+#   nexus-filtfilt --pad <padtype> --ref <name>.sosfiltfilt.npy <name>.npy out.npy
+import sys
+import numpy as np
+import scipy.signal
+
+FS = 250
+
+if len(sys.argv) < 2:
+    print('usage: filter_reference.py <recording.npy> [fs] [padtype]')
+    sys.exit(2)
+
+path = sys.argv[1]
+fs = float(sys.argv[2]) if len(sys.argv) > 2 else FS
+padtype = sys.argv[3] if len(sys.argv) > 3 else 'constant'
+
+# Same filters as signal_processing.py, but causal like the board
+sos_highpass = scipy.signal.butter(4, 0.5, 'highpass', fs=fs, output='sos')
+sos_notch_50hz = scipy.signal.butter(4, [48,52], 'bandstop', fs=fs, output='sos')
+sos = np.vstack([sos_highpass, sos_notch_50hz])
+
+raw = np.load(path).astype(np.float64)
+filtered = scipy.signal.sosfilt(sos, raw, axis=0)
+
+# Offline like signal_processing.py (constant) or hmm.ipynb (even), one call per design
+zero_phase = scipy.signal.sosfiltfilt(sos_highpass, raw, axis=0, padtype=None if padtype == 'none' else padtype)
+zero_phase = scipy.signal.sosfiltfilt(sos_notch_50hz, zero_phase, axis=0, padtype=None if padtype == 'none' else padtype)
+
+base = path[:-len('.npy')] if path.endswith('.npy') else path
+np.savetxt(base + '.sos.txt', sos, fmt='%.17g')
+np.save(base + '.sosfilt.npy', filtered)
+np.save(base + '.sosfiltfilt.npy', zero_phase)
+print('{}: {} sections, {} samples x {} channels'.format(path, len(sos), *raw.shape))
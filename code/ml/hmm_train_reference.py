@@ -0,0 +1,60 @@
+# hmmlearn side of code/host nexus-train. Reruns every restart of the report with
+# hmmlearn from the same initial means, on the same LDA observations, the way
+# get_model() in hmm.ipynb fits, and compares the final log-likelihoods and the time:
+#   nexus-train --report report.csv --observations z.npy f2.npy
+#   python hmm_train_reference.py z.npy report.csv
+import sys
+import time
+import numpy as np
+import pandas as pd
+from hmmlearn import hmm
+
+TOLERANCE = 1e-3 # Relative, on the log-likelihood of a class's training sequences
+
+if len(sys.argv) < 3:
+    print('usage: hmm_train_reference.py <observations.npy> <report.csv>')
+    sys.exit(2)
+
+z = np.load(sys.argv[1])
+trials = pd.read_csv(sys.argv[1][:-len('.npy')] + '.csv')
+trials = trials[trials['split'] == 'train']
+report = pd.read_csv(sys.argv[2])
+
+def make_ltr_transition(n):
+    transmat = np.zeros((n, n))
+    for i in range(n):
+        if i == (n - 1):
+            transmat[i, i] = 1.0
+        else:
+            transmat[i, i] = 0.5
+            transmat[i, i + 1] = 0.5
+    return transmat
+
+worst = 0
+python_seconds = 0
+for _, run in report.iterrows():
+    rows = trials[trials['cls'] == run['cls']]
+    X = np.concatenate([z[r['first']:r['first'] + r['windows']] for _, r in rows.iterrows()])
+    lengths = list(rows['windows'])
+    states = int(run['states'])
+
+    start = time.perf_counter()
+    model = hmm.GaussianHMM(n_components=states, covariance_type='diag', n_iter=int(run['n_iter']),
+                            tol=float(run['tol']), init_params='c', params='cmt')
+    startprob = np.zeros(states)
+    startprob[0] = 1.0
+    model.startprob_ = startprob
+    model.transmat_ = make_ltr_transition(states)
+    model.means_ = np.array([float(v) for v in run['init_means'].split()]).reshape(states, -1)
+    model.fit(X, lengths)
+    score = model.score(X, lengths)
+    python_seconds += time.perf_counter() - start
+
+    diff = abs(score - run['log_likelihood']) / abs(score)
+    worst = max(worst, diff)
+    print('{:12s} restart {}: hmmlearn {:12.4f} in {:3d} iterations, C++ {:12.4f} in {:3d}, rel diff {:.2g}'.format(
+        run['cls'], run['restart'], score, model.monitor_.iter, run['log_likelihood'], run['iterations'], diff))
+
+print('{} fits: hmmlearn {:.3f} s, C++ {:.3f} s summed over the fits'.format(len(report), python_seconds, report['seconds'].sum()))
+print('log-likelihood max rel diff {:.3g} ({})'.format(worst, 'ok' if worst < TOLERANCE else 'FAIL'))
+sys.exit(0 if worst < TOLERANCE else 1)
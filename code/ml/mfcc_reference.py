@@ -0,0 +1,37 @@
+# Checks the C MFCC engine (code/host mfcc-bench --out) against librosa over the
+# F2 windows of a recording, and times librosa for comparison:
+#   mfcc-bench --out mfcc.npy rec.npy
+#   python mfcc_reference.py mfcc.npy rec.npy
+import sys
+import time
+import numpy as np
+from librosa.feature import mfcc
+from feature_extractors import window_generator
+
+WINDOW = 100 # 400ms at 250SPS
+STRIDE = 25  # 100ms
+SR = 250
+
+if len(sys.argv) < 3:
+    print('usage: mfcc_reference.py <c_mfcc.npy> <rec.npy>')
+    sys.exit(2)
+
+c_mfcc = np.load(sys.argv[1])
+emg = np.load(sys.argv[2])
+emg_windows = window_generator(emg, WINDOW, STRIDE)
+
+# Exactly as F2 calls it, one window at a time
+start = time.perf_counter()
+reference = np.stack([mfcc(y=window.T, sr=SR, n_mfcc=6, n_mels=15, n_fft=window.shape[0], center=True)
+                      for window in emg_windows])
+elapsed = time.perf_counter() - start
+
+# (windows, channels, n_mfcc, 1) to the (windows, n_mfcc * channels) order F2 flattens to
+reference = np.swapaxes(reference[..., 0], 1, 2).reshape(len(emg_windows), -1)
+
+diff = np.abs(c_mfcc - reference)
+print('librosa: {:.1f} us per window'.format(elapsed * 1e6 / len(emg_windows)))
+print('max abs diff {:.3g} dB, mean {:.3g} dB'.format(diff.max(), diff.mean()))
+ok = np.allclose(c_mfcc, reference, rtol=1e-3, atol=1e-2)
+print('within tolerance: {}'.format(ok))
+sys.exit(0 if ok else 1)